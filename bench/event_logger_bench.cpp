@@ -0,0 +1,276 @@
+// Microbenchmark: keystroke formatting in EventLogger, before and after the
+// compile-time key table. The "legacy" functions are copies of the previous
+// switch/ostringstream implementation, kept here only for comparison.
+//
+// Usage: WinOpAutoLoggerBench [iterations]
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "event_logger.h"
+#include "key_table.h"
+
+// Count every heap allocation made by the process
+static std::atomic<std::uint64_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace legacy {
+
+std::string VKeyToKeyName(USHORT vKey) {
+    switch (vKey) {
+        case 0x41: return "A"; case 0x42: return "B"; case 0x43: return "C"; case 0x44: return "D";
+        case 0x45: return "E"; case 0x46: return "F"; case 0x47: return "G"; case 0x48: return "H";
+        case 0x49: return "I"; case 0x4A: return "J"; case 0x4B: return "K"; case 0x4C: return "L";
+        case 0x4D: return "M"; case 0x4E: return "N"; case 0x4F: return "O"; case 0x50: return "P";
+        case 0x51: return "Q"; case 0x52: return "R"; case 0x53: return "S"; case 0x54: return "T";
+        case 0x55: return "U"; case 0x56: return "V"; case 0x57: return "W"; case 0x58: return "X";
+        case 0x59: return "Y"; case 0x5A: return "Z";
+        case 0x30: return "0"; case 0x31: return "1"; case 0x32: return "2"; case 0x33: return "3";
+        case 0x34: return "4"; case 0x35: return "5"; case 0x36: return "6"; case 0x37: return "7";
+        case 0x38: return "8"; case 0x39: return "9";
+        case VK_SPACE: return "SPACE";
+        case VK_RETURN: return "ENTER";
+        case VK_BACK: return "BACKSPACE";
+        case VK_TAB: return "TAB";
+        case VK_ESCAPE: return "ESC";
+        case VK_DELETE: return "DELETE";
+        case VK_INSERT: return "INSERT";
+        case VK_HOME: return "HOME";
+        case VK_END: return "END";
+        case VK_PRIOR: return "PAGE_UP";
+        case VK_NEXT: return "PAGE_DOWN";
+        case VK_UP: return "UP_ARROW";
+        case VK_DOWN: return "DOWN_ARROW";
+        case VK_LEFT: return "LEFT_ARROW";
+        case VK_RIGHT: return "RIGHT_ARROW";
+        case VK_SHIFT: return "SHIFT";
+        case VK_CONTROL: return "CTRL";
+        case VK_MENU: return "ALT";
+        case VK_CAPITAL: return "CAPS_LOCK";
+        case VK_LWIN: return "LEFT_WIN";
+        case VK_RWIN: return "RIGHT_WIN";
+        case VK_F1: return "F1"; case VK_F2: return "F2"; case VK_F3: return "F3";
+        case VK_F4: return "F4"; case VK_F5: return "F5"; case VK_F6: return "F6";
+        case VK_F7: return "F7"; case VK_F8: return "F8"; case VK_F9: return "F9";
+        case VK_F10: return "F10"; case VK_F11: return "F11"; case VK_F12: return "F12";
+        case VK_OEM_1: return "SEMICOLON";
+        case VK_OEM_PLUS: return "EQUALS";
+        case VK_OEM_COMMA: return "COMMA";
+        case VK_OEM_MINUS: return "MINUS";
+        case VK_OEM_PERIOD: return "PERIOD";
+        case VK_OEM_2: return "SLASH";
+        case VK_OEM_3: return "BACKTICK";
+        case VK_OEM_4: return "LEFT_BRACKET";
+        case VK_OEM_5: return "BACKSLASH";
+        case VK_OEM_6: return "RIGHT_BRACKET";
+        case VK_OEM_7: return "QUOTE";
+        default:
+            std::ostringstream oss;
+            oss << "VK_0x" << std::hex << vKey;
+            return oss.str();
+    }
+}
+
+std::string VKeyToChar(USHORT vKey, bool shiftPressed, bool capsLockOn) {
+    if (vKey >= 0x41 && vKey <= 0x5A) {
+        char letter = static_cast<char>('A' + (vKey - 0x41));
+        if (!(shiftPressed ^ capsLockOn)) {
+            letter = static_cast<char>(letter - 'A' + 'a');
+        }
+        return std::string(1, letter);
+    }
+    if (vKey >= 0x30 && vKey <= 0x39) {
+        if (shiftPressed) {
+            const char* shiftedNumbers = ")!@#$%^&*(";
+            return std::string(1, shiftedNumbers[vKey - 0x30]);
+        }
+        return std::string(1, static_cast<char>('0' + (vKey - 0x30)));
+    }
+    switch (vKey) {
+        case VK_SPACE: return " ";
+        case VK_OEM_1: return shiftPressed ? ":" : ";";
+        case VK_OEM_PLUS: return shiftPressed ? "+" : "=";
+        case VK_OEM_COMMA: return shiftPressed ? "<" : ",";
+        case VK_OEM_MINUS: return shiftPressed ? "_" : "-";
+        case VK_OEM_PERIOD: return shiftPressed ? ">" : ".";
+        case VK_OEM_2: return shiftPressed ? "?" : "/";
+        case VK_OEM_3: return shiftPressed ? "~" : "`";
+        case VK_OEM_4: return shiftPressed ? "{" : "[";
+        case VK_OEM_5: return shiftPressed ? "|" : "\\";
+        case VK_OEM_6: return shiftPressed ? "}" : "]";
+        case VK_OEM_7: return shiftPressed ? "\"" : "'";
+        default: return "";
+    }
+}
+
+std::string BuildKeyboardJson(std::uint64_t timestamp, USHORT vKey, bool isKeyUp, const std::string& charValue) {
+    std::string keyName = VKeyToKeyName(vKey);
+    std::string action = isKeyUp ? "keyup" : "keydown";
+
+    std::ostringstream json;
+    json << "{";
+    json << "\"timestamp\":" << timestamp << ",";
+    json << "\"type\":\"keyboard\",";
+    json << "\"action\":\"" << action << "\",";
+    json << "\"key\":\"" << keyName << "\"";
+    if (!charValue.empty()) {
+        json << ",\"char\":\"" << charValue << "\"";
+    } else {
+        json << ",\"char\":null";
+    }
+    json << "}";
+    return json.str();
+}
+
+}  // namespace legacy
+
+namespace {
+
+struct BenchEvent {
+    USHORT vKey;
+    bool shift;
+    bool isKeyUp;
+};
+
+// Typical typing: prose with capitals, digits, punctuation, edits and navigation
+std::vector<BenchEvent> BuildCorpus() {
+    const USHORT keys[] = {
+        0x54, 0x48, 0x45, VK_SPACE, 0x51, 0x55, 0x49, 0x43, 0x4B, VK_SPACE, 0x42, 0x52, 0x4F, 0x57, 0x4E,
+        VK_OEM_COMMA, VK_SPACE, 0x31, 0x32, 0x33, VK_OEM_PERIOD, VK_BACK, VK_BACK, VK_OEM_7, VK_OEM_5,
+        VK_RETURN, VK_LEFT, VK_RIGHT, VK_TAB, VK_SHIFT, VK_CONTROL, VK_F5, 0x5D, 0xA0, VK_OEM_2,
+    };
+
+    std::vector<BenchEvent> corpus;
+    bool shift = false;
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        shift = (i % 7) == 0;
+        corpus.push_back({ keys[i], shift, false });
+        corpus.push_back({ keys[i], shift, true });
+    }
+    return corpus;
+}
+
+char TableChar(USHORT vKey, bool shift, bool capsLockOn) {
+    // Same resolution as EventLogger::VKeyToCharCode, with the modifier state passed in
+    const KeyInfo& info = KEY_TABLE[vKey];
+    bool shifted = shift ^ (info.capsLockApplies && capsLockOn);
+    return shifted ? info.shifted : info.normal;
+}
+
+struct BenchResult {
+    double nsPerEvent;
+    double allocationsPerEvent;
+    std::uint64_t bytes;
+};
+
+BenchResult RunLegacy(const std::vector<BenchEvent>& corpus, int iterations) {
+    std::uint64_t bytes = 0;
+    std::uint64_t allocationsBefore = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            const BenchEvent& e = corpus[i];
+            std::string charValue = legacy::VKeyToChar(e.vKey, e.shift, false);
+            bytes += legacy::BuildKeyboardJson(1000000 + i, e.vKey, e.isKeyUp, charValue).size() + 1;
+        }
+    }
+
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double events = static_cast<double>(corpus.size()) * iterations;
+    return { elapsed / events, (g_allocations.load() - allocationsBefore) / events, bytes };
+}
+
+BenchResult RunTable(const std::vector<BenchEvent>& corpus, int iterations) {
+    std::uint64_t bytes = 0;
+    char line[EventLogger::MAX_LOG_LINE];
+    std::uint64_t allocationsBefore = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            const BenchEvent& e = corpus[i];
+            char charValue = TableChar(e.vKey, e.shift, false);
+            bytes += EventLogger::FormatKeyboardEvent(line, sizeof(line), 1000000 + i, e.vKey, e.isKeyUp, charValue);
+        }
+    }
+
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double events = static_cast<double>(corpus.size()) * iterations;
+    return { elapsed / events, (g_allocations.load() - allocationsBefore) / events, bytes };
+}
+
+// Both implementations must produce the same lines, except that quote and
+// backslash are now escaped (the legacy output was invalid JSON for them)
+int CountMismatches() {
+    int mismatches = 0;
+    char line[EventLogger::MAX_LOG_LINE];
+    for (int vKey = 0; vKey < 256; ++vKey) {
+        for (int shift = 0; shift < 2; ++shift) {
+            for (int caps = 0; caps < 2; ++caps) {
+                std::string legacyChar = legacy::VKeyToChar(static_cast<USHORT>(vKey), shift != 0, caps != 0);
+                char tableChar = TableChar(static_cast<USHORT>(vKey), shift != 0, caps != 0);
+                std::string expected = legacy::BuildKeyboardJson(42, static_cast<USHORT>(vKey), false, legacyChar) + "\n";
+                size_t length = EventLogger::FormatKeyboardEvent(line, sizeof(line), 42, static_cast<USHORT>(vKey), false, tableChar);
+                bool escaped = tableChar == '"' || tableChar == '\\';
+                if (!escaped && expected != std::string(line, length)) {
+                    std::cout << "[ERROR] Mismatch for VK 0x" << std::hex << vKey << std::dec << ": "
+                              << expected << "        vs " << std::string(line, length);
+                    ++mismatches;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+    if (iterations <= 0) {
+        iterations = 20000;
+    }
+
+    int mismatches = CountMismatches();
+    if (mismatches > 0) {
+        std::cout << "[ERROR] " << mismatches << " formatting mismatches\n";
+        return 1;
+    }
+    std::cout << "[OK] Table output matches the legacy formatter for all 256 keys\n";
+
+    std::vector<BenchEvent> corpus = BuildCorpus();
+
+    // Warm up both paths before timing
+    RunLegacy(corpus, iterations / 10 + 1);
+    RunTable(corpus, iterations / 10 + 1);
+
+    BenchResult before = RunLegacy(corpus, iterations);
+    BenchResult after = RunTable(corpus, iterations);
+
+    std::cout << "\n=== Keyboard event formatting (" << corpus.size() * iterations << " events) ===\n";
+    std::cout << "Legacy (switch + ostringstream): " << before.nsPerEvent << " ns/event, "
+              << before.allocationsPerEvent << " allocations/event\n";
+    std::cout << "Table  (constexpr + to_chars):   " << after.nsPerEvent << " ns/event, "
+              << after.allocationsPerEvent << " allocations/event\n";
+    std::cout << "Speedup: " << before.nsPerEvent / after.nsPerEvent << "x ("
+              << before.bytes << " vs " << after.bytes << " bytes formatted)\n";
+    return 0;
+}
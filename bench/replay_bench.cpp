@@ -0,0 +1,574 @@
+// Replay benchmark: feeds a recorded event log (JSON lines or the binary
+// format) through InputPipeline::ProcessInput, the same path WM_INPUT takes,
+// and reports throughput and per-event latency. Suggestions use a fixed-latency
+// fake completion by default so logging, storage and injection can be measured
+// without network noise; injection runs dry unless --inject is given.
+//
+// Usage: WinOpAutoBench [options] [events_file]
+//   events_file           Recorded log (default: input_events.txt)
+//   --rate <n>            Events per second, 0 = as fast as possible (default: 0)
+//   --repeat <n>          Replay the recording n times (default: 1)
+//   --llm-latency <ms>    Fake completion latency (default: 200)
+//   --real-llm            Use the completion worker instead of the fake
+//   --native-llm          Use the built-in WinHTTP client instead of the fake
+//   --accept              Press Right Ctrl after each suggestion to exercise injection
+//   --inject              Really call SendInput when accepting (default: dry run)
+//   --log <path>          Event log written during the run (default: bench_events.txt)
+//   --binary-log          Write the event log in the binary format
+//   --sync-log            Write the event log on the input thread instead of the writer thread
+//   --archive <dir>       Rotate the event log into 64KB compressed segments under dir
+//   --prefetch-idle <ms>  Speculative completion after this much idle time (default: 0 = off)
+//   --trace               Keep per-event console traces
+//   --capture-bench <n>   Instead of replaying, inject n F24 taps with SendInput and compare the
+//                         raw input and low-level hook capture backends (latency and CPU per event)
+
+#include <windows.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "input_pipeline.h"
+#include "special_keys.h"
+#include "input_injection.h"
+#include "event_logger.h"
+#include "key_table.h"
+#include "completion_client.h"
+#include "native_llm_client.h"
+#include "suggestion_service.h"
+#include "typed_context.h"
+#include "shared_journal.h"
+#include "diagnostics.h"
+#include "instrumentation.h"
+#include "capture_thread.h"
+#include "startup_timeline.h"
+
+struct BenchOptions {
+    std::string eventsFile = "input_events.txt";
+    std::string logFile = "bench_events.txt";
+    std::string archiveDir;
+    std::uint32_t rate = 0;
+    std::uint32_t repeat = 1;
+    DWORD llmLatencyMs = 200;
+    DWORD prefetchIdleMs = 0;
+    bool realLlm = false;
+    bool nativeLlm = false;
+    bool accept = false;
+    bool inject = false;
+    bool binaryLog = false;
+    bool syncLog = false;
+    bool trace = false;
+    std::uint32_t captureEvents = 0;
+};
+
+// One synthetic WM_INPUT event
+struct ReplayEvent {
+    RAWINPUT raw;
+    POINT cursorPos;
+};
+
+static BenchOptions g_options;
+static std::uint64_t g_startTicks = 0;
+static std::uint64_t g_ticksPerSecond = 1;
+static std::uint64_t g_suggestionsReady = 0;
+static std::uint64_t g_acceptedEvents = 0;
+
+// --capture-bench: send time of the F24 press in flight, and its latency once captured
+static std::uint64_t g_captureSendTicks = 0;
+static bool g_captureReceived = false;
+static LatencyHistogram* g_captureLatencyNs = nullptr;
+
+namespace {
+
+RAWINPUT MakeKeyboardInput(USHORT vKey, bool isKeyUp, bool extended) {
+    RAWINPUT raw = {};
+    raw.header.dwType = RIM_TYPEKEYBOARD;
+    raw.header.dwSize = sizeof(RAWINPUT);
+    raw.data.keyboard.VKey = vKey;
+    raw.data.keyboard.MakeCode = static_cast<USHORT>(MapVirtualKeyW(vKey, MAPVK_VK_TO_VSC));
+    raw.data.keyboard.Flags = static_cast<USHORT>((isKeyUp ? RI_KEY_BREAK : RI_KEY_MAKE) | (extended ? RI_KEY_E0 : 0));
+    raw.data.keyboard.Message = isKeyUp ? WM_KEYUP : WM_KEYDOWN;
+    return raw;
+}
+
+RAWINPUT MakeButtonInput(USHORT buttonFlags) {
+    RAWINPUT raw = {};
+    raw.header.dwType = RIM_TYPEMOUSE;
+    raw.header.dwSize = sizeof(RAWINPUT);
+    raw.data.mouse.usButtonFlags = buttonFlags;
+    return raw;
+}
+
+// A logged motion summary replays as one raw move (its net movement) or one wheel event
+RAWINPUT MakeMotionInput(LONG deltaX, LONG deltaY, short wheelDelta) {
+    RAWINPUT raw = MakeButtonInput(wheelDelta != 0 ? RI_MOUSE_WHEEL : 0);
+    raw.data.mouse.usButtonData = static_cast<USHORT>(wheelDelta);
+    raw.data.mouse.lLastX = deltaX;
+    raw.data.mouse.lLastY = deltaY;
+    return raw;
+}
+
+USHORT ButtonFlags(std::string_view button, bool isUp) {
+    if (button == "left") return isUp ? RI_MOUSE_LEFT_BUTTON_UP : RI_MOUSE_LEFT_BUTTON_DOWN;
+    if (button == "right") return isUp ? RI_MOUSE_RIGHT_BUTTON_UP : RI_MOUSE_RIGHT_BUTTON_DOWN;
+    if (button == "middle") return isUp ? RI_MOUSE_MIDDLE_BUTTON_UP : RI_MOUSE_MIDDLE_BUTTON_DOWN;
+    return 0;
+}
+
+// Inverse of the log's key names; unnamed keys are logged as VK_0x<hex>
+bool KeyNameToVKey(std::string_view name, USHORT& vKey) {
+    for (size_t i = 0; i < KEY_TABLE.size(); ++i) {
+        if (name == KEY_TABLE[i].name) {
+            vKey = static_cast<USHORT>(i);
+            return true;
+        }
+    }
+    if (name.substr(0, 5) == "VK_0x") {
+        vKey = static_cast<USHORT>(std::strtoul(std::string(name.substr(5)).c_str(), nullptr, 16));
+        return true;
+    }
+    return false;
+}
+
+// Value of "field":"..." in one of our own log lines (no escapes in the fields we read)
+std::string_view StringField(std::string_view line, std::string_view field) {
+    std::string key = "\"" + std::string(field) + "\":\"";
+    size_t start = line.find(key);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    start += key.size();
+    size_t end = line.find('"', start);
+    return end == std::string_view::npos ? std::string_view() : line.substr(start, end - start);
+}
+
+long NumberField(std::string_view line, std::string_view field) {
+    std::string key = "\"" + std::string(field) + "\":";
+    size_t start = line.find(key);
+    return start == std::string_view::npos ? 0 : std::strtol(line.data() + start + key.size(), nullptr, 10);
+}
+
+bool LoadJsonEvents(std::ifstream& file, std::vector<ReplayEvent>& events) {
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string_view type = StringField(line, "type");
+        std::string_view action = StringField(line, "action");
+
+        if (type == "keyboard") {
+            USHORT vKey;
+            if (!KeyNameToVKey(StringField(line, "key"), vKey)) {
+                continue;
+            }
+            events.push_back({ MakeKeyboardInput(vKey, action == "keyup", false), { 0, 0 } });
+        } else if (type == "mouse" && (action == "move" || action == "wheel")) {
+            POINT cursorPos = { NumberField(line, "x"), NumberField(line, "y") };
+            if (action == "wheel") {
+                events.push_back({ MakeMotionInput(0, 0, static_cast<short>(NumberField(line, "delta"))), cursorPos });
+            } else {
+                events.push_back({ MakeMotionInput(cursorPos.x - NumberField(line, "from_x"),
+                                                   cursorPos.y - NumberField(line, "from_y"), 0), cursorPos });
+            }
+        } else if (type == "mouse") {
+            bool isUp = action.size() > 2 && action.substr(action.size() - 2) == "up";
+            std::string_view button = action.substr(0, action.size() - (isUp ? 2 : 4));
+            USHORT flags = ButtonFlags(button, isUp);
+            if (flags == 0) {
+                continue;
+            }
+            POINT cursorPos = { NumberField(line, "x"), NumberField(line, "y") };
+            events.push_back({ MakeButtonInput(flags), cursorPos });
+        }
+    }
+    return true;
+}
+
+bool LoadBinaryEvents(std::ifstream& file, std::vector<ReplayEvent>& events) {
+    BinaryLogHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.version != BINARY_LOG_VERSION || header.recordSize != sizeof(BinaryLogRecord)) {
+        std::cout << "[ERROR] Unsupported binary event log\n";
+        return false;
+    }
+
+    static const char* const BUTTON_NAMES[] = { "", "left", "right", "middle" };
+    BinaryLogRecord record;
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        bool isUp = (record.flags & BINARY_RECORD_FLAG_UP) != 0;
+        if (record.kind == BINARY_RECORD_KEYBOARD) {
+            events.push_back({ MakeKeyboardInput(record.vKey, isUp, false), { 0, 0 } });
+        } else if (record.kind == BINARY_RECORD_MOUSE_BUTTON && record.button <= BINARY_BUTTON_MIDDLE) {
+            USHORT flags = ButtonFlags(BUTTON_NAMES[record.button], isUp);
+            if (flags != 0) {
+                events.push_back({ MakeButtonInput(flags), { record.x, record.y } });
+            }
+        } else if (record.kind == BINARY_RECORD_MOUSE_MOVE) {
+            events.push_back({ MakeMotionInput(record.x - record.startX, record.y - record.startY, 0), { record.x, record.y } });
+        } else if (record.kind == BINARY_RECORD_MOUSE_WHEEL) {
+            events.push_back({ MakeMotionInput(0, 0, static_cast<std::int16_t>(record.reserved)), { record.x, record.y } });
+        }
+    }
+    return true;
+}
+
+bool LoadEvents(const std::string& path, std::vector<ReplayEvent>& events) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cout << "[ERROR] Could not open " << path << "\n";
+        return false;
+    }
+
+    char magic[sizeof(BINARY_LOG_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    bool isBinary = file.gcount() == sizeof(magic) && std::memcmp(magic, BINARY_LOG_MAGIC, sizeof(magic)) == 0;
+    file.clear();
+    file.seekg(0);
+
+    bool loaded = isBinary ? LoadBinaryEvents(file, events) : LoadJsonEvents(file, events);
+    if (loaded && events.empty()) {
+        std::cout << "[ERROR] No replayable events in " << path << "\n";
+        return false;
+    }
+    return loaded;
+}
+
+bool FakeCompletion(const std::string& context, std::string& completion) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(g_options.llmLatencyMs));
+    completion = "bench completion";
+    return true;
+}
+
+std::uint64_t BenchTimestamp() {
+    return Instrumentation::TicksToMicros(Instrumentation::NowTicks() - g_startTicks);
+}
+
+// Per-event latency is recorded in nanoseconds; most events take well under a microsecond
+void Replay(const ReplayEvent& event, LatencyHistogram& latencyNs) {
+    std::uint64_t timestamp = BenchTimestamp();
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+    InputPipeline::ProcessInput(event.raw, timestamp, event.cursorPos);
+    latencyNs.Record((Instrumentation::NowTicks() - startTicks) * 1000000000 / g_ticksPerSecond);
+}
+
+LRESULT CALLBACK BenchWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_TIMER && wParam == PREFETCH_TIMER_ID) {
+        InputPipeline::OnPrefetchTimer(BenchTimestamp());
+        return 0;
+    }
+    if (message == WM_TIMER && wParam == MOTION_FLUSH_TIMER_ID) {
+        InputPipeline::OnMotionFlushTimer(BenchTimestamp());
+        return 0;
+    }
+    if (message != WM_SUGGESTION_READY) {
+        return DefWindowProc(hWnd, message, wParam, lParam);
+    }
+
+    g_suggestionsReady++;
+    SpecialKeyHandler::OnSuggestionReady(static_cast<std::uint32_t>(wParam));
+
+    if (g_options.accept) {
+        // Right Ctrl tap: accepts the pending suggestion through the injector
+        POINT origin = { 0, 0 };
+        InputPipeline::ProcessInput(MakeKeyboardInput(VK_CONTROL, false, true), BenchTimestamp(), origin);
+        InputPipeline::ProcessInput(MakeKeyboardInput(VK_CONTROL, true, true), BenchTimestamp(), origin);
+        g_acceptedEvents += 2;
+    }
+    return 0;
+}
+
+void PumpMessages() {
+    MSG msg;
+    while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+        DispatchMessage(&msg);
+    }
+}
+
+bool OnBenchCapturedInput(const RAWINPUT& raw, std::uint64_t timestamp, POINT cursorPos) {
+    const RAWKEYBOARD& kb = raw.data.keyboard;
+    if (raw.header.dwType == RIM_TYPEKEYBOARD && kb.VKey == VK_F24 && !(kb.Flags & RI_KEY_BREAK) && !g_captureReceived) {
+        g_captureLatencyNs->Record((Instrumentation::NowTicks() - g_captureSendTicks) * 1000000000 / g_ticksPerSecond);
+        g_captureReceived = true;
+    }
+    return true;
+}
+
+LRESULT CALLBACK CaptureBenchWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_CAPTURED_INPUT) {
+        CaptureThread::DrainInput(OnBenchCapturedInput);
+        return 0;
+    }
+    return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+std::uint64_t ProcessCpuMicros() {
+    FILETIME creation, exitTime, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user);
+    auto toMicros = [](const FILETIME& time) {
+        return ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+    };
+    return toMicros(kernel) + toMicros(user);
+}
+
+// Time from SendInput to the injected key reaching the UI-thread handler, per backend.
+// The taps carry no INJECTED_INPUT_TAG, so the capture thread treats them like real input.
+// F24 is unassigned almost everywhere, but it does go to the foreground window.
+void RunCaptureBackend(HWND window, CaptureBackend backend, std::uint32_t count) {
+    if (!CaptureThread::Start(window, BenchTimestamp, backend)) {
+        std::cout << "[ERROR] Could not start the " << CaptureThread::GetBackendName(backend) << " backend\n";
+        return;
+    }
+
+    auto latencyNs = std::make_unique<LatencyHistogram>();
+    g_captureLatencyNs = latencyNs.get();
+    std::uint64_t missed = 0;
+    std::uint64_t droppedBefore = Instrumentation::GetCounter(Counter::CaptureQueueOverflow);
+
+    INPUT tap[2] = {};
+    tap[0].type = INPUT_KEYBOARD;
+    tap[0].ki.wVk = VK_F24;
+    tap[1] = tap[0];
+    tap[1].ki.dwFlags = KEYEVENTF_KEYUP;
+
+    std::uint64_t cpuStart = ProcessCpuMicros();
+    std::uint64_t wallStart = Instrumentation::NowTicks();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        g_captureReceived = false;
+        g_captureSendTicks = Instrumentation::NowTicks();
+        SendInput(2, tap, sizeof(INPUT));
+
+        // Sleep in the message wait so the CPU figure is capture work, not polling
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+        while (!g_captureReceived && std::chrono::steady_clock::now() < deadline) {
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, 10, QS_ALLINPUT);
+            PumpMessages();
+        }
+        if (!g_captureReceived) {
+            missed++;
+        }
+    }
+    std::uint64_t wallMicros = Instrumentation::TicksToMicros(Instrumentation::NowTicks() - wallStart);
+    std::uint64_t cpuMicros = ProcessCpuMicros() - cpuStart;
+
+    CaptureThread::Stop();
+    PumpMessages();
+    g_captureLatencyNs = nullptr;
+
+    std::cout << "\n=== Capture backend: " << CaptureThread::GetBackendName(backend) << " (" << count << " taps) ===\n";
+    std::cout << "SendInput to handler (ns): mean " << static_cast<std::uint64_t>(latencyNs->GetMean())
+              << ", p50 " << latencyNs->GetPercentile(50)
+              << ", p90 " << latencyNs->GetPercentile(90)
+              << ", p99 " << latencyNs->GetPercentile(99)
+              << ", max " << latencyNs->GetMax() << "\n";
+    std::cout << "Process CPU: " << cpuMicros / 1000 << "ms over " << wallMicros / 1000 << "ms, "
+              << (count ? static_cast<double>(cpuMicros) / count : 0.0) << "us per tap\n";
+    std::cout << "Missed taps: " << missed << ", queue overflows: "
+              << (Instrumentation::GetCounter(Counter::CaptureQueueOverflow) - droppedBefore) << "\n";
+}
+
+int RunCaptureBench(std::uint32_t count) {
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = CaptureBenchWindowProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = L"WinOpAutoCaptureBench";
+    RegisterClassExW(&wc);
+    HWND window = CreateWindowExW(0, wc.lpszClassName, L"WinOpAutoCaptureBench", 0, 0, 0, 0, 0,
+                                  HWND_MESSAGE, nullptr, wc.hInstance, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create message window\n";
+        return 1;
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    g_ticksPerSecond = static_cast<std::uint64_t>(frequency.QuadPart);
+    g_startTicks = Instrumentation::NowTicks();
+
+    RunCaptureBackend(window, CaptureBackend::RawInput, count);
+    RunCaptureBackend(window, CaptureBackend::LowLevelHook, count);
+
+    DestroyWindow(window);
+    Instrumentation::PrintSummary();
+    return 0;
+}
+
+bool ParseArgs(int argc, char* argv[], BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--rate" && hasValue) options.rate = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--repeat" && hasValue) options.repeat = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--llm-latency" && hasValue) options.llmLatencyMs = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--prefetch-idle" && hasValue) options.prefetchIdleMs = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--log" && hasValue) options.logFile = argv[++i];
+        else if (arg == "--archive" && hasValue) options.archiveDir = argv[++i];
+        else if (arg == "--capture-bench" && hasValue) options.captureEvents = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--real-llm") options.realLlm = true;
+        else if (arg == "--native-llm") options.nativeLlm = true;
+        else if (arg == "--accept") options.accept = true;
+        else if (arg == "--inject") options.inject = true;
+        else if (arg == "--binary-log") options.binaryLog = true;
+        else if (arg == "--sync-log") options.syncLog = true;
+        else if (arg == "--trace") options.trace = true;
+        else if (!arg.empty() && arg[0] != '-') options.eventsFile = argv[i];
+        else {
+            std::cout << "[ERROR] Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    if (options.repeat == 0) {
+        options.repeat = 1;
+    }
+    if (options.logFile == options.eventsFile) {
+        std::cout << "[ERROR] --log must differ from the replayed file\n";
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    // The first replayed suggestion is reported like the app's first one
+    StartupTimeline::Initialize();
+    if (!ParseArgs(argc, argv, g_options)) {
+        return 1;
+    }
+    if (g_options.captureEvents > 0) {
+        return RunCaptureBench(g_options.captureEvents);
+    }
+
+    std::vector<ReplayEvent> events;
+    if (!LoadEvents(g_options.eventsFile, events)) {
+        return 1;
+    }
+    std::cout << "[OK] Loaded " << events.size() << " events from " << g_options.eventsFile << "\n";
+
+    // Same components main() starts, minus the overlay and raw input registration
+    Diagnostics::Initialize();
+    if (!g_options.trace) {
+        Diagnostics::SetLevel(DiagLevel::Off);
+    }
+
+    EventLogger::SetLogFilePath(g_options.logFile);
+    EventLogger::SetLogFormat(g_options.binaryLog ? LogFormat::Binary : LogFormat::Json);
+    EventLogger::SetAsyncLogging(!g_options.syncLog);
+    if (!g_options.archiveDir.empty()) {
+        EventLogger::SetArchive(g_options.archiveDir, 64 * 1024);
+    }
+    EventLogger::Initialize();
+    EventLogger::ClearLogFile();
+
+    TypedContext::Initialize();
+    SpecialKeyHandler::Initialize();
+    InputInjector::Initialize();
+    InputInjector::SetDryRun(!g_options.inject);
+
+    if (g_options.nativeLlm) {
+        if (!NativeLlmClient::Initialize()) {
+            std::cerr << "Native LLM client unavailable\n";
+            return 1;
+        }
+    } else if (g_options.realLlm) {
+        SharedJournal::Initialize();
+        if (!CompletionClient::Initialize()) {
+            std::cout << "[WARNING] Completion worker unavailable, using process_input.py per request\n";
+        }
+    } else {
+        SuggestionService::SetCompletionHandler(FakeCompletion);
+    }
+
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = BenchWindowProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = L"WinOpAutoBench";
+    RegisterClassExW(&wc);
+    HWND window = CreateWindowExW(0, wc.lpszClassName, L"WinOpAutoBench", 0, 0, 0, 0, 0,
+                                  HWND_MESSAGE, nullptr, wc.hInstance, nullptr);
+    if (!window) {
+        std::cerr << "Failed to create message window\n";
+        return 1;
+    }
+    SuggestionService::Initialize(window);
+    InputPipeline::EnableSpeculativePrefetch(window, g_options.prefetchIdleMs);
+    InputPipeline::EnableMotionFlushTimer(window);
+
+    auto latencyNs = std::make_unique<LatencyHistogram>();
+    std::uint64_t totalEvents = static_cast<std::uint64_t>(events.size()) * g_options.repeat;
+    std::uint64_t lateEvents = 0;
+
+    std::cout << "\nReplaying " << totalEvents << " events"
+              << (g_options.rate ? " at " + std::to_string(g_options.rate) + " events/s" : std::string(" unpaced"))
+              << "...\n";
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    g_ticksPerSecond = static_cast<std::uint64_t>(frequency.QuadPart);
+    g_startTicks = Instrumentation::NowTicks();
+    std::uint64_t sent = 0;
+    for (std::uint32_t pass = 0; pass < g_options.repeat; ++pass) {
+        for (const ReplayEvent& event : events) {
+            if (g_options.rate > 0) {
+                // Absolute schedule so pacing errors don't accumulate; Sleep is too coarse at these rates
+                std::uint64_t dueMicros = sent * 1000000 / g_options.rate;
+                if (BenchTimestamp() > dueMicros + 1000) {
+                    lateEvents++;
+                }
+                while (BenchTimestamp() < dueMicros) {
+                    YieldProcessor();
+                }
+            }
+            PumpMessages();
+            Replay(event, *latencyNs);
+            sent++;
+        }
+    }
+    std::uint64_t replayMicros = BenchTimestamp();
+
+    // Let a suggestion that is still in flight finish so its stages show up in the summary
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(g_options.llmLatencyMs + 5000);
+    while (SuggestionService::IsBusy() && std::chrono::steady_clock::now() < deadline) {
+        PumpMessages();
+        Sleep(1);
+    }
+    PumpMessages();
+    InputPipeline::FlushPendingMotion();
+
+    SuggestionService::Shutdown();
+    CompletionClient::Shutdown();
+    NativeLlmClient::Shutdown();
+    SharedJournal::Shutdown();
+
+    std::uint64_t drainStart = Instrumentation::NowTicks();
+    EventLogger::Shutdown();
+    std::uint64_t drainMicros = Instrumentation::TicksToMicros(Instrumentation::NowTicks() - drainStart);
+    Diagnostics::Shutdown();
+    DestroyWindow(window);
+
+    double seconds = replayMicros / 1e6;
+    std::cout << "\n=== Replay (" << sent << " events, " << g_options.repeat << " pass"
+              << (g_options.repeat == 1 ? "" : "es") << ") ===\n";
+    std::cout << "Elapsed: " << replayMicros / 1000 << "ms, throughput: "
+              << static_cast<std::uint64_t>(seconds > 0 ? sent / seconds : 0) << " events/s\n";
+    if (g_options.rate > 0) {
+        std::cout << "Target rate: " << g_options.rate << " events/s, " << lateEvents << " events started >1ms late\n";
+    }
+    std::cout << "Per-event latency (ns): mean " << static_cast<std::uint64_t>(latencyNs->GetMean())
+              << ", p50 " << latencyNs->GetPercentile(50)
+              << ", p90 " << latencyNs->GetPercentile(90)
+              << ", p99 " << latencyNs->GetPercentile(99)
+              << ", max " << latencyNs->GetMax() << "\n";
+    std::cout << "Suggestions delivered: " << g_suggestionsReady
+              << (g_options.accept ? ", accept events: " + std::to_string(g_acceptedEvents) : std::string()) << "\n";
+    std::cout << "Event log drain at shutdown: " << drainMicros / 1000 << "ms (" << g_options.logFile << ")\n";
+    std::cout << "Events in history: " << InputPipeline::GetEventCount() << "\n";
+
+    Instrumentation::PrintSummary();
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include "capture_thread.h"
+#include "raw_input_reader.h"
+#include "input_injection.h"
+#include "instrumentation.h"
+#include <cstring>
+#include <iostream>
+
+// Static member definitions
+std::unique_ptr<SpscRingBuffer<CapturedInput>> CaptureThread::s_queue;
+std::atomic<bool> CaptureThread::s_notifyPending{false};
+TimestampSource CaptureThread::s_now = nullptr;
+HWND CaptureThread::s_uiWindow = nullptr;
+HWND CaptureThread::s_captureWindow = nullptr;
+CaptureBackend CaptureThread::s_backend = CaptureBackend::RawInput;
+HHOOK CaptureThread::s_keyboardHook = nullptr;
+HHOOK CaptureThread::s_mouseHook = nullptr;
+POINT CaptureThread::s_hookCursor = { 0, 0 };
+std::thread CaptureThread::s_thread;
+DWORD CaptureThread::s_threadId = 0;
+HANDLE CaptureThread::s_readyEvent = nullptr;
+bool CaptureThread::s_started = false;
+
+bool CaptureThread::Start(HWND uiWindow, TimestampSource now, CaptureBackend backend) {
+    if (s_thread.joinable()) return s_started;
+
+    s_uiWindow = uiWindow;
+    s_now = now;
+    s_backend = backend;
+    s_queue = std::make_unique<SpscRingBuffer<CapturedInput>>(CAPTURE_QUEUE_CAPACITY);
+    s_readyEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!s_readyEvent) {
+        std::cout << "[ERROR] Failed to create capture startup event: " << GetLastError() << "\n";
+        return false;
+    }
+
+    s_started = false;
+    s_thread = std::thread(ThreadMain);
+    WaitForSingleObject(s_readyEvent, INFINITE);
+    CloseHandle(s_readyEvent);
+    s_readyEvent = nullptr;
+
+    if (!s_started) {
+        s_thread.join();
+        return false;
+    }
+    std::cout << "[OK] Capture thread started (" << GetBackendName(backend) << " backend)\n";
+    return true;
+}
+
+bool CaptureThread::DrainInput(CapturedInputHandler handler) {
+    if (!s_queue) return true;
+
+    // Clear first so input queued while draining posts a fresh notification
+    s_notifyPending.store(false, std::memory_order_release);
+
+    CapturedInput event;
+    while (s_queue->TryPop(event)) {
+        Instrumentation::RecordSince(Stage::CaptureHandoff, event.capturedTicks);
+        if (!handler(event.raw, event.timestamp, event.cursorPos)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CaptureThread::Stop() {
+    if (!s_thread.joinable()) return;
+
+    PostThreadMessageW(s_threadId, WM_QUIT, 0, 0);
+    s_thread.join();
+    s_threadId = 0;
+    s_started = false;
+}
+
+const char* CaptureThread::GetBackendName(CaptureBackend backend) {
+    return backend == CaptureBackend::LowLevelHook ? "hook" : "raw";
+}
+
+bool CaptureThread::ParseBackendName(const char* name, CaptureBackend& backend) {
+    if (std::strcmp(name, "raw") == 0) {
+        backend = CaptureBackend::RawInput;
+        return true;
+    }
+    if (std::strcmp(name, "hook") == 0) {
+        backend = CaptureBackend::LowLevelHook;
+        return true;
+    }
+    return false;
+}
+
+void CaptureThread::ThreadMain() {
+    s_threadId = GetCurrentThreadId();
+
+    // Capture must keep up with 1000 Hz mice even while the UI thread is busy
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    bool installed = s_backend == CaptureBackend::LowLevelHook ? InstallHooks() : InstallRawInput();
+    s_started = installed;
+    SetEvent(s_readyEvent);
+    if (!installed) {
+        return;
+    }
+
+    // Hooks are called from this loop too, so it must keep pumping
+    MSG msg;
+    while (GetMessage(&msg, nullptr, 0, 0) > 0) {
+        DispatchMessage(&msg);
+    }
+
+    if (s_backend == CaptureBackend::LowLevelHook) {
+        RemoveHooks();
+    } else {
+        RemoveRawInput();
+    }
+}
+
+bool CaptureThread::InstallRawInput() {
+    const wchar_t* className = L"WinOpAutoCapture";
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = CaptureWindowProc;
+    wc.hInstance = GetModuleHandle(nullptr);
+    wc.lpszClassName = className;
+    RegisterClassExW(&wc);
+
+    // Message-only window: never shown, still receives raw input with RIDEV_INPUTSINK
+    s_captureWindow = CreateWindowExW(0, className, L"WinOpAutoCapture", 0, 0, 0, 0, 0,
+                                      HWND_MESSAGE, nullptr, GetModuleHandle(nullptr), nullptr);
+    if (!s_captureWindow) {
+        std::cout << "[ERROR] Failed to create capture window: " << GetLastError() << "\n";
+        return false;
+    }
+    if (!RegisterDevices(s_captureWindow, RIDEV_INPUTSINK)) {
+        std::cout << "[ERROR] Failed to register raw input devices: " << GetLastError() << "\n";
+        DestroyWindow(s_captureWindow);
+        s_captureWindow = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void CaptureThread::RemoveRawInput() {
+    RegisterDevices(nullptr, RIDEV_REMOVE);
+    DestroyWindow(s_captureWindow);
+    s_captureWindow = nullptr;
+}
+
+bool CaptureThread::InstallHooks() {
+    GetCursorPos(&s_hookCursor);
+
+    HINSTANCE instance = GetModuleHandle(nullptr);
+    s_keyboardHook = SetWindowsHookExW(WH_KEYBOARD_LL, KeyboardHookProc, instance, 0);
+    s_mouseHook = SetWindowsHookExW(WH_MOUSE_LL, MouseHookProc, instance, 0);
+    if (!s_keyboardHook || !s_mouseHook) {
+        std::cout << "[ERROR] Failed to install low-level hooks: " << GetLastError() << "\n";
+        RemoveHooks();
+        return false;
+    }
+    return true;
+}
+
+void CaptureThread::RemoveHooks() {
+    if (s_keyboardHook) {
+        UnhookWindowsHookEx(s_keyboardHook);
+        s_keyboardHook = nullptr;
+    }
+    if (s_mouseHook) {
+        UnhookWindowsHookEx(s_mouseHook);
+        s_mouseHook = nullptr;
+    }
+}
+
+LRESULT CALLBACK CaptureThread::CaptureWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_INPUT) {
+        {
+            ScopedSpan span(Stage::WmInput);
+            RawInputReader::ProcessMessage(reinterpret_cast<HRAWINPUT>(lParam), OnRawInput);
+        }
+
+        // One notification per burst; the UI thread drains everything queued by then
+        NotifyUi();
+        return 0;
+    }
+    return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+bool CaptureThread::OnRawInput(const RAWINPUT& raw, POINT cursorPos) {
+    if (InputInjector::IsOwnInjectedInput(raw)) {
+        Instrumentation::Increment(Counter::InjectedInputFiltered);
+        return true;
+    }
+    Publish(raw, cursorPos);
+    return true;
+}
+
+LRESULT CALLBACK CaptureThread::KeyboardHookProc(int code, WPARAM wParam, LPARAM lParam) {
+    if (code != HC_ACTION) {
+        return CallNextHookEx(nullptr, code, wParam, lParam);
+    }
+    ScopedSpan span(Stage::HookCallback);
+
+    const KBDLLHOOKSTRUCT* hook = reinterpret_cast<const KBDLLHOOKSTRUCT*>(lParam);
+    if ((hook->flags & LLKHF_INJECTED) && hook->dwExtraInfo == INJECTED_INPUT_TAG) {
+        Instrumentation::Increment(Counter::InjectedInputFiltered);
+        return CallNextHookEx(nullptr, code, wParam, lParam);
+    }
+
+    // Raw input reports modifiers as the generic key plus scan code and E0; match it
+    USHORT vKey = static_cast<USHORT>(hook->vkCode);
+    switch (vKey) {
+        case VK_LSHIFT: case VK_RSHIFT: vKey = VK_SHIFT; break;
+        case VK_LCONTROL: case VK_RCONTROL: vKey = VK_CONTROL; break;
+        case VK_LMENU: case VK_RMENU: vKey = VK_MENU; break;
+    }
+
+    RAWINPUT raw = {};
+    raw.header.dwType = RIM_TYPEKEYBOARD;
+    raw.header.dwSize = sizeof(RAWINPUT);
+    raw.data.keyboard.VKey = vKey;
+    raw.data.keyboard.MakeCode = static_cast<USHORT>(hook->scanCode);
+    raw.data.keyboard.Flags = static_cast<USHORT>(((hook->flags & LLKHF_UP) ? RI_KEY_BREAK : RI_KEY_MAKE) |
+                                                  ((hook->flags & LLKHF_EXTENDED) ? RI_KEY_E0 : 0));
+    raw.data.keyboard.Message = static_cast<UINT>(wParam);
+    raw.data.keyboard.ExtraInformation = static_cast<ULONG>(hook->dwExtraInfo);
+    Publish(raw, s_hookCursor);
+    NotifyUi();
+
+    return CallNextHookEx(nullptr, code, wParam, lParam);
+}
+
+LRESULT CALLBACK CaptureThread::MouseHookProc(int code, WPARAM wParam, LPARAM lParam) {
+    if (code != HC_ACTION) {
+        return CallNextHookEx(nullptr, code, wParam, lParam);
+    }
+    ScopedSpan span(Stage::HookCallback);
+
+    const MSLLHOOKSTRUCT* hook = reinterpret_cast<const MSLLHOOKSTRUCT*>(lParam);
+    if ((hook->flags & LLMHF_INJECTED) && hook->dwExtraInfo == INJECTED_INPUT_TAG) {
+        Instrumentation::Increment(Counter::InjectedInputFiltered);
+        return CallNextHookEx(nullptr, code, wParam, lParam);
+    }
+
+    RAWINPUT raw = {};
+    raw.header.dwType = RIM_TYPEMOUSE;
+    raw.header.dwSize = sizeof(RAWINPUT);
+    switch (wParam) {
+        case WM_MOUSEMOVE:
+            // Hooks see positions, not device deltas (so no movement past the screen edge)
+            raw.data.mouse.lLastX = hook->pt.x - s_hookCursor.x;
+            raw.data.mouse.lLastY = hook->pt.y - s_hookCursor.y;
+            break;
+        case WM_LBUTTONDOWN: raw.data.mouse.usButtonFlags = RI_MOUSE_LEFT_BUTTON_DOWN; break;
+        case WM_LBUTTONUP: raw.data.mouse.usButtonFlags = RI_MOUSE_LEFT_BUTTON_UP; break;
+        case WM_RBUTTONDOWN: raw.data.mouse.usButtonFlags = RI_MOUSE_RIGHT_BUTTON_DOWN; break;
+        case WM_RBUTTONUP: raw.data.mouse.usButtonFlags = RI_MOUSE_RIGHT_BUTTON_UP; break;
+        case WM_MBUTTONDOWN: raw.data.mouse.usButtonFlags = RI_MOUSE_MIDDLE_BUTTON_DOWN; break;
+        case WM_MBUTTONUP: raw.data.mouse.usButtonFlags = RI_MOUSE_MIDDLE_BUTTON_UP; break;
+        case WM_MOUSEWHEEL:
+            raw.data.mouse.usButtonFlags = RI_MOUSE_WHEEL;
+            raw.data.mouse.usButtonData = HIWORD(hook->mouseData);
+            break;
+        default:
+            return CallNextHookEx(nullptr, code, wParam, lParam);  // X buttons, horizontal wheel
+    }
+    raw.data.mouse.ulExtraInformation = static_cast<ULONG>(hook->dwExtraInfo);
+    s_hookCursor = hook->pt;
+    Publish(raw, hook->pt);
+    NotifyUi();
+
+    return CallNextHookEx(nullptr, code, wParam, lParam);
+}
+
+void CaptureThread::NotifyUi() {
+    if (!s_notifyPending.exchange(true, std::memory_order_acq_rel)) {
+        PostMessage(s_uiWindow, WM_CAPTURED_INPUT, 0, 0);
+    }
+}
+
+void CaptureThread::Publish(const RAWINPUT& raw, POINT cursorPos) {
+    CapturedInput event;
+    event.raw = raw;
+    event.timestamp = s_now();
+    event.capturedTicks = Instrumentation::NowTicks();
+    event.cursorPos = cursorPos;
+    if (!s_queue->TryPush(event)) {
+        Instrumentation::Increment(Counter::CaptureQueueOverflow);
+    }
+}
+
+bool CaptureThread::RegisterDevices(HWND hWnd, DWORD flags) {
+    RAWINPUTDEVICE rid[2];
+    
+    // Register for keyboard input (0x01, 0x06)
+    rid[0].usUsagePage = 0x01;    // Generic Desktop
+    rid[0].usUsage = 0x06;        // Keyboard
+    rid[0].dwFlags = flags;       // RIDEV_INPUTSINK: receive input even when not foreground
+    rid[0].hwndTarget = hWnd;
+    
+    // Register for mouse input (0x01, 0x02)
+    rid[1].usUsagePage = 0x01;    // Generic Desktop
+    rid[1].usUsage = 0x02;        // Mouse
+    rid[1].dwFlags = flags;
+    rid[1].hwndTarget = hWnd;
+    
+    return RegisterRawInputDevices(rid, 2, sizeof(RAWINPUTDEVICE));
+}
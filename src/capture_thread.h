@@ -0,0 +1,96 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "spsc_ring_buffer.h"
+
+// Posted to the UI window when captured input is waiting.
+// Coalesced: at most one is pending until DrainInput runs.
+constexpr UINT WM_CAPTURED_INPUT = WM_USER + 4;
+
+// One raw input event as published by the capture thread
+struct CapturedInput {
+    RAWINPUT raw;
+    std::uint64_t timestamp;     // Clock passed to Start, sampled as the event was read
+    std::uint64_t capturedTicks; // Instrumentation ticks for the CaptureHandoff stage
+    POINT cursorPos;
+};
+
+// Where the capture thread gets input from
+enum class CaptureBackend {
+    RawInput,     // RegisterRawInputDevices + WM_INPUT (RIDEV_INPUTSINK)
+    LowLevelHook  // WH_KEYBOARD_LL / WH_MOUSE_LL, translated to RAWINPUT for the pipeline
+};
+
+// Clock used for event timestamps (must be callable from the capture thread)
+using TimestampSource = std::uint64_t (*)();
+
+// Receives each captured event on the UI thread; return false to stop (e.g. ESC)
+using CapturedInputHandler = bool (*)(const RAWINPUT& raw, std::uint64_t timestamp, POINT cursorPos);
+
+// Owns input capture on a dedicated above-normal-priority thread.
+// That thread only reads, timestamps and queues events, so overlay painting,
+// suggestion handling and text injection can't delay capture. Our own injected
+// keystrokes are dropped here, before the log and the context see them.
+// Both backends publish RAWINPUT records, so everything downstream is shared.
+class CaptureThread {
+public:
+    // Start capturing keyboard and mouse input with backend on a new thread.
+    // Captured events are announced to uiWindow with WM_CAPTURED_INPUT.
+    static bool Start(HWND uiWindow, TimestampSource now, CaptureBackend backend = CaptureBackend::RawInput);
+
+    // Run handler over everything queued so far (UI thread). Returns false if the handler stopped.
+    static bool DrainInput(CapturedInputHandler handler);
+
+    // Unregister and join the capture thread
+    static void Stop();
+
+    // "raw" or "hook" (for config and reports)
+    static const char* GetBackendName(CaptureBackend backend);
+    static bool ParseBackendName(const char* name, CaptureBackend& backend);
+
+private:
+    static void ThreadMain();
+    static LRESULT CALLBACK CaptureWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
+
+    // RawInputCallback: filter, timestamp and queue one event
+    static bool OnRawInput(const RAWINPUT& raw, POINT cursorPos);
+
+    // Timestamp and queue one event, then notify the UI window unless a notification is pending
+    static void Publish(const RAWINPUT& raw, POINT cursorPos);
+    static void NotifyUi();
+
+    // Backend setup on the capture thread; undone by the matching teardown after the loop
+    static bool InstallRawInput();
+    static void RemoveRawInput();
+    static bool InstallHooks();
+    static void RemoveHooks();
+
+    // Register (or with RIDEV_REMOVE, unregister) keyboard and mouse on hWnd
+    static bool RegisterDevices(HWND hWnd, DWORD flags);
+
+    // Low-level hook procedures: translate, queue and return. Anything slower risks the
+    // system's LowLevelHooksTimeout, after which Windows silently removes the hook.
+    static LRESULT CALLBACK KeyboardHookProc(int code, WPARAM wParam, LPARAM lParam);
+    static LRESULT CALLBACK MouseHookProc(int code, WPARAM wParam, LPARAM lParam);
+
+    // Events queued between DrainInput calls; overflow is counted and dropped
+    static constexpr size_t CAPTURE_QUEUE_CAPACITY = 4096;
+
+    static std::unique_ptr<SpscRingBuffer<CapturedInput>> s_queue;
+    static std::atomic<bool> s_notifyPending;
+    static TimestampSource s_now;
+    static HWND s_uiWindow;
+    static HWND s_captureWindow;
+    static CaptureBackend s_backend;
+    static HHOOK s_keyboardHook;
+    static HHOOK s_mouseHook;
+    static POINT s_hookCursor;    // Last position seen by the mouse hook (cursor for key events)
+    static std::thread s_thread;
+    static DWORD s_threadId;
+    static HANDLE s_readyEvent;   // Set once the thread has registered (or failed to)
+    static bool s_started;
+};
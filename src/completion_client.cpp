@@ -0,0 +1,313 @@
+#include "completion_client.h"
+#include "shared_journal.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Static member definitions
+HANDLE CompletionClient::s_pipe = INVALID_HANDLE_VALUE;
+HANDLE CompletionClient::s_ioEvent = nullptr;
+HANDLE CompletionClient::s_workerProcess = nullptr;
+bool CompletionClient::s_connected = false;
+std::uint32_t CompletionClient::s_nextRequestId = 1;
+DWORD CompletionClient::s_startupTimeoutMs = 15000;
+DWORD CompletionClient::s_requestTimeoutMs = 35000;
+std::mutex CompletionClient::s_pipeMutex;
+bool CompletionClient::s_enabled = false;
+DWORD CompletionClient::s_retryDelayMs = 0;
+ULONGLONG CompletionClient::s_nextRetryTime = 0;
+
+// Relaunch backoff after the worker was lost or failed to start
+constexpr DWORD MIN_RELAUNCH_DELAY_MS = 1000;
+constexpr DWORD MAX_RELAUNCH_DELAY_MS = 60000;
+
+// Upper bound on a completion payload; anything larger means the stream is out of sync
+constexpr std::uint32_t MAX_COMPLETION_PAYLOAD = 1024 * 1024;
+
+bool CompletionClient::Initialize() {
+    if (s_connected) return true;
+    s_enabled = true;
+
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+
+    // One pipe per process so several instances don't collide
+    std::wstring pipeName = L"\\\\.\\pipe\\WinOpAuto-" + std::to_wstring(GetCurrentProcessId());
+
+    s_pipe = CreateNamedPipeW(
+        pipeName.c_str(),
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1,              // Single instance
+        64 * 1024,      // Output buffer
+        64 * 1024,      // Input buffer
+        0,
+        nullptr
+    );
+    if (s_pipe == INVALID_HANDLE_VALUE) {
+        std::cout << "[ERROR] Failed to create completion pipe: " << GetLastError() << "\n";
+        return false;
+    }
+
+    s_ioEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!s_ioEvent || !LaunchWorker(pipeName) || !WaitForConnection()) {
+        Shutdown();
+        s_retryDelayMs = s_retryDelayMs ? (std::min)(s_retryDelayMs * 2, MAX_RELAUNCH_DELAY_MS) : MIN_RELAUNCH_DELAY_MS;
+        s_nextRetryTime = GetTickCount64() + s_retryDelayMs;
+        return false;
+    }
+
+    s_connected = true;
+    s_retryDelayMs = 0;
+    Instrumentation::RecordSince(Stage::WorkerStartup, startTicks);
+    std::cout << "[OK] Completion worker connected\n";
+    return true;
+}
+
+bool CompletionClient::RequestCompletion(const std::string& context, std::uint32_t flags, std::string& completion,
+                                         PartialCompletionHandler onPartial) {
+    completion.clear();
+    if (!s_connected) {
+        return false;
+    }
+
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+    CompletionFrameHeader request = {};
+    request.requestId = s_nextRequestId++;
+
+    // Prefer the shared journal; the pipe frame then only rings the doorbell
+    bool viaJournal = SharedJournal::IsOpen() &&
+        ((flags & COMPLETION_CONTEXT_FROM_LOG) || SharedJournal::WriteContext(request.requestId, context));
+    request.payloadSize = viaJournal ? 0 : static_cast<std::uint32_t>(context.size());
+    request.status = viaJournal ? (flags | COMPLETION_VIA_JOURNAL) : flags;
+    if (onPartial) {
+        request.status |= COMPLETION_STREAM_PARTIAL;
+    }
+
+    if (!TransferAll(true, &request, sizeof(request), s_requestTimeoutMs) ||
+        (request.payloadSize > 0 && !TransferAll(true, const_cast<char*>(context.data()), request.payloadSize, s_requestTimeoutMs))) {
+        std::cout << "[ERROR] Failed to send completion request\n";
+        Disconnect();
+        return false;
+    }
+
+    // Streamed pieces arrive as COMPLETION_PARTIAL frames ahead of the final one
+    CompletionFrameHeader response = {};
+    std::string streamed;
+    while (true) {
+        if (!TransferAll(false, &response, sizeof(response), s_requestTimeoutMs)) {
+            std::cout << "[ERROR] No response from completion worker\n";
+            Disconnect();
+            return false;
+        }
+        if (response.requestId != request.requestId || response.payloadSize > MAX_COMPLETION_PAYLOAD ||
+            (response.status == COMPLETION_PARTIAL && streamed.size() + response.payloadSize > MAX_COMPLETION_PAYLOAD)) {
+            std::cout << "[ERROR] Completion worker protocol mismatch\n";
+            Disconnect();
+            return false;
+        }
+        if (response.status != COMPLETION_PARTIAL) {
+            break;
+        }
+
+        size_t offset = streamed.size();
+        streamed.resize(offset + response.payloadSize);
+        if (response.payloadSize > 0 && !TransferAll(false, streamed.data() + offset, response.payloadSize, s_requestTimeoutMs)) {
+            std::cout << "[ERROR] Truncated response from completion worker\n";
+            Disconnect();
+            return false;
+        }
+        if (onPartial) {
+            onPartial(streamed);
+        }
+    }
+
+    if (response.payloadSize > 0) {
+        completion.resize(response.payloadSize);
+        if (!TransferAll(false, completion.data(), response.payloadSize, s_requestTimeoutMs)) {
+            std::cout << "[ERROR] Truncated response from completion worker\n";
+            completion.clear();
+            Disconnect();
+            return false;
+        }
+    } else if (viaJournal && response.status == COMPLETION_OK) {
+        // The worker only falls back to an inline payload if the text does not fit the slot
+        std::uint32_t slotStatus = COMPLETION_ERROR;
+        if (!SharedJournal::ReadResponse(request.requestId, slotStatus, completion) || slotStatus != COMPLETION_OK) {
+            std::cout << "[ERROR] Completion missing from shared journal\n";
+            completion.clear();
+            return false;
+        }
+    }
+
+    Instrumentation::RecordSince(Stage::CompletionRequest, startTicks);
+    Instrumentation::Record(Stage::WorkerCompute, response.elapsedMicros);
+    std::cout << "[AI] Worker answered in " << (response.elapsedMicros / 1000) << "ms\n";
+    return response.status == COMPLETION_OK || response.status == COMPLETION_EMPTY;
+}
+
+bool CompletionClient::IsConnected() {
+    return s_connected;
+}
+
+bool CompletionClient::EnsureConnected() {
+    if (s_connected && WaitForSingleObject(s_workerProcess, 0) == WAIT_OBJECT_0) {
+        std::cout << "[WARNING] Completion worker exited\n";
+        Disconnect();
+    }
+    if (s_connected || !s_enabled || GetTickCount64() < s_nextRetryTime) {
+        return s_connected;
+    }
+
+    std::cout << "[AI] Relaunching completion worker\n";
+    return Initialize();
+}
+
+void CompletionClient::Shutdown() {
+    s_connected = false;
+
+    // Closing the pipe makes the worker's read fail, which ends its loop. The handles are
+    // taken under the lock so CancelPendingIo never sees one that is being closed.
+    HANDLE workerProcess = nullptr;
+    HANDLE ioEvent = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(s_pipeMutex);
+        if (s_pipe != INVALID_HANDLE_VALUE) {
+            CloseHandle(s_pipe);
+            s_pipe = INVALID_HANDLE_VALUE;
+        }
+        workerProcess = s_workerProcess;
+        ioEvent = s_ioEvent;
+        s_workerProcess = nullptr;
+        s_ioEvent = nullptr;
+    }
+    if (workerProcess) {
+        if (WaitForSingleObject(workerProcess, 2000) == WAIT_TIMEOUT) {
+            TerminateProcess(workerProcess, 1);
+        }
+        CloseHandle(workerProcess);
+    }
+    if (ioEvent) {
+        CloseHandle(ioEvent);
+    }
+}
+
+void CompletionClient::CancelPendingIo() {
+    std::lock_guard<std::mutex> lock(s_pipeMutex);
+    if (s_pipe != INVALID_HANDLE_VALUE) {
+        CancelIoEx(s_pipe, nullptr);
+    }
+}
+
+void CompletionClient::SetStartupTimeout(DWORD timeoutMs) {
+    s_startupTimeoutMs = timeoutMs;
+    std::cout << "[CONFIG] Completion worker startup timeout set to " << timeoutMs << "ms\n";
+}
+
+void CompletionClient::SetRequestTimeout(DWORD timeoutMs) {
+    s_requestTimeoutMs = timeoutMs;
+    std::cout << "[CONFIG] Completion request timeout set to " << timeoutMs << "ms\n";
+}
+
+bool CompletionClient::LaunchWorker(const std::wstring& pipeName) {
+    // Script lives next to the executable, same as process_input.py
+    std::wstring commandLine = L"python completion_worker.py --pipe " + pipeName;
+    if (SharedJournal::IsOpen()) {
+        commandLine += L" --journal " + SharedJournal::GetName();
+    }
+    std::vector<wchar_t> commandBuffer(commandLine.begin(), commandLine.end());
+    commandBuffer.push_back(L'\0');
+
+    STARTUPINFOW startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo = {};
+
+    // The worker shares our console so its log lines show up as before
+    if (!CreateProcessW(nullptr, commandBuffer.data(), nullptr, nullptr, FALSE, 0,
+                        nullptr, nullptr, &startupInfo, &processInfo)) {
+        std::cout << "[ERROR] Failed to start completion worker: " << GetLastError() << "\n";
+        return false;
+    }
+
+    CloseHandle(processInfo.hThread);
+    s_workerProcess = processInfo.hProcess;
+    return true;
+}
+
+bool CompletionClient::WaitForConnection() {
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = s_ioEvent;
+    ResetEvent(s_ioEvent);
+
+    if (ConnectNamedPipe(s_pipe, &overlapped)) {
+        return true;
+    }
+
+    DWORD error = GetLastError();
+    if (error == ERROR_PIPE_CONNECTED) {
+        return true;
+    }
+    if (error != ERROR_IO_PENDING) {
+        std::cout << "[ERROR] ConnectNamedPipe failed: " << error << "\n";
+        return false;
+    }
+
+    // Wake on either the connection or the worker dying during startup
+    HANDLE waitHandles[2] = { s_ioEvent, s_workerProcess };
+    DWORD waitResult = WaitForMultipleObjects(2, waitHandles, FALSE, s_startupTimeoutMs);
+    if (waitResult == WAIT_OBJECT_0) {
+        DWORD unused = 0;
+        return GetOverlappedResult(s_pipe, &overlapped, &unused, FALSE) != 0;
+    }
+
+    CancelIoEx(s_pipe, &overlapped);
+    DWORD unused = 0;
+    GetOverlappedResult(s_pipe, &overlapped, &unused, TRUE);
+
+    if (waitResult == WAIT_OBJECT_0 + 1) {
+        std::cout << "[ERROR] Completion worker exited during startup\n";
+    } else {
+        std::cout << "[ERROR] Timed out waiting for completion worker\n";
+    }
+    return false;
+}
+
+bool CompletionClient::TransferAll(bool isWrite, void* data, DWORD size, DWORD timeoutMs) {
+    BYTE* cursor = static_cast<BYTE*>(data);
+    DWORD remaining = size;
+
+    while (remaining > 0) {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = s_ioEvent;
+        ResetEvent(s_ioEvent);
+
+        DWORD transferred = 0;
+        BOOL ok = isWrite ? WriteFile(s_pipe, cursor, remaining, nullptr, &overlapped)
+                          : ReadFile(s_pipe, cursor, remaining, nullptr, &overlapped);
+        if (!ok && GetLastError() != ERROR_IO_PENDING) {
+            return false;
+        }
+
+        if (WaitForSingleObject(s_ioEvent, timeoutMs) != WAIT_OBJECT_0) {
+            CancelIoEx(s_pipe, &overlapped);
+            GetOverlappedResult(s_pipe, &overlapped, &transferred, TRUE);
+            return false;
+        }
+        if (!GetOverlappedResult(s_pipe, &overlapped, &transferred, FALSE) || transferred == 0) {
+            return false;
+        }
+
+        cursor += transferred;
+        remaining -= transferred;
+    }
+    return true;
+}
+
+void CompletionClient::Disconnect() {
+    // A partial frame leaves the byte stream unusable; EnsureConnected starts a new worker
+    // after the retry delay
+    std::cout << "[WARNING] Completion worker disconnected\n";
+    Shutdown();
+    s_retryDelayMs = MIN_RELAUNCH_DELAY_MS;
+    s_nextRetryTime = GetTickCount64() + s_retryDelayMs;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Frame header exchanged with completion_worker.py over the named pipe.
+// Every message is this header (little-endian) followed by payloadSize bytes of UTF-8.
+struct CompletionFrameHeader {
+    std::uint32_t payloadSize;
+    std::uint32_t requestId;
+    std::uint32_t status;         // Request: CompletionRequestFlags, response: CompletionStatus
+    std::uint32_t elapsedMicros;  // Response only: time the worker spent on the request
+};
+
+// Request flags
+enum CompletionRequestFlags : std::uint32_t {
+    COMPLETION_CONTEXT_IN_PAYLOAD = 0,  // Payload holds the input sequence
+    COMPLETION_CONTEXT_FROM_LOG = 1,    // Worker builds the sequence from logged events (journal ring, else input_events.txt)
+    COMPLETION_VIA_JOURNAL = 2,         // Context is in the shared journal's context slot and the
+                                        // response text goes to its response slot (set by the client)
+    COMPLETION_STREAM_PARTIAL = 4       // Send COMPLETION_PARTIAL frames while the LLM streams (set by the client)
+};
+
+// Response status
+enum CompletionStatus : std::uint32_t {
+    COMPLETION_OK = 0,     // Payload (or the journal response slot) holds the completion text
+    COMPLETION_EMPTY = 1,  // LLM returned nothing
+    COMPLETION_ERROR = 2,  // Worker failed (details are printed by the worker)
+    COMPLETION_PARTIAL = 3 // Payload holds the next streamed piece of text; the final frame follows
+};
+
+// Receives the text streamed so far; runs on the thread that called RequestCompletion
+using PartialCompletionHandler = void (*)(const std::string& textSoFar);
+
+// Client for the long-lived Python completion worker.
+// The worker is started once and keeps its config, system prompt and HTTP
+// session warm, so a request costs roughly network + model latency.
+class CompletionClient {
+public:
+    // Start the worker process and wait for it to connect to our pipe
+    static bool Initialize();
+
+    // Send the input sequence (or ask the worker to read the event log) and wait for the completion.
+    // Goes through the shared journal when it is open and the context fits; the pipe then only carries headers.
+    // With onPartial, the worker streams the response and onPartial sees each update before this returns.
+    // Returns false if the worker is unavailable or the request failed.
+    static bool RequestCompletion(const std::string& context, std::uint32_t flags, std::string& completion,
+                                  PartialCompletionHandler onPartial = nullptr);
+
+    // True if the worker is running and connected
+    static bool IsConnected();
+
+    // Connected, or relaunch a worker that exited or was disconnected once the retry delay
+    // has passed (doubles per failed attempt, up to 60s). Only after Initialize was called.
+    static bool EnsureConnected();
+
+    // Stop the worker and close the pipe
+    static void Shutdown();
+    
+    // Abort a request blocked in I/O on another thread (it fails and disconnects)
+    static void CancelPendingIo();
+
+    // Timeout for worker startup (default: 15000ms)
+    static void SetStartupTimeout(DWORD timeoutMs);
+
+    // Timeout for a single request (default: 35000ms, just above the worker's HTTP timeout)
+    static void SetRequestTimeout(DWORD timeoutMs);
+
+private:
+    static HANDLE s_pipe;
+    static HANDLE s_ioEvent;
+    static HANDLE s_workerProcess;
+    static bool s_connected;
+    static std::uint32_t s_nextRequestId;
+    static DWORD s_startupTimeoutMs;
+    static DWORD s_requestTimeoutMs;
+    static std::mutex s_pipeMutex;  // Guards the handles against cancel-during-close
+    static bool s_enabled;          // Initialize was called, so EnsureConnected may relaunch
+    static DWORD s_retryDelayMs;
+    static ULONGLONG s_nextRetryTime;
+
+    // Launch "python completion_worker.py --pipe <name> [--journal <name>]"
+    static bool LaunchWorker(const std::wstring& pipeName);
+
+    // Wait for the worker to connect, giving up if it exits first
+    static bool WaitForConnection();
+
+    // Overlapped read/write of exactly size bytes with a timeout
+    static bool TransferAll(bool isWrite, void* data, DWORD size, DWORD timeoutMs);
+
+    // Drop the connection after a protocol or I/O failure
+    static void Disconnect();
+};
@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""
+Persistent completion worker for WinOpAuto
+Started once by the C++ process, connects back over a named pipe and serves
+completion requests with a warm LLMHandler (config, system prompt and HTTP
+session are loaded once instead of per Left Ctrl press).
+
+Wire format (little-endian), shared with completion_client.h:
+    header  = payload_size:u32, request_id:u32, status:u32, elapsed_us:u32
+    payload = UTF-8 text of payload_size bytes
+Requests carry the input sequence built incrementally by the C++ side (or
+flag CONTEXT_FROM_LOG to rebuild it from logged events); responses carry the
+completion text. Requests flagged STREAM_PARTIAL first get STATUS_PARTIAL
+frames with each streamed piece of text, then the usual final frame holding
+the complete text.
+
+With --journal, requests flagged VIA_JOURNAL leave the payload empty: the
+context is read from the shared journal (shared_journal.h) and the
+completion is written to its response slot, so the pipe is only a doorbell.
+CONTEXT_FROM_LOG then reads the journal's event ring instead of the log file.
+Without the journal it reads the log, plus the recent segments of the event
+archive when WINOPAUTO_ARCHIVE_DIR is set (see event_archive.py).
+
+Usage: python completion_worker.py --pipe \\\\.\\pipe\\WinOpAuto-<pid> [--journal Local\\WinOpAuto-journal-<pid>]
+"""
+
+import mmap
+import os
+import struct
+import sys
+import threading
+import time
+from typing import Dict, List, Optional
+
+from llm_handler import LLMHandler
+from process_input import (MAX_CONTEXT_CHARS, RECENT_CONTEXT_MINUTES, BINARY_LOG_RECORD, decode_binary_records,
+                           extract_input_sequence, process_with_llm)
+from event_archive import read_recent_events
+
+FRAME_HEADER = struct.Struct("<IIII")
+
+# Request flags
+CONTEXT_IN_PAYLOAD = 0
+CONTEXT_FROM_LOG = 1
+VIA_JOURNAL = 2
+STREAM_PARTIAL = 4
+
+# Response status
+STATUS_OK = 0
+STATUS_EMPTY = 1
+STATUS_ERROR = 2
+STATUS_PARTIAL = 3
+
+
+# Shared journal layout (SharedJournalLayout in shared_journal.h; static_asserts there pin these offsets)
+JOURNAL_MAGIC = b"WOAJ"
+JOURNAL_VERSION = 2
+JOURNAL_SIZE = 393472
+JOURNAL_HEADER = struct.Struct("<4sHHIII")
+JOURNAL_EVENT_CAPACITY = 8192
+JOURNAL_CONTEXT_CAPACITY = 64 * 1024
+JOURNAL_RESPONSE_CAPACITY = 64 * 1024
+EVENT_WRITE_INDEX_OFFSET = 64
+EVENTS_OFFSET = 128
+CONTEXT_SEQUENCE_OFFSET = 262272
+CONTEXT_OFFSET = 262288
+RESPONSE_SEQUENCE_OFFSET = 327872
+RESPONSE_OFFSET = 327896
+U32 = struct.Struct("<I")
+U64 = struct.Struct("<Q")
+SEQLOCK_READ_ATTEMPTS = 16
+
+
+class SharedJournal:
+    """Worker side of the shared-memory journal created by the C++ process."""
+
+    def __init__(self, name: str):
+        # tagname opens the existing pagefile-backed mapping (Windows only)
+        self.mm = mmap.mmap(-1, JOURNAL_SIZE, tagname=name)
+        magic, version, record_size, event_capacity, context_capacity, response_capacity = \
+            JOURNAL_HEADER.unpack_from(self.mm, 0)
+        if (magic != JOURNAL_MAGIC or version != JOURNAL_VERSION or record_size != BINARY_LOG_RECORD.size
+                or event_capacity != JOURNAL_EVENT_CAPACITY or context_capacity != JOURNAL_CONTEXT_CAPACITY
+                or response_capacity != JOURNAL_RESPONSE_CAPACITY):
+            self.mm.close()
+            raise ValueError(f"Incompatible shared journal {name} (version {version})")
+
+    def close(self):
+        self.mm.close()
+
+    def _u32(self, offset: int) -> int:
+        return U32.unpack_from(self.mm, offset)[0]
+
+    def _u64(self, offset: int) -> int:
+        return U64.unpack_from(self.mm, offset)[0]
+
+    def read_events(self) -> List[Dict]:
+        """Copy the retained window of the event ring, dropping records overwritten meanwhile."""
+        record_size = BINARY_LOG_RECORD.size
+        write_index = self._u64(EVENT_WRITE_INDEX_OFFSET)
+        first = max(0, write_index - JOURNAL_EVENT_CAPACITY)
+        start_slot = first % JOURNAL_EVENT_CAPACITY
+        count = write_index - first
+
+        # The window may wrap around the end of the ring
+        head = min(count, JOURNAL_EVENT_CAPACITY - start_slot)
+        data = self.mm[EVENTS_OFFSET + start_slot * record_size:EVENTS_OFFSET + (start_slot + head) * record_size]
+        if count > head:
+            data += self.mm[EVENTS_OFFSET:EVENTS_OFFSET + (count - head) * record_size]
+
+        # The writer may have lapped the oldest records (and be writing the next one) while we copied
+        valid_first = max(first, self._u64(EVENT_WRITE_INDEX_OFFSET) - JOURNAL_EVENT_CAPACITY + 1)
+        data = data[(valid_first - first) * record_size:]
+        return list(decode_binary_records(data))
+
+    def read_context(self, request_id: int) -> Optional[str]:
+        """Seqlock read of the context slot; None if it does not belong to request_id."""
+        for _ in range(SEQLOCK_READ_ATTEMPTS):
+            before = self._u64(CONTEXT_SEQUENCE_OFFSET)
+            if before & 1:
+                continue
+            slot_request_id = self._u32(CONTEXT_SEQUENCE_OFFSET + 8)
+            length = min(self._u32(CONTEXT_SEQUENCE_OFFSET + 12), JOURNAL_CONTEXT_CAPACITY)
+            data = self.mm[CONTEXT_OFFSET:CONTEXT_OFFSET + length]
+            if self._u64(CONTEXT_SEQUENCE_OFFSET) != before:
+                continue
+            if slot_request_id != request_id:
+                return None
+            return data.decode("utf-8", errors="replace")
+        return None
+
+    def write_response(self, request_id: int, status: int, text: str) -> bool:
+        """Seqlock write of the response slot. Returns False if the text does not fit."""
+        payload = text.encode("utf-8")
+        if len(payload) > JOURNAL_RESPONSE_CAPACITY:
+            return False
+        sequence = self._u64(RESPONSE_SEQUENCE_OFFSET) | 1
+        U64.pack_into(self.mm, RESPONSE_SEQUENCE_OFFSET, sequence)
+        struct.pack_into("<III", self.mm, RESPONSE_SEQUENCE_OFFSET + 8, request_id, status, len(payload))
+        self.mm[RESPONSE_OFFSET:RESPONSE_OFFSET + len(payload)] = payload
+        U64.pack_into(self.mm, RESPONSE_SEQUENCE_OFFSET, sequence + 1)
+        return True
+
+
+def read_exact(pipe, size: int) -> Optional[bytes]:
+    """Read exactly size bytes, or None if the pipe was closed."""
+    chunks = []
+    remaining = size
+    while remaining > 0:
+        chunk = pipe.read(remaining)
+        if not chunk:
+            return None
+        chunks.append(chunk)
+        remaining -= len(chunk)
+    return b"".join(chunks)
+
+
+def write_frame(pipe, request_id: int, status: int, elapsed_us: int, text: str):
+    """Write one response frame."""
+    payload = text.encode("utf-8")
+    pipe.write(FRAME_HEADER.pack(len(payload), request_id, status, min(elapsed_us, 0xFFFFFFFF)) + payload)
+    pipe.flush()
+
+
+def resolve_context(request_id: int, flags: int, payload: bytes, events_file: str,
+                    journal: Optional[SharedJournal]) -> Optional[str]:
+    """Get the input sequence for a request."""
+    via_journal = journal is not None and flags & VIA_JOURNAL
+    if flags & CONTEXT_FROM_LOG:
+        events = journal.read_events() if via_journal else read_recent_events(
+            events_file, os.environ.get("WINOPAUTO_ARCHIVE_DIR"), RECENT_CONTEXT_MINUTES)
+        if not events:
+            return None
+        return extract_input_sequence(events)[-MAX_CONTEXT_CHARS:]
+    if via_journal:
+        return journal.read_context(request_id)
+    return payload.decode("utf-8", errors="replace")
+
+
+def serve(pipe, llm: LLMHandler, events_file: str, journal: Optional[SharedJournal]):
+    """Handle requests until the C++ side closes the pipe."""
+    while True:
+        header = read_exact(pipe, FRAME_HEADER.size)
+        if header is None:
+            print("[WORKER] Pipe closed, exiting")
+            return
+
+        payload_size, request_id, flags, _ = FRAME_HEADER.unpack(header)
+        payload = read_exact(pipe, payload_size) if payload_size else b""
+        if payload is None:
+            print("[WORKER] Pipe closed mid-request, exiting")
+            return
+
+        start = time.perf_counter()
+        status = STATUS_ERROR
+        completion = ""
+        
+        on_partial = None
+        if flags & STREAM_PARTIAL:
+            def on_partial(delta: str, request_id=request_id):
+                elapsed_us = int((time.perf_counter() - start) * 1_000_000)
+                write_frame(pipe, request_id, STATUS_PARTIAL, elapsed_us, delta)
+        
+        try:
+            input_sequence = resolve_context(request_id, flags, payload, events_file, journal)
+            if input_sequence is not None:
+                completion = process_with_llm(input_sequence, llm, on_partial) or ""
+                status = STATUS_OK if completion else STATUS_EMPTY
+        except Exception as e:
+            print(f"[ERROR] Worker request {request_id} failed: {e}")
+
+        # Journal requests get the text through the response slot, unless it does not fit
+        if journal is not None and flags & VIA_JOURNAL and status == STATUS_OK:
+            if journal.write_response(request_id, status, completion):
+                completion = ""
+
+        elapsed_us = int((time.perf_counter() - start) * 1_000_000)
+        write_frame(pipe, request_id, status, elapsed_us, completion)
+
+
+def main(argv) -> int:
+    if len(argv) not in (3, 5) or argv[1] != "--pipe" or (len(argv) == 5 and argv[3] != "--journal"):
+        print("Usage: python completion_worker.py --pipe <pipe name> [--journal <mapping name>]")
+        return 2
+
+    pipe_name = argv[2]
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    events_file = os.path.join(script_dir, "input_events.txt")
+
+    # Load config, secrets and prompt before connecting so the first request is already warm
+    try:
+        llm = LLMHandler()
+        llm._get_prompt_builder()
+    except Exception as e:
+        print(f"[ERROR] Worker initialization failed: {e}")
+        return 1
+    
+    # The TLS handshake overlaps with connecting to the pipe; serving waits for it
+    warm_up = threading.Thread(target=llm.warm_up, daemon=True)
+    warm_up.start()
+    
+    # The C++ side only passes --journal after creating it, so failing to attach is fatal
+    journal = None
+    if len(argv) == 5:
+        try:
+            journal = SharedJournal(argv[4])
+        except (OSError, ValueError) as e:
+            print(f"[ERROR] Could not attach shared journal {argv[4]}: {e}")
+            return 1
+        print(f"[WORKER] Attached shared journal {argv[4]}")
+
+    try:
+        pipe = open(pipe_name, "r+b", buffering=0)
+    except OSError as e:
+        print(f"[ERROR] Could not connect to {pipe_name}: {e}")
+        return 1
+
+    print(f"[WORKER] Connected to {pipe_name}")
+    warm_up.join()
+    with pipe:
+        try:
+            serve(pipe, llm, events_file, journal)
+        except OSError:
+            # The C++ side closed the pipe (normal shutdown)
+            pass
+    if llm.config.get("hedge_provider") or llm.config.get("hedge_model"):
+        print(f"[WORKER] Hedged requests: {llm.hedge_stats()}")
+    if journal is not None:
+        journal.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,340 @@
+#include "diagnostics.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+constexpr size_t CATEGORY_COUNT = static_cast<size_t>(DiagCategory::Count);
+
+// Static member definitions
+std::atomic<std::uint8_t> Diagnostics::s_categoryLevels[CATEGORY_COUNT] = {
+    static_cast<std::uint8_t>(DiagLevel::Trace), static_cast<std::uint8_t>(DiagLevel::Trace),
+    static_cast<std::uint8_t>(DiagLevel::Trace), static_cast<std::uint8_t>(DiagLevel::Trace),
+    static_cast<std::uint8_t>(DiagLevel::Trace),
+};
+std::unique_ptr<SpscRingBuffer<Diagnostics::Record>> Diagnostics::s_queue;
+std::atomic_flag Diagnostics::s_producerLock = ATOMIC_FLAG_INIT;
+std::atomic<bool> Diagnostics::s_running{false};
+std::thread Diagnostics::s_printerThread;
+std::mutex Diagnostics::s_printerMutex;
+std::condition_variable Diagnostics::s_printerWake;
+bool Diagnostics::s_stopPrinter = false;
+// Defaults allow normal typing and clicking but cap key-repeat and drag floods
+std::atomic<std::uint32_t> Diagnostics::s_rateLimits[CATEGORY_COUNT] = { 100, 50, 50, 20, 0 };
+std::atomic<std::uint64_t> Diagnostics::s_rateWindow[CATEGORY_COUNT] = {};
+std::atomic<std::uint32_t> Diagnostics::s_rateCount[CATEGORY_COUNT] = {};
+std::atomic<std::uint32_t> Diagnostics::s_suppressed[CATEGORY_COUNT] = {};
+std::atomic<std::uint64_t> Diagnostics::s_queueDrops{0};
+
+// Queue capacity in records (128KB); the printer drains it every interval
+constexpr size_t DIAG_QUEUE_CAPACITY = 1024;
+constexpr auto DIAG_PRINT_INTERVAL = std::chrono::milliseconds(20);
+
+namespace {
+
+const char* CategoryName(DiagCategory category) {
+    switch (category) {
+        case DiagCategory::Keyboard: return "keyboard";
+        case DiagCategory::Mouse: return "mouse";
+        case DiagCategory::Combo: return "combo";
+        case DiagCategory::Overlay: return "overlay";
+        default: return "general";
+    }
+}
+
+// Right-aligned decimal, like std::setw(width)
+void AppendPadded(std::string& out, std::uint64_t value, size_t width) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    size_t length = static_cast<size_t>(result.ptr - digits);
+    if (length < width) {
+        out.append(width - length, ' ');
+    }
+    out.append(digits, length);
+}
+
+// Zero-padded lowercase hex, like std::hex << std::setw(width) << std::setfill('0')
+void AppendHex(std::string& out, std::uint32_t value, size_t width) {
+    char digits[16];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value, 16);
+    size_t length = static_cast<size_t>(result.ptr - digits);
+    if (length < width) {
+        out.append(width - length, '0');
+    }
+    out.append(digits, length);
+}
+
+void AppendInt(std::string& out, std::int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+bool ParseLevel(const char* text, DiagLevel& level) {
+    std::string_view value = text;
+    if (value == "off") level = DiagLevel::Off;
+    else if (value == "error") level = DiagLevel::Error;
+    else if (value == "warning") level = DiagLevel::Warning;
+    else if (value == "info") level = DiagLevel::Info;
+    else if (value == "trace") level = DiagLevel::Trace;
+    else return false;
+    return true;
+}
+
+}  // namespace
+
+void Diagnostics::Initialize() {
+    char verbosity[16] = {};
+    DWORD length = GetEnvironmentVariableA("WINOPAUTO_VERBOSITY", verbosity, sizeof(verbosity));
+    if (length > 0 && length < sizeof(verbosity)) {
+        DiagLevel level;
+        if (ParseLevel(verbosity, level)) {
+            SetLevel(level);
+        } else {
+            std::cout << "[WARNING] Unknown WINOPAUTO_VERBOSITY '" << verbosity << "' (use off/error/warning/info/trace)\n";
+        }
+    }
+
+    if (!s_printerThread.joinable()) {
+        s_queue = std::make_unique<SpscRingBuffer<Record>>(DIAG_QUEUE_CAPACITY);
+        s_stopPrinter = false;
+        s_printerThread = std::thread(PrinterThreadMain);
+        s_running = true;
+    }
+
+    std::cout << "[OK] Diagnostics initialized (background console output)\n";
+}
+
+void Diagnostics::Shutdown() {
+    if (!s_printerThread.joinable()) {
+        return;
+    }
+
+    // Later messages go straight to the console; wait out a producer that is mid-push
+    s_running = false;
+    while (s_producerLock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    s_producerLock.clear(std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(s_printerMutex);
+        s_stopPrinter = true;
+    }
+    s_printerWake.notify_one();
+    s_printerThread.join();
+    s_queue.reset();
+
+    std::uint64_t drops = s_queueDrops.exchange(0);
+    if (drops > 0) {
+        std::cout << "[WARNING] " << drops << " diagnostic messages dropped (queue full)\n";
+    }
+}
+
+void Diagnostics::SetLevel(DiagLevel level) {
+    for (auto& categoryLevel : s_categoryLevels) {
+        categoryLevel.store(static_cast<std::uint8_t>(level), std::memory_order_relaxed);
+    }
+    std::cout << "[CONFIG] Diagnostics level set to " << static_cast<int>(level) << "\n";
+}
+
+void Diagnostics::SetCategoryLevel(DiagCategory category, DiagLevel level) {
+    s_categoryLevels[static_cast<size_t>(category)].store(static_cast<std::uint8_t>(level), std::memory_order_relaxed);
+    std::cout << "[CONFIG] Diagnostics level for " << CategoryName(category) << " set to " << static_cast<int>(level) << "\n";
+}
+
+void Diagnostics::SetRateLimit(DiagCategory category, std::uint32_t messagesPerSecond) {
+    s_rateLimits[static_cast<size_t>(category)].store(messagesPerSecond, std::memory_order_relaxed);
+    std::cout << "[CONFIG] Diagnostics rate limit for " << CategoryName(category) << " set to "
+              << messagesPerSecond << "/s\n";
+}
+
+void Diagnostics::EmitKeyEvent(std::uint64_t timestamp, USHORT vKey, USHORT scanCode, bool isKeyUp, POINT cursorPos, const char* label) {
+    Record record = {};
+    record.kind = RecordKind::KeyEvent;
+    record.category = DiagCategory::Keyboard;
+    record.timestamp = timestamp;
+    record.label = label;
+    record.args[0] = vKey;
+    record.args[1] = scanCode;
+    record.args[2] = cursorPos.x;
+    record.args[3] = cursorPos.y;
+    record.isUp = isKeyUp;
+    Submit(record);
+}
+
+void Diagnostics::EmitMouseEvent(std::uint64_t timestamp, const char* action, LONG deltaX, LONG deltaY, POINT cursorPos) {
+    Record record = {};
+    record.kind = RecordKind::MouseEvent;
+    record.category = DiagCategory::Mouse;
+    record.timestamp = timestamp;
+    record.label = action;
+    record.args[0] = deltaX;
+    record.args[1] = deltaY;
+    record.args[2] = cursorPos.x;
+    record.args[3] = cursorPos.y;
+    Submit(record);
+}
+
+void Diagnostics::EmitCombo(const char* specialKeyName, USHORT vKey) {
+    Record record = {};
+    record.kind = RecordKind::Combo;
+    record.category = DiagCategory::Combo;
+    record.label = specialKeyName;
+    record.args[0] = vKey;
+    Submit(record);
+}
+
+void Diagnostics::EmitMessage(DiagCategory category, std::string_view text) {
+    Record record = {};
+    record.kind = RecordKind::Message;
+    record.category = category;
+    size_t length = (std::min)(text.size(), sizeof(record.text));
+    std::memcpy(record.text, text.data(), length);
+    record.textLength = static_cast<std::uint8_t>(length);
+    Submit(record);
+}
+
+bool Diagnostics::TakeToken(DiagCategory category) {
+    size_t index = static_cast<size_t>(category);
+    std::uint32_t limit = s_rateLimits[index].load(std::memory_order_relaxed);
+    if (limit == 0) {
+        return true;
+    }
+
+    // Fixed windows are approximate under concurrent producers, which is fine for console output
+    std::uint64_t second = GetTickCount64() / 1000;
+    if (s_rateWindow[index].exchange(second, std::memory_order_relaxed) != second) {
+        s_rateCount[index].store(0, std::memory_order_relaxed);
+    }
+    if (s_rateCount[index].fetch_add(1, std::memory_order_relaxed) < limit) {
+        return true;
+    }
+    s_suppressed[index].fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Diagnostics::Submit(const Record& record) {
+    if (!TakeToken(record.category)) {
+        return;
+    }
+
+    if (!s_running.load(std::memory_order_acquire)) {
+        std::string line;
+        FormatRecord(record, line);
+        std::cout << line;
+        return;
+    }
+
+    // Producers are almost always the input thread alone, so this lock is uncontended
+    while (s_producerLock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    bool queued = s_running.load(std::memory_order_relaxed) && s_queue->TryPush(record);
+    s_producerLock.clear(std::memory_order_release);
+
+    // Never block input on the console: count and drop instead
+    if (!queued) {
+        s_queueDrops.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Diagnostics::FormatRecord(const Record& record, std::string& out) {
+    switch (record.kind) {
+        case RecordKind::KeyEvent:
+            out += '[';
+            AppendPadded(out, record.timestamp, 10);
+            out += "us] KB: VK=0x";
+            AppendHex(out, static_cast<std::uint32_t>(record.args[0]), 2);
+            out += " SC=0x";
+            AppendHex(out, static_cast<std::uint32_t>(record.args[1]), 2);
+            out += record.isUp ? " UP" : " DOWN";
+            if (record.label) {
+                out += " (";
+                out += record.label;
+                out += ')';
+            }
+            out += " Cursor=(";
+            AppendInt(out, record.args[2]);
+            out += ',';
+            AppendInt(out, record.args[3]);
+            out += ")\n";
+            break;
+
+        case RecordKind::MouseEvent:
+            out += '[';
+            AppendPadded(out, record.timestamp, 10);
+            out += "us] MOUSE: ";
+            out += record.label;
+            out += " Delta=(";
+            AppendInt(out, record.args[0]);
+            out += ',';
+            AppendInt(out, record.args[1]);
+            out += ") Cursor=(";
+            AppendInt(out, record.args[2]);
+            out += ',';
+            AppendInt(out, record.args[3]);
+            out += ")\n";
+            break;
+
+        case RecordKind::Combo:
+            out += "[COMBO] ";
+            out += record.label;
+            out += " + 0x";
+            AppendHex(out, static_cast<std::uint32_t>(record.args[0]), 0);
+            out += " detected\n";
+            break;
+
+        case RecordKind::Message:
+            out.append(record.text, record.textLength);
+            out += '\n';
+            break;
+    }
+}
+
+void Diagnostics::PrinterThreadMain() {
+    std::vector<Record> batch(s_queue->Capacity());
+    std::string output;
+    output.reserve(64 * 1024);
+
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(s_printerMutex);
+            s_printerWake.wait_for(lock, DIAG_PRINT_INTERVAL, [] { return s_stopPrinter; });
+            stopping = s_stopPrinter;
+        }
+
+        output.clear();
+        size_t count;
+        while ((count = s_queue->PopBatch(batch.data(), batch.size())) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                FormatRecord(batch[i], output);
+            }
+        }
+
+        // Report rate-limited categories once per interval in which something was suppressed
+        for (size_t i = 0; i < CATEGORY_COUNT; ++i) {
+            std::uint32_t suppressed = s_suppressed[i].exchange(0, std::memory_order_relaxed);
+            if (suppressed > 0) {
+                output += "[DIAG] Suppressed ";
+                AppendInt(output, suppressed);
+                output += ' ';
+                output += CategoryName(static_cast<DiagCategory>(i));
+                output += " messages (rate limit)\n";
+            }
+        }
+
+        // One console write per batch instead of one per event
+        if (!output.empty()) {
+            std::cout.write(output.data(), static_cast<std::streamsize>(output.size()));
+            std::cout.flush();
+        }
+
+        if (stopping) {
+            break;
+        }
+    }
+}
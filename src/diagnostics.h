@@ -0,0 +1,135 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "spsc_ring_buffer.h"
+
+// Verbosity, lowest to highest. A message is printed if its level <= the category's level.
+enum class DiagLevel : std::uint8_t {
+    Off = 0,
+    Error = 1,
+    Warning = 2,
+    Info = 3,
+    Trace = 4   // Per-event input traces (KB/MOUSE/COMBO/OVERLAY lines)
+};
+
+// Message categories, each with its own level and rate limit
+enum class DiagCategory : std::uint8_t {
+    Keyboard,
+    Mouse,
+    Combo,
+    Overlay,
+    General,
+    Count
+};
+
+// Console diagnostics kept off the input thread: callers queue fixed-size
+// records and a background thread formats and prints them in batches.
+// A disabled category costs one relaxed atomic load at the call site.
+class Diagnostics {
+public:
+    // Start the printer thread. Reads WINOPAUTO_VERBOSITY (off/error/warning/info/trace) if set.
+    static void Initialize();
+
+    // Print everything still queued and stop the printer thread
+    static void Shutdown();
+
+    // Level for every category (default: Trace, which matches the previous console output)
+    static void SetLevel(DiagLevel level);
+
+    // Level for one category
+    static void SetCategoryLevel(DiagCategory category, DiagLevel level);
+
+    // Maximum messages per second for a category (0 = unlimited); excess is counted and reported
+    static void SetRateLimit(DiagCategory category, std::uint32_t messagesPerSecond);
+
+    // Cheap check for call sites that need to prepare arguments
+    static bool IsEnabled(DiagCategory category, DiagLevel level) {
+        return static_cast<std::uint8_t>(level) <=
+               s_categoryLevels[static_cast<size_t>(category)].load(std::memory_order_relaxed);
+    }
+
+    // "[ts us] KB: VK=0x.. SC=0x.. DOWN (name) Cursor=(x,y)" (label may be nullptr; must be a static string)
+    static void KeyEvent(std::uint64_t timestamp, USHORT vKey, USHORT scanCode, bool isKeyUp, POINT cursorPos, const char* label) {
+        if (IsEnabled(DiagCategory::Keyboard, DiagLevel::Trace)) {
+            EmitKeyEvent(timestamp, vKey, scanCode, isKeyUp, cursorPos, label);
+        }
+    }
+
+    // "[ts us] MOUSE: L_DOWN Delta=(dx,dy) Cursor=(x,y)" (action must be a static string)
+    static void MouseEvent(std::uint64_t timestamp, const char* action, LONG deltaX, LONG deltaY, POINT cursorPos) {
+        if (IsEnabled(DiagCategory::Mouse, DiagLevel::Trace)) {
+            EmitMouseEvent(timestamp, action, deltaX, deltaY, cursorPos);
+        }
+    }
+
+    // "[COMBO] <special> + 0x.. detected" (specialKeyName must be a static string)
+    static void Combo(const char* specialKeyName, USHORT vKey) {
+        if (IsEnabled(DiagCategory::Combo, DiagLevel::Trace)) {
+            EmitCombo(specialKeyName, vKey);
+        }
+    }
+
+    // Free-form line (copied, truncated to the record's text capacity)
+    static void Message(DiagCategory category, DiagLevel level, std::string_view text) {
+        if (IsEnabled(category, level)) {
+            EmitMessage(category, text);
+        }
+    }
+
+private:
+    enum class RecordKind : std::uint8_t { KeyEvent, MouseEvent, Combo, Message };
+
+    // Fixed-size queued record; formatting happens on the printer thread
+    struct Record {
+        std::uint64_t timestamp;
+        const char* label;      // Static string (key name, mouse action)
+        std::int32_t args[4];
+        RecordKind kind;
+        DiagCategory category;
+        bool isUp;              // Key events: key released
+        std::uint8_t textLength;
+        char text[92];
+    };
+
+    static std::atomic<std::uint8_t> s_categoryLevels[static_cast<size_t>(DiagCategory::Count)];
+
+    static void EmitKeyEvent(std::uint64_t timestamp, USHORT vKey, USHORT scanCode, bool isKeyUp, POINT cursorPos, const char* label);
+    static void EmitMouseEvent(std::uint64_t timestamp, const char* action, LONG deltaX, LONG deltaY, POINT cursorPos);
+    static void EmitCombo(const char* specialKeyName, USHORT vKey);
+    static void EmitMessage(DiagCategory category, std::string_view text);
+
+    // Rate limit, then queue (or print directly if the printer thread is not running)
+    static void Submit(const Record& record);
+
+    // Rate limiter: true if the category may print another message this second
+    static bool TakeToken(DiagCategory category);
+
+    // Append a record's console line to out
+    static void FormatRecord(const Record& record, std::string& out);
+
+    // Printer thread body
+    static void PrinterThreadMain();
+
+    static std::unique_ptr<SpscRingBuffer<Record>> s_queue;
+    static std::atomic_flag s_producerLock;   // Serializes producers on the SPSC queue
+    static std::atomic<bool> s_running;
+    static std::thread s_printerThread;
+    static std::mutex s_printerMutex;
+    static std::condition_variable s_printerWake;
+    static bool s_stopPrinter;
+
+    // Per-category rate limiting (fixed one-second windows)
+    static std::atomic<std::uint32_t> s_rateLimits[static_cast<size_t>(DiagCategory::Count)];
+    static std::atomic<std::uint64_t> s_rateWindow[static_cast<size_t>(DiagCategory::Count)];
+    static std::atomic<std::uint32_t> s_rateCount[static_cast<size_t>(DiagCategory::Count)];
+    static std::atomic<std::uint32_t> s_suppressed[static_cast<size_t>(DiagCategory::Count)];
+    static std::atomic<std::uint64_t> s_queueDrops;
+};
@@ -0,0 +1,308 @@
+#include "event_archive.h"
+#include <compressapi.h>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+// Static member definitions
+std::string EventArchive::s_directory;
+bool EventArchive::s_enabled = false;
+size_t EventArchive::s_maxSegments = 512;
+std::vector<ArchiveSegment> EventArchive::s_segments;
+std::uint32_t EventArchive::s_nextSequence = 1;
+std::deque<std::uint32_t> EventArchive::s_compressQueue;
+std::mutex EventArchive::s_mutex;
+std::condition_variable EventArchive::s_wake;
+std::thread EventArchive::s_compressorThread;
+bool EventArchive::s_stopCompressor = false;
+
+// Suffix of compressed segments (Compression API buffer format, which records the original size)
+constexpr char COMPRESSED_SUFFIX[] = ".xph";
+
+// FILETIME of 1970-01-01 in 100ns units
+constexpr std::uint64_t UNIX_EPOCH_FILETIME = 116444736000000000ULL;
+
+namespace {
+
+// Value after "field": in one of our own index lines (strings have no escapes)
+std::string_view IndexField(std::string_view line, std::string_view field) {
+    std::string key = "\"" + std::string(field) + "\":";
+    size_t start = line.find(key);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    start += key.size();
+    if (start < line.size() && line[start] == '"') {
+        size_t end = line.find('"', start + 1);
+        return end == std::string_view::npos ? std::string_view() : line.substr(start + 1, end - start - 1);
+    }
+    size_t end = line.find_first_of(",}", start);
+    return line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+}
+
+std::uint64_t IndexNumber(std::string_view line, std::string_view field) {
+    std::string_view text = IndexField(line, field);
+    std::uint64_t value = 0;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+}
+
+bool ReadWholeFile(const std::string& path, std::vector<char>& data) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    return static_cast<bool>(file.read(data.data(), static_cast<std::streamsize>(data.size())));
+}
+
+}  // namespace
+
+bool EventArchive::Initialize(const std::string& directory) {
+    if (s_enabled) return true;
+
+    if (!CreateDirectoryA(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+        std::cout << "[ERROR] Could not create event archive directory " << directory << ": " << GetLastError() << "\n";
+        return false;
+    }
+    s_directory = directory;
+
+    size_t segmentCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        LoadIndex();
+        for (const ArchiveSegment& segment : s_segments) {
+            if (!segment.compressed) {
+                s_compressQueue.push_back(segment.sequence);
+            }
+        }
+        segmentCount = s_segments.size();
+    }
+
+    s_stopCompressor = false;
+    s_compressorThread = std::thread(CompressorThreadMain);
+    s_enabled = true;
+    std::cout << "[OK] Event archive: " << directory << " (" << segmentCount << " segments)\n";
+    return true;
+}
+
+void EventArchive::Shutdown() {
+    if (!s_compressorThread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stopCompressor = true;
+    }
+    s_wake.notify_one();
+    s_compressorThread.join();
+    s_enabled = false;
+}
+
+bool EventArchive::IsEnabled() {
+    return s_enabled;
+}
+
+bool EventArchive::ArchiveFile(const std::string& activeLogPath, bool binary, std::uint64_t startMs, std::uint64_t endMs) {
+    WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+    if (!GetFileAttributesExA(activeLogPath.c_str(), GetFileExInfoStandard, &attributes)) {
+        return false;
+    }
+    std::uint64_t bytes = (static_cast<std::uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    if (bytes == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    ArchiveSegment segment = {};
+    segment.sequence = s_nextSequence++;
+    char name[40];
+    std::snprintf(name, sizeof(name), "segment-%06u%s", segment.sequence, binary ? ".bin" : ".jsonl");
+    segment.fileName = name;
+    segment.startMs = startMs;
+    segment.endMs = endMs;
+    segment.bytes = bytes;
+    segment.compressed = false;
+
+    // Moving fails while another process (e.g. the Python worker) has the log open
+    std::string target = PathOf(segment.fileName);
+    if (!MoveFileExA(activeLogPath.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED) &&
+        !CopyFileA(activeLogPath.c_str(), target.c_str(), FALSE)) {
+        std::cout << "[WARNING] Could not archive " << activeLogPath << ": " << GetLastError() << "\n";
+        return false;
+    }
+
+    s_segments.push_back(segment);
+    PruneSegments();
+    SaveIndex();
+    s_compressQueue.push_back(segment.sequence);
+    s_wake.notify_one();
+    return true;
+}
+
+std::uint64_t EventArchive::GetLastEndMs() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    return s_segments.empty() ? 0 : s_segments.back().endMs;
+}
+
+void EventArchive::SetMaxSegments(size_t count) {
+    s_maxSegments = count > 0 ? count : 1;
+    std::cout << "[CONFIG] Event archive keeps " << s_maxSegments << " segments\n";
+}
+
+std::uint64_t EventArchive::NowUnixMs() {
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return FileTimeToUnixMs(now);
+}
+
+std::uint64_t EventArchive::FileTimeToUnixMs(const FILETIME& time) {
+    std::uint64_t ticks = (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    return ticks > UNIX_EPOCH_FILETIME ? (ticks - UNIX_EPOCH_FILETIME) / 10000 : 0;
+}
+
+void EventArchive::CompressorThreadMain() {
+    std::unique_lock<std::mutex> lock(s_mutex);
+    while (true) {
+        s_wake.wait(lock, [] { return s_stopCompressor || !s_compressQueue.empty(); });
+        if (s_compressQueue.empty()) {
+            return;  // Stop requested and nothing left to compress
+        }
+
+        std::uint32_t sequence = s_compressQueue.front();
+        s_compressQueue.pop_front();
+        lock.unlock();
+        CompressSegment(sequence);
+        lock.lock();
+    }
+}
+
+bool EventArchive::CompressSegment(std::uint32_t sequence) {
+    std::string fileName;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        for (const ArchiveSegment& segment : s_segments) {
+            if (segment.sequence == sequence && !segment.compressed) {
+                fileName = segment.fileName;
+            }
+        }
+    }
+    if (fileName.empty()) {
+        return false;  // Pruned or already compressed
+    }
+
+    std::vector<char> input;
+    if (!ReadWholeFile(PathOf(fileName), input)) {
+        std::cout << "[WARNING] Could not read archive segment " << fileName << "\n";
+        return false;
+    }
+
+    // XPRESS with Huffman: fast, and text logs shrink 5-10x
+    COMPRESSOR_HANDLE compressor = nullptr;
+    if (!CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &compressor)) {
+        std::cout << "[WARNING] Compression unavailable: " << GetLastError() << "\n";
+        return false;
+    }
+    SIZE_T compressedSize = 0;
+    Compress(compressor, input.data(), input.size(), nullptr, 0, &compressedSize);
+    std::vector<char> output(compressedSize);
+    bool compressed = compressedSize > 0 &&
+        Compress(compressor, input.data(), input.size(), output.data(), output.size(), &compressedSize);
+    CloseCompressor(compressor);
+    if (!compressed) {
+        std::cout << "[WARNING] Could not compress archive segment " << fileName << ": " << GetLastError() << "\n";
+        return false;
+    }
+
+    // Write next to the original, then switch the index over before deleting it
+    std::string compressedName = fileName + COMPRESSED_SUFFIX;
+    std::string temporary = PathOf(compressedName) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file.write(output.data(), static_cast<std::streamsize>(compressedSize))) {
+            std::cout << "[WARNING] Could not write " << temporary << "\n";
+            return false;
+        }
+    }
+
+    {
+        // Under the lock, so the segment cannot be pruned between the check and the rename
+        std::lock_guard<std::mutex> lock(s_mutex);
+        ArchiveSegment* indexed = nullptr;
+        for (ArchiveSegment& segment : s_segments) {
+            if (segment.sequence == sequence && !segment.compressed) {
+                indexed = &segment;
+            }
+        }
+        if (!indexed) {
+            DeleteFileA(temporary.c_str());
+            return false;  // Pruned while compressing
+        }
+        if (!MoveFileExA(temporary.c_str(), PathOf(compressedName).c_str(), MOVEFILE_REPLACE_EXISTING)) {
+            DeleteFileA(temporary.c_str());
+            return false;
+        }
+        indexed->fileName = compressedName;
+        indexed->compressed = true;
+        SaveIndex();
+    }
+    DeleteFileA(PathOf(fileName).c_str());
+    return true;
+}
+
+void EventArchive::SaveIndex() {
+    std::string temporary = PathOf("index.jsonl.tmp");
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "[WARNING] Could not write event archive index\n";
+            return;
+        }
+        for (const ArchiveSegment& segment : s_segments) {
+            file << "{\"seq\":" << segment.sequence
+                 << ",\"file\":\"" << segment.fileName
+                 << "\",\"start_ms\":" << segment.startMs
+                 << ",\"end_ms\":" << segment.endMs
+                 << ",\"bytes\":" << segment.bytes
+                 << ",\"compressed\":" << (segment.compressed ? "true" : "false") << "}\n";
+        }
+    }
+    // Readers never see a half-written index
+    MoveFileExA(temporary.c_str(), PathOf("index.jsonl").c_str(), MOVEFILE_REPLACE_EXISTING);
+}
+
+void EventArchive::LoadIndex() {
+    s_segments.clear();
+    std::ifstream file(PathOf("index.jsonl"));
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string_view fileName = IndexField(line, "file");
+        if (fileName.empty()) {
+            continue;
+        }
+        ArchiveSegment segment = {};
+        segment.sequence = static_cast<std::uint32_t>(IndexNumber(line, "seq"));
+        segment.fileName = std::string(fileName);
+        segment.startMs = IndexNumber(line, "start_ms");
+        segment.endMs = IndexNumber(line, "end_ms");
+        segment.bytes = IndexNumber(line, "bytes");
+        segment.compressed = IndexField(line, "compressed") == "true";
+        s_segments.push_back(segment);
+        if (segment.sequence >= s_nextSequence) {
+            s_nextSequence = segment.sequence + 1;
+        }
+    }
+}
+
+void EventArchive::PruneSegments() {
+    while (s_segments.size() > s_maxSegments) {
+        DeleteFileA(PathOf(s_segments.front().fileName).c_str());
+        s_segments.erase(s_segments.begin());
+    }
+}
+
+std::string EventArchive::PathOf(const std::string& fileName) {
+    return s_directory + "\\" + fileName;
+}
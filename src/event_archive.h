@@ -0,0 +1,79 @@
+#pragma once
+
+#include <windows.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One closed log segment, as listed in <directory>/index.jsonl (read by event_archive.py)
+struct ArchiveSegment {
+    std::uint32_t sequence;
+    std::string fileName;       // Relative to the archive directory
+    std::uint64_t startMs;      // Wall clock (Unix milliseconds) of the first record
+    std::uint64_t endMs;        // Wall clock when the segment was closed
+    std::uint64_t bytes;        // Uncompressed size
+    bool compressed;            // fileName is an XPRESS_HUFF buffer (Windows Compression API)
+};
+
+// Long-session archive for the event log. EventLogger rotates the active log
+// into numbered segments here; closed segments are compressed on a background
+// thread and listed with their time ranges in a small index, so "last N minutes"
+// readers only open the tail. Segments survive restarts.
+class EventArchive {
+public:
+    // Create the directory if needed, load the index and start the compressor thread.
+    // Segments a previous run left uncompressed are queued again.
+    static bool Initialize(const std::string& directory);
+
+    // Finish queued compression and stop the compressor thread
+    static void Shutdown();
+
+    static bool IsEnabled();
+
+    // Move the closed active log into the archive as a new segment and queue it for compression.
+    // Falls back to copying if the file can't be moved (e.g. a reader still has it open);
+    // the caller truncates the active log afterwards either way. Returns false if nothing was archived.
+    static bool ArchiveFile(const std::string& activeLogPath, bool binary, std::uint64_t startMs, std::uint64_t endMs);
+
+    // End time of the newest segment (0 if there is none)
+    static std::uint64_t GetLastEndMs();
+
+    // Segments kept on disk; older ones are deleted (default: 512)
+    static void SetMaxSegments(size_t count);
+
+    // Current wall clock, and a file time, in Unix milliseconds
+    static std::uint64_t NowUnixMs();
+    static std::uint64_t FileTimeToUnixMs(const FILETIME& time);
+
+private:
+    static void CompressorThreadMain();
+
+    // Compress one segment in place and update its index entry
+    static bool CompressSegment(std::uint32_t sequence);
+
+    // Rewrite index.jsonl atomically (s_mutex held)
+    static void SaveIndex();
+    static void LoadIndex();
+
+    // Delete the oldest segments past s_maxSegments (s_mutex held)
+    static void PruneSegments();
+
+    static std::string PathOf(const std::string& fileName);
+
+    static std::string s_directory;
+    static bool s_enabled;
+    static size_t s_maxSegments;
+
+    // Index and compression queue, guarded by s_mutex
+    static std::vector<ArchiveSegment> s_segments;
+    static std::uint32_t s_nextSequence;
+    static std::deque<std::uint32_t> s_compressQueue;
+    static std::mutex s_mutex;
+    static std::condition_variable s_wake;
+    static std::thread s_compressorThread;
+    static bool s_stopCompressor;
+};
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""
+Reader for the long-session event archive (EventArchive in event_archive.cpp)
+
+With WINOPAUTO_ARCHIVE_DIR set, the C++ side rotates input_events.txt into
+numbered segments in that directory and lists them in index.jsonl, one JSON
+object per segment:
+    {"seq":12,"file":"segment-000012.jsonl.xph","start_ms":...,"end_ms":...,"bytes":...,"compressed":true}
+start_ms/end_ms are wall-clock Unix milliseconds. Closed segments are
+compressed with the Windows Compression API (XPRESS_HUFF, buffer mode) and
+are decompressed here through cabinet.dll with ctypes.
+
+"Last N minutes" readers only open the segments whose time range reaches into
+the window, plus the active log.
+
+Usage:
+    python event_archive.py <archive dir> --recent <minutes> [active log]
+    python event_archive.py <archive dir> --extract <segment file> <output file>
+"""
+
+import json
+import os
+import sys
+import time
+from typing import Dict, List, Optional
+
+from process_input import (BINARY_LOG_MAGIC, BINARY_LOG_VERSION, BINARY_LOG_HEADER, BINARY_LOG_RECORD,
+                           decode_binary_records, read_input_events)
+
+INDEX_FILE = "index.jsonl"
+
+# COMPRESS_ALGORITHM_XPRESS_HUFF in compressapi.h
+COMPRESS_ALGORITHM_XPRESS_HUFF = 4
+
+
+def load_index(archive_dir: str) -> List[Dict]:
+    """Segments listed in the archive index, oldest first (empty if there is no archive)."""
+    segments = []
+    try:
+        with open(os.path.join(archive_dir, INDEX_FILE), "r", encoding="utf-8") as f:
+            for line in f:
+                line = line.strip()
+                if not line:
+                    continue
+                try:
+                    segments.append(json.loads(line))
+                except json.JSONDecodeError:
+                    continue
+    except OSError:
+        return []
+    segments.sort(key=lambda segment: segment.get("seq", 0))
+    return segments
+
+
+def decompress_xpress_huff(data: bytes) -> bytes:
+    """Decompress a Compression API buffer (the format records the original size)."""
+    import ctypes
+
+    cabinet = ctypes.WinDLL("cabinet", use_last_error=True)
+    cabinet.CreateDecompressor.argtypes = [ctypes.c_uint32, ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p)]
+    cabinet.Decompress.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t,
+                                   ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_size_t)]
+    cabinet.CloseDecompressor.argtypes = [ctypes.c_void_p]
+
+    handle = ctypes.c_void_p()
+    if not cabinet.CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, None, ctypes.byref(handle)):
+        raise OSError(f"CreateDecompressor failed: {ctypes.get_last_error()}")
+    try:
+        # A first call without an output buffer reports the decompressed size
+        size = ctypes.c_size_t(0)
+        cabinet.Decompress(handle, data, len(data), None, 0, ctypes.byref(size))
+        output = ctypes.create_string_buffer(max(size.value, 1))
+        if not cabinet.Decompress(handle, data, len(data), output, size.value, ctypes.byref(size)):
+            raise OSError(f"Decompress failed: {ctypes.get_last_error()}")
+        return output.raw[:size.value]
+    finally:
+        cabinet.CloseDecompressor(handle)
+
+
+def read_segment_bytes(archive_dir: str, segment: Dict) -> bytes:
+    """Raw log bytes of one segment, decompressed if needed."""
+    with open(os.path.join(archive_dir, segment["file"]), "rb") as f:
+        data = f.read()
+    return decompress_xpress_huff(data) if segment.get("compressed") else data
+
+
+def parse_log_bytes(data: bytes) -> List[Dict]:
+    """Events from the contents of a JSON lines or binary log."""
+    if data.startswith(BINARY_LOG_MAGIC):
+        if len(data) < BINARY_LOG_HEADER.size:
+            return []
+        magic, version, record_size, timestamp_base = BINARY_LOG_HEADER.unpack_from(data)
+        if version != BINARY_LOG_VERSION or record_size != BINARY_LOG_RECORD.size:
+            raise ValueError(f"Unsupported binary log (version {version}, record size {record_size})")
+        body = data[BINARY_LOG_HEADER.size:]
+        return list(decode_binary_records(body[:len(body) - len(body) % record_size], timestamp_base))
+
+    events = []
+    for line in data.decode("utf-8", errors="replace").splitlines():
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            events.append(json.loads(line))
+        except json.JSONDecodeError:
+            continue
+    return events
+
+
+def recent_segments(archive_dir: str, minutes: float, now_ms: Optional[int] = None) -> List[Dict]:
+    """Index entries whose time range reaches into the last `minutes` minutes."""
+    if now_ms is None:
+        now_ms = int(time.time() * 1000)
+    cutoff = now_ms - int(minutes * 60 * 1000)
+    return [segment for segment in load_index(archive_dir) if segment.get("end_ms", 0) >= cutoff]
+
+
+def read_recent_events(active_log: str, archive_dir: Optional[str], minutes: float) -> List[Dict]:
+    """Events from the last `minutes` minutes: recent archive segments, then the active log.
+
+    Segments are selected by their index time range, so the result reaches back
+    at most one segment further than the window. Without an archive this is
+    just read_input_events(active_log).
+    """
+    events = []
+    if archive_dir:
+        for segment in recent_segments(archive_dir, minutes):
+            try:
+                events.extend(parse_log_bytes(read_segment_bytes(archive_dir, segment)))
+            except (OSError, ValueError) as e:
+                print(f"[WARNING] Skipping archive segment {segment.get('file')}: {e}")
+    if os.path.exists(active_log) or not events:
+        events.extend(read_input_events(active_log))
+    return events
+
+
+def main(argv) -> int:
+    if len(argv) in (4, 5) and argv[2] == "--recent":
+        active_log = argv[4] if len(argv) == 5 else "input_events.txt"
+        events = read_recent_events(active_log, argv[1], float(argv[3]))
+        print(f"[SUCCESS] {len(events)} events from the last {argv[3]} minutes")
+        return 0
+    if len(argv) == 5 and argv[2] == "--extract":
+        segment = next((s for s in load_index(argv[1]) if s.get("file") == argv[3]),
+                       {"file": argv[3], "compressed": argv[3].endswith(".xph")})
+        data = read_segment_bytes(argv[1], segment)
+        with open(argv[4], "wb") as out:
+            out.write(data)
+        print(f"[SUCCESS] Wrote {len(data)} bytes to {argv[4]}")
+        return 0
+    print(__doc__)
+    return 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
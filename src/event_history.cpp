@@ -0,0 +1,88 @@
+#include "event_history.h"
+#include <algorithm>
+
+namespace {
+
+std::int16_t ClampToInt16(LONG value) {
+    return static_cast<std::int16_t>(std::clamp<LONG>(value, INT16_MIN, INT16_MAX));
+}
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+}  // namespace
+
+EventRecord EventRecord::FromKeyboard(std::uint64_t timestamp, POINT cursorPos, const KeyboardEventData& kbData) {
+    EventRecord record = {};
+    record.timestamp = timestamp;
+    record.cursorX = cursorPos.x;
+    record.cursorY = cursorPos.y;
+    record.type = EventType::KEYBOARD;
+    record.flags = kbData.isKeyUp ? EVENT_FLAG_KEY_UP : 0;
+    record.code = kbData.vKey;
+    record.keyboard.scanCode = kbData.scanCode;
+    record.keyboard.rawFlags = kbData.flags;
+    return record;
+}
+
+EventRecord EventRecord::FromMouse(std::uint64_t timestamp, POINT cursorPos, const MouseEventData& mouseData) {
+    EventRecord record = {};
+    record.timestamp = timestamp;
+    record.cursorX = cursorPos.x;
+    record.cursorY = cursorPos.y;
+    record.type = EventType::MOUSE;
+    record.code = static_cast<std::uint16_t>(mouseData.eventType);
+
+    switch (mouseData.eventType) {
+        case MouseEventData::LEFT_UP:
+        case MouseEventData::RIGHT_UP:
+        case MouseEventData::MIDDLE_UP:
+            record.flags = EVENT_FLAG_KEY_UP;
+            break;
+        default:
+            break;
+    }
+
+    if (mouseData.eventType == MouseEventData::WHEEL) {
+        record.wheelDelta = mouseData.wheelData;
+    } else {
+        record.mouse.deltaX = ClampToInt16(mouseData.deltaX);
+        record.mouse.deltaY = ClampToInt16(mouseData.deltaY);
+    }
+    return record;
+}
+
+KeyboardEventData EventRecord::GetKeyboardData() const {
+    return KeyboardEventData(code, keyboard.scanCode, keyboard.rawFlags, IsKeyUp());
+}
+
+MouseEventData EventRecord::GetMouseData() const {
+    auto eventType = static_cast<MouseEventData::Type>(code);
+    if (eventType == MouseEventData::WHEEL) {
+        return MouseEventData(eventType, 0, 0, static_cast<short>(wheelDelta));
+    }
+    return MouseEventData(eventType, mouse.deltaX, mouse.deltaY);
+}
+
+EventHistory::EventHistory(size_t capacity)
+    : m_capacity(RoundUpToPowerOfTwo(capacity)),
+      m_mask(m_capacity - 1),
+      m_records(std::make_unique<EventRecord[]>(m_capacity)) {}
+
+EventHistory::Window EventHistory::Last(size_t count) const {
+    size_t retained = size();
+    size_t first = count < retained ? retained - count : 0;
+    return Window(ConstIterator(this, first), end());
+}
+
+EventHistory::Window EventHistory::Range(size_t first, size_t count) const {
+    size_t retained = size();
+    first = std::min(first, retained);
+    size_t last = std::min(first + count, retained);
+    return Window(ConstIterator(this, first), ConstIterator(this, last));
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+
+// Event data structures
+enum class EventType : std::uint8_t {
+    KEYBOARD,
+    MOUSE
+};
+
+struct KeyboardEventData {
+    USHORT vKey;
+    USHORT scanCode;
+    USHORT flags;
+    bool isKeyUp;
+
+    KeyboardEventData() = default;
+    KeyboardEventData(USHORT vk, USHORT sc, USHORT f, bool keyUp)
+        : vKey(vk), scanCode(sc), flags(f), isKeyUp(keyUp) {}
+};
+
+struct MouseEventData {
+    enum Type {
+        LEFT_DOWN, LEFT_UP, RIGHT_DOWN, RIGHT_UP,
+        MIDDLE_DOWN, MIDDLE_UP, WHEEL, MOVE
+    };
+
+    Type eventType;
+    LONG deltaX;
+    LONG deltaY;
+    short wheelData;  // Only used for wheel events
+
+    MouseEventData() = default;
+    MouseEventData(Type type, LONG dx, LONG dy, short wheel = 0)
+        : eventType(type), deltaX(dx), deltaY(dy), wheelData(wheel) {}
+};
+
+// Compact 24-byte tagged record stored in the event history.
+// Mouse deltas are clamped to 16 bits; wheel events store the wheel delta instead.
+struct EventRecord {
+    std::uint64_t timestamp;
+    std::int32_t cursorX;
+    std::int32_t cursorY;
+    EventType type;
+    std::uint8_t flags;     // EVENT_FLAG_* bits
+    std::uint16_t code;     // Virtual key for keyboard events, MouseEventData::Type for mouse events
+    union {
+        struct {
+            std::uint16_t scanCode;
+            std::uint16_t rawFlags;
+        } keyboard;
+        struct {
+            std::int16_t deltaX;
+            std::int16_t deltaY;
+        } mouse;
+        std::int32_t wheelDelta;
+    };
+
+    static constexpr std::uint8_t EVENT_FLAG_KEY_UP = 0x01;
+
+    static EventRecord FromKeyboard(std::uint64_t timestamp, POINT cursorPos, const KeyboardEventData& kbData);
+    static EventRecord FromMouse(std::uint64_t timestamp, POINT cursorPos, const MouseEventData& mouseData);
+
+    // Decode back into the capture-side structures
+    KeyboardEventData GetKeyboardData() const;
+    MouseEventData GetMouseData() const;
+    POINT GetCursorPosition() const { return POINT{ cursorX, cursorY }; }
+    bool IsKeyUp() const { return (flags & EVENT_FLAG_KEY_UP) != 0; }
+};
+
+static_assert(sizeof(EventRecord) == 24, "EventRecord should stay tightly packed");
+
+// Fixed-capacity event store. All storage is allocated up front; Push is O(1),
+// never allocates, and overwrites the oldest record once the buffer is full.
+// Logical index 0 is the oldest retained record.
+class EventHistory {
+public:
+    class ConstIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = EventRecord;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const EventRecord*;
+        using reference = const EventRecord&;
+
+        ConstIterator(const EventHistory* history, size_t index) : m_history(history), m_index(index) {}
+
+        reference operator*() const { return (*m_history)[m_index]; }
+        pointer operator->() const { return &(*m_history)[m_index]; }
+        ConstIterator& operator++() { ++m_index; return *this; }
+        ConstIterator operator++(int) { ConstIterator copy = *this; ++m_index; return copy; }
+        bool operator==(const ConstIterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const ConstIterator& other) const { return m_index != other.m_index; }
+
+    private:
+        const EventHistory* m_history;
+        size_t m_index;
+    };
+
+    // A contiguous logical window of the history, usable in range-for
+    class Window {
+    public:
+        Window(ConstIterator first, ConstIterator last) : m_first(first), m_last(last) {}
+        ConstIterator begin() const { return m_first; }
+        ConstIterator end() const { return m_last; }
+
+    private:
+        ConstIterator m_first;
+        ConstIterator m_last;
+    };
+
+    // Capacity is rounded up to the next power of two
+    explicit EventHistory(size_t capacity);
+
+    EventHistory(const EventHistory&) = delete;
+    EventHistory& operator=(const EventHistory&) = delete;
+
+    // Append a record, overwriting the oldest one when full
+    void Push(const EventRecord& record) {
+        m_records[m_totalPushed & m_mask] = record;
+        ++m_totalPushed;
+    }
+
+    // Logical access, 0 = oldest retained record
+    const EventRecord& operator[](size_t index) const {
+        return m_records[(m_totalPushed - size() + index) & m_mask];
+    }
+
+    const EventRecord& back() const { return (*this)[size() - 1]; }
+
+    size_t size() const { return m_totalPushed < m_capacity ? static_cast<size_t>(m_totalPushed) : m_capacity; }
+    bool empty() const { return m_totalPushed == 0; }
+    size_t capacity() const { return m_capacity; }
+
+    // Number of records ever pushed, including ones that have been overwritten
+    std::uint64_t TotalRecorded() const { return m_totalPushed; }
+
+    void clear() { m_totalPushed = 0; }
+
+    ConstIterator begin() const { return ConstIterator(this, 0); }
+    ConstIterator end() const { return ConstIterator(this, size()); }
+
+    // The last count records (or fewer if the history is shorter)
+    Window Last(size_t count) const;
+
+    // count records starting at logical index first (clamped to the retained range)
+    Window Range(size_t first, size_t count) const;
+
+private:
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<EventRecord[]> m_records;
+    std::uint64_t m_totalPushed = 0;
+};
+
+// Default history size: 64K records (1.5MB), enough for hours of typing
+constexpr size_t DEFAULT_EVENT_HISTORY_CAPACITY = 64 * 1024;
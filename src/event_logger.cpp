@@ -1,13 +1,89 @@
 #include "event_logger.h"
+#include "key_table.h"
+#include "instrumentation.h"
+#include "event_archive.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
-#include <sstream>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+#include <vector>
 
 // Static member definitions
 std::string EventLogger::s_logFilePath = "input_events.txt";
 bool EventLogger::s_initialized = false;
 bool EventLogger::s_shiftPressed = false;
 bool EventLogger::s_capsLockOn = false;
+LogFormat EventLogger::s_logFormat = LogFormat::Json;
+std::atomic<bool> EventLogger::s_binaryHeaderPending{true};
+std::uint64_t EventLogger::s_binaryTimestampBase = 0;
+bool EventLogger::s_asyncLogging = false;
+DWORD EventLogger::s_flushIntervalMs = 100;
+size_t EventLogger::s_flushBatchSize = 64;
+std::unique_ptr<SpscRingBuffer<EventLogger::LogRecord>> EventLogger::s_queue;
+std::thread EventLogger::s_writerThread;
+std::mutex EventLogger::s_writerMutex;
+std::condition_variable EventLogger::s_writerWake;
+std::condition_variable EventLogger::s_flushDone;
+bool EventLogger::s_stopWriter = false;
+bool EventLogger::s_flushRequested = false;
+std::atomic<std::uint64_t> EventLogger::s_recordsQueued{0};
+std::atomic<std::uint64_t> EventLogger::s_recordsWritten{0};
+std::string EventLogger::s_archiveDirectory;
+std::uint64_t EventLogger::s_segmentMaxBytes = 8 * 1024 * 1024;
+std::uint64_t EventLogger::s_segmentMaxMs = 3600 * 1000;
+std::uint64_t EventLogger::s_segmentBytes = 0;
+std::uint64_t EventLogger::s_segmentStartMs = 0;
+
+// Queue capacity in records (~300KB); large enough to absorb typing and drag bursts
+constexpr size_t LOG_QUEUE_CAPACITY = 8192;
+
+namespace {
+
+// Appends to a caller-provided buffer, truncating instead of overflowing
+class LineWriter {
+public:
+    LineWriter(char* buffer, size_t size) : m_begin(buffer), m_pos(buffer), m_end(buffer + size) {}
+    
+    void Append(std::string_view text) {
+        size_t count = (std::min)(text.size(), static_cast<size_t>(m_end - m_pos));
+        std::memcpy(m_pos, text.data(), count);
+        m_pos += count;
+    }
+    
+    void Append(char c) {
+        if (m_pos < m_end) {
+            *m_pos++ = c;
+        }
+    }
+    
+    template<typename T>
+    void AppendNumber(T value, int base = 10) {
+        auto result = std::to_chars(m_pos, m_end, value, base);
+        if (result.ec == std::errc()) {
+            m_pos = result.ptr;
+        }
+    }
+    
+    // Character as a JSON string body (only quote and backslash can occur in the table)
+    void AppendEscaped(char c) {
+        if (c == '"' || c == '\\') {
+            Append('\\');
+        }
+        Append(c);
+    }
+    
+    size_t Size() const { return static_cast<size_t>(m_pos - m_begin); }
+    
+private:
+    char* m_begin;
+    char* m_pos;
+    char* m_end;
+};
+
+}  // namespace
 
 void EventLogger::Initialize() {
     s_initialized = true;
@@ -16,13 +92,63 @@ void EventLogger::Initialize() {
     // Check initial caps lock state
     s_capsLockOn = (GetKeyState(VK_CAPITAL) & 0x0001) != 0;
     
-    std::cout << "[OK] Event logger initialized (file: " << s_logFilePath << ")\n";
+    // Keep the previous session's log before anything truncates or appends to it
+    if (!s_archiveDirectory.empty() && !EventArchive::IsEnabled()) {
+        if (!s_asyncLogging) {
+            std::cout << "[WARNING] Event archive needs async logging, not archiving\n";
+        } else if (EventArchive::Initialize(s_archiveDirectory)) {
+            WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+            if (GetFileAttributesExA(s_logFilePath.c_str(), GetFileExInfoStandard, &attributes)) {
+                // Its start time isn't recorded; it began no earlier than the previous segment ended
+                std::uint64_t endMs = EventArchive::FileTimeToUnixMs(attributes.ftLastWriteTime);
+                std::uint64_t startMs = EventArchive::GetLastEndMs();
+                if (EventArchive::ArchiveFile(s_logFilePath, s_logFormat == LogFormat::Binary,
+                                              startMs > 0 && startMs < endMs ? startMs : endMs, endMs)) {
+                    std::ofstream(s_logFilePath, LogOpenMode() | std::ios::trunc);
+                    std::cout << "[OK] Previous event log archived\n";
+                }
+            }
+        }
+    }
+    
+    if (s_logFormat == LogFormat::Binary) {
+        LoadBinaryLogState();
+    }
+    
+    if (s_asyncLogging && !s_writerThread.joinable()) {
+        s_queue = std::make_unique<SpscRingBuffer<LogRecord>>(LOG_QUEUE_CAPACITY);
+        s_stopWriter = false;
+        s_flushRequested = false;
+        s_recordsQueued = 0;
+        s_recordsWritten = 0;
+        s_segmentBytes = 0;
+        s_segmentStartMs = 0;
+        s_writerThread = std::thread(WriterThreadMain);
+    }
+    
+    std::cout << "[OK] Event logger initialized (file: " << s_logFilePath
+              << (s_logFormat == LogFormat::Binary ? ", binary" : "")
+              << (s_asyncLogging ? ", async writer" : "") << ")\n";
 }
 
 void EventLogger::ClearLogFile() {
-    std::ofstream file(s_logFilePath, std::ios::trunc);
+    // The writer truncates after the records queued before the clear, without blocking the caller
+    if (s_asyncLogging && s_writerThread.joinable()) {
+        LogRecord record = {};
+        record.kind = LogRecord::CLEAR_LOG;
+        EnqueueRecord(record);
+        RequestFlush();
+        return;
+    }
+    
+    // Make sure nothing queued before the clear lands after it
+    Flush();
+    
+    std::ofstream file(s_logFilePath, LogOpenMode() | std::ios::trunc);
     if (file.is_open()) {
         file.close();
+        // The next binary record rewrites the header with a fresh timestamp base
+        s_binaryHeaderPending = true;
         std::cout << "[OK] Event log file cleared\n";
     } else {
         std::cout << "[WARNING] Could not clear log file\n";
@@ -38,188 +164,344 @@ void EventLogger::LogKeyboardEvent(std::uint64_t timestamp, USHORT vKey, bool is
     // Update modifier states first
     UpdateModifierStates(vKey, isKeyUp);
     
-    std::string keyName = VKeyToKeyName(vKey);
-    std::string charValue = VKeyToChar(vKey);
-    std::string action = isKeyUp ? "keyup" : "keydown";
+    // Resolve the character now (it depends on the current modifier state),
+    // everything else is formatted from the record
+    LogRecord record = {};
+    record.timestamp = timestamp;
+    record.vKey = vKey;
+    record.kind = LogRecord::KEYBOARD;
+    record.isUp = isKeyUp;
+    record.charValue = VKeyToCharCode(vKey);
     
-    // Build JSON entry
-    std::ostringstream json;
-    json << "{";
-    json << "\"timestamp\":" << timestamp << ",";
-    json << "\"type\":\"keyboard\",";
-    json << "\"action\":\"" << action << "\",";
-    json << "\"key\":\"" << keyName << "\"";
+    if (s_asyncLogging) {
+        EnqueueRecord(record);
+        return;
+    }
     
-    if (!charValue.empty()) {
-        json << ",\"char\":\"" << charValue << "\"";
-    } else {
-        json << ",\"char\":null";
+    char line[MAX_LOG_LINE];
+    WriteLogEntry(line, EncodeRecord(record, line, sizeof(line)));
+}
+
+void EventLogger::LogMouseButtonEvent(std::uint64_t timestamp, const std::string& button, bool isButtonUp, POINT cursorPos) {
+    if (!s_initialized) {
+        std::cerr << "[ERROR] EventLogger not initialized\n";
+        return;
     }
     
-    json << "}";
+    LogRecord record = {};
+    record.timestamp = timestamp;
+    record.cursorPos = cursorPos;
+    record.kind = LogRecord::MOUSE_BUTTON;
+    record.isUp = isButtonUp;
+    strncpy_s(record.button, sizeof(record.button), button.c_str(), _TRUNCATE);
     
-    WriteLogEntry(json.str());
+    if (s_asyncLogging) {
+        EnqueueRecord(record);
+        return;
+    }
+    
+    char line[MAX_LOG_LINE];
+    WriteLogEntry(line, EncodeRecord(record, line, sizeof(line)));
 }
 
-void EventLogger::LogMouseButtonEvent(std::uint64_t timestamp, const std::string& button, bool isButtonUp, POINT cursorPos) {
+void EventLogger::LogMouseMotion(const MouseMotionSummary& summary) {
     if (!s_initialized) {
         std::cerr << "[ERROR] EventLogger not initialized\n";
         return;
     }
     
-    std::string action = button + (isButtonUp ? "up" : "down");
+    LogRecord record = {};
+    record.timestamp = summary.startTimestamp;
+    record.cursorPos = summary.endPos;
+    record.kind = LogRecord::MOUSE_MOTION;
+    record.motion = summary;
     
-    // Build JSON entry
-    std::ostringstream json;
-    json << "{";
-    json << "\"timestamp\":" << timestamp << ",";
-    json << "\"type\":\"mouse\",";
-    json << "\"action\":\"" << action << "\",";
-    json << "\"x\":" << cursorPos.x << ",";
-    json << "\"y\":" << cursorPos.y;
-    json << "}";
+    if (s_asyncLogging) {
+        EnqueueRecord(record);
+        return;
+    }
     
-    WriteLogEntry(json.str());
+    char line[MAX_LOG_LINE];
+    WriteLogEntry(line, EncodeRecord(record, line, sizeof(line)));
 }
 
-void EventLogger::SetLogFilePath(const std::string& filePath) {
-    s_logFilePath = filePath;
-    std::cout << "[CONFIG] Log file path set to: " << filePath << "\n";
+size_t EventLogger::FormatKeyboardEvent(char* buffer, size_t bufferSize, std::uint64_t timestamp, USHORT vKey, bool isKeyUp, char charValue) {
+    LineWriter line(buffer, bufferSize);
+    line.Append("{\"timestamp\":");
+    line.AppendNumber(timestamp);
+    line.Append(isKeyUp ? ",\"type\":\"keyboard\",\"action\":\"keyup\",\"key\":\""
+                        : ",\"type\":\"keyboard\",\"action\":\"keydown\",\"key\":\"");
+    
+    const char* keyName = KeyName(vKey);
+    if (keyName) {
+        line.Append(keyName);
+    } else {
+        line.Append("VK_0x");
+        line.AppendNumber(vKey, 16);
+    }
+    
+    if (charValue) {
+        line.Append("\",\"char\":\"");
+        line.AppendEscaped(charValue);
+        line.Append("\"}\n");
+    } else {
+        line.Append("\",\"char\":null}\n");
+    }
+    return line.Size();
 }
 
-std::string EventLogger::VKeyToKeyName(USHORT vKey) {
-    switch (vKey) {
-        // Letters
-        case 0x41: return "A"; case 0x42: return "B"; case 0x43: return "C"; case 0x44: return "D";
-        case 0x45: return "E"; case 0x46: return "F"; case 0x47: return "G"; case 0x48: return "H";
-        case 0x49: return "I"; case 0x4A: return "J"; case 0x4B: return "K"; case 0x4C: return "L";
-        case 0x4D: return "M"; case 0x4E: return "N"; case 0x4F: return "O"; case 0x50: return "P";
-        case 0x51: return "Q"; case 0x52: return "R"; case 0x53: return "S"; case 0x54: return "T";
-        case 0x55: return "U"; case 0x56: return "V"; case 0x57: return "W"; case 0x58: return "X";
-        case 0x59: return "Y"; case 0x5A: return "Z";
-        
-        // Numbers
-        case 0x30: return "0"; case 0x31: return "1"; case 0x32: return "2"; case 0x33: return "3";
-        case 0x34: return "4"; case 0x35: return "5"; case 0x36: return "6"; case 0x37: return "7";
-        case 0x38: return "8"; case 0x39: return "9";
-        
-        // Special keys
-        case VK_SPACE: return "SPACE";
-        case VK_RETURN: return "ENTER";
-        case VK_BACK: return "BACKSPACE";
-        case VK_TAB: return "TAB";
-        case VK_ESCAPE: return "ESC";
-        case VK_DELETE: return "DELETE";
-        case VK_INSERT: return "INSERT";
-        case VK_HOME: return "HOME";
-        case VK_END: return "END";
-        case VK_PRIOR: return "PAGE_UP";
-        case VK_NEXT: return "PAGE_DOWN";
-        
-        // Arrow keys
-        case VK_UP: return "UP_ARROW";
-        case VK_DOWN: return "DOWN_ARROW";
-        case VK_LEFT: return "LEFT_ARROW";
-        case VK_RIGHT: return "RIGHT_ARROW";
-        
-        // Modifier keys
-        case VK_SHIFT: return "SHIFT";
-        case VK_CONTROL: return "CTRL";
-        case VK_MENU: return "ALT";
-        case VK_CAPITAL: return "CAPS_LOCK";
-        case VK_LWIN: return "LEFT_WIN";
-        case VK_RWIN: return "RIGHT_WIN";
-        
-        // Function keys
-        case VK_F1: return "F1"; case VK_F2: return "F2"; case VK_F3: return "F3";
-        case VK_F4: return "F4"; case VK_F5: return "F5"; case VK_F6: return "F6";
-        case VK_F7: return "F7"; case VK_F8: return "F8"; case VK_F9: return "F9";
-        case VK_F10: return "F10"; case VK_F11: return "F11"; case VK_F12: return "F12";
-        
-        // Punctuation
-        case VK_OEM_1: return "SEMICOLON";      // ;:
-        case VK_OEM_PLUS: return "EQUALS";      // =+
-        case VK_OEM_COMMA: return "COMMA";      // ,<
-        case VK_OEM_MINUS: return "MINUS";      // -_
-        case VK_OEM_PERIOD: return "PERIOD";    // .>
-        case VK_OEM_2: return "SLASH";          // /?
-        case VK_OEM_3: return "BACKTICK";       // `~
-        case VK_OEM_4: return "LEFT_BRACKET";   // [{
-        case VK_OEM_5: return "BACKSLASH";      // \|
-        case VK_OEM_6: return "RIGHT_BRACKET";  // ]}
-        case VK_OEM_7: return "QUOTE";          // '"
-        
-        default:
-            // For unknown keys, return hex value
-            std::ostringstream oss;
-            oss << "VK_0x" << std::hex << vKey;
-            return oss.str();
+size_t EventLogger::FormatMouseButtonEvent(char* buffer, size_t bufferSize, std::uint64_t timestamp, const char* button, bool isButtonUp, POINT cursorPos) {
+    LineWriter line(buffer, bufferSize);
+    line.Append("{\"timestamp\":");
+    line.AppendNumber(timestamp);
+    line.Append(",\"type\":\"mouse\",\"action\":\"");
+    line.Append(button);
+    line.Append(isButtonUp ? "up\",\"x\":" : "down\",\"x\":");
+    line.AppendNumber(cursorPos.x);
+    line.Append(",\"y\":");
+    line.AppendNumber(cursorPos.y);
+    line.Append("}\n");
+    return line.Size();
+}
+
+size_t EventLogger::FormatMouseMotion(char* buffer, size_t bufferSize, const MouseMotionSummary& summary) {
+    LineWriter line(buffer, bufferSize);
+    line.Append("{\"timestamp\":");
+    line.AppendNumber(summary.startTimestamp);
+    line.Append(summary.type == MouseEventData::WHEEL ? ",\"type\":\"mouse\",\"action\":\"wheel\",\"x\":"
+                                                      : ",\"type\":\"mouse\",\"action\":\"move\",\"x\":");
+    line.AppendNumber(summary.endPos.x);
+    line.Append(",\"y\":");
+    line.AppendNumber(summary.endPos.y);
+    if (summary.type == MouseEventData::WHEEL) {
+        line.Append(",\"delta\":");
+        line.AppendNumber(summary.wheelDelta);
+    } else {
+        line.Append(",\"from_x\":");
+        line.AppendNumber(summary.startPos.x);
+        line.Append(",\"from_y\":");
+        line.AppendNumber(summary.startPos.y);
+        line.Append(",\"path\":");
+        line.AppendNumber(summary.pathLength);
     }
+    line.Append(",\"duration_ms\":");
+    line.AppendNumber(summary.GetDurationMs());
+    line.Append(",\"events\":");
+    line.AppendNumber(summary.eventCount);
+    line.Append("}\n");
+    return line.Size();
 }
 
-std::string EventLogger::VKeyToChar(USHORT vKey) {
-    // Only return characters for printable keys on key down events
-    if (!IsPrintableKey(vKey)) {
-        return "";  // Non-printable key
+size_t EventLogger::EncodeRecord(const LogRecord& record, char* buffer, size_t bufferSize) {
+    if (s_logFormat == LogFormat::Binary) {
+        return EncodeBinaryRecord(record, buffer, bufferSize);
     }
+    if (record.kind == LogRecord::KEYBOARD) {
+        return FormatKeyboardEvent(buffer, bufferSize, record.timestamp, record.vKey, record.isUp, record.charValue);
+    }
+    if (record.kind == LogRecord::MOUSE_MOTION) {
+        return FormatMouseMotion(buffer, bufferSize, record.motion);
+    }
+    return FormatMouseButtonEvent(buffer, bufferSize, record.timestamp, record.button, record.isUp, record.cursorPos);
+}
+
+size_t EventLogger::EncodeBinaryRecord(const LogRecord& record, char* buffer, size_t bufferSize) {
+    size_t length = 0;
     
-    // Letters
-    if (vKey >= 0x41 && vKey <= 0x5A) {
-        char letter = 'A' + (vKey - 0x41);
+    if (s_binaryHeaderPending.exchange(false)) {
+        BinaryLogHeader header = {};
+        std::memcpy(header.magic, BINARY_LOG_MAGIC, sizeof(header.magic));
+        header.version = BINARY_LOG_VERSION;
+        header.recordSize = sizeof(BinaryLogRecord);
+        header.timestampBase = record.timestamp;
+        s_binaryTimestampBase = record.timestamp;
         
-        // Apply shift/caps lock logic
-        bool shouldBeUppercase = s_shiftPressed ^ s_capsLockOn;  // XOR
-        if (!shouldBeUppercase) {
-            letter = letter - 'A' + 'a';  // Convert to lowercase
+        if (bufferSize < sizeof(header)) {
+            return 0;
         }
-        
-        return std::string(1, letter);
+        std::memcpy(buffer, &header, sizeof(header));
+        length = sizeof(header);
     }
     
-    // Numbers and their shifted symbols
-    if (vKey >= 0x30 && vKey <= 0x39) {
-        if (s_shiftPressed) {
-            const char* shiftedNumbers = ")!@#$%^&*(";
-            return std::string(1, shiftedNumbers[vKey - 0x30]);
-        } else {
-            return std::string(1, '0' + (vKey - 0x30));
-        }
+    // x86/x64 are little-endian, so the struct is written as is
+    BinaryLogRecord out = {};
+    out.timestampOffset = record.timestamp >= s_binaryTimestampBase ? record.timestamp - s_binaryTimestampBase : 0;
+    out.flags = record.isUp ? BINARY_RECORD_FLAG_UP : 0;
+    if (record.kind == LogRecord::KEYBOARD) {
+        out.kind = BINARY_RECORD_KEYBOARD;
+        out.vKey = record.vKey;
+        out.charValue = static_cast<std::uint8_t>(record.charValue);
+    } else if (record.kind == LogRecord::MOUSE_MOTION) {
+        // Path length, duration and count only fit the JSON format
+        out = MakeMotionRecord(record.motion, out.timestampOffset);
+    } else {
+        out.kind = BINARY_RECORD_MOUSE_BUTTON;
+        std::string_view button = record.button;
+        out.button = button == "left" ? BINARY_BUTTON_LEFT
+                   : button == "right" ? BINARY_BUTTON_RIGHT
+                   : button == "middle" ? BINARY_BUTTON_MIDDLE : BINARY_BUTTON_NONE;
+        out.x = record.cursorPos.x;
+        out.y = record.cursorPos.y;
     }
     
-    // Common punctuation
-    switch (vKey) {
-        case VK_SPACE: return " ";
-        case VK_OEM_1: return s_shiftPressed ? ":" : ";";      // ;:
-        case VK_OEM_PLUS: return s_shiftPressed ? "+" : "=";   // =+
-        case VK_OEM_COMMA: return s_shiftPressed ? "<" : ",";  // ,<
-        case VK_OEM_MINUS: return s_shiftPressed ? "_" : "-";  // -_
-        case VK_OEM_PERIOD: return s_shiftPressed ? ">" : "."; // .>
-        case VK_OEM_2: return s_shiftPressed ? "?" : "/";      // /?
-        case VK_OEM_3: return s_shiftPressed ? "~" : "`";      // `~
-        case VK_OEM_4: return s_shiftPressed ? "{" : "[";      // [{
-        case VK_OEM_5: return s_shiftPressed ? "|" : "\\";     // \|
-        case VK_OEM_6: return s_shiftPressed ? "}" : "]";      // ]}
-        case VK_OEM_7: return s_shiftPressed ? "\"" : "'";     // '"
-        default: return "";
-    }
-}
-
-bool EventLogger::IsPrintableKey(USHORT vKey) {
-    // Letters and numbers
-    if ((vKey >= 0x41 && vKey <= 0x5A) || (vKey >= 0x30 && vKey <= 0x39)) {
+    if (bufferSize - length < sizeof(out)) {
+        return length;
+    }
+    std::memcpy(buffer + length, &out, sizeof(out));
+    return length + sizeof(out);
+}
+
+void EventLogger::LoadBinaryLogState() {
+    // Appending to a log from an earlier run keeps its timestamp base
+    std::ifstream file(s_logFilePath, std::ios::binary);
+    BinaryLogHeader header = {};
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        s_binaryHeaderPending = true;
+        return;
+    }
+    
+    if (std::memcmp(header.magic, BINARY_LOG_MAGIC, sizeof(header.magic)) != 0
+        || header.version != BINARY_LOG_VERSION || header.recordSize != sizeof(BinaryLogRecord)) {
+        std::cout << "[WARNING] " << s_logFilePath << " is not a compatible binary log; clear it before logging\n";
+        s_binaryHeaderPending = true;
+        return;
+    }
+    s_binaryTimestampBase = header.timestampBase;
+    s_binaryHeaderPending = false;
+}
+
+std::ios_base::openmode EventLogger::LogOpenMode() {
+    // JSON stays in text mode so lines end in CRLF as before
+    return s_logFormat == LogFormat::Binary ? std::ios::out | std::ios::binary : std::ios::out;
+}
+
+void EventLogger::SetLogFilePath(const std::string& filePath) {
+    s_logFilePath = filePath;
+    std::cout << "[CONFIG] Log file path set to: " << filePath << "\n";
+}
+
+void EventLogger::SetLogFormat(LogFormat format) {
+    if (s_initialized) {
+        std::cout << "[WARNING] Log format must be configured before Initialize\n";
+        return;
+    }
+    s_logFormat = format;
+    std::cout << "[CONFIG] Log format set to " << (format == LogFormat::Binary ? "binary" : "JSON") << "\n";
+}
+
+void EventLogger::SetAsyncLogging(bool enabled) {
+    if (s_writerThread.joinable()) {
+        std::cout << "[WARNING] Async logging must be configured before Initialize\n";
+        return;
+    }
+    s_asyncLogging = enabled;
+    std::cout << "[CONFIG] Async logging " << (enabled ? "enabled" : "disabled") << "\n";
+}
+
+void EventLogger::SetArchive(const std::string& directory, std::uint64_t maxSegmentBytes, DWORD maxSegmentSeconds) {
+    if (s_initialized) {
+        std::cout << "[WARNING] Event archive must be configured before Initialize\n";
+        return;
+    }
+    s_archiveDirectory = directory;
+    s_segmentMaxBytes = maxSegmentBytes > 0 ? maxSegmentBytes : 1;
+    s_segmentMaxMs = static_cast<std::uint64_t>(maxSegmentSeconds > 0 ? maxSegmentSeconds : 1) * 1000;
+    std::cout << "[CONFIG] Event archive in " << directory << ", segments up to "
+              << (s_segmentMaxBytes / 1024) << "KB or " << (s_segmentMaxMs / 1000) << "s\n";
+}
+
+void EventLogger::SetFlushInterval(DWORD intervalMs) {
+    s_flushIntervalMs = intervalMs > 0 ? intervalMs : 1;
+    std::cout << "[CONFIG] Log flush interval set to " << s_flushIntervalMs << "ms\n";
+}
+
+void EventLogger::SetFlushBatchSize(size_t recordCount) {
+    s_flushBatchSize = recordCount > 0 ? recordCount : 1;
+    std::cout << "[CONFIG] Log flush batch size set to " << s_flushBatchSize << " records\n";
+}
+
+void EventLogger::Flush() {
+    WaitForFlush(RequestFlush());
+}
+
+std::uint64_t EventLogger::RequestFlush() {
+    if (!s_writerThread.joinable()) {
+        return 0;  // Synchronous mode writes immediately
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(s_writerMutex);
+        s_flushRequested = true;
+    }
+    s_writerWake.notify_one();
+    return s_recordsQueued.load(std::memory_order_relaxed);
+}
+
+bool EventLogger::WaitForFlush(std::uint64_t ticket) {
+    if (!s_writerThread.joinable()) {
         return true;
     }
     
-    // Space and common punctuation
-    switch (vKey) {
-        case VK_SPACE:
-        case VK_OEM_1: case VK_OEM_PLUS: case VK_OEM_COMMA: case VK_OEM_MINUS:
-        case VK_OEM_PERIOD: case VK_OEM_2: case VK_OEM_3: case VK_OEM_4:
-        case VK_OEM_5: case VK_OEM_6: case VK_OEM_7:
-            return true;
-        default:
-            return false;
+    // Bounded wait so a stuck disk can't hang the caller forever
+    std::unique_lock<std::mutex> lock(s_writerMutex);
+    bool flushed = s_flushDone.wait_for(lock, std::chrono::seconds(2), [ticket] {
+        return s_recordsWritten.load(std::memory_order_acquire) >= ticket;
+    });
+    if (!flushed) {
+        std::cerr << "[WARNING] Timed out waiting for event log flush\n";
+    }
+    return flushed;
+}
+
+void EventLogger::Shutdown() {
+    if (!s_writerThread.joinable()) {
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(s_writerMutex);
+        s_stopWriter = true;
+    }
+    s_writerWake.notify_one();
+    s_writerThread.join();
+    
+    std::cout << "[OK] Event logger drained (" << s_recordsWritten.load() << " records written)\n";
+    s_queue.reset();
+    
+    // The active log stays in place for the Python side; the next start archives it
+    EventArchive::Shutdown();
+}
+
+std::string EventLogger::VKeyToKeyName(USHORT vKey) {
+    const char* keyName = KeyName(vKey);
+    if (keyName) {
+        return keyName;
     }
+    
+    // Outside the table: same hex format as the table's unnamed keys
+    char name[16] = "VK_0x";
+    auto result = std::to_chars(name + 5, name + sizeof(name), vKey, 16);
+    return std::string(name, result.ptr);
+}
+
+std::string EventLogger::VKeyToChar(USHORT vKey) {
+    char c = VKeyToCharCode(vKey);
+    return c ? std::string(1, c) : std::string();
+}
+
+const char* EventLogger::KeyName(USHORT vKey) {
+    return vKey < KEY_TABLE.size() ? KEY_TABLE[vKey].name : nullptr;
+}
+
+char EventLogger::VKeyToCharCode(USHORT vKey) {
+    if (vKey >= KEY_TABLE.size()) {
+        return 0;
+    }
+    
+    // Caps Lock only affects letters, where it inverts Shift
+    const KeyInfo& info = KEY_TABLE[vKey];
+    bool shifted = s_shiftPressed ^ (info.capsLockApplies && s_capsLockOn);
+    return shifted ? info.shifted : info.normal;
 }
 
 void EventLogger::UpdateModifierStates(USHORT vKey, bool isKeyUp) {
@@ -237,12 +519,118 @@ void EventLogger::UpdateModifierStates(USHORT vKey, bool isKeyUp) {
     }
 }
 
-void EventLogger::WriteLogEntry(const std::string& jsonEntry) {
-    std::ofstream file(s_logFilePath, std::ios::app);
+void EventLogger::WriteLogEntry(const char* line, size_t length) {
+    ScopedSpan span(Stage::LogWrite);
+    std::ofstream file(s_logFilePath, LogOpenMode() | std::ios::app);
     if (file.is_open()) {
-        file << jsonEntry << std::endl;
+        file.write(line, static_cast<std::streamsize>(length));
         file.close();
     } else {
         std::cerr << "[ERROR] Could not write to log file: " << s_logFilePath << "\n";
     }
-}
\ No newline at end of file
+}
+
+void EventLogger::EnqueueRecord(const LogRecord& record) {
+    // If the writer falls behind, wait for room rather than dropping events
+    while (!s_queue->TryPush(record)) {
+        s_writerWake.notify_one();
+        std::this_thread::yield();
+    }
+    s_recordsQueued.fetch_add(1, std::memory_order_relaxed);
+    
+    // Wake the writer early once a full batch is waiting. The notify is not
+    // synchronized with the writer's wait, so a missed wakeup only delays the
+    // batch until the next flush interval.
+    if (s_queue->SizeApprox() >= s_flushBatchSize) {
+        s_writerWake.notify_one();
+    }
+}
+
+void EventLogger::WriterThreadMain() {
+    std::ofstream file(s_logFilePath, LogOpenMode() | std::ios::app);
+    if (!file.is_open()) {
+        std::cerr << "[ERROR] Could not open log file for writer thread: " << s_logFilePath << "\n";
+    }
+    
+    std::vector<LogRecord> batch(s_queue->Capacity());
+    char line[MAX_LOG_LINE];
+    
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(s_writerMutex);
+            s_writerWake.wait_for(lock, std::chrono::milliseconds(s_flushIntervalMs), [] {
+                return s_stopWriter || s_flushRequested || s_queue->SizeApprox() >= s_flushBatchSize;
+            });
+            stopping = s_stopWriter;
+            s_flushRequested = false;
+        }
+        
+        // Drain everything currently queued, then hit the disk once
+        std::uint64_t batchStart = Instrumentation::NowTicks();
+        size_t written = 0;
+        size_t count;
+        while ((count = s_queue->PopBatch(batch.data(), batch.size())) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                if (batch[i].kind == LogRecord::CLEAR_LOG) {
+                    file.close();
+                    file.open(s_logFilePath, LogOpenMode() | std::ios::trunc);
+                    s_binaryHeaderPending = true;
+                    s_segmentBytes = 0;
+                    s_segmentStartMs = 0;
+                    std::cout << (file.is_open() ? "[OK] Event log file cleared\n" : "[WARNING] Could not clear log file\n");
+                    continue;
+                }
+                if (file.is_open()) {
+                    size_t length = EncodeRecord(batch[i], line, sizeof(line));
+                    file.write(line, static_cast<std::streamsize>(length));
+                    s_segmentBytes += length;
+                }
+            }
+            written += count;
+        }
+        
+        if (written > 0) {
+            if (file.is_open()) {
+                file.flush();
+            }
+            Instrumentation::RecordSince(Stage::LogWrite, batchStart);
+            std::lock_guard<std::mutex> lock(s_writerMutex);
+            s_recordsWritten.fetch_add(written, std::memory_order_release);
+        }
+        s_flushDone.notify_all();
+        
+        // Rotate on size, or on age (checked every flush interval, so idle segments close too)
+        if (EventArchive::IsEnabled() && s_segmentBytes > 0) {
+            std::uint64_t nowMs = EventArchive::NowUnixMs();
+            if (s_segmentStartMs == 0) {
+                s_segmentStartMs = nowMs;
+            }
+            if (s_segmentBytes >= s_segmentMaxBytes || nowMs - s_segmentStartMs >= s_segmentMaxMs) {
+                RotateSegment(file);
+            }
+        }
+        
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+void EventLogger::RotateSegment(std::ofstream& file) {
+    file.close();
+    bool archived = EventArchive::ArchiveFile(s_logFilePath, s_logFormat == LogFormat::Binary,
+                                              s_segmentStartMs, EventArchive::NowUnixMs());
+    
+    // Truncate whether the segment was moved or copied; a binary segment needs its own header.
+    // If archiving failed, keep appending and try again after another full segment.
+    if (archived) {
+        file.open(s_logFilePath, LogOpenMode() | std::ios::trunc);
+        s_binaryHeaderPending = true;
+        s_segmentStartMs = 0;
+    } else {
+        file.open(s_logFilePath, LogOpenMode() | std::ios::app);
+        s_segmentStartMs = EventArchive::NowUnixMs();
+    }
+    s_segmentBytes = 0;
+}
@@ -2,14 +2,93 @@
 
 #include <windows.h>  
 #include <string>
+#include <cstddef>
 #include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <ios>
+#include <mutex>
+#include <thread>
+#include "spsc_ring_buffer.h"
+#include "mouse_coalescer.h"
+
+// On-disk format of the event log
+enum class LogFormat {
+    Json,    // One JSON object per line (default, human readable)
+    Binary   // BinaryLogHeader followed by fixed-size BinaryLogRecords
+};
+
+// Binary log layout, little-endian (read by process_input.py; keep both in sync).
+// The header is written before the first record, which sets the timestamp base.
+constexpr char BINARY_LOG_MAGIC[4] = { 'W', 'O', 'A', 'E' };
+constexpr std::uint16_t BINARY_LOG_VERSION = 2;
+
+struct BinaryLogHeader {
+    char magic[4];                  // BINARY_LOG_MAGIC
+    std::uint16_t version;          // BINARY_LOG_VERSION
+    std::uint16_t recordSize;       // sizeof(BinaryLogRecord)
+    std::uint64_t timestampBase;    // Timestamp (microseconds) of the first record
+    std::uint8_t reserved[16];
+};
+
+enum BinaryLogRecordKind : std::uint8_t {
+    BINARY_RECORD_KEYBOARD = 0,
+    BINARY_RECORD_MOUSE_BUTTON = 1,
+    BINARY_RECORD_MOUSE_MOVE = 2,   // Summary: startX/startY = start, x/y = end
+    BINARY_RECORD_MOUSE_WHEEL = 3   // Summary: reserved = accumulated delta (int16), x/y = cursor
+};
+
+enum BinaryLogButton : std::uint8_t {
+    BINARY_BUTTON_NONE = 0,
+    BINARY_BUTTON_LEFT = 1,
+    BINARY_BUTTON_RIGHT = 2,
+    BINARY_BUTTON_MIDDLE = 3
+};
+
+constexpr std::uint8_t BINARY_RECORD_FLAG_UP = 0x01;
+
+struct BinaryLogRecord {
+    std::uint64_t timestampOffset;  // Microseconds since BinaryLogHeader::timestampBase
+    std::uint8_t kind;              // BinaryLogRecordKind
+    std::uint8_t flags;             // BINARY_RECORD_FLAG_*
+    std::uint16_t vKey;             // Keyboard: virtual key
+    std::uint8_t charValue;         // Keyboard: typed character (0 = none)
+    std::uint8_t button;            // Mouse: BinaryLogButton
+    std::uint16_t reserved;         // Mouse summaries, see BinaryLogRecordKind
+    std::int32_t x;                 // Mouse: cursor position
+    std::int32_t y;
+    std::int32_t startX;            // Mouse move summary: cursor before the run
+    std::int32_t startY;
+};
+
+static_assert(sizeof(BinaryLogHeader) == 32, "BinaryLogHeader layout is shared with process_input.py");
+static_assert(sizeof(BinaryLogRecord) == 32, "BinaryLogRecord layout is shared with process_input.py");
+
+// Binary record of a coalesced mouse run (event log and shared journal)
+inline BinaryLogRecord MakeMotionRecord(const MouseMotionSummary& motion, std::uint64_t timestampOffset) {
+    BinaryLogRecord record = {};
+    record.timestampOffset = timestampOffset;
+    if (motion.type == MouseEventData::WHEEL) {
+        record.kind = BINARY_RECORD_MOUSE_WHEEL;
+        record.reserved = static_cast<std::uint16_t>(motion.wheelDelta < INT16_MIN ? INT16_MIN
+                                                     : motion.wheelDelta > INT16_MAX ? INT16_MAX : motion.wheelDelta);
+    } else {
+        record.kind = BINARY_RECORD_MOUSE_MOVE;
+        record.startX = motion.startPos.x;
+        record.startY = motion.startPos.y;
+    }
+    record.x = motion.endPos.x;
+    record.y = motion.endPos.y;
+    return record;
+}
 
 class EventLogger {
 public:
     // Initialize the event logger
     static void Initialize();
     
-    // Clear/reset the log file
+    // Clear/reset the log file. With async logging the writer thread truncates it in queue
+    // order, so call it from the thread that logs events.
     static void ClearLogFile();
     
     // Log a keyboard event
@@ -18,27 +97,133 @@ public:
     // Log a mouse button event  
     static void LogMouseButtonEvent(std::uint64_t timestamp, const std::string& button, bool isButtonUp, POINT cursorPos);
     
+    // Log a coalesced run of mouse moves or wheel ticks
+    static void LogMouseMotion(const MouseMotionSummary& summary);
+    
     // Set the log file path (default: "input_events.txt")
     static void SetLogFilePath(const std::string& filePath);
+    
+    // Select JSON or binary log output (call before Initialize, default: Json)
+    static void SetLogFormat(LogFormat format);
+    
+    // Enable the background writer thread (call before Initialize).
+    // When enabled the input thread only queues fixed-size records and the
+    // writer keeps the log file open and writes them in batches.
+    static void SetAsyncLogging(bool enabled);
+    
+    // Rotate the log into segments under directory once it reaches maxSegmentBytes or has been
+    // open for maxSegmentSeconds; closed segments are compressed in the background and kept
+    // across restarts (see EventArchive). Needs async logging. Call before Initialize.
+    static void SetArchive(const std::string& directory, std::uint64_t maxSegmentBytes = 8 * 1024 * 1024,
+                           DWORD maxSegmentSeconds = 3600);
+    
+    // Maximum time a queued record waits before being written (default: 100ms)
+    static void SetFlushInterval(DWORD intervalMs);
+    
+    // Number of queued records that wakes the writer early (default: 64)
+    static void SetFlushBatchSize(size_t recordCount);
+    
+    // Block until every queued record has reached the log file
+    static void Flush();
+    
+    // Ask the writer to flush now; returns a ticket for WaitForFlush.
+    // Must be called from the logging (input) thread.
+    static std::uint64_t RequestFlush();
+    
+    // Block until all records queued before the ticket was issued are on disk.
+    // Safe to call from any thread.
+    static bool WaitForFlush(std::uint64_t ticket);
+    
+    // Drain the queue and stop the writer thread
+    static void Shutdown();
+    
+    // Convert virtual key to readable key name (same names as the "key" field in the log)
+    static std::string VKeyToKeyName(USHORT vKey);
+    
+    // Convert virtual key to character (considering the shift/caps state tracked by LogKeyboardEvent)
+    static std::string VKeyToChar(USHORT vKey);
+    
+    // Allocation-free variants: key name from the compile-time table (nullptr above 0xFF),
+    // and the typed character (0 if the key produces none)
+    static const char* KeyName(USHORT vKey);
+    static char VKeyToCharCode(USHORT vKey);
+    
+    // Buffer size that always fits one encoded log entry (JSON line, or binary header plus record)
+    static constexpr size_t MAX_LOG_LINE = 256;
+    
+    // Format one JSON log line (with trailing newline) into buffer; returns its length
+    static size_t FormatKeyboardEvent(char* buffer, size_t bufferSize, std::uint64_t timestamp, USHORT vKey, bool isKeyUp, char charValue);
+    static size_t FormatMouseButtonEvent(char* buffer, size_t bufferSize, std::uint64_t timestamp, const char* button, bool isButtonUp, POINT cursorPos);
+    static size_t FormatMouseMotion(char* buffer, size_t bufferSize, const MouseMotionSummary& summary);
 
 private:
+    // Fixed-size record queued by the input thread in async mode
+    struct LogRecord {
+        enum Kind : std::uint8_t { KEYBOARD, MOUSE_BUTTON, MOUSE_MOTION, CLEAR_LOG };
+        
+        std::uint64_t timestamp;
+        POINT cursorPos;    // Motion: end position
+        USHORT vKey;
+        Kind kind;
+        bool isUp;
+        char charValue;     // 0 when the key produces no character
+        char button[7];     // Mouse button name, null terminated
+        MouseMotionSummary motion;  // MOUSE_MOTION only
+    };
+    
     static std::string s_logFilePath;
     static bool s_initialized;
     static bool s_shiftPressed;
     static bool s_capsLockOn;
     
-    // Convert virtual key to readable key name
-    static std::string VKeyToKeyName(USHORT vKey);
+    // Update modifier key states
+    static void UpdateModifierStates(USHORT vKey, bool isKeyUp);
     
-    // Convert virtual key to character (considering shift state)
-    static std::string VKeyToChar(USHORT vKey);
+    // Encode a queued record in the current log format (shared by the synchronous and async paths).
+    // In binary mode this includes the header when it is the first record in the file.
+    static size_t EncodeRecord(const LogRecord& record, char* buffer, size_t bufferSize);
+    static size_t EncodeBinaryRecord(const LogRecord& record, char* buffer, size_t bufferSize);
     
-    // Check if a key is a printable character
-    static bool IsPrintableKey(USHORT vKey);
+    // Read the timestamp base from an existing binary log, or mark the header as pending
+    static void LoadBinaryLogState();
     
-    // Update modifier key states
-    static void UpdateModifierStates(USHORT vKey, bool isKeyUp);
+    // Open mode for the log file in the current format
+    static std::ios_base::openmode LogOpenMode();
+    
+    // Write an encoded entry to the log file
+    static void WriteLogEntry(const char* line, size_t length);
+    
+    // Queue a record for the writer thread
+    static void EnqueueRecord(const LogRecord& record);
+    
+    // Background writer thread body
+    static void WriterThreadMain();
+    
+    // Hand the active log to the archive and reopen it empty (writer thread)
+    static void RotateSegment(std::ofstream& file);
+    
+    static LogFormat s_logFormat;
+    static std::atomic<bool> s_binaryHeaderPending;   // Next binary record starts a new file
+    static std::uint64_t s_binaryTimestampBase;
+    
+    static bool s_asyncLogging;
+    static DWORD s_flushIntervalMs;
+    static size_t s_flushBatchSize;
+    
+    static std::unique_ptr<SpscRingBuffer<LogRecord>> s_queue;
+    static std::thread s_writerThread;
+    static std::mutex s_writerMutex;
+    static std::condition_variable s_writerWake;
+    static std::condition_variable s_flushDone;
+    static bool s_stopWriter;
+    static bool s_flushRequested;
+    static std::atomic<std::uint64_t> s_recordsQueued;   // Written only by the input thread
+    static std::atomic<std::uint64_t> s_recordsWritten;  // Written only by the writer thread
     
-    // Write JSON entry to log file
-    static void WriteLogEntry(const std::string& jsonEntry);
+    // Archive mode; the segment counters belong to the writer thread
+    static std::string s_archiveDirectory;
+    static std::uint64_t s_segmentMaxBytes;
+    static std::uint64_t s_segmentMaxMs;
+    static std::uint64_t s_segmentBytes;
+    static std::uint64_t s_segmentStartMs;              // Wall clock of the first record (0 = empty)
 };
\ No newline at end of file
@@ -1,29 +1,113 @@
 #!/usr/bin/env python3
 """
 Input cleaning utilities for better LLM processing.
+
+InputNormalizer builds the cleaned sequence in one pass as units arrive
+(same rules as TypedContext in typed_context.cpp, which applies them at
+capture time):
+- [SHIFT]/[CTRL]/[ALT] are dropped (their effect is already in the text)
+- runs of spaces collapse to one space
+- [BACKSPACE] right after typed characters erases the last one; after a key
+  or click (cursor possibly moved) it stays in the sequence
 """
 
+import re
+from typing import List
+
+# Dropped modifier markers
+NOISE_TOKENS = frozenset(("[SHIFT]", "[CTRL]", "[ALT]"))
+
+BACKSPACE_TOKEN = "[BACKSPACE]"
+
+# A [KEY] or [Name(args)] marker, otherwise one character
+_UNIT = re.compile(r"\[[A-Za-z0-9_]+(?:\([^()\[\]]*\))?\]|.", re.DOTALL)
+
+
+class InputNormalizer:
+    """Streaming cleaner: feed characters and [TOKEN]s in order, read text() at the end."""
+
+    def __init__(self):
+        self._parts: List[str] = []
+        self._editable = 0      # Trailing parts that are typed characters (erasable)
+        self._space_run = 0     # Raw spaces merged into a trailing " " part
+        self._space_runs: List[int] = []    # Raw lengths of the earlier " " parts among the erasable ones
+
+    def add_char(self, char: str):
+        if char == " " and self._space_run:
+            self._space_run += 1
+            return
+        if self._space_run:
+            # Erasing back to this run must restore how many spaces it still holds
+            self._space_runs.append(self._space_run)
+        self._parts.append(char)
+        self._editable += 1
+        self._space_run = 1 if char == " " else 0
+
+    def add_token(self, token: str):
+        if token in NOISE_TOKENS:
+            return
+        if token == BACKSPACE_TOKEN and self._editable:
+            self._erase_char()
+            return
+        self._parts.append(token)
+        self._editable = 0
+        self._space_run = 0
+        self._space_runs.clear()
+
+    def _erase_char(self):
+        if self._space_run > 1:
+            self._space_run -= 1
+            return
+        self._parts.pop()
+        self._editable -= 1
+        self._space_run = self._space_runs.pop() if self._editable and self._parts[-1] == " " else 0
+
+    def text(self) -> str:
+        return ''.join(self._parts)
+
+
 def clean_input_for_llm(input_sequence: str) -> str:
     """Clean up the input sequence minimally while preserving context for LLM."""
-    
-    # Only do minimal cleaning - preserve most special keys for context
-    cleaned = input_sequence
-    
-    # Only remove truly redundant patterns
-    noise_patterns = [
-        "[SHIFT]",  # Shift effect is already in capitalization
-        "[CTRL]",   # Ctrl combinations are handled separately 
-        "[ALT]",    # Alt combinations are handled separately
-    ]
-    
-    for pattern in noise_patterns:
-        cleaned = cleaned.replace(pattern, "")
-    
-    # Clean up multiple spaces but preserve intentional spacing
-    while "  " in cleaned:
-        cleaned = cleaned.replace("  ", " ")
-    
+    normalizer = InputNormalizer()
+    for unit in _UNIT.findall(input_sequence):
+        if len(unit) > 1:
+            normalizer.add_token(unit)
+        else:
+            normalizer.add_char(unit)
+
     # Don't strip - preserve leading/trailing context
-    
-    # Always return the cleaned version, even if short
-    return cleaned
+    return normalizer.text()
+
+
+def test_input_normalizer(trials: int = 2000):
+    """Check the normalizer against applying backspaces to the raw text, then collapsing spaces."""
+    import random
+
+    units = ["a", "b", " ", " ", "\n", BACKSPACE_TOKEN, BACKSPACE_TOKEN, "[UP]", "[SHIFT]"]
+    rng = random.Random(0)
+    for _ in range(trials):
+        sequence = [rng.choice(units) for _ in range(rng.randint(0, 24))]
+
+        # Reference: edit the raw text; a backspace after a key is kept and fences what came before
+        raw: List[str] = []
+        fence = 0
+        for unit in sequence:
+            if unit in NOISE_TOKENS:
+                continue
+            if unit == BACKSPACE_TOKEN and len(raw) > fence:
+                raw.pop()
+            elif len(unit) > 1:
+                raw.append(unit)
+                fence = len(raw)
+            else:
+                raw.append(unit)
+        expected = re.sub(" +", " ", "".join(raw))
+
+        actual = clean_input_for_llm("".join(sequence))
+        assert actual == expected, f"{''.join(sequence)!r}: got {actual!r}, expected {expected!r}"
+    assert clean_input_for_llm("a   b[BACKSPACE][BACKSPACE]") == "a "
+    print(f"[OK] InputNormalizer matches the raw-text reference on {trials} sequences")
+
+
+if __name__ == "__main__":
+    test_input_normalizer()
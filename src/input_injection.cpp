@@ -1,15 +1,39 @@
 #include "input_injection.h"
+#include "instrumentation.h"
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 // Static member definitions
 DWORD InputInjector::s_keyDelayMs = 10; // Default 10ms delay between keys
 bool InputInjector::s_initialized = false;
+InjectionMode InputInjector::s_injectionMode = InjectionMode::Batched;
+size_t InputInjector::s_chunkSize = 128;
+DWORD InputInjector::s_chunkDelayMs = 1;
+bool InputInjector::s_unicodeInjection = true;
+bool InputInjector::s_dryRun = false;
+DWORD InputInjector::s_acceptSlaMicros = 5000;
+std::array<SHORT, 256> InputInjector::s_layoutTable = {};
+HKL InputInjector::s_layoutHkl = nullptr;
+std::atomic<bool> InputInjector::s_layoutValid{false};
+std::thread InputInjector::s_injectionThread;
+std::mutex InputInjector::s_queueMutex;
+std::condition_variable InputInjector::s_queueWake;
+std::deque<InputInjector::InjectionJob> InputInjector::s_jobQueue;
+bool InputInjector::s_stopInjection = false;
+std::string InputInjector::s_preparedText;
+std::vector<INPUT> InputInjector::s_preparedInputs;
+HKL InputInjector::s_preparedLayout = nullptr;
 
 void InputInjector::Initialize() {
     s_initialized = true;
-    std::cout << "[OK] Input injector initialized with " << s_keyDelayMs << "ms key delay\n";
+    if (s_injectionMode == InjectionMode::Batched) {
+        std::cout << "[OK] Input injector initialized (batched, " << s_chunkSize << " events per chunk, "
+                  << s_chunkDelayMs << "ms chunk delay)\n";
+    } else {
+        std::cout << "[OK] Input injector initialized with " << s_keyDelayMs << "ms key delay\n";
+    }
 }
 
 bool InputInjector::SendVirtualKey(WORD vkCode, bool isKeyUp) {
@@ -18,13 +42,7 @@ bool InputInjector::SendVirtualKey(WORD vkCode, bool isKeyUp) {
         return false;
     }
     
-    INPUT input = {};
-    input.type = INPUT_KEYBOARD;
-    input.ki.wVk = vkCode;
-    input.ki.dwFlags = isKeyUp ? KEYEVENTF_KEYUP : 0;
-    input.ki.time = 0;
-    
-    return SendInputHelper(input);
+    return SendInputHelper(MakeKeyInput(vkCode, isKeyUp));
 }
 
 bool InputInjector::SendKeyPress(WORD vkCode) {
@@ -45,13 +63,181 @@ bool InputInjector::SendTextString(const std::string& text) {
     }
     
     std::cout << "[INPUT] Sending text: \"" << text << "\"\n";
+    ScopedSpan span(Stage::Injection);
+    
+    if (s_injectionMode == InjectionMode::PerKey) {
+        return SendTextStringPerKey(text);
+    }
+    
+    // Reused between calls so steady-state injection doesn't allocate
+    static std::vector<INPUT> inputs;
+    BuildTextInputs(text, inputs);
+    return SendInputBatch(inputs, s_chunkSize);
+}
+
+void InputInjector::QueueTextString(const std::string& text) {
+    QueueJob({ InjectionJob::Text, text, 0 });
+}
+
+void InputInjector::PrepareText(const std::string& text) {
+    QueueJob({ InjectionJob::Prepare, text, 0 });
+}
+
+void InputInjector::QueueAccept(const std::string& text, std::uint64_t acceptTicks) {
+    QueueJob({ InjectionJob::Accept, text, acceptTicks });
+}
+
+void InputInjector::SetAcceptSla(DWORD slaMicros) {
+    s_acceptSlaMicros = slaMicros;
+    std::cout << "[CONFIG] Accept latency SLA set to " << slaMicros << "us\n";
+}
+
+void InputInjector::QueueJob(InjectionJob job) {
+    if (!s_injectionThread.joinable()) {
+        RunJob(job);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(s_queueMutex);
+        s_jobQueue.push_back(std::move(job));
+    }
+    s_queueWake.notify_one();
+}
+
+void InputInjector::RunJob(const InjectionJob& job) {
+    switch (job.kind) {
+        case InjectionJob::Text: SendAndReport(job.text); break;
+        case InjectionJob::Prepare: Prepare(job.text); break;
+        case InjectionJob::Accept: SendAccepted(job.text, job.acceptTicks); break;
+    }
+}
+
+void InputInjector::StartInjectionThread() {
+    if (s_injectionThread.joinable()) return;
+    
+    s_stopInjection = false;
+    s_injectionThread = std::thread(InjectionThreadMain);
+    std::cout << "[OK] Injection thread started\n";
+}
+
+void InputInjector::Shutdown() {
+    if (!s_injectionThread.joinable()) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(s_queueMutex);
+        s_stopInjection = true;
+    }
+    s_queueWake.notify_one();
+    s_injectionThread.join();
+}
+
+bool InputInjector::IsOwnInjectedInput(const RAWINPUT& raw) {
+    // SendInput events have no device handle; the tag tells ours from other injectors'
+    if (raw.header.hDevice != nullptr) {
+        return false;
+    }
+    if (raw.header.dwType == RIM_TYPEKEYBOARD) {
+        return raw.data.keyboard.ExtraInformation == INJECTED_INPUT_TAG;
+    }
+    if (raw.header.dwType == RIM_TYPEMOUSE) {
+        return raw.data.mouse.ulExtraInformation == INJECTED_INPUT_TAG;
+    }
+    return false;
+}
+
+void InputInjector::InjectionThreadMain() {
+    std::unique_lock<std::mutex> lock(s_queueMutex);
+    while (true) {
+        s_queueWake.wait(lock, [] { return s_stopInjection || !s_jobQueue.empty(); });
+        if (s_jobQueue.empty()) {
+            return;  // Stop requested and everything queued was sent
+        }
+        
+        InjectionJob job = std::move(s_jobQueue.front());
+        s_jobQueue.pop_front();
+        lock.unlock();
+        RunJob(job);
+        lock.lock();
+    }
+}
+
+void InputInjector::SendAndReport(const std::string& text) {
+    if (SendTextString(text)) {
+        std::cout << "[SUCCESS] Injected LLM text: " << text.length() << " characters\n";
+    } else {
+        std::cout << "[ERROR] Failed to inject LLM text\n";
+    }
+}
+
+void InputInjector::Prepare(const std::string& text) {
+    if (!s_initialized || s_injectionMode == InjectionMode::PerKey) {
+        return;  // Per-key injection types as it goes
+    }
+    
+    s_preparedText.clear();
+    if (!BuildTextInputs(text, s_preparedInputs)) {
+        return;
+    }
+    s_preparedText = text;
+    s_preparedLayout = s_layoutHkl;
+}
+
+void InputInjector::SendAccepted(const std::string& text, std::uint64_t acceptTicks) {
+    if (!s_initialized || s_injectionMode == InjectionMode::PerKey) {
+        SendAndReport(text);
+        return;
+    }
+    
+    // Layout-mapped events are only valid for the layout they were built with
+    bool prepared = !s_preparedText.empty() && s_preparedText == text;
+    if (prepared && !s_unicodeInjection) {
+        EnsureLayoutTable();
+        prepared = s_preparedLayout == s_layoutHkl;
+    }
+    if (!prepared) {
+        Prepare(text);
+        if (s_preparedText.empty()) {
+            std::cout << "[ERROR] Failed to inject LLM text\n";
+            return;
+        }
+    }
+    
+    // One SendInput call: the text can't interleave with the user's own typing
+    bool success;
+    {
+        ScopedSpan span(Stage::Injection);
+        success = SendInputBatch(s_preparedInputs, 0);
+    }
+    std::uint64_t acceptMicros = Instrumentation::TicksToMicros(Instrumentation::NowTicks() - acceptTicks);
+    Instrumentation::Record(Stage::Accept, acceptMicros);
+    s_preparedText.clear();
+    
+    if (!success) {
+        std::cout << "[ERROR] Failed to inject LLM text\n";
+        return;
+    }
+    if (prepared) {
+        Instrumentation::Increment(Counter::AcceptPrepared);
+    }
+    std::cout << "[SUCCESS] Injected LLM text: " << text.length() << " characters in " << acceptMicros << "us"
+              << (prepared ? " (prepared)" : "") << "\n";
+    if (acceptMicros > s_acceptSlaMicros) {
+        Instrumentation::Increment(Counter::AcceptSlaMissed);
+        std::cout << "[WARNING] Accept took " << acceptMicros << "us, over the " << s_acceptSlaMicros << "us SLA\n";
+    }
+}
+
+bool InputInjector::SendTextStringPerKey(const std::string& text) {
+    // One layout lookup for the whole text
+    const std::array<SHORT, 256>& layoutTable = EnsureLayoutTable();
     
     bool success = true;
     for (char c : text) {
-        WORD vkCode = CharToVirtualKey(c);
+        SHORT vkScan = layoutTable[static_cast<unsigned char>(c)];
+        WORD vkCode = CharToVirtualKey(c, vkScan);
         if (vkCode != 0) {
             // Check if we need Shift for this character
-            SHORT vkScan = VkKeyScanA(c);
             WORD modifiers = HIBYTE(vkScan);
             
             // Press Shift if needed
@@ -101,6 +287,12 @@ bool InputInjector::SendKeySequence(const std::vector<WORD>& vkCodes) {
 }
 
 WORD InputInjector::CharToVirtualKey(char c) {
+    // Callable from any thread, so it asks the layout directly instead of using the injection thread's table
+    DWORD foregroundThread = GetWindowThreadProcessId(GetForegroundWindow(), nullptr);
+    return CharToVirtualKey(c, VkKeyScanExW(static_cast<unsigned char>(c), GetKeyboardLayout(foregroundThread)));
+}
+
+WORD InputInjector::CharToVirtualKey(char c, SHORT vkScan) {
     // Handle uppercase letters
     if (c >= 'A' && c <= 'Z') {
         return static_cast<WORD>('A' + (c - 'A'));
@@ -121,8 +313,12 @@ WORD InputInjector::CharToVirtualKey(char c) {
         return VK_SPACE;
     }
     
-    // For other characters, try VkKeyScan
-    SHORT vkScan = VkKeyScanA(c);
+    // Bytes of multi-byte UTF-8 sequences have no single key
+    if (static_cast<unsigned char>(c) >= 0x80) {
+        return 0;
+    }
+    
+    // For other characters, use the layout's mapping
     if (vkScan != -1) {
         return LOBYTE(vkScan);
     }
@@ -136,6 +332,10 @@ void InputInjector::SetKeyDelay(DWORD delayMs) {
 }
 
 bool InputInjector::SendInputHelper(const INPUT& input) {
+    if (s_dryRun) {
+        return true;
+    }
+    
     UINT result = SendInput(1, const_cast<INPUT*>(&input), sizeof(INPUT));
     
     if (result != 1) {
@@ -145,4 +345,194 @@ bool InputInjector::SendInputHelper(const INPUT& input) {
     }
     
     return true;
-}
\ No newline at end of file
+}
+
+void InputInjector::SetInjectionMode(InjectionMode mode) {
+    s_injectionMode = mode;
+    std::cout << "[CONFIG] Injection mode set to " << (mode == InjectionMode::Batched ? "batched" : "per-key") << "\n";
+}
+
+void InputInjector::SetChunkSize(size_t inputsPerChunk) {
+    s_chunkSize = inputsPerChunk;
+    std::cout << "[CONFIG] Injection chunk size set to " << inputsPerChunk << " events\n";
+}
+
+void InputInjector::SetChunkDelay(DWORD delayMs) {
+    s_chunkDelayMs = delayMs;
+    std::cout << "[CONFIG] Injection chunk delay set to " << delayMs << "ms\n";
+}
+
+bool InputInjector::BuildTextInputs(const std::string& text, std::vector<INPUT>& inputs) {
+    inputs.clear();
+    
+    // Reused between calls so steady-state injection doesn't allocate
+    static std::wstring wideText;
+    if (!Utf8ToUtf16(text, wideText)) {
+        std::cout << "[WARNING] Suggestion is not valid UTF-8, nothing injected\n";
+        return false;
+    }
+    
+    inputs.reserve(wideText.size() * 2 + 2);
+    if (!s_unicodeInjection) {
+        EnsureLayoutTable();
+    }
+    
+    bool shiftDown = false;
+    for (size_t i = 0; i < wideText.size(); ++i) {
+        wchar_t c = wideText[i];
+        
+        // Control characters need real keys; Unicode injection can't press Enter or Tab
+        WORD vkCode = 0;
+        bool needsShift = false;
+        if (c == L'\r' || c == L'\n') {
+            vkCode = VK_RETURN;
+            if (c == L'\r' && i + 1 < wideText.size() && wideText[i + 1] == L'\n') {
+                ++i;  // CRLF is one Enter
+            }
+        } else if (c == L'\t') {
+            vkCode = VK_TAB;
+        } else if (c == L'\b') {
+            vkCode = VK_BACK;
+        } else if (c < 0x20 || c == 0x7F) {
+            continue;  // Other control characters can't be typed
+        } else if (!s_unicodeInjection) {
+            // Only plain or Shift-modified keys; AltGr/Ctrl combos go through Unicode
+            SHORT vkScan = LookupKeyScan(c);
+            BYTE modifiers = HIBYTE(vkScan);
+            if (vkScan != -1 && (modifiers & ~1) == 0) {
+                vkCode = LOBYTE(vkScan);
+                needsShift = (modifiers & 1) != 0;
+            }
+        }
+        
+        if (vkCode != 0) {
+            // Only toggle Shift at the boundaries of shifted runs
+            if (needsShift != shiftDown) {
+                inputs.push_back(MakeKeyInput(VK_SHIFT, !needsShift));
+                shiftDown = needsShift;
+            }
+            inputs.push_back(MakeKeyInput(vkCode, false));
+            inputs.push_back(MakeKeyInput(vkCode, true));
+        } else {
+            // Unicode events carry the character itself; Shift must not be held
+            if (shiftDown) {
+                inputs.push_back(MakeKeyInput(VK_SHIFT, true));
+                shiftDown = false;
+            }
+            inputs.push_back(MakeUnicodeInput(c, false));
+            inputs.push_back(MakeUnicodeInput(c, true));
+        }
+    }
+    
+    // Never leave Shift held after the text
+    if (shiftDown) {
+        inputs.push_back(MakeKeyInput(VK_SHIFT, true));
+    }
+    
+    return true;
+}
+
+bool InputInjector::SendInputBatch(const std::vector<INPUT>& inputs, size_t chunkSize) {
+    if (s_dryRun || inputs.empty()) {
+        return true;
+    }
+    
+    if (chunkSize == 0) {
+        chunkSize = inputs.size();
+    }
+    
+    for (size_t offset = 0; offset < inputs.size(); offset += chunkSize) {
+        if (offset > 0 && s_chunkDelayMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(s_chunkDelayMs));
+        }
+        
+        UINT count = static_cast<UINT>(std::min(chunkSize, inputs.size() - offset));
+        UINT sent = SendInput(count, const_cast<INPUT*>(inputs.data() + offset), sizeof(INPUT));
+        if (sent != count) {
+            DWORD error = GetLastError();
+            std::cerr << "[ERROR] SendInput injected " << sent << " of " << count << " events, error: " << error << "\n";
+            
+            // Don't leave Shift stuck if the chunk was cut off mid-run
+            SendInputHelper(MakeKeyInput(VK_SHIFT, true));
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+INPUT InputInjector::MakeKeyInput(WORD vkCode, bool isKeyUp) {
+    INPUT input = {};
+    input.type = INPUT_KEYBOARD;
+    input.ki.wVk = vkCode;
+    input.ki.dwFlags = isKeyUp ? KEYEVENTF_KEYUP : 0;
+    input.ki.time = 0;
+    input.ki.dwExtraInfo = INJECTED_INPUT_TAG;
+    return input;
+}
+
+INPUT InputInjector::MakeUnicodeInput(wchar_t codeUnit, bool isKeyUp) {
+    INPUT input = {};
+    input.type = INPUT_KEYBOARD;
+    input.ki.wVk = 0;
+    input.ki.wScan = static_cast<WORD>(codeUnit);  // Surrogate pairs are sent as two events
+    input.ki.dwFlags = KEYEVENTF_UNICODE | (isKeyUp ? KEYEVENTF_KEYUP : 0);
+    input.ki.time = 0;
+    input.ki.dwExtraInfo = INJECTED_INPUT_TAG;
+    return input;
+}
+
+void InputInjector::SetUnicodeInjection(bool enabled) {
+    s_unicodeInjection = enabled;
+    std::cout << "[CONFIG] Unicode injection " << (enabled ? "enabled" : "disabled") << "\n";
+}
+
+void InputInjector::InvalidateLayoutTable() {
+    s_layoutValid = false;
+}
+
+void InputInjector::SetDryRun(bool enabled) {
+    s_dryRun = enabled;
+    std::cout << "[CONFIG] Injection dry run " << (enabled ? "enabled" : "disabled") << "\n";
+}
+
+const std::array<SHORT, 256>& InputInjector::EnsureLayoutTable() {
+    // Text goes to the foreground window, so use its thread's layout. Comparing the
+    // HKL also catches layout switches made in other apps, which WM_INPUTLANGCHANGE
+    // on our own window does not report.
+    DWORD foregroundThread = GetWindowThreadProcessId(GetForegroundWindow(), nullptr);
+    HKL layout = GetKeyboardLayout(foregroundThread);
+    if (s_layoutValid && layout == s_layoutHkl) {
+        return s_layoutTable;
+    }
+    
+    for (size_t i = 0; i < s_layoutTable.size(); ++i) {
+        s_layoutTable[i] = VkKeyScanExW(static_cast<WCHAR>(i), layout);
+    }
+    s_layoutHkl = layout;
+    s_layoutValid = true;
+    return s_layoutTable;
+}
+
+SHORT InputInjector::LookupKeyScan(wchar_t c) {
+    if (static_cast<size_t>(c) < s_layoutTable.size()) {
+        return s_layoutTable[c];
+    }
+    return -1;
+}
+
+bool InputInjector::Utf8ToUtf16(const std::string& text, std::wstring& wideText) {
+    wideText.clear();
+    if (text.empty()) {
+        return true;
+    }
+    
+    int length = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    if (length <= 0) {
+        return false;
+    }
+    
+    wideText.resize(length);
+    MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, text.data(), static_cast<int>(text.size()), wideText.data(), length);
+    return true;
+}
@@ -1,9 +1,25 @@
 #pragma once
 
 #include <windows.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+// dwExtraInfo stamped on every event we inject; raw input reports it as ExtraInformation
+constexpr ULONG INJECTED_INPUT_TAG = 0x57414F49;
+
+// How SendTextString submits keystrokes
+enum class InjectionMode {
+    PerKey,   // One SendInput call per key event with s_keyDelayMs sleeps (legacy)
+    Batched   // Whole INPUT[] built up front and submitted in chunks
+};
+
 class InputInjector {
 public:
     // Initialize the input injector
@@ -18,19 +34,140 @@ public:
     // Send a text string (converts to appropriate key presses)
     static bool SendTextString(const std::string& text);
     
+    // Hand text to the injection thread and return immediately (sends inline if it isn't running).
+    // The outcome is reported on the console.
+    static void QueueTextString(const std::string& text);
+    
+    // Build the events for a suggestion as soon as it is shown, so accepting it is a single
+    // SendInput call. Runs on the injection thread (inline if it isn't running).
+    static void PrepareText(const std::string& text);
+    
+    // Accept a suggestion: submit its prepared events in one SendInput call (built now if
+    // PrepareText wasn't called for this text). acceptTicks (Instrumentation::NowTicks when
+    // the accept key was handled) starts the accept latency checked against the SLA.
+    static void QueueAccept(const std::string& text, std::uint64_t acceptTicks);
+    
+    // Accept latency reported as a miss above this (default: 5000us)
+    static void SetAcceptSla(DWORD slaMicros);
+    
+    // Run queued text injection on a dedicated thread so SendInput bursts never block the UI thread
+    static void StartInjectionThread();
+    
+    // Finish queued text and stop the injection thread
+    static void Shutdown();
+    
+    // True for events produced by our own SendInput calls (no device handle and our tag)
+    static bool IsOwnInjectedInput(const RAWINPUT& raw);
+    
     // Send a sequence of virtual key codes
     static bool SendKeySequence(const std::vector<WORD>& vkCodes);
     
-    // Utility: Convert character to virtual key code
+    // Utility: Convert an ASCII character to virtual key code (0 if it has none on the current layout)
     static WORD CharToVirtualKey(char c);
     
-    // Add delay between key presses (in milliseconds)
+    // Add delay between key presses (in milliseconds, PerKey mode)
     static void SetKeyDelay(DWORD delayMs);
+    
+    // Select per-key or batched text injection (default: Batched)
+    static void SetInjectionMode(InjectionMode mode);
+    
+    // Maximum INPUT events per SendInput call in Batched mode (default: 128, 0 = no limit)
+    static void SetChunkSize(size_t inputsPerChunk);
+    
+    // Delay between chunks in Batched mode (default: 1ms)
+    static void SetChunkDelay(DWORD delayMs);
+    
+    // Inject characters with KEYEVENTF_UNICODE instead of virtual keys (default: enabled).
+    // Newline, tab and backspace always use real keys. With this disabled, characters
+    // are mapped through the layout table and only unmappable ones fall back to Unicode.
+    static void SetUnicodeInjection(bool enabled);
+    
+    // Build the key events for UTF-8 text, toggling Shift only when the next character needs a different state.
+    // Returns false if the text is not valid UTF-8.
+    static bool BuildTextInputs(const std::string& text, std::vector<INPUT>& inputs);
+    
+    // Force the layout table to be rebuilt (call on WM_INPUTLANGCHANGE)
+    static void InvalidateLayoutTable();
+    
+    // Build events as usual but skip SendInput (benchmarks; default: disabled)
+    static void SetDryRun(bool enabled);
 
 private:
     static DWORD s_keyDelayMs;
     static bool s_initialized;
+    static InjectionMode s_injectionMode;
+    static size_t s_chunkSize;
+    static DWORD s_chunkDelayMs;
+    static bool s_unicodeInjection;
+    static bool s_dryRun;
+    static DWORD s_acceptSlaMicros;
+    
+    // VkKeyScanExW results for code units 0-255, computed once per keyboard layout.
+    // The table and HKL belong to the injection thread; only s_layoutValid is also
+    // written from the UI thread (InvalidateLayoutTable).
+    static std::array<SHORT, 256> s_layoutTable;
+    static HKL s_layoutHkl;
+    static std::atomic<bool> s_layoutValid;
+    
+    // Work for the injection thread
+    struct InjectionJob {
+        enum Kind : std::uint8_t { Text, Prepare, Accept } kind;
+        std::string text;
+        std::uint64_t acceptTicks;  // Accept only
+    };
+    
+    // Injection thread and its queue of jobs, guarded by s_queueMutex
+    static std::thread s_injectionThread;
+    static std::mutex s_queueMutex;
+    static std::condition_variable s_queueWake;
+    static std::deque<InjectionJob> s_jobQueue;
+    static bool s_stopInjection;
+    
+    // Events built by PrepareText; only the injection thread touches them
+    static std::string s_preparedText;
+    static std::vector<INPUT> s_preparedInputs;
+    static HKL s_preparedLayout;
+    
+    // Injection thread body
+    static void InjectionThreadMain();
+    
+    // Queue a job, or run it inline when the injection thread isn't running
+    static void QueueJob(InjectionJob job);
+    static void RunJob(const InjectionJob& job);
+    
+    // SendTextString plus the console report
+    static void SendAndReport(const std::string& text);
+    
+    // Build and keep the events for text
+    static void Prepare(const std::string& text);
+    
+    // Submit an accepted suggestion and report its latency
+    static void SendAccepted(const std::string& text, std::uint64_t acceptTicks);
     
     // Helper to send raw INPUT structure
     static bool SendInputHelper(const INPUT& input);
+    
+    // Submit prepared events in chunks of chunkSize (0 = one SendInput call)
+    static bool SendInputBatch(const std::vector<INPUT>& inputs, size_t chunkSize);
+    
+    // Legacy per-key implementation of SendTextString
+    static bool SendTextStringPerKey(const std::string& text);
+    
+    // Make a keyboard INPUT for a virtual key
+    static INPUT MakeKeyInput(WORD vkCode, bool isKeyUp);
+    
+    // Make a KEYEVENTF_UNICODE INPUT for one UTF-16 code unit
+    static INPUT MakeUnicodeInput(wchar_t codeUnit, bool isKeyUp);
+    
+    // Rebuild the layout table if the foreground keyboard layout changed; resolve it once per text
+    static const std::array<SHORT, 256>& EnsureLayoutTable();
+    
+    // CharToVirtualKey given the layout's VkKeyScanExW result for c (no layout API calls)
+    static WORD CharToVirtualKey(char c, SHORT vkScan);
+    
+    // Table lookup replacing per-character VkKeyScan calls (-1 if unmapped)
+    static SHORT LookupKeyScan(wchar_t c);
+    
+    // Decode UTF-8 into a reusable UTF-16 buffer
+    static bool Utf8ToUtf16(const std::string& text, std::wstring& wideText);
 };
\ No newline at end of file
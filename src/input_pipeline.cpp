@@ -0,0 +1,310 @@
+#include "input_pipeline.h"
+#include "special_keys.h"
+#include "event_logger.h"
+#include "suggestion_overlay.h"
+#include "suggestion_service.h"
+#include "typed_context.h"
+#include "shared_journal.h"
+#include "diagnostics.h"
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <string>
+
+// Static member definitions
+EventHistory InputPipeline::s_eventHistory(DEFAULT_EVENT_HISTORY_CAPACITY);
+HWND InputPipeline::s_prefetchWindow = nullptr;
+DWORD InputPipeline::s_prefetchIdleMs = 0;
+std::uint64_t InputPipeline::s_lastKeyboardTimestamp = 0;
+HWND InputPipeline::s_motionTimerWindow = nullptr;
+bool InputPipeline::s_motionTimerArmed = false;
+
+bool InputPipeline::ProcessInput(const RAWINPUT& raw, std::uint64_t timestamp, POINT cursorPos) {
+    bool exitRequested = false;
+    if (raw.header.dwType == RIM_TYPEKEYBOARD) {
+        FlushPendingMotion();  // Keep the summary ahead of the key in the history and log
+        ProcessKeyboard(raw.data.keyboard, timestamp, cursorPos, exitRequested);
+    } else if (raw.header.dwType == RIM_TYPEMOUSE) {
+        ProcessMouse(raw.data.mouse, timestamp, cursorPos);
+    }
+    return !exitRequested;
+}
+
+const EventHistory& InputPipeline::GetEventHistory() {
+    return s_eventHistory;
+}
+
+void InputPipeline::ClearEventHistory() {
+    s_eventHistory.clear();
+}
+
+size_t InputPipeline::GetEventCount() {
+    return s_eventHistory.size();
+}
+
+const char* InputPipeline::MouseEventTypeToString(MouseEventData::Type type) {
+    switch (type) {
+        case MouseEventData::LEFT_DOWN: return "LEFT_DOWN";
+        case MouseEventData::LEFT_UP: return "LEFT_UP";
+        case MouseEventData::RIGHT_DOWN: return "RIGHT_DOWN";
+        case MouseEventData::RIGHT_UP: return "RIGHT_UP";
+        case MouseEventData::MIDDLE_DOWN: return "MIDDLE_DOWN";
+        case MouseEventData::MIDDLE_UP: return "MIDDLE_UP";
+        case MouseEventData::WHEEL: return "WHEEL";
+        case MouseEventData::MOVE: return "MOVE";
+        default: return "UNKNOWN";
+    }
+}
+
+void InputPipeline::EnableSpeculativePrefetch(HWND timerWindow, DWORD idleMs) {
+    if (s_prefetchWindow && s_prefetchIdleMs > 0) {
+        KillTimer(s_prefetchWindow, PREFETCH_TIMER_ID);
+    }
+    s_prefetchWindow = timerWindow;
+    s_prefetchIdleMs = idleMs;
+
+    if (idleMs > 0) {
+        std::cout << "[CONFIG] Speculative completion after " << idleMs << "ms of idle typing\n";
+    }
+}
+
+void InputPipeline::OnPrefetchTimer(std::uint64_t now) {
+    KillTimer(s_prefetchWindow, PREFETCH_TIMER_ID);
+    if (s_prefetchIdleMs == 0 || s_lastKeyboardTimestamp == 0) {
+        return;
+    }
+
+    // The timer only approximates the pause; the recorded timestamps decide
+    std::uint64_t thresholdMicros = static_cast<std::uint64_t>(s_prefetchIdleMs) * 1000;
+    std::uint64_t lastEvent = s_lastKeyboardTimestamp;
+    std::uint64_t idleMicros = now > lastEvent ? now - lastEvent : 0;
+    if (idleMicros < thresholdMicros) {
+        UINT remainingMs = static_cast<UINT>((thresholdMicros - idleMicros + 999) / 1000);
+        SetTimer(s_prefetchWindow, PREFETCH_TIMER_ID, remainingMs, nullptr);
+        return;
+    }
+
+    SuggestionService::Prefetch(TypedContext::GetContext());
+}
+
+void InputPipeline::EnableMotionFlushTimer(HWND timerWindow) {
+    s_motionTimerWindow = timerWindow;
+    s_motionTimerArmed = false;
+}
+
+void InputPipeline::OnMotionFlushTimer(std::uint64_t now) {
+    KillTimer(s_motionTimerWindow, MOTION_FLUSH_TIMER_ID);
+    s_motionTimerArmed = false;
+
+    // As with prefetch, the timer only approximates the pause; the recorded timestamps decide
+    MouseMotionSummary finished;
+    std::uint64_t remainingMicros = 0;
+    if (MouseCoalescer::FlushIfIdle(now, finished, remainingMicros)) {
+        StoreMotionSummary(finished);
+    } else if (remainingMicros > 0) {
+        ArmMotionFlushTimer(static_cast<DWORD>((remainingMicros + 999) / 1000));
+    }
+}
+
+void InputPipeline::FlushPendingMotion() {
+    MouseMotionSummary finished;
+    if (MouseCoalescer::Flush(finished)) {
+        StoreMotionSummary(finished);
+    }
+}
+
+void InputPipeline::ArmMotionFlushTimer(DWORD delayMs) {
+    if (!s_motionTimerWindow || s_motionTimerArmed || !MouseCoalescer::HasPending()) {
+        return;
+    }
+    SetTimer(s_motionTimerWindow, MOTION_FLUSH_TIMER_ID, delayMs, nullptr);
+    s_motionTimerArmed = true;
+}
+
+void InputPipeline::ProcessKeyboard(const RAWKEYBOARD& kb, std::uint64_t timestamp, POINT cursorPos, bool& exitRequested) {
+    bool isKeyUp = (kb.Flags & RI_KEY_BREAK) != 0;
+
+    // Store keyboard event in memory
+    KeyboardEventData kbData(kb.VKey, kb.MakeCode, kb.Flags, isKeyUp);
+    StoreEvent(timestamp, cursorPos, kbData);
+    s_lastKeyboardTimestamp = timestamp;
+
+    // ESC exits; the caller decides how to shut down
+    if (kb.VKey == VK_ESCAPE && !isKeyUp) {
+        exitRequested = true;
+        return;
+    }
+
+    // Typing restarts the idle countdown (SetTimer replaces a pending timer with the same id)
+    if (!isKeyUp && s_prefetchIdleMs > 0) {
+        SetTimer(s_prefetchWindow, PREFETCH_TIMER_ID, s_prefetchIdleMs, nullptr);
+    }
+
+    // Hide suggestion overlay on any key press (except when Left Ctrl is generating suggestion)
+    if (!isKeyUp) { // Only on key down events
+        bool isLeftCtrl = (kb.VKey == VK_CONTROL && (kb.Flags & RI_KEY_E0) == 0);
+        bool isRightCtrl = (kb.VKey == VK_CONTROL && (kb.Flags & RI_KEY_E0) != 0);
+
+        // Hide overlay for any key except Left Ctrl (which shows suggestions)
+        // Right Ctrl will be handled by the special key handler
+        if (!isLeftCtrl) {
+            SuggestionOverlay::HideSuggestion();
+
+            // New input makes any in-flight suggestion stale
+            SuggestionService::CancelPending();
+        }
+    }
+
+    // Process special key events
+    bool hookTriggered = SpecialKeyHandler::ProcessSpecialKeyEvent(kb.VKey, kb.MakeCode, kb.Flags, isKeyUp, timestamp, cursorPos);
+
+    // If this is not a special key and it's a key down event, notify the special key handler
+    // (so it can track key combinations like Ctrl+A)
+    if (!hookTriggered && !isKeyUp) {
+        SpecialKeyHandler::NotifyRegularKeyPressed(kb.VKey);
+    }
+
+    // Trace output (skip if hook was triggered to avoid spam); printed on the diagnostics thread
+    if (!hookTriggered && Diagnostics::IsEnabled(DiagCategory::Keyboard, DiagLevel::Trace)) {
+        const char* label = SpecialKeyHandler::IsSpecialKey(kb.VKey) ? SpecialKeyHandler::GetKeyName(kb.VKey) : nullptr;
+        Diagnostics::KeyEvent(timestamp, kb.VKey, kb.MakeCode, isKeyUp, cursorPos, label);
+    }
+}
+
+void InputPipeline::ProcessMouse(const RAWMOUSE& mouse, std::uint64_t timestamp, POINT cursorPos) {
+    // Moves and wheel ticks only extend the pending run; it is stored (and traced) when it ends
+    MouseMotionSummary finished;
+    bool hasButtons = (mouse.usButtonFlags & ~RI_MOUSE_WHEEL) != 0;
+    bool isWheel = (mouse.usButtonFlags & RI_MOUSE_WHEEL) != 0;
+    if (!hasButtons && (isWheel || mouse.lLastX != 0 || mouse.lLastY != 0)) {
+        bool ended = isWheel
+            ? MouseCoalescer::AddWheel(timestamp, cursorPos, static_cast<short>(mouse.usButtonData), finished)
+            : MouseCoalescer::AddMove(timestamp, cursorPos, mouse.lLastX, mouse.lLastY, finished);
+        if (ended) {
+            StoreMotionSummary(finished);
+        }
+        ArmMotionFlushTimer(MouseCoalescer::GetIdleGap());
+        return;
+    }
+    FlushPendingMotion();
+
+    // Store mouse event in memory; mouseAction names it for the trace output
+    const char* mouseAction = nullptr;
+
+    // A click means the user moved on, so any in-flight suggestion is stale
+    if (mouse.usButtonFlags & (RI_MOUSE_LEFT_BUTTON_DOWN | RI_MOUSE_RIGHT_BUTTON_DOWN | RI_MOUSE_MIDDLE_BUTTON_DOWN)) {
+        SuggestionService::CancelPending();
+    }
+
+    // Button events
+    if (mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_DOWN) {
+        StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::LEFT_DOWN, mouse.lLastX, mouse.lLastY));
+        mouseAction = "L_DOWN";
+    }
+    else if (mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_UP) {
+        StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::LEFT_UP, mouse.lLastX, mouse.lLastY));
+        mouseAction = "L_UP";
+    }
+    else if (mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_DOWN) {
+        StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::RIGHT_DOWN, mouse.lLastX, mouse.lLastY));
+        mouseAction = "R_DOWN";
+    }
+    else if (mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_UP) {
+        StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::RIGHT_UP, mouse.lLastX, mouse.lLastY));
+        mouseAction = "R_UP";
+    }
+    else if (mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_DOWN) {
+        StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::MIDDLE_DOWN, mouse.lLastX, mouse.lLastY));
+        mouseAction = "M_DOWN";
+    }
+    else if (mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_UP) {
+        StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::MIDDLE_UP, mouse.lLastX, mouse.lLastY));
+        mouseAction = "M_UP";
+    }
+    else {
+        return;  // No relevant mouse event
+    }
+
+    if (mouseAction && (mouse.usButtonFlags || mouse.lLastX != 0 || mouse.lLastY != 0)) {
+        Diagnostics::MouseEvent(timestamp, mouseAction, mouse.lLastX, mouse.lLastY, cursorPos);
+    }
+}
+
+void InputPipeline::StoreMotionSummary(const MouseMotionSummary& summary) {
+    // The history keeps the net movement (or total wheel delta) at the end position
+    MouseEventData mouseData = summary.type == MouseEventData::WHEEL
+        ? MouseEventData(MouseEventData::WHEEL, 0, 0, static_cast<short>(std::clamp<std::int32_t>(summary.wheelDelta, SHRT_MIN, SHRT_MAX)))
+        : MouseEventData(MouseEventData::MOVE, summary.deltaX, summary.deltaY);
+    s_eventHistory.Push(EventRecord::FromMouse(summary.startTimestamp, summary.endPos, mouseData));
+
+    EventLogger::LogMouseMotion(summary);
+    TypedContext::OnMouseMotion(summary);
+    SharedJournal::AppendMouseMotion(summary);
+
+    bool isWheel = summary.type == MouseEventData::WHEEL;
+    Diagnostics::MouseEvent(summary.startTimestamp, isWheel ? "WHEEL" : "MOVE",
+                            isWheel ? summary.wheelDelta : summary.deltaX, isWheel ? 0 : summary.deltaY, summary.endPos);
+}
+
+void InputPipeline::StoreEvent(std::uint64_t timestamp, POINT cursorPos, const KeyboardEventData& kbData) {
+    s_eventHistory.Push(EventRecord::FromKeyboard(timestamp, cursorPos, kbData));
+
+    // Use new EventLogger
+    EventLogger::LogKeyboardEvent(timestamp, kbData.vKey, kbData.isKeyUp);
+
+    // Keep the suggestion context current (after logging, which updates the shift state)
+    TypedContext::OnKeyboardEvent(kbData.vKey, kbData.isKeyUp);
+    SharedJournal::AppendKeyboardEvent(timestamp, kbData.vKey, kbData.isKeyUp, EventLogger::VKeyToCharCode(kbData.vKey));
+}
+
+void InputPipeline::StoreEvent(std::uint64_t timestamp, POINT cursorPos, const MouseEventData& mouseData) {
+    s_eventHistory.Push(EventRecord::FromMouse(timestamp, cursorPos, mouseData));
+
+    // Use new EventLogger for mouse clicks only
+    std::string buttonName;
+    bool isButtonUp = false;
+    bool shouldLog = false;
+
+    switch (mouseData.eventType) {
+        case MouseEventData::LEFT_DOWN:
+            buttonName = "left";
+            isButtonUp = false;
+            shouldLog = true;
+            break;
+        case MouseEventData::LEFT_UP:
+            buttonName = "left";
+            isButtonUp = true;
+            shouldLog = true;
+            break;
+        case MouseEventData::RIGHT_DOWN:
+            buttonName = "right";
+            isButtonUp = false;
+            shouldLog = true;
+            break;
+        case MouseEventData::RIGHT_UP:
+            buttonName = "right";
+            isButtonUp = true;
+            shouldLog = true;
+            break;
+        case MouseEventData::MIDDLE_DOWN:
+            buttonName = "middle";
+            isButtonUp = false;
+            shouldLog = true;
+            break;
+        case MouseEventData::MIDDLE_UP:
+            buttonName = "middle";
+            isButtonUp = true;
+            shouldLog = true;
+            break;
+        // Skip WHEEL and MOVE events for simplified logging
+        default:
+            shouldLog = false;
+            break;
+    }
+
+    if (shouldLog) {
+        EventLogger::LogMouseButtonEvent(timestamp, buttonName, isButtonUp, cursorPos);
+        TypedContext::OnMouseButtonEvent(buttonName, isButtonUp, cursorPos);
+        SharedJournal::AppendMouseButtonEvent(timestamp, buttonName, isButtonUp, cursorPos);
+    }
+}
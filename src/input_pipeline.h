@@ -0,0 +1,63 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include "event_history.h"
+#include "mouse_coalescer.h"
+
+// WM_TIMER ids used on the timer window
+constexpr UINT_PTR PREFETCH_TIMER_ID = 1;
+constexpr UINT_PTR MOTION_FLUSH_TIMER_ID = 2;
+
+// Per-event input handling shared by the WM_INPUT loop and the replay bench:
+// in-memory history, event log, suggestion context, shared journal, special
+// keys and overlay/suggestion cancellation. Mouse moves and wheel ticks pass
+// through MouseCoalescer and are stored as one summary per run.
+class InputPipeline {
+public:
+    // Handle one raw input event. Returns false if the event asks the app to exit (ESC down).
+    static bool ProcessInput(const RAWINPUT& raw, std::uint64_t timestamp, POINT cursorPos);
+
+    // Events captured so far (preallocated ring buffer)
+    static const EventHistory& GetEventHistory();
+    static void ClearEventHistory();
+    static size_t GetEventCount();
+
+    // "LEFT_DOWN", "WHEEL", ...
+    static const char* MouseEventTypeToString(MouseEventData::Type type);
+
+    // Speculatively request a completion once typing has paused for idleMs (0 = disabled, the default).
+    // Key presses (re)arm PREFETCH_TIMER_ID on timerWindow; forward that WM_TIMER to OnPrefetchTimer.
+    static void EnableSpeculativePrefetch(HWND timerWindow, DWORD idleMs);
+
+    // Handle PREFETCH_TIMER_ID. now uses the same clock as the event timestamps.
+    static void OnPrefetchTimer(std::uint64_t now);
+
+    // Emit a pending motion summary once the mouse has been idle for the coalescer's gap,
+    // instead of waiting for the next event. Starting a run arms MOTION_FLUSH_TIMER_ID on
+    // timerWindow; forward that WM_TIMER to OnMotionFlushTimer.
+    static void EnableMotionFlushTimer(HWND timerWindow);
+    static void OnMotionFlushTimer(std::uint64_t now);
+
+    // Store the pending motion summary now (e.g. before shutdown)
+    static void FlushPendingMotion();
+
+private:
+    static void ProcessKeyboard(const RAWKEYBOARD& kb, std::uint64_t timestamp, POINT cursorPos, bool& exitRequested);
+    static void ProcessMouse(const RAWMOUSE& mouse, std::uint64_t timestamp, POINT cursorPos);
+
+    // Store in memory and fan out to the logger, context and journal
+    static void StoreEvent(std::uint64_t timestamp, POINT cursorPos, const KeyboardEventData& kbData);
+    static void StoreEvent(std::uint64_t timestamp, POINT cursorPos, const MouseEventData& mouseData);
+    static void StoreMotionSummary(const MouseMotionSummary& summary);
+
+    // Arm MOTION_FLUSH_TIMER_ID if a run is pending and the timer is not already running
+    static void ArmMotionFlushTimer(DWORD delayMs);
+
+    static EventHistory s_eventHistory;
+    static HWND s_prefetchWindow;
+    static DWORD s_prefetchIdleMs;
+    static std::uint64_t s_lastKeyboardTimestamp;  // Idle detection ignores mouse movement
+    static HWND s_motionTimerWindow;
+    static bool s_motionTimerArmed;
+};
@@ -0,0 +1,354 @@
+#include "instrumentation.h"
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(Stage::Count);
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+
+// Static member definitions
+std::atomic<std::uint64_t> Instrumentation::s_counters[COUNTER_COUNT] = {};
+std::string Instrumentation::s_dumpFilePath;
+DWORD Instrumentation::s_dumpIntervalMs = 10000;
+std::thread Instrumentation::s_dumpThread;
+std::mutex Instrumentation::s_dumpMutex;
+std::condition_variable Instrumentation::s_dumpWake;
+bool Instrumentation::s_stopDump = false;
+
+namespace {
+
+// One set of stage histograms per recording thread
+struct ThreadHistograms {
+    LatencyHistogram stages[STAGE_COUNT];
+};
+
+// Registered sets live until process exit, so a snapshot can read threads that already ended
+std::mutex g_registryMutex;
+std::vector<std::unique_ptr<ThreadHistograms>> g_registry;
+thread_local ThreadHistograms* t_histograms = nullptr;
+
+ThreadHistograms& LocalHistograms() {
+    if (!t_histograms) {
+        auto histograms = std::make_unique<ThreadHistograms>();
+        t_histograms = histograms.get();
+        std::lock_guard<std::mutex> lock(g_registryMutex);
+        g_registry.push_back(std::move(histograms));
+    }
+    return *t_histograms;
+}
+
+std::uint64_t QueryFrequency() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<std::uint64_t>(frequency.QuadPart);
+}
+
+const std::uint64_t g_ticksPerSecond = QueryFrequency();
+
+// Single-writer increment: a plain load/store pair instead of a locked RMW
+template <typename T>
+void BumpRelaxed(std::atomic<T>& value, T amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+bool EndsWith(const std::string& text, const char* suffix) {
+    size_t length = std::char_traits<char>::length(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+}  // namespace
+
+size_t LatencyHistogram::BucketIndex(std::uint64_t micros) {
+    if (micros < LINEAR_LIMIT) {
+        return static_cast<size_t>(micros);
+    }
+    // Top SUB_BUCKET_BITS + 1 bits select the bucket within the value's power of two
+    int msb = 63 - std::countl_zero(micros);
+    int shift = msb - SUB_BUCKET_BITS;
+    size_t mantissa = static_cast<size_t>(micros >> shift) - SUB_BUCKETS;
+    return LINEAR_LIMIT + static_cast<size_t>(msb - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + mantissa;
+}
+
+std::uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < LINEAR_LIMIT) {
+        return index;
+    }
+    size_t offset = index - LINEAR_LIMIT;
+    int shift = static_cast<int>(offset / SUB_BUCKETS) + 1;
+    std::uint64_t mantissa = SUB_BUCKETS + offset % SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(std::uint64_t micros) {
+    BumpRelaxed(m_buckets[BucketIndex(micros)], std::uint32_t(1));
+    BumpRelaxed(m_count, std::uint64_t(1));
+    BumpRelaxed(m_sum, micros);
+    if (micros > m_max.load(std::memory_order_relaxed)) {
+        m_max.store(micros, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::AddTo(LatencyHistogram& total) const {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        std::uint32_t count = m_buckets[i].load(std::memory_order_relaxed);
+        if (count > 0) {
+            BumpRelaxed(total.m_buckets[i], count);
+        }
+    }
+    BumpRelaxed(total.m_count, m_count.load(std::memory_order_relaxed));
+    BumpRelaxed(total.m_sum, m_sum.load(std::memory_order_relaxed));
+    total.m_max.store(std::max(total.GetMax(), GetMax()), std::memory_order_relaxed);
+}
+
+double LatencyHistogram::GetMean() const {
+    std::uint64_t count = GetCount();
+    return count > 0 ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count : 0.0;
+}
+
+std::uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+    // Bucket totals are read separately from m_count, so rank against their own sum
+    std::uint64_t total = 0;
+    for (const auto& bucket : m_buckets) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    std::uint64_t rank = static_cast<std::uint64_t>(percentile / 100.0 * total + 0.5);
+    rank = std::clamp<std::uint64_t>(rank, 1, total);
+
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // The top bucket's bound can overshoot the real maximum
+            return std::min(BucketUpperBound(i), GetMax());
+        }
+    }
+    return GetMax();
+}
+
+void Instrumentation::Initialize() {
+    char filePath[MAX_PATH] = {};
+    DWORD length = GetEnvironmentVariableA("WINOPAUTO_METRICS_FILE", filePath, sizeof(filePath));
+    if (length == 0 || length >= sizeof(filePath)) {
+        return;
+    }
+
+    DWORD intervalMs = s_dumpIntervalMs;
+    char interval[16] = {};
+    length = GetEnvironmentVariableA("WINOPAUTO_METRICS_INTERVAL_MS", interval, sizeof(interval));
+    if (length > 0 && length < sizeof(interval)) {
+        intervalMs = static_cast<DWORD>(std::strtoul(interval, nullptr, 10));
+    }
+    SetDumpFile(filePath, intervalMs);
+}
+
+void Instrumentation::Shutdown() {
+    if (!s_dumpThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_dumpMutex);
+        s_stopDump = true;
+    }
+    s_dumpWake.notify_one();
+    s_dumpThread.join();
+
+    // Final totals for the whole session
+    WriteDump();
+}
+
+void Instrumentation::SetDumpFile(const std::string& filePath, DWORD intervalMs) {
+    Shutdown();
+
+    s_dumpFilePath = filePath;
+    s_dumpIntervalMs = std::max<DWORD>(intervalMs, 1000);
+    if (s_dumpFilePath.empty()) {
+        return;
+    }
+
+    s_stopDump = false;
+    s_dumpThread = std::thread(DumpThreadMain);
+    std::cout << "[CONFIG] Latency metrics dumped to " << s_dumpFilePath
+              << " every " << s_dumpIntervalMs << "ms\n";
+}
+
+void Instrumentation::Record(Stage stage, std::uint64_t micros) {
+    LocalHistograms().stages[static_cast<size_t>(stage)].Record(micros);
+}
+
+std::uint64_t Instrumentation::NowTicks() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<std::uint64_t>(counter.QuadPart);
+}
+
+std::uint64_t Instrumentation::TicksToMicros(std::uint64_t ticks) {
+    // Split to avoid overflowing ticks * 1e6 on long spans
+    return (ticks / g_ticksPerSecond) * 1000000 + (ticks % g_ticksPerSecond) * 1000000 / g_ticksPerSecond;
+}
+
+void Instrumentation::PrintSummary() {
+    std::cout << "\n=== Latency Summary (microseconds) ===\n";
+    std::cout << std::left << std::setw(18) << "Stage" << std::right
+              << std::setw(9) << "Count" << std::setw(11) << "Mean"
+              << std::setw(10) << "p50" << std::setw(10) << "p90"
+              << std::setw(10) << "p99" << std::setw(11) << "Max" << "\n";
+
+    bool any = false;
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        Stage stage = static_cast<Stage>(i);
+        auto total = std::make_unique<LatencyHistogram>();
+        Snapshot(stage, *total);
+        if (total->GetCount() == 0) {
+            continue;
+        }
+        any = true;
+        std::cout << std::left << std::setw(18) << GetStageName(stage) << std::right
+                  << std::setw(9) << total->GetCount()
+                  << std::setw(11) << static_cast<std::uint64_t>(total->GetMean() + 0.5)
+                  << std::setw(10) << total->GetPercentile(50)
+                  << std::setw(10) << total->GetPercentile(90)
+                  << std::setw(10) << total->GetPercentile(99)
+                  << std::setw(11) << total->GetMax() << "\n";
+    }
+    if (!any) {
+        std::cout << "(no samples)\n";
+    }
+
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        Counter counter = static_cast<Counter>(i);
+        if (GetCounter(counter) > 0) {
+            std::cout << std::left << std::setw(27) << GetCounterName(counter) << std::right
+                      << GetCounter(counter) << "\n";
+        }
+    }
+}
+
+const char* Instrumentation::GetStageName(Stage stage) {
+    switch (stage) {
+        case Stage::WmInput: return "WmInput";
+        case Stage::CaptureHandoff: return "CaptureHandoff";
+        case Stage::HookCallback: return "HookCallback";
+        case Stage::LogWrite: return "LogWrite";
+        case Stage::WorkerStartup: return "WorkerStartup";
+        case Stage::CompletionRequest: return "CompletionRequest";
+        case Stage::WorkerCompute: return "WorkerCompute";
+        case Stage::ScriptRun: return "ScriptRun";
+        case Stage::OutputReadback: return "OutputReadback";
+        case Stage::SuggestionTotal: return "SuggestionTotal";
+        case Stage::FirstPartial: return "FirstPartial";
+        case Stage::OverlayPaint: return "OverlayPaint";
+        case Stage::Injection: return "Injection";
+        case Stage::Accept: return "Accept";
+        default: return "Unknown";
+    }
+}
+
+const char* Instrumentation::GetCounterName(Counter counter) {
+    switch (counter) {
+        case Counter::SuggestionCacheHit: return "SuggestionCacheHit";
+        case Counter::SuggestionCacheMiss: return "SuggestionCacheMiss";
+        case Counter::SuggestionCacheEviction: return "SuggestionCacheEviction";
+        case Counter::PrefetchIssued: return "PrefetchIssued";
+        case Counter::PrefetchAdopted: return "PrefetchAdopted";
+        case Counter::PrefetchBudgetExhausted: return "PrefetchBudgetExhausted";
+        case Counter::RawInputBuffered: return "RawInputBuffered";
+        case Counter::InjectedInputFiltered: return "InjectedInputFiltered";
+        case Counter::CaptureQueueOverflow: return "CaptureQueueOverflow";
+        case Counter::MouseEventsCoalesced: return "MouseEventsCoalesced";
+        case Counter::AcceptPrepared: return "AcceptPrepared";
+        case Counter::AcceptSlaMissed: return "AcceptSlaMissed";
+        default: return "Unknown";
+    }
+}
+
+void Instrumentation::Snapshot(Stage stage, LatencyHistogram& total) {
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    for (const auto& histograms : g_registry) {
+        histograms->stages[static_cast<size_t>(stage)].AddTo(total);
+    }
+}
+
+void Instrumentation::WriteDump() {
+    bool asJson = EndsWith(s_dumpFilePath, ".json") || EndsWith(s_dumpFilePath, ".jsonl");
+    bool writeHeader = !asJson && !std::ifstream(s_dumpFilePath).good();
+
+    std::ofstream file(s_dumpFilePath, std::ios::app);
+    if (!file.is_open()) {
+        std::cout << "[WARNING] Could not open metrics file " << s_dumpFilePath << "\n";
+        return;
+    }
+
+    // Cumulative since startup; each dump is one JSON line or one CSV row per stage
+    long long unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (writeHeader) {
+        file << "unix_time_ms,stage,count,mean_us,p50_us,p90_us,p99_us,max_us\n";
+    }
+    if (asJson) {
+        file << "{\"unix_time_ms\": " << unixMs << ", \"stages\": {";
+    }
+    file << std::fixed << std::setprecision(1);
+
+    bool first = true;
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        Stage stage = static_cast<Stage>(i);
+        auto total = std::make_unique<LatencyHistogram>();
+        Snapshot(stage, *total);
+        if (total->GetCount() == 0) {
+            continue;
+        }
+
+        if (asJson) {
+            file << (first ? "" : ", ") << "\"" << GetStageName(stage) << "\": {"
+                 << "\"count\": " << total->GetCount()
+                 << ", \"mean_us\": " << total->GetMean()
+                 << ", \"p50_us\": " << total->GetPercentile(50)
+                 << ", \"p90_us\": " << total->GetPercentile(90)
+                 << ", \"p99_us\": " << total->GetPercentile(99)
+                 << ", \"max_us\": " << total->GetMax() << "}";
+        } else {
+            file << unixMs << "," << GetStageName(stage) << "," << total->GetCount() << ","
+                 << total->GetMean() << "," << total->GetPercentile(50) << ","
+                 << total->GetPercentile(90) << "," << total->GetPercentile(99) << ","
+                 << total->GetMax() << "\n";
+        }
+        first = false;
+    }
+
+    // Counters: JSON gets their own object, CSV one row each with only the count column
+    if (asJson) {
+        file << "}, \"counters\": {";
+    }
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        Counter counter = static_cast<Counter>(i);
+        if (asJson) {
+            file << (i == 0 ? "" : ", ") << "\"" << GetCounterName(counter) << "\": " << GetCounter(counter);
+        } else {
+            file << unixMs << "," << GetCounterName(counter) << "," << GetCounter(counter) << ",,,,,\n";
+        }
+    }
+
+    if (asJson) {
+        file << "}}\n";
+    }
+}
+
+void Instrumentation::DumpThreadMain() {
+    std::unique_lock<std::mutex> lock(s_dumpMutex);
+    while (!s_dumpWake.wait_for(lock, std::chrono::milliseconds(s_dumpIntervalMs), [] { return s_stopDump; })) {
+        lock.unlock();
+        WriteDump();
+        lock.lock();
+    }
+}
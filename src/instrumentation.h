@@ -0,0 +1,151 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Pipeline stages with their own latency histogram
+enum class Stage : std::uint8_t {
+    WmInput,            // One WM_INPUT message on the capture thread (read, timestamp, queue)
+    CaptureHandoff,     // Raw input queued by the capture thread until the pipeline processes it
+    HookCallback,       // One low-level hook callback (must stay far below LowLevelHooksTimeout)
+    LogWrite,           // Event log write (one synchronous entry or one async batch)
+    WorkerStartup,      // Completion worker launch until it connects
+    CompletionRequest,  // Pipe round trip to the completion worker
+    WorkerCompute,      // Time the worker reports for a request (cleaning + HTTP + model)
+    ScriptRun,          // process_input.py fallback process
+    OutputReadback,     // Reading python_output.txt after the fallback
+    SuggestionTotal,    // Suggestion requested until its result is posted to the UI
+    FirstPartial,       // Suggestion requested until the first streamed text is posted to the UI
+    OverlayPaint,       // Overlay WM_PAINT
+    Injection,          // InputInjector::SendTextString (or the SendInput call of an accept)
+    Accept,             // Right Ctrl handled until the accepted text was submitted
+    Count
+};
+
+// Event counters reported next to the stage histograms
+enum class Counter : std::uint8_t {
+    SuggestionCacheHit,
+    SuggestionCacheMiss,
+    SuggestionCacheEviction,  // Capacity evictions and expired entries
+    PrefetchIssued,           // Speculative completions started while idle
+    PrefetchAdopted,          // Left Ctrl arrived while the matching prefetch was still running
+    PrefetchBudgetExhausted,  // Idle periods skipped because of the per-minute budget
+    RawInputBuffered,         // Events drained with GetRawInputBuffer instead of their own WM_INPUT
+    InjectedInputFiltered,    // Our own SendInput events dropped before the log and context
+    CaptureQueueOverflow,     // Raw input dropped because the UI thread fell behind
+    MouseEventsCoalesced,     // Raw moves and wheel ticks merged into an earlier summary
+    AcceptPrepared,           // Accepts submitted from events built when the suggestion was shown
+    AcceptSlaMissed,          // Accepts slower than the accept latency SLA
+    Count
+};
+
+// HDR-style log-linear histogram of microsecond values: exact below 32us, then
+// 16 sub-buckets per power of two (about 6% relative error) up to 2^64.
+// Each instance has a single writer thread, so recording needs no atomic RMW.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr size_t LINEAR_LIMIT = SUB_BUCKETS * 2;
+    static constexpr size_t BUCKET_COUNT = LINEAR_LIMIT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+    // Record one value (writer thread only)
+    void Record(std::uint64_t micros);
+
+    // Add this histogram's current counts to another (any thread; counts are read relaxed)
+    void AddTo(LatencyHistogram& total) const;
+
+    std::uint64_t GetCount() const { return m_count.load(std::memory_order_relaxed); }
+    std::uint64_t GetMax() const { return m_max.load(std::memory_order_relaxed); }
+    double GetMean() const;
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    std::uint64_t GetPercentile(double percentile) const;
+
+    static size_t BucketIndex(std::uint64_t micros);
+    static std::uint64_t BucketUpperBound(size_t index);
+
+private:
+    std::atomic<std::uint32_t> m_buckets[BUCKET_COUNT] = {};
+    std::atomic<std::uint64_t> m_count{0};
+    std::atomic<std::uint64_t> m_sum{0};
+    std::atomic<std::uint64_t> m_max{0};
+};
+
+// Process-wide latency instrumentation: per-thread histograms for each Stage,
+// a summary printed at exit and an optional periodic CSV/JSON dump.
+class Instrumentation {
+public:
+    // Start the periodic dump if WINOPAUTO_METRICS_FILE is set
+    // (.json = JSON lines, otherwise CSV; interval from WINOPAUTO_METRICS_INTERVAL_MS, default 10000)
+    static void Initialize();
+
+    // Write a final dump and stop the dump thread
+    static void Shutdown();
+
+    // Dump cumulative percentiles to filePath every intervalMs (empty path disables)
+    static void SetDumpFile(const std::string& filePath, DWORD intervalMs);
+
+    // Record a duration for a stage on the calling thread's histogram
+    static void Record(Stage stage, std::uint64_t micros);
+
+    // Add to a process-wide counter
+    static void Increment(Counter counter, std::uint64_t amount = 1) {
+        s_counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    static std::uint64_t GetCounter(Counter counter) {
+        return s_counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+    // High-resolution tick counter and conversion for manual spans
+    static std::uint64_t NowTicks();
+    static std::uint64_t TicksToMicros(std::uint64_t ticks);
+
+    // Record the time since startTicks
+    static void RecordSince(Stage stage, std::uint64_t startTicks) {
+        Record(stage, TicksToMicros(NowTicks() - startTicks));
+    }
+
+    // Print count, mean and p50/p90/p99/max for every stage that recorded anything, then nonzero counters
+    static void PrintSummary();
+
+    static const char* GetStageName(Stage stage);
+    static const char* GetCounterName(Counter counter);
+
+private:
+    // Merge all threads' histograms for a stage
+    static void Snapshot(Stage stage, LatencyHistogram& total);
+
+    // Append one snapshot of all stages to the dump file
+    static void WriteDump();
+
+    static void DumpThreadMain();
+
+    static std::atomic<std::uint64_t> s_counters[static_cast<size_t>(Counter::Count)];
+    static std::string s_dumpFilePath;
+    static DWORD s_dumpIntervalMs;
+    static std::thread s_dumpThread;
+    static std::mutex s_dumpMutex;
+    static std::condition_variable s_dumpWake;
+    static bool s_stopDump;
+};
+
+// Records the lifetime of the scope as one sample for a stage
+class ScopedSpan {
+public:
+    explicit ScopedSpan(Stage stage) : m_stage(stage), m_startTicks(Instrumentation::NowTicks()) {}
+    ~ScopedSpan() { Instrumentation::RecordSince(m_stage, m_startTicks); }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    Stage m_stage;
+    std::uint64_t m_startTicks;
+};
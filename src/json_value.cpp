@@ -0,0 +1,277 @@
+#include "json_value.h"
+#include <charconv>
+#include <cstdio>
+
+// Nesting limit; these documents are a few levels deep
+constexpr int MAX_JSON_DEPTH = 64;
+
+// Recursive descent over the input; position only moves forward
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : m_text(text) {}
+
+    bool ParseDocument(JsonValue& value) {
+        if (!ParseValue(value, 0)) {
+            return false;
+        }
+        SkipWhitespace();
+        return m_pos == m_text.size();
+    }
+
+private:
+    void SkipWhitespace() {
+        while (m_pos < m_text.size() &&
+               (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\n' || m_text[m_pos] == '\r')) {
+            ++m_pos;
+        }
+    }
+
+    bool Consume(std::string_view literal) {
+        if (m_text.substr(m_pos, literal.size()) != literal) {
+            return false;
+        }
+        m_pos += literal.size();
+        return true;
+    }
+
+    bool ParseValue(JsonValue& value, int depth) {
+        if (depth > MAX_JSON_DEPTH) {
+            return false;
+        }
+        SkipWhitespace();
+        if (m_pos >= m_text.size()) {
+            return false;
+        }
+
+        switch (m_text[m_pos]) {
+            case '{': return ParseObject(value, depth);
+            case '[': return ParseArray(value, depth);
+            case '"':
+                value.m_type = JsonValue::Type::String;
+                return ParseString(value.m_string);
+            case 't':
+                value.m_type = JsonValue::Type::Bool;
+                value.m_bool = true;
+                return Consume("true");
+            case 'f':
+                value.m_type = JsonValue::Type::Bool;
+                value.m_bool = false;
+                return Consume("false");
+            case 'n':
+                value.m_type = JsonValue::Type::Null;
+                return Consume("null");
+            default:
+                return ParseNumber(value);
+        }
+    }
+
+    bool ParseObject(JsonValue& value, int depth) {
+        value.m_type = JsonValue::Type::Object;
+        ++m_pos;  // '{'
+        SkipWhitespace();
+        if (Consume("}")) {
+            return true;
+        }
+        while (true) {
+            SkipWhitespace();
+            std::string key;
+            if (m_pos >= m_text.size() || m_text[m_pos] != '"' || !ParseString(key)) {
+                return false;
+            }
+            SkipWhitespace();
+            if (!Consume(":")) {
+                return false;
+            }
+            value.m_keys.push_back(std::move(key));
+            value.m_items.emplace_back();
+            if (!ParseValue(value.m_items.back(), depth + 1)) {
+                return false;
+            }
+            SkipWhitespace();
+            if (Consume("}")) {
+                return true;
+            }
+            if (!Consume(",")) {
+                return false;
+            }
+        }
+    }
+
+    bool ParseArray(JsonValue& value, int depth) {
+        value.m_type = JsonValue::Type::Array;
+        ++m_pos;  // '['
+        SkipWhitespace();
+        if (Consume("]")) {
+            return true;
+        }
+        while (true) {
+            value.m_items.emplace_back();
+            if (!ParseValue(value.m_items.back(), depth + 1)) {
+                return false;
+            }
+            SkipWhitespace();
+            if (Consume("]")) {
+                return true;
+            }
+            if (!Consume(",")) {
+                return false;
+            }
+        }
+    }
+
+    bool ParseHex4(std::uint32_t& codePoint) {
+        if (m_pos + 4 > m_text.size()) {
+            return false;
+        }
+        auto result = std::from_chars(m_text.data() + m_pos, m_text.data() + m_pos + 4, codePoint, 16);
+        if (result.ec != std::errc() || result.ptr != m_text.data() + m_pos + 4) {
+            return false;
+        }
+        m_pos += 4;
+        return true;
+    }
+
+    static void AppendUtf8(std::string& out, std::uint32_t codePoint) {
+        if (codePoint < 0x80) {
+            out += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codePoint >> 6));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codePoint >> 12));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codePoint >> 18));
+            out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool ParseString(std::string& out) {
+        ++m_pos;  // Opening quote
+        while (m_pos < m_text.size()) {
+            char c = m_text[m_pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_text.size()) {
+                return false;
+            }
+            switch (m_text[m_pos++]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    std::uint32_t codePoint;
+                    if (!ParseHex4(codePoint)) {
+                        return false;
+                    }
+                    // Characters outside the BMP arrive as a surrogate pair
+                    if (codePoint >= 0xD800 && codePoint < 0xDC00 && Consume("\\u")) {
+                        std::uint32_t low;
+                        if (!ParseHex4(low) || low < 0xDC00 || low >= 0xE000) {
+                            return false;
+                        }
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(out, codePoint);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;  // Unterminated
+    }
+
+    bool ParseNumber(JsonValue& value) {
+        size_t start = m_pos;
+        while (m_pos < m_text.size() && std::string_view("+-0123456789.eE").find(m_text[m_pos]) != std::string_view::npos) {
+            ++m_pos;
+        }
+        if (m_pos == start) {
+            return false;
+        }
+        value.m_type = JsonValue::Type::Number;
+        auto result = std::from_chars(m_text.data() + start, m_text.data() + m_pos, value.m_number);
+        return result.ec == std::errc() && result.ptr == m_text.data() + m_pos;
+    }
+
+    std::string_view m_text;
+    size_t m_pos = 0;
+};
+
+bool JsonValue::Parse(std::string_view text, JsonValue& value) {
+    value = JsonValue();
+    JsonParser parser(text);
+    if (!parser.ParseDocument(value)) {
+        value = JsonValue();
+        return false;
+    }
+    return true;
+}
+
+void JsonValue::AppendQuoted(std::string& out, std::string_view text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+                    out += escape;
+                } else {
+                    out += c;  // UTF-8 passes through unchanged
+                }
+                break;
+        }
+    }
+    out += '"';
+}
+
+const JsonValue* JsonValue::Find(std::string_view key) const {
+    if (m_type != Type::Object) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < m_keys.size(); ++i) {
+        if (m_keys[i] == key) {
+            return &m_items[i];
+        }
+    }
+    return nullptr;
+}
+
+const JsonValue* JsonValue::At(size_t index) const {
+    return m_type == Type::Array && index < m_items.size() ? &m_items[index] : nullptr;
+}
+
+std::string JsonValue::GetString(std::string_view key, std::string_view fallback) const {
+    const JsonValue* member = Find(key);
+    return member && member->IsString() ? member->m_string : std::string(fallback);
+}
+
+double JsonValue::GetNumber(std::string_view key, double fallback) const {
+    const JsonValue* member = Find(key);
+    return member ? member->AsNumber(fallback) : fallback;
+}
+
+bool JsonValue::GetBool(std::string_view key, bool fallback) const {
+    const JsonValue* member = Find(key);
+    return member ? member->AsBool(fallback) : fallback;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal JSON document model for LLM_config.json, SECRET and the chat
+// completion responses. Parses UTF-8 (\u escapes included) into a small tree;
+// object members keep their order and lookups are linear, which is fine for
+// the handful of keys these documents have.
+class JsonValue {
+public:
+    enum class Type : std::uint8_t { Null, Bool, Number, String, Array, Object };
+
+    // Parse a whole document. Returns false (and leaves value Null) on malformed input.
+    static bool Parse(std::string_view text, JsonValue& value);
+
+    // Append text as a quoted JSON string literal
+    static void AppendQuoted(std::string& out, std::string_view text);
+
+    Type GetType() const { return m_type; }
+    bool IsNull() const { return m_type == Type::Null; }
+    bool IsString() const { return m_type == Type::String; }
+    bool IsObject() const { return m_type == Type::Object; }
+    bool IsArray() const { return m_type == Type::Array; }
+
+    // Object member by key, or nullptr (also for non-objects)
+    const JsonValue* Find(std::string_view key) const;
+
+    // Array element, or nullptr when out of range
+    const JsonValue* At(size_t index) const;
+    size_t Size() const { return m_items.size(); }
+
+    // Scalar value, or fallback when the type does not match
+    const std::string& AsString() const { return m_string; }
+    double AsNumber(double fallback = 0.0) const { return m_type == Type::Number ? m_number : fallback; }
+    bool AsBool(bool fallback = false) const { return m_type == Type::Bool ? m_bool : fallback; }
+
+    // Member shortcuts for flat config objects
+    std::string GetString(std::string_view key, std::string_view fallback = {}) const;
+    double GetNumber(std::string_view key, double fallback) const;
+    bool GetBool(std::string_view key, bool fallback) const;
+
+private:
+    friend class JsonParser;
+
+    Type m_type = Type::Null;
+    bool m_bool = false;
+    double m_number = 0.0;
+    std::string m_string;
+    std::vector<JsonValue> m_items;      // Array elements, or object member values
+    std::vector<std::string> m_keys;     // Object member names (parallel to m_items)
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <windows.h>
+#include <array>
+#include <cstddef>
+
+// Per virtual-key naming and character data, built at compile time.
+// Replaces the switch/ostringstream conversions so the keystroke path needs no allocation.
+struct KeyInfo {
+    char name[16];          // Log name ("A", "SPACE", "VK_0x5d" for unnamed keys)
+    char normal;            // Character without Shift (0 = not printable)
+    char shifted;           // Character with Shift
+    bool capsLockApplies;   // Letters: Caps Lock inverts the Shift state
+};
+
+namespace key_table_detail {
+
+constexpr void SetName(KeyInfo& info, const char* name) {
+    size_t i = 0;
+    for (; name[i] != '\0' && i < sizeof(info.name) - 1; ++i) {
+        info.name[i] = name[i];
+    }
+    info.name[i] = '\0';
+}
+
+// Fallback name for keys without one, e.g. "VK_0x5d" (same format as the old std::hex output)
+constexpr void SetHexName(KeyInfo& info, unsigned vKey) {
+    SetName(info, "VK_0x");
+    const char* digits = "0123456789abcdef";
+    size_t pos = 5;
+    if (vKey >= 0x10) {
+        info.name[pos++] = digits[(vKey >> 4) & 0xF];
+    }
+    info.name[pos++] = digits[vKey & 0xF];
+    info.name[pos] = '\0';
+}
+
+constexpr void Set(std::array<KeyInfo, 256>& table, unsigned vKey, const char* name, char normal = 0, char shifted = 0) {
+    SetName(table[vKey], name);
+    table[vKey].normal = normal;
+    table[vKey].shifted = shifted;
+}
+
+constexpr std::array<KeyInfo, 256> BuildKeyTable() {
+    std::array<KeyInfo, 256> table{};
+
+    for (unsigned vKey = 0; vKey < table.size(); ++vKey) {
+        SetHexName(table[vKey], vKey);
+    }
+
+    // Letters
+    for (unsigned i = 0; i < 26; ++i) {
+        char upper = static_cast<char>('A' + i);
+        char name[2] = { upper, '\0' };
+        Set(table, 0x41 + i, name, static_cast<char>('a' + i), upper);
+        table[0x41 + i].capsLockApplies = true;
+    }
+
+    // Numbers and their shifted symbols
+    const char* shiftedNumbers = ")!@#$%^&*(";
+    for (unsigned i = 0; i < 10; ++i) {
+        char digit = static_cast<char>('0' + i);
+        char name[2] = { digit, '\0' };
+        Set(table, 0x30 + i, name, digit, shiftedNumbers[i]);
+    }
+
+    // Special keys
+    Set(table, VK_SPACE, "SPACE", ' ', ' ');
+    Set(table, VK_RETURN, "ENTER");
+    Set(table, VK_BACK, "BACKSPACE");
+    Set(table, VK_TAB, "TAB");
+    Set(table, VK_ESCAPE, "ESC");
+    Set(table, VK_DELETE, "DELETE");
+    Set(table, VK_INSERT, "INSERT");
+    Set(table, VK_HOME, "HOME");
+    Set(table, VK_END, "END");
+    Set(table, VK_PRIOR, "PAGE_UP");
+    Set(table, VK_NEXT, "PAGE_DOWN");
+
+    // Arrow keys
+    Set(table, VK_UP, "UP_ARROW");
+    Set(table, VK_DOWN, "DOWN_ARROW");
+    Set(table, VK_LEFT, "LEFT_ARROW");
+    Set(table, VK_RIGHT, "RIGHT_ARROW");
+
+    // Modifier keys
+    Set(table, VK_SHIFT, "SHIFT");
+    Set(table, VK_CONTROL, "CTRL");
+    Set(table, VK_MENU, "ALT");
+    Set(table, VK_CAPITAL, "CAPS_LOCK");
+    Set(table, VK_LWIN, "LEFT_WIN");
+    Set(table, VK_RWIN, "RIGHT_WIN");
+
+    // Function keys
+    const char* functionKeys[12] = { "F1", "F2", "F3", "F4", "F5", "F6", "F7", "F8", "F9", "F10", "F11", "F12" };
+    for (unsigned i = 0; i < 12; ++i) {
+        Set(table, VK_F1 + i, functionKeys[i]);
+    }
+
+    // Punctuation
+    Set(table, VK_OEM_1, "SEMICOLON", ';', ':');
+    Set(table, VK_OEM_PLUS, "EQUALS", '=', '+');
+    Set(table, VK_OEM_COMMA, "COMMA", ',', '<');
+    Set(table, VK_OEM_MINUS, "MINUS", '-', '_');
+    Set(table, VK_OEM_PERIOD, "PERIOD", '.', '>');
+    Set(table, VK_OEM_2, "SLASH", '/', '?');
+    Set(table, VK_OEM_3, "BACKTICK", '`', '~');
+    Set(table, VK_OEM_4, "LEFT_BRACKET", '[', '{');
+    Set(table, VK_OEM_5, "BACKSLASH", '\\', '|');
+    Set(table, VK_OEM_6, "RIGHT_BRACKET", ']', '}');
+    Set(table, VK_OEM_7, "QUOTE", '\'', '"');
+
+    return table;
+}
+
+}  // namespace key_table_detail
+
+inline constexpr std::array<KeyInfo, 256> KEY_TABLE = key_table_detail::BuildKeyTable();
+
+static_assert(KEY_TABLE[0x41].normal == 'a' && KEY_TABLE[0x41].shifted == 'A', "Letter table mismatch");
+static_assert(KEY_TABLE[0x5D].name[5] == '5' && KEY_TABLE[0x5D].name[6] == 'd', "Unnamed keys use VK_0x<hex>");
@@ -2,12 +2,96 @@
 """
 LLM Handler for WinOpAuto
 Supports OpenAI and DeepSeek APIs with configurable settings.
+
+Hedged requests: with "hedge_provider" and/or "hedge_model" set in
+LLM_config.json, a request that the primary provider has not answered by its
+recent "hedge_percentile" latency is sent again to the hedge target. The
+first to answer (or, when streaming, to start streaming) wins and the other
+is cancelled.
 """
 
 import os
 import json
+import math
+import time
+import threading
+import collections
 import requests
-from typing import Optional, Dict, Any
+from typing import Callable, Optional, Dict, Any, List, Tuple
+
+from prompt_builder import PromptBuilder
+
+
+class LatencyStats:
+    """Recent response latencies of one provider/model (seconds), including lower bounds of lost hedge races."""
+    
+    def __init__(self, window: int = 100):
+        self._samples = collections.deque(maxlen=window)
+        self._lock = threading.Lock()
+    
+    def record(self, seconds: float):
+        with self._lock:
+            self._samples.append(seconds)
+    
+    def count(self) -> int:
+        with self._lock:
+            return len(self._samples)
+    
+    def percentile(self, p: float) -> Optional[float]:
+        """Nearest-rank percentile of the recorded samples (None without samples)."""
+        with self._lock:
+            if not self._samples:
+                return None
+            ordered = sorted(self._samples)
+        rank = max(math.ceil(p / 100.0 * len(ordered)), 1)
+        return ordered[min(rank, len(ordered)) - 1]
+
+
+class _HedgeRace:
+    """Shared state of one hedged request: the winning lane and each lane's result."""
+    
+    def __init__(self, lane_count: int):
+        self.condition = threading.Condition()
+        self.winner = None                  # Lane index, set by the first answer (or first streamed delta)
+        self.results = {}                   # Lane index -> completion text or None
+        self.cancel = [threading.Event() for _ in range(lane_count)]
+        self.in_flight = [[] for _ in range(lane_count)]  # Each lane's session and open response
+    
+    def track(self, lane: int, closable):
+        """Remember a lane's session or response so that losing the race closes it."""
+        with self.condition:
+            if not self.cancel[lane].is_set():
+                self.in_flight[lane].append(closable)
+                return
+        closable.close()
+    
+    def claim(self, lane: int) -> bool:
+        """Make lane the winner if nobody won yet; True if lane is (now) the winner."""
+        losers = []
+        with self.condition:
+            if self.winner is None:
+                self.winner = lane
+                for other, event in enumerate(self.cancel):
+                    if other != lane:
+                        event.set()
+                        losers.extend(self.in_flight[other])
+                        self.in_flight[other] = []
+                self.condition.notify_all()
+            won = self.winner == lane
+        # Closing drops the loser's connection, so it stops reading (or waiting for) its answer
+        for closable in losers:
+            try:
+                closable.close()
+            except Exception:
+                pass
+        return won
+    
+    def finish(self, lane: int, result: Optional[str]):
+        if result is not None:
+            self.claim(lane)
+        with self.condition:
+            self.results[lane] = result
+            self.condition.notify_all()
 
 class LLMHandler:
     """Handles LLM interactions with multiple providers."""
@@ -19,8 +103,27 @@ class LLMHandler:
         self.config = self._load_json_file(config_file)
         self.provider = self.config.get("provider", "openai").lower()
         
+        # Reused across requests so long-lived callers keep the TLS connection alive
+        self.session = requests.Session()
+        self._system_prompt = None
+        self._prompt_builder = None
+        
+        # Latency per "provider:model:mode", and idle sessions per hedge lane
+        self.latency_stats: Dict[str, LatencyStats] = {}
+        self._stats_lock = threading.Lock()
+        self._idle_sessions: Dict[Tuple[str, str], List[requests.Session]] = {}
+        self._hedge_target = self._resolve_hedge_target()
+        # (connect, read): the read timeout bounds the wait for each chunk, or for a whole non-streamed answer
+        self.timeout = (self.config.get("connect_timeout_ms", 5000) / 1000.0,
+                        self.config.get("read_timeout_ms", 15000) / 1000.0)
+        self.hedges_fired = 0
+        self.hedges_won = 0
+        
         print(f"[LLM] Initialized with provider: {self.provider}")
         print(f"[LLM] Using model: {self._get_model_name()}")
+        if self._hedge_target:
+            print(f"[LLM] Hedging slow requests with {self._hedge_target[0]}:{self._hedge_target[1]} "
+                  f"after the p{self.config.get('hedge_percentile', 95)} latency")
     
     def _load_json_file(self, filename: str) -> Dict[str, Any]:
         """Load configuration from JSON file."""
@@ -57,7 +160,10 @@ class LLMHandler:
             raise Exception(f"Failed to load {filename}: {e}")
     
     def _get_system_prompt(self) -> str:
-        """Get system prompt from file."""
+        """Get system prompt from file (loaded once per handler)."""
+        if self._system_prompt is not None:
+            return self._system_prompt
+        
         system_prompt_file = self.config.get("system_prompt_file", "system_prompt.md")
         content = self._load_markdown_file(system_prompt_file)
         
@@ -74,34 +180,256 @@ class LLMHandler:
             plain_lines.append(line)
         
         # Join lines and clean up
-        return '\n'.join(plain_lines).strip()
+        self._system_prompt = '\n'.join(plain_lines).strip()
+        return self._system_prompt
     
+    def _get_prompt_builder(self) -> PromptBuilder:
+        """Message builder around the system prompt and user template (created once per handler)."""
+        if self._prompt_builder is None:
+            self._prompt_builder = PromptBuilder(
+                self._get_system_prompt(),
+                self.config.get("user_prompt_template", 
+                    "The user's input sequence: '{input}'\n\nNext keyboard input:"),
+                int(self.config.get("context_token_budget", 1024)))
+            print(f"[LLM] System prompt: ~{self._prompt_builder.system_tokens} tokens, "
+                  f"context budget: {self.config.get('context_token_budget', 1024)} tokens")
+        return self._prompt_builder
 
     
-    def _get_model_name(self) -> str:
-        """Get the appropriate model name for the current provider."""
-        if self.provider == "openai":
+    def _get_model_name(self, provider: Optional[str] = None) -> str:
+        """Get the appropriate model name for a provider (default: the current one)."""
+        provider = provider or self.provider
+        if provider == "openai":
             return self.config.get("openai_model", "gpt-3.5-turbo")
-        elif self.provider == "deepseek":
+        elif provider == "deepseek":
             return self.config.get("deepseek_model", "deepseek-chat")
         return "unknown"
     
-    def generate_response(self, input_sequence: str) -> Optional[str]:
-        """Generate response using configured LLM provider."""
-        if self.provider == "openai":
-            return self._openai_request(input_sequence)
-        elif self.provider == "deepseek":
-            return self._deepseek_request(input_sequence)
-        else:
+    def _resolve_hedge_target(self) -> Optional[Tuple[str, str]]:
+        """(provider, model) to hedge with, or None when hedging is off or unusable."""
+        provider = (self.config.get("hedge_provider") or "").lower()
+        model = self.config.get("hedge_model") or ""
+        if not provider and not model:
+            return None
+        provider = provider or self.provider
+        model = model or self._get_model_name(provider)
+        if provider not in ("openai", "deepseek"):
+            print(f"[WARNING] Unsupported hedge provider: {provider}, hedging disabled")
+            return None
+        if not self.secrets.get(f"{provider}_api_key"):
+            print(f"[WARNING] {provider}_api_key not found in SECRET file, hedging disabled")
+            return None
+        if (provider, model) == (self.provider, self._get_model_name()):
+            return None
+        return provider, model
+    
+    def generate_response(self, input_sequence: str,
+                          on_delta: Optional[Callable[[str], None]] = None) -> Optional[str]:
+        """Generate response using configured LLM provider.
+        
+        With on_delta (and "stream" enabled in the config) the response is
+        streamed and on_delta gets each piece of text as it arrives; the full
+        text is still returned at the end.
+        """
+        if on_delta is not None and not self.config.get("stream", True):
+            on_delta = None
+        if self.provider not in ("openai", "deepseek"):
             raise ValueError(f"Unsupported LLM provider: {self.provider}")
+        # Built once per request (the context tail is counted incrementally), shared by hedge lanes
+        messages = self._get_prompt_builder().build(input_sequence)
+        if self.debug:
+            print(f"[DEBUG] Context tail: ~{self._prompt_builder.context_tokens()} tokens")
+        if self._hedge_target:
+            return self._hedged_request(messages, on_delta)
+        return self._timed_request(self.provider, self._get_model_name(), messages, on_delta, self.session)
+    
+    def _stats_for(self, provider: str, model: str, streaming: bool) -> LatencyStats:
+        # Streams are judged by time to the first delta, full responses by total time
+        key = f"{provider}:{model}:{'stream' if streaming else 'full'}"
+        with self._stats_lock:
+            stats = self.latency_stats.get(key)
+            if stats is None:
+                stats = self.latency_stats[key] = LatencyStats(int(self.config.get("hedge_latency_window", 100)))
+            return stats
+    
+    def _timed_request(self, provider: str, model: str, messages: List[Dict[str, str]],
+                       on_delta: Optional[Callable[[str], None]], session: requests.Session,
+                       cancel: Optional[threading.Event] = None) -> Optional[str]:
+        """One request to provider/model, recording its latency when it succeeds or loses a hedge race."""
+        start = time.perf_counter()
+        first_delta = []
+        
+        def timed_delta(delta: str):
+            if not first_delta:
+                first_delta.append(time.perf_counter() - start)
+            on_delta(delta)
+        
+        request = self._openai_request if provider == "openai" else self._deepseek_request
+        result = request(messages, timed_delta if on_delta is not None else None, model, session, cancel)
+        # A lane cancelled by the other one's answer was at least this slow; dropping it would
+        # leave only fast samples and keep shrinking the hedge delay
+        if result is not None or (cancel and cancel.is_set()):
+            latency = first_delta[0] if first_delta else time.perf_counter() - start
+            self._stats_for(provider, model, on_delta is not None).record(latency)
+        return result
+    
+    def warm_up(self) -> bool:
+        """Open the TLS connection(s) ahead of the first request with a GET of the model list."""
+        # Hedged requests take each lane's session from the pool, so that is what gets warmed
+        if self._hedge_target:
+            lanes = [(self.provider, self._get_model_name()), self._hedge_target]
+            sessions = [self._take_session(lane) for lane in lanes]
+        else:
+            lanes = [None]
+            sessions = [self.session]
+        connected = True
+        for lane, session in zip(lanes, sessions):
+            provider = lane[0] if lane else self.provider
+            host = "api.openai.com" if provider == "openai" else "api.deepseek.com"
+            start = time.perf_counter()
+            try:
+                # Any status will do: the point is the pooled connection, not the answer
+                session.get(f"https://{host}/v1/models", timeout=5,
+                            headers={"Authorization": f"Bearer {self.secrets.get(f'{provider}_api_key', '')}"}).close()
+                print(f"[LLM] {provider} connection warmed up in {(time.perf_counter() - start) * 1000:.0f}ms")
+            except requests.exceptions.RequestException as e:
+                print(f"[WARNING] Could not pre-connect to {provider}: {e}")
+                connected = False
+            if lane:
+                self._return_session(lane, session)
+        return connected
+    
+    def hedge_delay(self, streaming: bool) -> float:
+        """Seconds to wait for the primary before hedging: its recent percentile latency."""
+        stats = self._stats_for(self.provider, self._get_model_name(), streaming)
+        minimum = self.config.get("hedge_min_delay_ms", 300) / 1000.0
+        if stats.count() < self.config.get("hedge_min_samples", 10):
+            return max(self.config.get("hedge_default_delay_ms", 2000) / 1000.0, minimum)
+        return max(stats.percentile(self.config.get("hedge_percentile", 95)), minimum)
+    
+    def _take_session(self, lane: Tuple[str, str]) -> requests.Session:
+        # A cancelled lane may still be waiting on its response, so sessions are never shared
+        with self._stats_lock:
+            idle = self._idle_sessions.setdefault(lane, [])
+            return idle.pop() if idle else requests.Session()
+    
+    def _return_session(self, lane: Tuple[str, str], session: requests.Session):
+        with self._stats_lock:
+            self._idle_sessions.setdefault(lane, []).append(session)
+    
+    def _hedged_request(self, messages: List[Dict[str, str]], on_delta: Optional[Callable[[str], None]]) -> Optional[str]:
+        """Race the primary against the hedge target once the primary is slower than usual."""
+        lanes = [(self.provider, self._get_model_name()), self._hedge_target]
+        race = _HedgeRace(len(lanes))
+        
+        def run_lane(index: int):
+            provider, model = lanes[index]
+            
+            def lane_delta(delta: str):
+                # Streaming: the first lane to produce text wins; the loser's text is dropped
+                if race.claim(index):
+                    on_delta(delta)
+            
+            session = self._take_session(lanes[index])
+            # The response hook runs once the headers arrive, before the body is read
+            session.hooks["response"] = [lambda response, *args, **kwargs: race.track(index, response)]
+            race.track(index, session)
+            try:
+                result = self._timed_request(provider, model, messages,
+                                             lane_delta if on_delta is not None else None,
+                                             session, race.cancel[index])
+            except Exception as e:
+                if not race.cancel[index].is_set():
+                    print(f"[ERROR] {provider}:{model} request failed: {e}")
+                result = None
+            finally:
+                session.hooks["response"] = []
+                # A losing lane's session was closed with its connection
+                if not race.cancel[index].is_set():
+                    self._return_session(lanes[index], session)
+            race.finish(index, result)
+        
+        threading.Thread(target=run_lane, args=(0,), daemon=True).start()
+        deadline = time.monotonic() + self.hedge_delay(on_delta is not None)
+        with race.condition:
+            # A primary that fails early is hedged right away
+            race.condition.wait_for(lambda: race.winner is not None or 0 in race.results,
+                                    max(deadline - time.monotonic(), 0))
+            hedge = race.winner is None
+        
+        if hedge:
+            with self._stats_lock:
+                self.hedges_fired += 1
+            print(f"[HEDGE] {lanes[0][0]}:{lanes[0][1]} has not answered, asking {lanes[1][0]}:{lanes[1][1]}")
+            threading.Thread(target=run_lane, args=(1,), daemon=True).start()
+        started = 2 if hedge else 1
+        
+        with race.condition:
+            race.condition.wait_for(lambda: (race.winner is not None and race.winner in race.results)
+                                    or len(race.results) == started)
+            winner = race.winner
+        if winner is None:
+            return None
+        if winner == 1:
+            with self._stats_lock:
+                self.hedges_won += 1
+            print(f"[HEDGE] {lanes[1][0]}:{lanes[1][1]} answered first")
+        return race.results[winner]
     
-    def _openai_request(self, input_sequence: str) -> Optional[str]:
-        """Make request to OpenAI API."""
+    def hedge_stats(self) -> Dict[str, Any]:
+        """Hedges fired/won and the per-lane latency percentiles (for the worker's exit summary)."""
+        latencies = {}
+        with self._stats_lock:
+            stats = dict(self.latency_stats)
+            fired, won = self.hedges_fired, self.hedges_won
+        for key, lane_stats in stats.items():
+            p50, p99 = lane_stats.percentile(50), lane_stats.percentile(99)
+            latencies[key] = {"count": lane_stats.count(),
+                              "p50_ms": round(p50 * 1000) if p50 is not None else None,
+                              "p99_ms": round(p99 * 1000) if p99 is not None else None}
+        return {"fired": fired, "won": won, "latency": latencies}
+    
+    def _read_event_stream(self, response, on_delta: Callable[[str], None],
+                           cancel: Optional[threading.Event] = None) -> Optional[str]:
+        """Collect a chat completion streamed as server-sent events, forwarding each delta.
+        
+        Returns None if cancel is set while streaming (the winning lane closes the connection).
+        """
+        parts = []
+        # iter_lines yields whole lines, so a frame split across TCP reads is reassembled here
+        for line in response.iter_lines():
+            if cancel is not None and cancel.is_set():
+                response.close()
+                return None
+            if not line.startswith(b"data:"):
+                continue  # Blank separators, comments and other SSE fields
+            payload = line[5:].strip()
+            if payload == b"[DONE]":
+                break
+            chunk = json.loads(payload)
+            choices = chunk.get("choices") or []
+            if not choices:
+                continue
+            delta = (choices[0].get("delta") or {}).get("content")
+            if delta:
+                parts.append(delta)
+                on_delta(delta)
+        # Closed by the winning lane between two reads
+        if cancel is not None and cancel.is_set():
+            return None
+        return "".join(parts)
+    
+    def _openai_request(self, messages: List[Dict[str, str]],
+                        on_delta: Optional[Callable[[str], None]] = None,
+                        model: Optional[str] = None, session: Optional[requests.Session] = None,
+                        cancel: Optional[threading.Event] = None) -> Optional[str]:
+        """Make request to OpenAI API (model and session default to the configured ones)."""
         api_key = self.secrets.get("openai_api_key")
         if not api_key:
             raise ValueError("OpenAI API key not found in SECRET file")
         
-        model = self.config.get("openai_model", "gpt-3.5-turbo")
+        model = model or self.config.get("openai_model", "gpt-3.5-turbo")
+        session = session or self.session
         
         url = "https://api.openai.com/v1/chat/completions"
         
@@ -110,8 +438,6 @@ class LLMHandler:
             "Content-Type": "application/json"
         }
         
-        system_prompt = self._get_system_prompt()
-        user_prompt = self._build_user_prompt(input_sequence)
         
         # Reasoning models (o3, o1 series) use different parameter names
         reasoning_models = ["o3", "o3-mini", "o1", "o1-mini", "o1-preview"]
@@ -119,10 +445,7 @@ class LLMHandler:
         
         data = {
             "model": model,
-            "messages": [
-                {"role": "system", "content": system_prompt},
-                {"role": "user", "content": user_prompt}
-            ]
+            "messages": messages
         }
         
         # Use appropriate token parameter based on model type
@@ -142,6 +465,9 @@ class LLMHandler:
         if not is_reasoning_model:
             data["temperature"] = self.config.get("temperature", 0.7)
         
+        if on_delta is not None:
+            data["stream"] = True
+        
         try:
             if is_reasoning_model:
                 print(f"[OPENAI] Making request to reasoning model {model} (using max_completion_tokens)...")
@@ -152,7 +478,8 @@ class LLMHandler:
             if self.debug:
                 print(f"[DEBUG] Request data: {data}")
             
-            response = requests.post(url, headers=headers, json=data, timeout=30)
+            response = session.post(url, headers=headers, json=data, timeout=self.timeout,
+                                    stream=on_delta is not None)
             
             # Debug: Print response status
             if self.debug:
@@ -175,6 +502,14 @@ class LLMHandler:
             
             response.raise_for_status()
             
+            if on_delta is not None:
+                content = self._read_event_stream(response, on_delta, cancel)
+                if content is None:
+                    print(f"[OPENAI] Stream from {model} cancelled")
+                    return None
+                print(f"[OPENAI] Stream finished: {len(content)} characters")
+                return content
+            
             result = response.json()
             
             # Debug: Print the full response
@@ -213,6 +548,9 @@ class LLMHandler:
             return content
             
         except requests.exceptions.RequestException as e:
+            if cancel is not None and cancel.is_set():
+                print(f"[OPENAI] Request to {model} cancelled")
+                return None
             print(f"[ERROR] OpenAI API request failed: {e}")
             if hasattr(e, 'response') and e.response is not None:
                 try:
@@ -222,17 +560,24 @@ class LLMHandler:
                 except:
                     pass
             return None
-        except (KeyError, IndexError) as e:
+        except (KeyError, IndexError, ValueError) as e:
+            if cancel is not None and cancel.is_set():
+                print(f"[OPENAI] Request to {model} cancelled")
+                return None
             print(f"[ERROR] Invalid OpenAI API response format: {e}")
             return None
     
-    def _deepseek_request(self, input_sequence: str) -> Optional[str]:
-        """Make request to DeepSeek API."""
+    def _deepseek_request(self, messages: List[Dict[str, str]],
+                          on_delta: Optional[Callable[[str], None]] = None,
+                          model: Optional[str] = None, session: Optional[requests.Session] = None,
+                          cancel: Optional[threading.Event] = None) -> Optional[str]:
+        """Make request to DeepSeek API (model and session default to the configured ones)."""
         api_key = self.secrets.get("deepseek_api_key")
         if not api_key:
             raise ValueError("DeepSeek API key not found in SECRET file")
         
-        model = self.config.get("deepseek_model", "deepseek-chat")
+        model = model or self.config.get("deepseek_model", "deepseek-chat")
+        session = session or self.session
         url = "https://api.deepseek.com/v1/chat/completions"
         
         headers = {
@@ -240,24 +585,30 @@ class LLMHandler:
             "Content-Type": "application/json"
         }
         
-        system_prompt = self._get_system_prompt()
-        user_prompt = self._build_user_prompt(input_sequence)
         
         data = {
             "model": model,
-            "messages": [
-                {"role": "system", "content": system_prompt},
-                {"role": "user", "content": user_prompt}
-            ],
+            "messages": messages,
             "max_tokens": self.config.get("max_tokens", 100),
             "temperature": self.config.get("temperature", 0.7)
         }
+        if on_delta is not None:
+            data["stream"] = True
         
         try:
             print(f"[DEEPSEEK] Making request to {model}...")
-            response = requests.post(url, headers=headers, json=data, timeout=30)
+            response = session.post(url, headers=headers, json=data, timeout=self.timeout,
+                                    stream=on_delta is not None)
             response.raise_for_status()
             
+            if on_delta is not None:
+                content = self._read_event_stream(response, on_delta, cancel)
+                if content is None:
+                    print(f"[DEEPSEEK] Stream from {model} cancelled")
+                    return None
+                print(f"[DEEPSEEK] Stream finished: {len(content)} characters")
+                return content
+            
             result = response.json()
             content = result["choices"][0]["message"]["content"]
             
@@ -265,18 +616,21 @@ class LLMHandler:
             return content
             
         except requests.exceptions.RequestException as e:
+            if cancel is not None and cancel.is_set():
+                print(f"[DEEPSEEK] Request to {model} cancelled")
+                return None
             print(f"[ERROR] DeepSeek API request failed: {e}")
             return None
-        except (KeyError, IndexError) as e:
+        except (KeyError, IndexError, ValueError) as e:
+            if cancel is not None and cancel.is_set():
+                print(f"[DEEPSEEK] Request to {model} cancelled")
+                return None
             print(f"[ERROR] Invalid DeepSeek API response format: {e}")
             return None
     
     def _build_user_prompt(self, input_sequence: str) -> str:
-        """Build user prompt for LLM based on input sequence."""
-        user_prompt_template = self.config.get("user_prompt_template", 
-            "The user's input sequence: '{input}'\n\nNext keyboard input:")
-        
-        return user_prompt_template.format(input=input_sequence)
+        """Build user prompt for LLM based on input sequence (context cut to the token budget)."""
+        return self._get_prompt_builder().build(input_sequence)[-1]["content"]
     
     def _build_prompt(self, input_sequence: str) -> str:
         """Build prompt for LLM based on input sequence (deprecated, use _build_user_prompt)."""
@@ -3,76 +3,30 @@
 #include <iomanip>
 #include <chrono>
 #include <cstdint>
-#include <vector>
+#include <cstring>
+#include "input_pipeline.h"
 #include "special_keys.h"
 #include "input_injection.h"
 #include "event_logger.h"
 #include "suggestion_overlay.h"
+#include "completion_client.h"
+#include "native_llm_client.h"
+#include "suggestion_service.h"
+#include "typed_context.h"
+#include "shared_journal.h"
+#include "diagnostics.h"
+#include "instrumentation.h"
+#include "capture_thread.h"
+#include "startup_timeline.h"
 
 constexpr UINT WM_QUIT_APP = WM_USER + 1;
 
-// Event data structures
-enum class EventType {
-    KEYBOARD,
-    MOUSE
-};
-
-struct KeyboardEventData {
-    USHORT vKey;
-    USHORT scanCode;
-    USHORT flags;
-    bool isKeyUp;
-    
-    KeyboardEventData() = default;
-    KeyboardEventData(USHORT vk, USHORT sc, USHORT f, bool keyUp)
-        : vKey(vk), scanCode(sc), flags(f), isKeyUp(keyUp) {}
-};
-
-struct MouseEventData {
-    enum Type {
-        LEFT_DOWN, LEFT_UP, RIGHT_DOWN, RIGHT_UP, 
-        MIDDLE_DOWN, MIDDLE_UP, WHEEL, MOVE
-    };
-    
-    Type eventType;
-    LONG deltaX;
-    LONG deltaY;
-    short wheelData;  // Only used for wheel events
-    
-    MouseEventData() = default;
-    MouseEventData(Type type, LONG dx, LONG dy, short wheel = 0)
-        : eventType(type), deltaX(dx), deltaY(dy), wheelData(wheel) {}
-};
-
-struct InputEvent {
-    std::uint64_t timestamp;
-    POINT cursorPosition;
-    EventType type;
-    
-    // Union to hold either keyboard or mouse data
-    union {
-        KeyboardEventData keyboardData;
-        MouseEventData mouseData;
-    };
-    
-    // Constructor for keyboard events
-    InputEvent(std::uint64_t ts, POINT cursor, const KeyboardEventData& kbData)
-        : timestamp(ts), cursorPosition(cursor), type(EventType::KEYBOARD), keyboardData(kbData) {}
-        
-    // Constructor for mouse events
-    InputEvent(std::uint64_t ts, POINT cursor, const MouseEventData& mData)
-        : timestamp(ts), cursorPosition(cursor), type(EventType::MOUSE), mouseData(mData) {}
-        
-    // Destructor (needed for union)
-    ~InputEvent() {}
-};
-
-
+// Posted once before capture starts: UI pieces not needed for capture are created from the message loop
+constexpr UINT WM_DEFERRED_INIT = WM_USER + 5;
 
 // Global variables
 HWND g_hWnd = nullptr;
 bool g_running = true;
-std::vector<InputEvent> g_eventHistory;
 
 // Get high-resolution timestamp
 std::uint64_t GetTimestampMicros() {
@@ -81,248 +35,58 @@ std::uint64_t GetTimestampMicros() {
     return std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
 }
 
-// Helper functions for event storage
-const std::vector<InputEvent>& GetEventHistory() {
-    return g_eventHistory;
-}
-
-void ClearEventHistory() {
-    g_eventHistory.clear();
-}
-
-size_t GetEventCount() {
-    return g_eventHistory.size();
-}
-
-// Convert mouse event type to string
-const char* MouseEventTypeToString(MouseEventData::Type type) {
-    switch (type) {
-        case MouseEventData::LEFT_DOWN: return "LEFT_DOWN";
-        case MouseEventData::LEFT_UP: return "LEFT_UP";
-        case MouseEventData::RIGHT_DOWN: return "RIGHT_DOWN";
-        case MouseEventData::RIGHT_UP: return "RIGHT_UP";
-        case MouseEventData::MIDDLE_DOWN: return "MIDDLE_DOWN";
-        case MouseEventData::MIDDLE_UP: return "MIDDLE_UP";
-        case MouseEventData::WHEEL: return "WHEEL";
-        case MouseEventData::MOVE: return "MOVE";
-        default: return "UNKNOWN";
-    }
-}
-
-// Legacy functions removed - now using EventLogger
-
-// Helper function to store event in memory and log using new EventLogger
-void StoreEvent(std::uint64_t timestamp, POINT cursorPos, const KeyboardEventData& kbData) {
-    InputEvent event(timestamp, cursorPos, kbData);
-    g_eventHistory.emplace_back(event);
-    
-    // Use new EventLogger
-    EventLogger::LogKeyboardEvent(timestamp, kbData.vKey, kbData.isKeyUp);
-}
-
-void StoreEvent(std::uint64_t timestamp, POINT cursorPos, const MouseEventData& mouseData) {
-    InputEvent event(timestamp, cursorPos, mouseData);
-    g_eventHistory.emplace_back(event);
-    
-    // Use new EventLogger for mouse clicks only
-    std::string buttonName;
-    bool isButtonUp = false;
-    bool shouldLog = false;
-    
-    switch (mouseData.eventType) {
-        case MouseEventData::LEFT_DOWN:
-            buttonName = "left";
-            isButtonUp = false;
-            shouldLog = true;
-            break;
-        case MouseEventData::LEFT_UP:
-            buttonName = "left";
-            isButtonUp = true;
-            shouldLog = true;
-            break;
-        case MouseEventData::RIGHT_DOWN:
-            buttonName = "right";
-            isButtonUp = false;
-            shouldLog = true;
-            break;
-        case MouseEventData::RIGHT_UP:
-            buttonName = "right";
-            isButtonUp = true;
-            shouldLog = true;
-            break;
-        case MouseEventData::MIDDLE_DOWN:
-            buttonName = "middle";
-            isButtonUp = false;
-            shouldLog = true;
-            break;
-        case MouseEventData::MIDDLE_UP:
-            buttonName = "middle";
-            isButtonUp = true;
-            shouldLog = true;
-            break;
-        // Skip WHEEL and MOVE events for simplified logging
-        default:
-            shouldLog = false;
-            break;
-    }
-    
-    if (shouldLog) {
-        EventLogger::LogMouseButtonEvent(timestamp, buttonName, isButtonUp, cursorPos);
+// Handle one raw input event published by the capture thread
+bool ProcessCapturedInput(const RAWINPUT& raw, std::uint64_t timestamp, POINT cursorPos) {
+    // Check for ESC key to exit
+    if (!InputPipeline::ProcessInput(raw, timestamp, cursorPos)) {
+        std::cout << "[" << std::setw(10) << timestamp << "us] ESC pressed - shutting down\n";
+        g_running = false;
+        PostMessage(g_hWnd, WM_QUIT_APP, 0, 0);
+        return false;
     }
+    return true;
 }
 
-
-
-// Process raw input data
-void ProcessRawInput(HRAWINPUT hRawInput) {
-    UINT dwSize = 0;
-    
-    // Get required buffer size
-    GetRawInputData(hRawInput, RID_INPUT, nullptr, &dwSize, sizeof(RAWINPUTHEADER));
-    if (dwSize == 0) return;
-    
-    // Allocate buffer and get data
-    auto lpb = std::make_unique<BYTE[]>(dwSize);
-    if (GetRawInputData(hRawInput, RID_INPUT, lpb.get(), &dwSize, sizeof(RAWINPUTHEADER)) != dwSize) {
-        return;
-    }
-    
-    RAWINPUT* raw = reinterpret_cast<RAWINPUT*>(lpb.get());
-    std::uint64_t timestamp = GetTimestampMicros();
-    
-    // Get current cursor position
-    POINT cursorPos;
-    GetCursorPos(&cursorPos);
-    
-    if (raw->header.dwType == RIM_TYPEKEYBOARD) {
-        // Keyboard input
-        RAWKEYBOARD& kb = raw->data.keyboard;
-        bool isKeyUp = (kb.Flags & RI_KEY_BREAK) != 0;
-        
-        // Store keyboard event in memory
-        KeyboardEventData kbData(kb.VKey, kb.MakeCode, kb.Flags, isKeyUp);
-        StoreEvent(timestamp, cursorPos, kbData);
-        
-        // Check for ESC key to exit
-        if (kb.VKey == VK_ESCAPE && !isKeyUp) {
-            std::cout << "[" << std::setw(10) << timestamp << "us] ESC pressed - shutting down\n";
-            g_running = false;
-            PostMessage(g_hWnd, WM_QUIT_APP, 0, 0);
-            return;
-        }
-        
-        // Hide suggestion overlay on any key press (except when Left Ctrl is generating suggestion)
-        if (!isKeyUp) { // Only on key down events
-            bool isLeftCtrl = (kb.VKey == VK_CONTROL && (kb.Flags & RI_KEY_E0) == 0);
-            bool isRightCtrl = (kb.VKey == VK_CONTROL && (kb.Flags & RI_KEY_E0) != 0);
-            
-            // Hide overlay for any key except Left Ctrl (which shows suggestions)
-            // Right Ctrl will be handled by the special key handler
-            if (!isLeftCtrl) {
-                SuggestionOverlay::HideSuggestion();
-            }
+// Window procedure
+LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    switch (message) {
+    case WM_CAPTURED_INPUT:
+        if (g_running) {
+            CaptureThread::DrainInput(ProcessCapturedInput);
         }
+        return 0;
         
-        // Process special key events
-        bool hookTriggered = SpecialKeyHandler::ProcessSpecialKeyEvent(kb.VKey, kb.Flags, isKeyUp, timestamp, cursorPos);
-        
-        // If this is not a special key and it's a key down event, notify the special key handler
-        // (so it can track key combinations like Ctrl+A)
-        if (!hookTriggered && !isKeyUp) {
-            SpecialKeyHandler::NotifyRegularKeyPressed(kb.VKey);
-        }
+    case WM_QUIT_APP:
+        PostQuitMessage(0);
+        return 0;
         
-        // Normal console output (skip if hook was triggered to avoid spam)
-        if (!hookTriggered) {
-            const char* action = isKeyUp ? "UP" : "DOWN";
-            std::cout << "[" << std::setw(10) << timestamp << "us] KB: VK=0x" 
-                      << std::hex << std::setw(2) << std::setfill('0') << kb.VKey
-                      << " SC=0x" << std::setw(2) << kb.MakeCode
-                      << " " << action;
-            if (SpecialKeyHandler::IsSpecialKey(kb.VKey)) {
-                std::cout << " (" << SpecialKeyHandler::GetKeyName(kb.VKey) << ")";
-            }
-            std::cout << " Cursor=(" << std::dec << cursorPos.x << "," << cursorPos.y << ")\n";
-        }
+    case WM_DEFERRED_INIT: {
+        StartupStep step("SuggestionOverlay");
+        SuggestionOverlay::Initialize();
+        return 0;
     }
-    else if (raw->header.dwType == RIM_TYPEMOUSE) {
-        // Mouse input
-        RAWMOUSE& mouse = raw->data.mouse;
         
-        // Store mouse event in memory and handle console output
-        bool eventStored = false;
+    case WM_INPUTLANGCHANGE:
+        InputInjector::InvalidateLayoutTable();
+        return DefWindowProc(hWnd, message, wParam, lParam);
         
-        // Button events
-        if (mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_DOWN) {
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::LEFT_DOWN, mouse.lLastX, mouse.lLastY));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: L_DOWN";
-            eventStored = true;
-        }
-        else if (mouse.usButtonFlags & RI_MOUSE_LEFT_BUTTON_UP) {
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::LEFT_UP, mouse.lLastX, mouse.lLastY));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: L_UP";
-            eventStored = true;
-        }
-        else if (mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_DOWN) {
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::RIGHT_DOWN, mouse.lLastX, mouse.lLastY));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: R_DOWN";
-            eventStored = true;
-        }
-        else if (mouse.usButtonFlags & RI_MOUSE_RIGHT_BUTTON_UP) {
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::RIGHT_UP, mouse.lLastX, mouse.lLastY));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: R_UP";
-            eventStored = true;
+    case WM_TIMER:
+        if (wParam == PREFETCH_TIMER_ID) {
+            InputPipeline::OnPrefetchTimer(GetTimestampMicros());
+            return 0;
         }
-        else if (mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_DOWN) {
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::MIDDLE_DOWN, mouse.lLastX, mouse.lLastY));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: M_DOWN";
-            eventStored = true;
-        }
-        else if (mouse.usButtonFlags & RI_MOUSE_MIDDLE_BUTTON_UP) {
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::MIDDLE_UP, mouse.lLastX, mouse.lLastY));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: M_UP";
-            eventStored = true;
-        }
-        /*
-        else if (mouse.usButtonFlags & RI_MOUSE_WHEEL) {
-            short wheelDelta = static_cast<short>(mouse.usButtonData);
-            StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::WHEEL, mouse.lLastX, mouse.lLastY, wheelDelta));
-            std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: WHEEL=" << wheelDelta;
-            eventStored = true;
-        }
-        else if (mouse.lLastX != 0 || mouse.lLastY != 0) {
-            // Movement only (don't spam for every tiny movement)
-            static int moveCount = 0;
-            if (++moveCount % 10 == 0) {  // Log every 10th movement
-                StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::MOVE, mouse.lLastX, mouse.lLastY));
-                std::cout << "[" << std::setw(10) << timestamp << "us] MOUSE: MOVE";
-                eventStored = true;
-            } else {
-                // Still store the event even if we don't log it to console
-                StoreEvent(timestamp, cursorPos, MouseEventData(MouseEventData::MOVE, mouse.lLastX, mouse.lLastY));
-                return;  // Skip console logging this movement
-            }
-        }*/
-        else {
-            return;  // No relevant mouse event
+        if (wParam == MOTION_FLUSH_TIMER_ID) {
+            InputPipeline::OnMotionFlushTimer(GetTimestampMicros());
+            return 0;
         }
+        return DefWindowProc(hWnd, message, wParam, lParam);
         
-        if (eventStored && (mouse.usButtonFlags || mouse.lLastX != 0 || mouse.lLastY != 0)) {
-            std::cout << " Delta=(" << mouse.lLastX << "," << mouse.lLastY << ")"
-                      << " Cursor=(" << cursorPos.x << "," << cursorPos.y << ")\n";
-        }
-    }
-}
-
-// Window procedure
-LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
-    switch (message) {
-    case WM_INPUT:
-        ProcessRawInput(reinterpret_cast<HRAWINPUT>(lParam));
+    case WM_SUGGESTION_READY:
+        SpecialKeyHandler::OnSuggestionReady(static_cast<std::uint32_t>(wParam));
         return 0;
         
-    case WM_QUIT_APP:
-        PostQuitMessage(0);
+    case WM_SUGGESTION_PARTIAL:
+        SpecialKeyHandler::OnSuggestionPartial(static_cast<std::uint32_t>(wParam));
         return 0;
         
     default:
@@ -330,38 +94,21 @@ LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPara
     }
 }
 
-// Register for raw input
-bool RegisterRawInputDevices(HWND hWnd) {
-    RAWINPUTDEVICE rid[2];
-    
-    // Register for keyboard input (0x01, 0x06)
-    rid[0].usUsagePage = 0x01;    // Generic Desktop
-    rid[0].usUsage = 0x06;        // Keyboard
-    rid[0].dwFlags = RIDEV_INPUTSINK;  // Receive input even when not foreground
-    rid[0].hwndTarget = hWnd;
-    
-    // Register for mouse input (0x01, 0x02)
-    rid[1].usUsagePage = 0x01;    // Generic Desktop
-    rid[1].usUsage = 0x02;        // Mouse
-    rid[1].dwFlags = RIDEV_INPUTSINK;  // Receive input even when not foreground
-    rid[1].hwndTarget = hWnd;
-    
-    return RegisterRawInputDevices(rid, 2, sizeof(RAWINPUTDEVICE));
-}
-
 // Function to demonstrate accessing stored event data
 void PrintStoredEventsSummary() {
     std::cout << "\n=== STORED EVENTS SUMMARY ===\n";
-    std::cout << "Total events stored: " << g_eventHistory.size() << "\n";
+    const EventHistory& eventHistory = InputPipeline::GetEventHistory();
+    std::cout << "Total events stored: " << eventHistory.size()
+              << " (" << eventHistory.TotalRecorded() << " recorded, capacity " << eventHistory.capacity() << ")\n";
     
     size_t keyboardEvents = 0, mouseEvents = 0;
     size_t specialKeyPresses = 0;
     
-    for (const auto& event : g_eventHistory) {
+    for (const auto& event : eventHistory) {
         if (event.type == EventType::KEYBOARD) {
             keyboardEvents++;
             // Check if this was a special key
-            if (SpecialKeyHandler::IsSpecialKey(event.keyboardData.vKey)) {
+            if (SpecialKeyHandler::IsSpecialKey(event.code)) {
                 specialKeyPresses++;
             }
         } else {
@@ -374,19 +121,17 @@ void PrintStoredEventsSummary() {
     std::cout << "Special key events (Ctrl/Shift/Alt): " << specialKeyPresses << "\n";
     
     // Show last few events as example
-    if (!g_eventHistory.empty()) {
+    if (!eventHistory.empty()) {
         std::cout << "\nLast 5 events:\n";
-        size_t start = g_eventHistory.size() > 5 ? g_eventHistory.size() - 5 : 0;
-        for (size_t i = start; i < g_eventHistory.size(); ++i) {
-            const auto& event = g_eventHistory[i];
+        for (const auto& event : eventHistory.Last(5)) {
             std::cout << "  [" << event.timestamp << "us] ";
             
             if (event.type == EventType::KEYBOARD) {
-                const auto& kb = event.keyboardData;
+                const auto kb = event.GetKeyboardData();
                 std::cout << "KB: VK=0x" << std::hex << kb.vKey << std::dec 
                           << " " << (kb.isKeyUp ? "UP" : "DOWN");
             } else {
-                const auto& mouse = event.mouseData;
+                const auto mouse = event.GetMouseData();
                 std::cout << "MOUSE: ";
                 switch (mouse.eventType) {
                     case MouseEventData::LEFT_DOWN: std::cout << "L_DOWN"; break;
@@ -400,7 +145,7 @@ void PrintStoredEventsSummary() {
                 }
                 std::cout << " Delta=(" << mouse.deltaX << "," << mouse.deltaY << ")";
             }
-            std::cout << " Cursor=(" << event.cursorPosition.x << "," << event.cursorPosition.y << ")\n";
+            std::cout << " Cursor=(" << event.cursorX << "," << event.cursorY << ")\n";
         }
     }
     std::cout << "============================\n\n";
@@ -408,11 +153,54 @@ void PrintStoredEventsSummary() {
 
 // Initialize the new event logging system
 void InitializeEventLog() {
+    // Keep file I/O off the WM_INPUT thread
+    EventLogger::SetAsyncLogging(true);
+    
+    // Optional long-session archive: rotated, compressed segments kept across restarts
+    char archiveDirectory[MAX_PATH] = {};
+    DWORD length = GetEnvironmentVariableA("WINOPAUTO_ARCHIVE_DIR", archiveDirectory, sizeof(archiveDirectory));
+    if (length > 0 && length < sizeof(archiveDirectory)) {
+        EventLogger::SetArchive(archiveDirectory);
+    }
+    
     EventLogger::Initialize();
     EventLogger::ClearLogFile();
 }
 
+// WINOPAUTO_LLM_BACKEND=native calls the LLM from this process instead of the Python worker
+bool IsNativeLlmBackend() {
+    char llmBackend[16] = {};
+    DWORD llmBackendLength = GetEnvironmentVariableA("WINOPAUTO_LLM_BACKEND", llmBackend, sizeof(llmBackend));
+    return llmBackendLength > 0 && llmBackendLength < sizeof(llmBackend) && strcmp(llmBackend, "native") == 0;
+}
+
+// Start the completion backend; runs on the suggestion worker thread (see SuggestionService::SetBackendStartup)
+void StartCompletionBackend() {
+    StartupStep step("CompletionBackend");
+    
+    bool nativeLlm = IsNativeLlmBackend();
+    if (nativeLlm && !NativeLlmClient::Initialize()) {
+        std::cout << "[WARNING] Native LLM client unavailable, starting the Python worker\n";
+        nativeLlm = false;
+    }
+    if (nativeLlm) {
+        // The first suggestion then reuses an open TLS connection
+        StartupStep warmUp("ConnectionWarmUp");
+        NativeLlmClient::WarmUp();
+        return;
+    }
+    
+    // Start the persistent completion worker (falls back to process_input.py if unavailable)
+    StartupStep worker("CompletionWorker");
+    if (!CompletionClient::Initialize()) {
+        std::cout << "[WARNING] Completion worker unavailable, using process_input.py per request\n";
+    }
+}
+
 int main() {
+    // Every Initialize below is a step on the startup timeline
+    StartupTimeline::Initialize();
+    
     std::cout << "WinOpAutoMouseKeybdtest - Global Input Capture Test\n";
     std::cout << "Features:\n";
     std::cout << "- Captures all keyboard and mouse events globally\n";
@@ -420,17 +208,49 @@ int main() {
     std::cout << "- Saves events to 'input_events.txt' in simplified JSON format\n";
     std::cout << "- Special key hooks for: Ctrl, Shift, Alt keys\n";
     
-    // Initialize the event log file
-    InitializeEventLog();
+    // Move per-event console output off the input thread
+    {
+        StartupStep step("Diagnostics");
+        Diagnostics::Initialize();
+    }
+    
+    // Optional periodic latency dump (WINOPAUTO_METRICS_FILE)
+    {
+        StartupStep step("Instrumentation");
+        Instrumentation::Initialize();
+    }
+    
+    // Initialize the event log file (the writer thread truncates it)
+    {
+        StartupStep step("EventLogger");
+        InitializeEventLog();
+    }
+    
+    // Initialize the in-memory suggestion context
+    {
+        StartupStep step("TypedContext");
+        TypedContext::Initialize();
+    }
     
     // Initialize the special key handler
-    SpecialKeyHandler::Initialize();
+    {
+        StartupStep step("SpecialKeyHandler");
+        SpecialKeyHandler::Initialize();
+    }
     
-    // Initialize the input injector
-    InputInjector::Initialize();
+    // Initialize the input injector; accepted text is typed from its own thread
+    {
+        StartupStep step("InputInjector");
+        InputInjector::Initialize();
+        InputInjector::StartInjectionThread();
+    }
     
-    // Initialize the suggestion overlay
-    SuggestionOverlay::Initialize();
+    // Accepts slower than WINOPAUTO_ACCEPT_SLA_US are reported (default: 5000us)
+    char acceptSla[16] = {};
+    DWORD acceptSlaLength = GetEnvironmentVariableA("WINOPAUTO_ACCEPT_SLA_US", acceptSla, sizeof(acceptSla));
+    if (acceptSlaLength > 0 && acceptSlaLength < sizeof(acceptSla)) {
+        InputInjector::SetAcceptSla(static_cast<DWORD>(strtoul(acceptSla, nullptr, 10)));
+    }
     
     std::cout << "\nSpecial Key Hooks Active:\n";
     const auto& specialKeys = SpecialKeyHandler::GetSpecialKeys();
@@ -453,7 +273,8 @@ int main() {
         return 1;
     }
     
-    // Create hidden window for message processing
+    // Create hidden window for the UI thread's messages (suggestions, timers, captured input)
+    std::uint64_t windowTicks = Instrumentation::NowTicks();
     g_hWnd = CreateWindowExW(
         0, className, L"WinOpAutoMouseKeybdtest",
         WS_OVERLAPPEDWINDOW,
@@ -465,14 +286,69 @@ int main() {
         std::cerr << "Failed to create window\n";
         return 1;
     }
+    StartupTimeline::Record("MessageWindow", windowTicks);
     
-    // Register for raw input
-    if (!RegisterRawInputDevices(g_hWnd)) {
-        std::cerr << "Failed to register raw input devices\n";
-        return 1;
+    // The suggestion overlay is created once the message loop runs
+    PostMessage(g_hWnd, WM_DEFERRED_INIT, 0, 0);
+    
+    // Shared memory for context and responses; without it the worker uses the pipe payload.
+    // Created before capture starts, since the input thread appends to it from the first event.
+    if (!IsNativeLlmBackend()) {
+        StartupStep step("SharedJournal");
+        if (!SharedJournal::Initialize()) {
+            std::cout << "[WARNING] Shared journal unavailable, sending context over the pipe\n";
+        }
     }
     
-    std::cout << "Raw input registration successful. Listening for global input events...\n\n";
+    // Suggestions are generated off the message loop and posted back to g_hWnd. The completion
+    // backend (worker process or native client) starts on the suggestion thread meanwhile.
+    {
+        StartupStep step("SuggestionService");
+        SuggestionService::SetBackendStartup(StartCompletionBackend);
+        SuggestionService::Initialize(g_hWnd);
+    }
+    
+    // Input is captured on its own thread, which posts to g_hWnd (WINOPAUTO_CAPTURE_BACKEND=raw|hook)
+    CaptureBackend captureBackend = CaptureBackend::RawInput;
+    char backendSetting[16] = {};
+    DWORD backendLength = GetEnvironmentVariableA("WINOPAUTO_CAPTURE_BACKEND", backendSetting, sizeof(backendSetting));
+    if (backendLength > 0 && backendLength < sizeof(backendSetting) &&
+        !CaptureThread::ParseBackendName(backendSetting, captureBackend)) {
+        std::cout << "[WARNING] Unknown capture backend \"" << backendSetting << "\", using raw input\n";
+    }
+    {
+        StartupStep step("CaptureThread");
+        if (!CaptureThread::Start(g_hWnd, GetTimestampMicros, captureBackend)) {
+            std::cerr << "Failed to start input capture\n";
+            return 1;
+        }
+    }
+    
+    std::cout << "Input capture started. Listening for global input events...\n\n";
+    StartupTimeline::MarkCaptureLive();
+    
+    // Optional speculative completions while typing pauses (off unless configured)
+    char prefetchSetting[16] = {};
+    DWORD length = GetEnvironmentVariableA("WINOPAUTO_PREFETCH_BUDGET", prefetchSetting, sizeof(prefetchSetting));
+    if (length > 0 && length < sizeof(prefetchSetting)) {
+        SuggestionService::SetPrefetchBudget(static_cast<std::uint32_t>(strtoul(prefetchSetting, nullptr, 10)));
+    }
+    length = GetEnvironmentVariableA("WINOPAUTO_PREFETCH_IDLE_MS", prefetchSetting, sizeof(prefetchSetting));
+    if (length > 0 && length < sizeof(prefetchSetting)) {
+        InputPipeline::EnableSpeculativePrefetch(g_hWnd, static_cast<DWORD>(strtoul(prefetchSetting, nullptr, 10)));
+    }
+    
+    // Mouse moves and wheel ticks are stored as one summary per run
+    char motionSetting[16] = {};
+    DWORD motionLength = GetEnvironmentVariableA("WINOPAUTO_MOTION_IDLE_MS", motionSetting, sizeof(motionSetting));
+    if (motionLength > 0 && motionLength < sizeof(motionSetting)) {
+        MouseCoalescer::SetIdleGap(static_cast<DWORD>(strtoul(motionSetting, nullptr, 10)));
+    }
+    motionLength = GetEnvironmentVariableA("WINOPAUTO_MOTION_WINDOW_MS", motionSetting, sizeof(motionSetting));
+    if (motionLength > 0 && motionLength < sizeof(motionSetting)) {
+        MouseCoalescer::SetMaxWindow(static_cast<DWORD>(strtoul(motionSetting, nullptr, 10)));
+    }
+    InputPipeline::EnableMotionFlushTimer(g_hWnd);
     
     // Message loop
     MSG msg;
@@ -481,11 +357,31 @@ int main() {
         DispatchMessage(&msg);
     }
     
+    // Stop capturing before tearing down what it feeds
+    CaptureThread::Stop();
+    InputPipeline::FlushPendingMotion();
+    
     // Cleanup overlay
     SuggestionOverlay::Cleanup();
     
-    // Show summary of stored events before exiting
+    // Let queued text finish typing
+    InputInjector::Shutdown();
+    
+    // Stop suggestion generation and the completion worker
+    SuggestionService::Shutdown();
+    CompletionClient::Shutdown();
+    NativeLlmClient::Shutdown();
+    SharedJournal::Shutdown();
+    
+    // Write out any queued log records and console output
+    EventLogger::Shutdown();
+    Diagnostics::Shutdown();
+    Instrumentation::Shutdown();
+    
+    // Show summary of stored events and per-stage latency before exiting
     PrintStoredEventsSummary();
+    Instrumentation::PrintSummary();
+    StartupTimeline::PrintIfPending();
     
     std::cout << "[OK] All events have been saved to 'input_events.txt'\n";
     std::cout << "\nShutdown complete.\n";
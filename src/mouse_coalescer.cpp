@@ -0,0 +1,96 @@
+#include "mouse_coalescer.h"
+#include "instrumentation.h"
+#include <cmath>
+#include <iostream>
+
+// Static member definitions
+std::uint64_t MouseCoalescer::s_idleGapMicros = 100 * 1000;
+std::uint64_t MouseCoalescer::s_maxWindowMicros = 1000 * 1000;
+MouseMotionSummary MouseCoalescer::s_pending = {};
+bool MouseCoalescer::s_hasPending = false;
+double MouseCoalescer::s_pathLength = 0.0;
+
+void MouseCoalescer::SetIdleGap(DWORD idleGapMs) {
+    s_idleGapMicros = static_cast<std::uint64_t>(idleGapMs > 0 ? idleGapMs : 1) * 1000;
+    std::cout << "[CONFIG] Mouse motion idle gap: " << idleGapMs << "ms\n";
+}
+
+void MouseCoalescer::SetMaxWindow(DWORD maxWindowMs) {
+    s_maxWindowMicros = static_cast<std::uint64_t>(maxWindowMs > 0 ? maxWindowMs : 1) * 1000;
+    std::cout << "[CONFIG] Mouse motion window: " << maxWindowMs << "ms\n";
+}
+
+DWORD MouseCoalescer::GetIdleGap() {
+    return static_cast<DWORD>(s_idleGapMicros / 1000);
+}
+
+bool MouseCoalescer::AddMove(std::uint64_t timestamp, POINT cursorPos, LONG deltaX, LONG deltaY, MouseMotionSummary& finished) {
+    // The cursor was already moved by this event; approximate where the run started
+    POINT startPos = { cursorPos.x - deltaX, cursorPos.y - deltaY };
+    bool ended = BeginOrExtend(MouseEventData::MOVE, timestamp, startPos, finished);
+
+    s_pending.endTimestamp = timestamp;
+    s_pending.endPos = cursorPos;
+    s_pending.deltaX += deltaX;
+    s_pending.deltaY += deltaY;
+    s_pending.eventCount++;
+    s_pathLength += std::sqrt(static_cast<double>(deltaX) * deltaX + static_cast<double>(deltaY) * deltaY);
+    return ended;
+}
+
+bool MouseCoalescer::AddWheel(std::uint64_t timestamp, POINT cursorPos, short wheelDelta, MouseMotionSummary& finished) {
+    bool ended = BeginOrExtend(MouseEventData::WHEEL, timestamp, cursorPos, finished);
+
+    s_pending.endTimestamp = timestamp;
+    s_pending.endPos = cursorPos;
+    s_pending.wheelDelta += wheelDelta;
+    s_pending.eventCount++;
+    return ended;
+}
+
+bool MouseCoalescer::Flush(MouseMotionSummary& finished) {
+    if (!s_hasPending) return false;
+
+    s_hasPending = false;
+    s_pending.pathLength = static_cast<std::uint32_t>(std::lround(s_pathLength));
+    Instrumentation::Increment(Counter::MouseEventsCoalesced, s_pending.eventCount - 1);
+    finished = s_pending;
+    return true;
+}
+
+bool MouseCoalescer::FlushIfIdle(std::uint64_t now, MouseMotionSummary& finished, std::uint64_t& remainingMicros) {
+    remainingMicros = 0;
+    if (!s_hasPending) return false;
+
+    std::uint64_t idleMicros = now > s_pending.endTimestamp ? now - s_pending.endTimestamp : 0;
+    if (idleMicros >= s_idleGapMicros) {
+        return Flush(finished);
+    }
+    remainingMicros = s_idleGapMicros - idleMicros;
+    return false;
+}
+
+bool MouseCoalescer::HasPending() {
+    return s_hasPending;
+}
+
+bool MouseCoalescer::BeginOrExtend(MouseEventData::Type type, std::uint64_t timestamp, POINT startPos, MouseMotionSummary& finished) {
+    bool ended = false;
+    if (s_hasPending) {
+        bool sameType = s_pending.type == type;
+        bool withinGap = timestamp < s_pending.endTimestamp + s_idleGapMicros;
+        bool withinWindow = timestamp < s_pending.startTimestamp + s_maxWindowMicros;
+        if (sameType && withinGap && withinWindow) {
+            return false;
+        }
+        ended = Flush(finished);
+    }
+
+    s_pending = {};
+    s_pending.type = type;
+    s_pending.startTimestamp = timestamp;
+    s_pending.startPos = startPos;
+    s_pathLength = 0.0;
+    s_hasPending = true;
+    return ended;
+}
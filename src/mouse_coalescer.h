@@ -0,0 +1,61 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include "event_history.h"
+
+// One run of consecutive mouse moves (or wheel ticks) merged into a single record
+struct MouseMotionSummary {
+    MouseEventData::Type type;      // MOVE or WHEEL
+    std::uint64_t startTimestamp;   // First merged event
+    std::uint64_t endTimestamp;     // Last merged event
+    POINT startPos;                 // Cursor before the first move (WHEEL: cursor at the first tick)
+    POINT endPos;                   // Cursor after the last event
+    LONG deltaX;                    // Net raw movement in mouse counts
+    LONG deltaY;
+    std::uint32_t pathLength;       // Length of the raw movement path in mouse counts
+    std::int32_t wheelDelta;        // Accumulated wheel delta (WHEEL_DELTA per notch, positive = away from the user)
+    std::uint32_t eventCount;       // Raw events merged into this summary
+
+    std::uint32_t GetDurationMs() const {
+        return static_cast<std::uint32_t>((endTimestamp - startTimestamp) / 1000);
+    }
+};
+
+// Merges high-frequency MOVE and WHEEL events into one summary per idle gap or
+// time window, so the history and the log carry motion without thousands of
+// raw deltas a second. A run ends when the next event arrives after the idle
+// gap, the run is older than the window, the other kind of motion starts, or
+// Flush is called (before any click or key, so event order is preserved).
+// Every call that can end a run returns true and fills finished when it did.
+class MouseCoalescer {
+public:
+    // Pause that ends a run and the longest span one summary covers (defaults: 100ms, 1000ms)
+    static void SetIdleGap(DWORD idleGapMs);
+    static void SetMaxWindow(DWORD maxWindowMs);
+    static DWORD GetIdleGap();
+
+    // Add one raw event. timestamp is in microseconds, cursorPos is the position after the event.
+    static bool AddMove(std::uint64_t timestamp, POINT cursorPos, LONG deltaX, LONG deltaY, MouseMotionSummary& finished);
+    static bool AddWheel(std::uint64_t timestamp, POINT cursorPos, short wheelDelta, MouseMotionSummary& finished);
+
+    // End the pending run, if any
+    static bool Flush(MouseMotionSummary& finished);
+
+    // End the pending run if nothing was added for the idle gap at now.
+    // Otherwise remainingMicros is set to the time left until it goes idle.
+    static bool FlushIfIdle(std::uint64_t now, MouseMotionSummary& finished, std::uint64_t& remainingMicros);
+
+    static bool HasPending();
+
+private:
+    // Start a new run of the given type, ending the current one if it can't be extended
+    static bool BeginOrExtend(MouseEventData::Type type, std::uint64_t timestamp, POINT startPos, MouseMotionSummary& finished);
+
+    static std::uint64_t s_idleGapMicros;
+    static std::uint64_t s_maxWindowMicros;
+
+    static MouseMotionSummary s_pending;
+    static bool s_hasPending;
+    static double s_pathLength;     // Accumulated before rounding into s_pending.pathLength
+};
@@ -0,0 +1,477 @@
+#include "native_llm_client.h"
+#include "json_value.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Static member definitions
+NativeLlmClient::Settings NativeLlmClient::s_settings = {};
+TokenBudgetTail NativeLlmClient::s_contextTail;
+bool NativeLlmClient::s_ready = false;
+DWORD NativeLlmClient::s_requestTimeoutMs = 30000;
+HINTERNET NativeLlmClient::s_session = nullptr;
+HINTERNET NativeLlmClient::s_connection = nullptr;
+HINTERNET NativeLlmClient::s_activeRequest = nullptr;
+std::mutex NativeLlmClient::s_requestMutex;
+
+// Read size for response bodies and event streams
+constexpr DWORD RESPONSE_CHUNK_SIZE = 8192;
+
+// Upper bound on a response body; anything larger is not a completion
+constexpr size_t MAX_RESPONSE_BYTES = 1024 * 1024;
+
+namespace {
+
+bool ReadTextFile(const std::string& path, std::string& text) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    text = content.str();
+    return true;
+}
+
+bool LoadJsonFile(const std::string& path, JsonValue& value) {
+    std::string text;
+    if (!ReadTextFile(path, text)) {
+        std::cout << "[ERROR] Configuration file not found: " << path << "\n";
+        return false;
+    }
+    if (!JsonValue::Parse(text, value) || !value.IsObject()) {
+        std::cout << "[ERROR] Invalid JSON in " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Markdown headers are dropped and the rest trimmed, as in llm_handler.py
+std::string MarkdownToPlainText(const std::string& markdown) {
+    std::string text;
+    std::istringstream lines(markdown);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        size_t firstChar = line.find_first_not_of(" \t");
+        if (firstChar != std::string::npos && line[firstChar] == '#') {
+            continue;
+        }
+        if (text.empty() && firstChar == std::string::npos) {
+            continue;
+        }
+        text += line;
+        text += '\n';
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return end == std::string::npos ? std::string() : text.substr(0, end + 1);
+}
+
+std::wstring Utf8ToWide(const std::string& text) {
+    if (text.empty()) {
+        return std::wstring();
+    }
+    int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+    std::wstring wide(length, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wide.data(), length);
+    return wide;
+}
+
+// "{{" and "}}" in the user template stand for literal braces, as with str.format in prompt_builder.py
+std::string UnescapeBraces(const std::string& text) {
+    std::string unescaped;
+    unescaped.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        unescaped += text[i];
+        if ((text[i] == '{' || text[i] == '}') && i + 1 < text.size() && text[i + 1] == text[i]) {
+            ++i;
+        }
+    }
+    return unescaped;
+}
+
+std::string DirectoryOfExecutable() {
+    char path[MAX_PATH] = {};
+    DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+    std::string directory(path, length);
+    size_t separator = directory.find_last_of("\\/");
+    return separator == std::string::npos ? std::string(".") : directory.substr(0, separator);
+}
+
+}  // namespace
+
+bool NativeLlmClient::Initialize(const std::string& configDirectory) {
+    if (s_ready) return true;
+
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+    if (!LoadSettings(configDirectory.empty() ? DirectoryOfExecutable() : configDirectory)) {
+        return false;
+    }
+
+    s_session = WinHttpOpen(L"WinOpAuto/1.0", WINHTTP_ACCESS_TYPE_AUTOMATIC_PROXY,
+                            WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    if (!s_session) {
+        std::cout << "[ERROR] WinHttpOpen failed: " << GetLastError() << "\n";
+        return false;
+    }
+
+    // HTTP/2 needs Windows 10 1607 or later; older systems stay on keep-alive HTTP/1.1
+    DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+    if (!WinHttpSetOption(s_session, WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols))) {
+        std::cout << "[WARNING] HTTP/2 unavailable, using HTTP/1.1\n";
+    }
+    WinHttpSetTimeouts(s_session, 0, 10000, 10000, static_cast<int>(s_requestTimeoutMs));
+
+    // One connection handle for the lifetime of the session; WinHTTP pools the sockets behind it
+    s_connection = WinHttpConnect(s_session, s_settings.host.c_str(), INTERNET_DEFAULT_HTTPS_PORT, 0);
+    if (!s_connection) {
+        std::cout << "[ERROR] WinHttpConnect failed: " << GetLastError() << "\n";
+        Shutdown();
+        return false;
+    }
+
+    s_ready = true;
+    Instrumentation::RecordSince(Stage::WorkerStartup, startTicks);
+    std::cout << "[OK] Native LLM client ready (" << s_settings.provider << ", " << s_settings.model << ")\n";
+    return true;
+}
+
+bool NativeLlmClient::IsReady() {
+    return s_ready;
+}
+
+bool NativeLlmClient::RequestCompletion(const std::string& context, std::string& completion,
+                                        PartialCompletionHandler onPartial) {
+    completion.clear();
+    if (!s_ready) {
+        return false;
+    }
+
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+    bool stream = onPartial && s_settings.stream;
+    // TypedContext cleans the context as it is captured (see input_cleaner.py)
+    std::string body = BuildRequestBody(context, stream);
+    std::wstring headers = L"Content-Type: application/json\r\nAuthorization: Bearer " +
+                           Utf8ToWide(s_settings.apiKey) + L"\r\n";
+
+    HINTERNET request = WinHttpOpenRequest(s_connection, L"POST", s_settings.path.c_str(), nullptr,
+                                           WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
+    if (!request) {
+        std::cout << "[ERROR] WinHttpOpenRequest failed: " << GetLastError() << "\n";
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_requestMutex);
+        s_activeRequest = request;
+    }
+
+    std::cout << "[AI] Requesting " << s_settings.model << (stream ? " (streaming)" : "") << "...\n";
+    if (!WinHttpSendRequest(request, headers.c_str(), static_cast<DWORD>(-1L), body.data(),
+                            static_cast<DWORD>(body.size()), static_cast<DWORD>(body.size()), 0) ||
+        !WinHttpReceiveResponse(request, nullptr)) {
+        std::cout << "[ERROR] LLM request failed: " << GetLastError() << "\n";
+        ReleaseRequest(request);
+        return false;
+    }
+
+    DWORD statusCode = 0;
+    DWORD statusSize = sizeof(statusCode);
+    WinHttpQueryHeaders(request, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+                        &statusCode, &statusSize, WINHTTP_NO_HEADER_INDEX);
+    if (statusCode != 200) {
+        std::string errorBody;
+        ReadBody(request, errorBody);
+        ReleaseRequest(request);
+
+        if (statusCode == 401) {
+            std::cout << "[ERROR] Authentication failed. Check your API key.\n";
+        } else if (statusCode == 404) {
+            std::cout << "[ERROR] Model '" << s_settings.model << "' not found or not available to your API key\n";
+        } else if (statusCode == 429) {
+            std::cout << "[ERROR] Rate limit exceeded. Please try again later.\n";
+        } else {
+            std::cout << "[ERROR] LLM request failed with HTTP " << statusCode << "\n";
+        }
+        JsonValue error;
+        if (JsonValue::Parse(errorBody, error) && error.Find("error")) {
+            std::cout << "[ERROR] API Error Details: " << error.Find("error")->GetString("message") << "\n";
+        }
+        return false;
+    }
+
+    bool success;
+    if (stream) {
+        success = ReadEventStream(request, completion, onPartial);
+    } else {
+        std::string responseBody;
+        JsonValue response;
+        success = ReadBody(request, responseBody) && JsonValue::Parse(responseBody, response);
+        const JsonValue* choices = success ? response.Find("choices") : nullptr;
+        const JsonValue* message = choices && choices->At(0) ? choices->At(0)->Find("message") : nullptr;
+        if (message) {
+            completion = message->GetString("content");
+        } else {
+            std::cout << "[ERROR] Invalid LLM response format\n";
+            success = false;
+        }
+    }
+    ReleaseRequest(request);
+
+    if (!success) {
+        completion.clear();
+        return false;
+    }
+    Instrumentation::RecordSince(Stage::CompletionRequest, startTicks);
+    std::cout << "[AI] Native client answered in " << Instrumentation::TicksToMicros(Instrumentation::NowTicks() - startTicks) / 1000
+              << "ms (" << completion.size() << " characters)\n";
+    return true;
+}
+
+bool NativeLlmClient::WarmUp() {
+    if (!s_ready) {
+        return false;
+    }
+
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+    std::wstring headers = L"Authorization: Bearer " + Utf8ToWide(s_settings.apiKey) + L"\r\n";
+    HINTERNET request = WinHttpOpenRequest(s_connection, L"GET", L"/v1/models", nullptr,
+                                           WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, WINHTTP_FLAG_SECURE);
+    if (!request) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s_requestMutex);
+        s_activeRequest = request;
+    }
+
+    // Any status will do: the point is the pooled connection, not the answer
+    bool connected = WinHttpSendRequest(request, headers.c_str(), static_cast<DWORD>(-1L), WINHTTP_NO_REQUEST_DATA,
+                                        0, 0, 0) &&
+                     WinHttpReceiveResponse(request, nullptr);
+    DWORD error = connected ? 0 : GetLastError();
+    std::string body;
+    if (connected) {
+        ReadBody(request, body);  // Drained so the connection can be reused
+    }
+    ReleaseRequest(request);
+
+    if (!connected) {
+        std::cout << "[WARNING] Could not pre-connect to the LLM endpoint: " << error << "\n";
+        return false;
+    }
+    std::cout << "[OK] LLM connection warmed up in "
+              << Instrumentation::TicksToMicros(Instrumentation::NowTicks() - startTicks) / 1000 << "ms\n";
+    return true;
+}
+
+void NativeLlmClient::CancelPendingIo() {
+    std::lock_guard<std::mutex> lock(s_requestMutex);
+    if (s_activeRequest) {
+        // Closing the handle makes the blocked WinHTTP call on the worker thread return with an error
+        WinHttpCloseHandle(s_activeRequest);
+        s_activeRequest = nullptr;
+    }
+}
+
+void NativeLlmClient::Shutdown() {
+    CancelPendingIo();
+    if (s_connection) {
+        WinHttpCloseHandle(s_connection);
+        s_connection = nullptr;
+    }
+    if (s_session) {
+        WinHttpCloseHandle(s_session);
+        s_session = nullptr;
+    }
+    s_ready = false;
+}
+
+void NativeLlmClient::SetRequestTimeout(DWORD timeoutMs) {
+    s_requestTimeoutMs = timeoutMs;
+    if (s_session) {
+        WinHttpSetTimeouts(s_session, 0, 10000, 10000, static_cast<int>(timeoutMs));
+    }
+    std::cout << "[CONFIG] Native LLM request timeout set to " << timeoutMs << "ms\n";
+}
+
+bool NativeLlmClient::LoadSettings(const std::string& directory) {
+    JsonValue config;
+    JsonValue secrets;
+    if (!LoadJsonFile(directory + "\\LLM_config.json", config) || !LoadJsonFile(directory + "\\SECRET", secrets)) {
+        return false;
+    }
+
+    Settings settings = {};
+    settings.provider = config.GetString("provider", "openai");
+    std::transform(settings.provider.begin(), settings.provider.end(), settings.provider.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (settings.provider == "openai") {
+        settings.model = config.GetString("openai_model", "gpt-3.5-turbo");
+        settings.host = L"api.openai.com";
+        settings.apiKey = secrets.GetString("openai_api_key");
+    } else if (settings.provider == "deepseek") {
+        settings.model = config.GetString("deepseek_model", "deepseek-chat");
+        settings.host = L"api.deepseek.com";
+        settings.apiKey = secrets.GetString("deepseek_api_key");
+    } else {
+        std::cout << "[ERROR] Unsupported LLM provider: " << settings.provider << "\n";
+        return false;
+    }
+    if (settings.apiKey.empty()) {
+        std::cout << "[ERROR] " << settings.provider << "_api_key not found in SECRET file\n";
+        return false;
+    }
+    settings.path = L"/v1/chat/completions";
+
+    std::string promptMarkdown;
+    std::string promptFile = config.GetString("system_prompt_file", "system_prompt.md");
+    if (!ReadTextFile(directory + "\\" + promptFile, promptMarkdown)) {
+        std::cout << "[ERROR] Markdown file not found: " << promptFile << "\n";
+        return false;
+    }
+    settings.systemPrompt = MarkdownToPlainText(promptMarkdown);
+    std::string userPromptTemplate = config.GetString("user_prompt_template",
+                                                      "The user's input sequence: '{input}'\n\nNext keyboard input:");
+    size_t placeholder = userPromptTemplate.find("{input}");
+    settings.userPromptHasInput = placeholder != std::string::npos;
+    settings.userPromptHead = UnescapeBraces(userPromptTemplate.substr(0, placeholder));
+    settings.userPromptTail = settings.userPromptHasInput ? UnescapeBraces(userPromptTemplate.substr(placeholder + 7)) : "";
+    settings.contextTokenBudget = static_cast<size_t>((std::max)(config.GetNumber("context_token_budget", 1024), 0.0));
+    settings.maxTokens = static_cast<int>(config.GetNumber("max_tokens", 100));
+    settings.temperature = config.GetNumber("temperature", 0.7);
+    settings.stream = config.GetBool("stream", true);
+
+    std::string lowerModel = settings.model;
+    std::transform(lowerModel.begin(), lowerModel.end(), lowerModel.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    settings.reasoningModel = lowerModel.find("o1") != std::string::npos || lowerModel.find("o3") != std::string::npos;
+
+    s_settings = std::move(settings);
+    s_contextTail.SetBudget(s_settings.contextTokenBudget);
+    std::cout << "[CONFIG] Loaded LLM_config.json, SECRET and " << promptFile << "\n";
+    return true;
+}
+
+std::string NativeLlmClient::BuildRequestBody(const std::string& context, bool stream) {
+    // Same messages as PromptBuilder in prompt_builder.py: the context tail within the token budget
+    std::string userPrompt = s_settings.userPromptHead;
+    if (s_settings.userPromptHasInput) {
+        userPrompt += s_contextTail.Update(context);
+        userPrompt += s_settings.userPromptTail;
+    }
+
+    std::string body = "{\"model\":";
+    JsonValue::AppendQuoted(body, s_settings.model);
+    body += ",\"messages\":[{\"role\":\"system\",\"content\":";
+    JsonValue::AppendQuoted(body, s_settings.systemPrompt);
+    body += "},{\"role\":\"user\",\"content\":";
+    JsonValue::AppendQuoted(body, userPrompt);
+    body += "}]";
+
+    if (s_settings.reasoningModel) {
+        // Reasoning models spend tokens on reasoning too, and reject temperature
+        body += ",\"max_completion_tokens\":" + std::to_string((std::max)(s_settings.maxTokens * 10, 1000));
+    } else {
+        char temperature[32];
+        auto result = std::to_chars(temperature, temperature + sizeof(temperature), s_settings.temperature);
+        body += ",\"max_tokens\":" + std::to_string(s_settings.maxTokens);
+        body += ",\"temperature\":" + std::string(temperature, result.ptr);
+    }
+    if (stream) {
+        body += ",\"stream\":true";
+    }
+    body += "}";
+    return body;
+}
+
+bool NativeLlmClient::ReadEventStream(HINTERNET request, std::string& completion, PartialCompletionHandler onPartial) {
+    char buffer[RESPONSE_CHUNK_SIZE];
+    std::string pending;
+    while (true) {
+        DWORD bytesRead = 0;
+        if (!ReadChunk(request, buffer, sizeof(buffer), bytesRead)) {
+            return false;
+        }
+        if (bytesRead == 0) {
+            return true;  // Connection finished without [DONE]
+        }
+        pending.append(buffer, bytesRead);
+
+        // Only whole lines are parsed; a frame split across reads waits for the rest
+        size_t lineStart = 0;
+        for (size_t lineEnd = pending.find('\n'); lineEnd != std::string::npos; lineEnd = pending.find('\n', lineStart)) {
+            std::string_view line(pending.data() + lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (line.substr(0, 5) != "data:") {
+                continue;  // Blank separators, comments and other SSE fields
+            }
+            std::string_view payload = line.substr(5);
+            payload.remove_prefix((std::min)(payload.find_first_not_of(' '), payload.size()));
+            if (payload == "[DONE]") {
+                return true;
+            }
+
+            JsonValue chunk;
+            if (!JsonValue::Parse(payload, chunk)) {
+                std::cout << "[ERROR] Invalid event stream chunk from LLM\n";
+                return false;
+            }
+            const JsonValue* choices = chunk.Find("choices");
+            const JsonValue* delta = choices && choices->At(0) ? choices->At(0)->Find("delta") : nullptr;
+            const JsonValue* content = delta ? delta->Find("content") : nullptr;
+            if (content && content->IsString() && !content->AsString().empty()) {
+                completion += content->AsString();
+                onPartial(completion);
+            }
+        }
+        pending.erase(0, lineStart);
+        if (pending.size() > MAX_RESPONSE_BYTES || completion.size() > MAX_RESPONSE_BYTES) {
+            std::cout << "[ERROR] LLM response too large\n";
+            return false;
+        }
+    }
+}
+
+bool NativeLlmClient::ReadBody(HINTERNET request, std::string& body) {
+    char buffer[RESPONSE_CHUNK_SIZE];
+    while (true) {
+        DWORD bytesRead = 0;
+        if (!ReadChunk(request, buffer, sizeof(buffer), bytesRead)) {
+            return false;
+        }
+        if (bytesRead == 0) {
+            return true;
+        }
+        body.append(buffer, bytesRead);
+        if (body.size() > MAX_RESPONSE_BYTES) {
+            std::cout << "[ERROR] LLM response too large\n";
+            return false;
+        }
+    }
+}
+
+bool NativeLlmClient::ReadChunk(HINTERNET request, char* buffer, DWORD size, DWORD& bytesRead) {
+    bytesRead = 0;
+    if (!WinHttpReadData(request, buffer, size, &bytesRead)) {
+        std::cout << "[ERROR] Reading LLM response failed: " << GetLastError() << "\n";
+        return false;
+    }
+    return true;
+}
+
+void NativeLlmClient::ReleaseRequest(HINTERNET request) {
+    std::lock_guard<std::mutex> lock(s_requestMutex);
+    if (s_activeRequest == request) {
+        WinHttpCloseHandle(request);
+        s_activeRequest = nullptr;
+    }
+}
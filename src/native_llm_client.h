@@ -0,0 +1,89 @@
+#pragma once
+
+#include <windows.h>
+#include <winhttp.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "completion_client.h"
+#include "prompt_budget.h"
+
+// Built-in chat completion backend: talks to the OpenAI / DeepSeek endpoints
+// that llm_handler.py targets, without Python. LLM_config.json, SECRET and the
+// system prompt are read once; a single WinHTTP session (HTTP/2 where the
+// server offers it) keeps the TLS connection alive between requests.
+// Select it with WINOPAUTO_LLM_BACKEND=native.
+class NativeLlmClient {
+public:
+    // Read the configuration from directory (default: next to the executable) and open the session
+    static bool Initialize(const std::string& configDirectory = "");
+
+    // True once Initialize succeeded
+    static bool IsReady();
+
+    // Blocking request for the completion of context; call from the suggestion worker thread.
+    // With onPartial (and "stream" enabled in the config) the response is streamed and
+    // onPartial sees the text so far after every delta. Returns false on any failure.
+    static bool RequestCompletion(const std::string& context, std::string& completion,
+                                  PartialCompletionHandler onPartial = nullptr);
+
+    // Open the TLS connection ahead of the first request with a small GET of the model list.
+    // Blocking; call from the thread that makes requests. Returns false if the server couldn't be reached.
+    static bool WarmUp();
+
+    // Abort a request blocked in WinHTTP on another thread (it fails)
+    static void CancelPendingIo();
+
+    // Close the session
+    static void Shutdown();
+
+    // Receive timeout for a request (default: 30000ms, as in llm_handler.py)
+    static void SetRequestTimeout(DWORD timeoutMs);
+
+private:
+    // Settings resolved from LLM_config.json and SECRET
+    struct Settings {
+        std::string provider;           // "openai" or "deepseek"
+        std::string model;
+        std::wstring host;
+        std::wstring path;
+        std::string apiKey;
+        std::string systemPrompt;
+        std::string userPromptHead;     // user_prompt_template around "{input}", "{{"/"}}" unescaped
+        std::string userPromptTail;
+        bool userPromptHasInput;
+        size_t contextTokenBudget;      // 0 = whole context
+        int maxTokens;
+        double temperature;
+        bool stream;
+        bool reasoningModel;            // o1/o3: max_completion_tokens, no temperature
+    };
+
+    static bool LoadSettings(const std::string& directory);
+
+    // Chat completion request body for context
+    static std::string BuildRequestBody(const std::string& context, bool stream);
+
+    // Read a server-sent event stream, forwarding each content delta
+    static bool ReadEventStream(HINTERNET request, std::string& completion, PartialCompletionHandler onPartial);
+
+    // Read the whole response body
+    static bool ReadBody(HINTERNET request, std::string& body);
+
+    // Next chunk of the response (0 bytes at the end); false if the read failed or was cancelled
+    static bool ReadChunk(HINTERNET request, char* buffer, DWORD size, DWORD& bytesRead);
+
+    // Close the request handle unless CancelPendingIo already did
+    static void ReleaseRequest(HINTERNET request);
+
+    static Settings s_settings;
+    static TokenBudgetTail s_contextTail;   // Same cut as prompt_builder.py; used on the suggestion thread only
+    static bool s_ready;
+    static DWORD s_requestTimeoutMs;
+    static HINTERNET s_session;
+    static HINTERNET s_connection;
+
+    // In-flight request, guarded by s_requestMutex so a cancel can't race the close
+    static HINTERNET s_activeRequest;
+    static std::mutex s_requestMutex;
+};
@@ -3,24 +3,175 @@
 Input processing script for WinOpAuto
 Reads input_events.txt, processes keyboard events, and generates key outputs.
 
+The log may be JSON lines or the binary format written with
+EventLogger::SetLogFormat(LogFormat::Binary); the format is detected from
+the file header. Convert a binary log for debugging with:
+    python process_input.py --to-json input_events.txt input_events.json
+
 Debug Mode:
 Set environment variable DEBUG=1 to see detailed input/output messages.
 Example: set DEBUG=1 && python process_input.py
 """
 
 import json
+import struct
 import sys
 import os
-from typing import List, Dict, Optional
+from typing import Dict, Iterator, List, Optional
+
+# One wheel notch (WHEEL_DELTA)
+WHEEL_DELTA = 120
+
+# Mouse positions are rounded to this grid for privacy (MOUSE_POSITION_GRID in typed_context.cpp)
+MOUSE_POSITION_GRID = 50
+
+# Only the tail of the session is sent to the LLM (matches TypedContext on the C++ side)
+MAX_CONTEXT_CHARS = 2000
+
+# How far back archived segments are read when rebuilding context from the log
+RECENT_CONTEXT_MINUTES = 30
+
+# Binary log layout, little-endian (BinaryLogHeader / BinaryLogRecord in event_logger.h)
+BINARY_LOG_MAGIC = b"WOAE"
+BINARY_LOG_VERSION = 2
+BINARY_LOG_HEADER = struct.Struct("<4sHHQ16x")
+BINARY_LOG_RECORD = struct.Struct("<QBBHBBHiiii")
+BINARY_RECORD_KEYBOARD = 0
+BINARY_RECORD_MOUSE_BUTTON = 1
+BINARY_RECORD_MOUSE_MOVE = 2     # Coalesced run: start_x/start_y = start, x/y = end
+BINARY_RECORD_MOUSE_WHEEL = 3    # Coalesced run: reserved = accumulated delta (int16)
+BINARY_RECORD_FLAG_UP = 0x01
+BINARY_BUTTON_NAMES = {1: "left", 2: "right", 3: "middle"}
+
+
+def _build_key_names() -> List[str]:
+    """Virtual key names, same as KEY_TABLE in key_table.h."""
+    names = [f"VK_0x{vk:x}" for vk in range(256)]
+    for i in range(26):
+        names[0x41 + i] = chr(ord("A") + i)
+    for i in range(10):
+        names[0x30 + i] = str(i)
+    named = {
+        0x20: "SPACE", 0x0D: "ENTER", 0x08: "BACKSPACE", 0x09: "TAB", 0x1B: "ESC",
+        0x2E: "DELETE", 0x2D: "INSERT", 0x24: "HOME", 0x23: "END", 0x21: "PAGE_UP", 0x22: "PAGE_DOWN",
+        0x26: "UP_ARROW", 0x28: "DOWN_ARROW", 0x25: "LEFT_ARROW", 0x27: "RIGHT_ARROW",
+        0x10: "SHIFT", 0x11: "CTRL", 0x12: "ALT", 0x14: "CAPS_LOCK", 0x5B: "LEFT_WIN", 0x5C: "RIGHT_WIN",
+        0xBA: "SEMICOLON", 0xBB: "EQUALS", 0xBC: "COMMA", 0xBD: "MINUS", 0xBE: "PERIOD", 0xBF: "SLASH",
+        0xC0: "BACKTICK", 0xDB: "LEFT_BRACKET", 0xDC: "BACKSLASH", 0xDD: "RIGHT_BRACKET", 0xDE: "QUOTE",
+    }
+    for i in range(12):
+        named[0x70 + i] = f"F{i + 1}"
+    for vk, name in named.items():
+        names[vk] = name
+    return names
+
+
+KEY_NAMES = _build_key_names()
+
+
+def is_binary_log(filepath: str) -> bool:
+    """Check the file header for the binary log magic."""
+    try:
+        with open(filepath, "rb") as f:
+            return f.read(len(BINARY_LOG_MAGIC)) == BINARY_LOG_MAGIC
+    except OSError:
+        return False
+
+
+def _int16(value: int) -> int:
+    """Reinterpret an unpacked uint16 field as int16."""
+    return value - 0x10000 if value & 0x8000 else value
+
+
+def decode_binary_records(buffer, timestamp_base: int = 0) -> Iterator[Dict]:
+    """Decode packed BinaryLogRecords (a whole number of them) into event dicts."""
+    for offset, kind, flags, vkey, char_value, button, reserved, x, y, start_x, start_y in \
+            BINARY_LOG_RECORD.iter_unpack(buffer):
+        is_up = bool(flags & BINARY_RECORD_FLAG_UP)
+        if kind == BINARY_RECORD_KEYBOARD:
+            yield {
+                "timestamp": timestamp_base + offset,
+                "type": "keyboard",
+                "action": "keyup" if is_up else "keydown",
+                "key": KEY_NAMES[vkey] if vkey < len(KEY_NAMES) else f"VK_0x{vkey:x}",
+                "char": chr(char_value) if char_value else None,
+            }
+        elif kind == BINARY_RECORD_MOUSE_BUTTON:
+            yield {
+                "timestamp": timestamp_base + offset,
+                "type": "mouse",
+                "action": BINARY_BUTTON_NAMES.get(button, "") + ("up" if is_up else "down"),
+                "x": x,
+                "y": y,
+            }
+        elif kind == BINARY_RECORD_MOUSE_MOVE:
+            yield {
+                "timestamp": timestamp_base + offset,
+                "type": "mouse",
+                "action": "move",
+                "x": x,
+                "y": y,
+                "from_x": start_x,
+                "from_y": start_y,
+            }
+        elif kind == BINARY_RECORD_MOUSE_WHEEL:
+            yield {
+                "timestamp": timestamp_base + offset,
+                "type": "mouse",
+                "action": "wheel",
+                "x": x,
+                "y": y,
+                "delta": _int16(reserved),
+            }
+
+
+def iter_binary_events(filepath: str) -> Iterator[Dict]:
+    """Stream events from a binary log as the same dicts the JSON log produces."""
+    with open(filepath, "rb") as f:
+        header = f.read(BINARY_LOG_HEADER.size)
+        if len(header) < BINARY_LOG_HEADER.size:
+            return
+        magic, version, record_size, timestamp_base = BINARY_LOG_HEADER.unpack(header)
+        if magic != BINARY_LOG_MAGIC or version != BINARY_LOG_VERSION or record_size != BINARY_LOG_RECORD.size:
+            raise ValueError(f"Unsupported binary log (version {version}, record size {record_size})")
+
+        while True:
+            # Read in large blocks; a partially written trailing record is ignored
+            block = f.read(record_size * 4096)
+            usable = len(block) - len(block) % record_size
+            if usable == 0:
+                return
+            yield from decode_binary_records(block[:usable], timestamp_base)
+            if usable < len(block):
+                return
+
+
+def convert_binary_to_json(binary_path: str, json_path: str) -> int:
+    """Write a binary log as JSON lines (the EventLogger JSON format). Returns the event count."""
+    count = 0
+    with open(json_path, "w", encoding="utf-8") as out:
+        for event in iter_binary_events(binary_path):
+            out.write(json.dumps(event, separators=(",", ":")) + "\n")
+            count += 1
+    return count
+
 
 def read_input_events(filepath: str) -> List[Dict]:
-    """Read and parse input events from JSON file."""
+    """Read and parse input events from a JSON or binary log file."""
     events = []
     
     if not os.path.exists(filepath):
         print(f"[ERROR] Input file not found: {filepath}")
         return events
     
+    if is_binary_log(filepath):
+        try:
+            events = list(iter_binary_events(filepath))
+        except Exception as e:
+            print(f"[ERROR] Failed to read binary input file: {e}")
+        print(f"[INFO] Read {len(events)} events from {filepath}")
+        return events
+    
     try:
         with open(filepath, 'r', encoding='utf-8') as f:
             for line_num, line in enumerate(f, 1):
@@ -43,9 +194,46 @@ def read_input_events(filepath: str) -> List[Dict]:
 
 
 
+# Key names without a character, as the LLM sees them (MapKeyName in typed_context.cpp)
+KEY_MAPPING = {
+    "SPACE": " ",
+    "ENTER": "\n",
+    "TAB": "\t",
+    "BACKSPACE": "[BACKSPACE]",
+    "DELETE": "[DELETE]",
+    "UP_ARROW": "[UP]",
+    "DOWN_ARROW": "[DOWN]",
+    "LEFT_ARROW": "[LEFT]",
+    "RIGHT_ARROW": "[RIGHT]",
+    "HOME": "[HOME]",
+    "END": "[END]",
+    "PAGE_UP": "[PAGEUP]",
+    "PAGE_DOWN": "[PAGEDOWN]",
+    "INSERT": "[INSERT]",
+    # Only filter out modifier keys that don't add context
+    "SHIFT": "",      # Shift effect is already reflected in capitalization
+    "CTRL": "",       # Ctrl combinations are handled separately
+    "ALT": "",        # Alt combinations are handled separately
+    "CAPS_LOCK": "[CAPS]"
+}
+
+# Mouse button actions; releases are not shown
+MOUSE_MAPPING = {
+    "leftdown": "MouseLeftClick",
+    "rightdown": "MouseRightClick",
+    "middledown": "MouseMiddleClick",
+}
+
+
 def extract_input_sequence(events: List[Dict]) -> str:
-    """Extract the sequence of user inputs (characters + special keys + mouse events)."""
-    input_sequence = []
+    """Extract the sequence of user inputs (characters + special keys + mouse events).
+    
+    Built with InputNormalizer, so the result is already cleaned (backspaces
+    applied, spaces collapsed) the same way TypedContext builds it.
+    """
+    from input_cleaner import InputNormalizer
+    
+    normalizer = InputNormalizer()
     
     for event in events:
         event_type = event.get("type")
@@ -57,34 +245,13 @@ def extract_input_sequence(events: List[Dict]) -> str:
                 key = event.get("key", "")
                 
                 if char and len(char) == 1:  # Single character available
-                    input_sequence.append(char)
+                    normalizer.add_char(char)
                 elif key:  # Use key name for special keys
-                    # Convert some common key names to more readable format for LLM understanding
-                    key_mapping = {
-                        "SPACE": " ",
-                        "ENTER": "\n",
-                        "TAB": "\t",
-                        "BACKSPACE": "[BACKSPACE]",
-                        "DELETE": "[DELETE]",
-                        "UP_ARROW": "[UP]",
-                        "DOWN_ARROW": "[DOWN]",
-                        "LEFT_ARROW": "[LEFT]",
-                        "RIGHT_ARROW": "[RIGHT]",
-                        "HOME": "[HOME]",
-                        "END": "[END]",
-                        "PAGE_UP": "[PAGEUP]",
-                        "PAGE_DOWN": "[PAGEDOWN]",
-                        "INSERT": "[INSERT]",
-                        # Only filter out modifier keys that don't add context
-                        "SHIFT": "",      # Shift effect is already reflected in capitalization
-                        "CTRL": "",       # Ctrl combinations are handled separately
-                        "ALT": "",        # Alt combinations are handled separately
-                        "CAPS_LOCK": "[CAPS]"
-                    }
-                    
-                    mapped_key = key_mapping.get(key, f"[{key}]")
-                    if mapped_key:  # Only append if not empty
-                        input_sequence.append(mapped_key)
+                    mapped_key = KEY_MAPPING.get(key, f"[{key}]")
+                    if len(mapped_key) == 1:
+                        normalizer.add_char(mapped_key)
+                    elif mapped_key:  # Only append if not empty
+                        normalizer.add_token(mapped_key)
                         
         elif event_type == "mouse":
             # Process mouse events for context
@@ -92,29 +259,37 @@ def extract_input_sequence(events: List[Dict]) -> str:
             x = event.get("x", 0)
             y = event.get("y", 0)
             
-            # Map mouse actions to readable format
-            mouse_mapping = {
-                "leftdown": "MouseLeftClick",
-                "leftup": "",  # Only show the click, not the release
-                "rightdown": "MouseRightClick", 
-                "rightup": "",
-                "middledown": "MouseMiddleClick",
-                "middleup": ""
-            }
-            
-            mouse_event = mouse_mapping.get(action, "")
+            mouse_event = MOUSE_MAPPING.get(action)
             if mouse_event:
                 # Include position for context (rounded to nearest 50 pixels for privacy)
-                rounded_x = (x // 50) * 50
-                rounded_y = (y // 50) * 50
-                input_sequence.append(f"[{mouse_event}({rounded_x},{rounded_y})]")
+                rounded_x = (x // MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID
+                rounded_y = (y // MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID
+                normalizer.add_token(f"[{mouse_event}({rounded_x},{rounded_y})]")
+            elif action == "move":
+                # Coalesced run; moves within one grid cell are jitter (same rule as TypedContext)
+                from_x = (event.get("from_x", x) // MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID
+                from_y = (event.get("from_y", y) // MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID
+                to_x = (x // MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID
+                to_y = (y // MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID
+                if (from_x, from_y) != (to_x, to_y):
+                    normalizer.add_token(f"[MouseMove({from_x},{from_y}->{to_x},{to_y})]")
+            elif action == "wheel":
+                delta = event.get("delta", 0)
+                if delta:
+                    notches = max(abs(delta) // WHEEL_DELTA, 1)
+                    normalizer.add_token(f"[{'ScrollUp' if delta > 0 else 'ScrollDown'}({notches})]")
     
-    sequence = ''.join(input_sequence)
+    sequence = normalizer.text()
     print(f"[INFO] Extracted input sequence: '{sequence}'")
     return sequence
 
-def process_with_llm(input_sequence: str) -> Optional[str]:
-    """Process input sequence with LLM and get response."""
+def process_with_llm(input_sequence: str, llm=None, on_partial=None) -> Optional[str]:
+    """Process input sequence with LLM and get response.
+    
+    Pass an existing LLMHandler to reuse its config and HTTP session.
+    on_partial, if given, receives each streamed piece of the response.
+    Repeated inputs are answered by the C++ SuggestionCache before they get here.
+    """
     import os
     from llm_handler import LLMHandler
     from input_cleaner import clean_input_for_llm
@@ -132,8 +307,10 @@ def process_with_llm(input_sequence: str) -> Optional[str]:
             print(f"[CLEAN] Input processed: {len(cleaned_input)} characters")
         
         # Use cleaned input for LLM
-        llm = LLMHandler(debug=debug_mode)
-        response = llm.generate_response(cleaned_input)
+        if llm is None:
+            llm = LLMHandler(debug=debug_mode)
+        
+        response = llm.generate_response(cleaned_input, on_partial)
         
         if response and response.strip():
             if debug_mode:
@@ -168,14 +345,15 @@ def main():
     
     print("[START] Processing input events...")
     
-    # Read input events
-    events = read_input_events(input_file)
+    # Read input events (the active log, plus recent archive segments if the log was rotated)
+    from event_archive import read_recent_events
+    events = read_recent_events(input_file, os.environ.get("WINOPAUTO_ARCHIVE_DIR"), RECENT_CONTEXT_MINUTES)
     if not events:
         print("[ERROR] No events to process")
         return 1
     
     # Extract the input sequence for LLM (Ctrl events already filtered by input_cleaner.py)
-    input_sequence = extract_input_sequence(events)
+    input_sequence = extract_input_sequence(events)[-MAX_CONTEXT_CHARS:]
     
     # Process with LLM and generate output
     output_keys = process_with_llm(input_sequence)
@@ -191,5 +369,9 @@ def main():
         return 0
 
 if __name__ == "__main__":
+    if len(sys.argv) == 4 and sys.argv[1] == "--to-json":
+        converted = convert_binary_to_json(sys.argv[2], sys.argv[3])
+        print(f"[SUCCESS] Converted {converted} events to {sys.argv[3]}")
+        sys.exit(0)
     exit_code = main()
     sys.exit(exit_code)
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "prompt_budget.h"
+#include <algorithm>
+
+// Longest key markup (see SegmentLength); an unclosed '[' within this many
+// characters of the end may still become one when more text is appended
+constexpr size_t MAX_MARKUP_CHARS = 66;
+
+// Characters per token assumed when slicing a fresh context before counting
+constexpr size_t SLICE_CHARS_PER_TOKEN = 6;
+
+namespace {
+
+// Python's \s for str
+bool IsSpace(char32_t c) {
+    return (c >= 0x09 && c <= 0x0D) || (c >= 0x1C && c <= 0x20) || c == 0x85 || c == 0xA0 || c == 0x1680
+        || (c >= 0x2000 && c <= 0x200A) || c == 0x2028 || c == 0x2029 || c == 0x202F || c == 0x205F || c == 0x3000;
+}
+
+bool IsLetter(char32_t c) {
+    return (c >= U'A' && c <= U'Z') || (c >= U'a' && c <= U'z') || c == U'_';
+}
+
+bool IsDigit(char32_t c) {
+    return c >= U'0' && c <= U'9';
+}
+
+// Length of the segment at position (prompt_builder.py _SEGMENT): leading whitespace
+// plus a key like [Enter] or [MouseMove(..)], a word or one character; or trailing whitespace
+size_t SegmentLength(const std::u32string& text, size_t position) {
+    size_t length = text.size();
+    size_t cursor = position;
+    while (cursor < length && IsSpace(text[cursor])) {
+        ++cursor;
+    }
+    if (cursor == length) {
+        return length - position;
+    }
+
+    if (text[cursor] == U'[') {
+        size_t close = cursor + 1;
+        while (close < length && close - cursor - 1 <= 64 && text[close] != U'[' && text[close] != U']') {
+            ++close;
+        }
+        size_t inner = close - cursor - 1;
+        if (close < length && text[close] == U']' && inner >= 1 && inner <= 64) {
+            return close + 1 - position;
+        }
+    }
+    if (IsLetter(text[cursor]) || IsDigit(text[cursor])) {
+        while (cursor < length && (IsLetter(text[cursor]) || IsDigit(text[cursor]))) {
+            ++cursor;
+        }
+        return cursor - position;
+    }
+    return cursor + 1 - position;
+}
+
+// Invalid sequences become U+FFFD, as the worker's errors="replace" decoding does
+std::u32string DecodeUtf8(const std::string& text) {
+    std::u32string decoded;
+    decoded.reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t extra = lead < 0x80 ? 0 : (lead >> 5) == 0x06 ? 1 : (lead >> 4) == 0x0E ? 2 : (lead >> 3) == 0x1E ? 3 : 4;
+        char32_t codePoint = extra == 0 ? lead : extra == 1 ? lead & 0x1F : extra == 2 ? lead & 0x0F : lead & 0x07;
+        bool valid = extra < 4 && i + extra < text.size();
+        for (size_t k = 1; valid && k <= extra; ++k) {
+            unsigned char next = static_cast<unsigned char>(text[i + k]);
+            valid = (next & 0xC0) == 0x80;
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+        if (!valid) {
+            decoded.push_back(0xFFFD);
+            ++i;
+            continue;
+        }
+        decoded.push_back(codePoint);
+        i += extra + 1;
+    }
+    return decoded;
+}
+
+std::string EncodeUtf8(std::u32string_view text) {
+    std::string encoded;
+    encoded.reserve(text.size());
+    for (char32_t c : text) {
+        if (c < 0x80) {
+            encoded += static_cast<char>(c);
+        } else if (c < 0x800) {
+            encoded += static_cast<char>(0xC0 | (c >> 6));
+            encoded += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            encoded += static_cast<char>(0xE0 | (c >> 12));
+            encoded += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            encoded += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            encoded += static_cast<char>(0xF0 | (c >> 18));
+            encoded += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            encoded += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            encoded += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return encoded;
+}
+
+}  // namespace
+
+size_t EstimateTokens(std::u32string_view text) {
+    size_t count = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t start = i;
+        if (IsLetter(text[i])) {
+            while (i < text.size() && IsLetter(text[i])) ++i;
+            count += (i - start + 3) / 4;
+        } else if (IsDigit(text[i])) {
+            while (i < text.size() && IsDigit(text[i])) ++i;
+            count += (i - start + 2) / 3;
+        } else {
+            count += IsSpace(text[i]) ? 0 : 1;
+            ++i;
+        }
+    }
+    return count;
+}
+
+void TokenBudgetTail::SetBudget(size_t budget) {
+    m_budget = budget;
+    m_total = 0;
+    m_text.clear();
+    m_base = 0;
+    m_segments.clear();
+    m_tokens.clear();
+}
+
+std::string TokenBudgetTail::Update(const std::string& context) {
+    if (m_budget == 0) {
+        return context;
+    }
+
+    std::u32string text = DecodeUtf8(context);
+    if (!m_text.empty() && text.compare(0, m_text.size(), m_text) == 0 && !ClosesTrimmedKey(text)) {
+        // The last segments may grow (a word, an unclosed key), so recount from them
+        size_t end = m_text.size();
+        size_t start = RewindPoint();
+        while (!m_segments.empty() && end > start) {
+            end -= m_segments.back();
+            m_total -= m_tokens.back();
+            m_segments.pop_back();
+            m_tokens.pop_back();
+        }
+        m_text = std::move(text);
+        Append(end);
+    } else {
+        m_text = std::move(text);
+        Reset();
+    }
+
+    while (m_total > m_budget && m_segments.size() > 1) {
+        m_base += m_segments.front();
+        m_total -= m_tokens.front();
+        m_segments.pop_front();
+        m_tokens.pop_front();
+    }
+    return EncodeUtf8(std::u32string_view(m_text).substr(m_base));
+}
+
+bool TokenBudgetTail::ClosesTrimmedKey(const std::u32string& text) const {
+    // An unclosed '[' already trimmed away may become a key with the appended text;
+    // segments from it on are then wrong, so they are counted afresh
+    if (m_base == 0) {
+        return false;
+    }
+    size_t searchFrom = m_text.size() > MAX_MARKUP_CHARS ? m_text.size() - MAX_MARKUP_CHARS : 0;
+    size_t bracket = m_text.rfind(U'[', m_base - 1);
+    return bracket != std::u32string::npos && bracket >= searchFrom &&
+        m_text.find(U']', bracket) == std::u32string::npos && text.find(U']', m_text.size()) != std::u32string::npos;
+}
+
+size_t TokenBudgetTail::RewindPoint() const {
+    size_t start = m_segments.empty() ? m_base : m_text.size() - m_segments.back();
+    size_t searchFrom = m_text.size() > MAX_MARKUP_CHARS ? m_text.size() - MAX_MARKUP_CHARS : 0;
+    size_t bracket = m_text.rfind(U'[');
+    if (bracket != std::u32string::npos && bracket >= (std::max)(searchFrom, m_base) &&
+        m_text.find(U']', bracket) == std::u32string::npos) {
+        start = (std::min)(start, bracket);
+    }
+    return start;
+}
+
+void TokenBudgetTail::Reset() {
+    // Widen the slice until it holds the budget or the whole context
+    size_t chars = m_budget * SLICE_CHARS_PER_TOKEN;
+    while (true) {
+        m_segments.clear();
+        m_tokens.clear();
+        m_total = 0;
+        m_base = m_text.size() > chars ? m_text.size() - chars : 0;
+        // Start at an unclosed key before the cut so it isn't split
+        if (m_base > 0) {
+            size_t searchFrom = m_base > MAX_MARKUP_CHARS ? m_base - MAX_MARKUP_CHARS : 0;
+            size_t bracket = m_text.rfind(U'[', m_base - 1);
+            if (bracket != std::u32string::npos && bracket >= searchFrom && m_text.find(U']', bracket) >= m_base) {
+                m_base = bracket;
+            }
+        }
+        Append(m_base);
+        // The first segment may be cut, so the rest alone must hold the budget
+        if (m_base == 0 || (m_total > m_budget && m_segments.size() > 1)) {
+            break;
+        }
+        chars *= 2;
+    }
+    if (m_base > 0 && m_segments.size() > 1) {
+        // The first segment may have been cut by the slice
+        m_base += m_segments.front();
+        m_total -= m_tokens.front();
+        m_segments.pop_front();
+        m_tokens.pop_front();
+    }
+}
+
+void TokenBudgetTail::Append(size_t from) {
+    while (from < m_text.size()) {
+        size_t length = SegmentLength(m_text, from);
+        size_t tokens = EstimateTokens(std::u32string_view(m_text).substr(from, length));
+        m_segments.push_back(length);
+        m_tokens.push_back(tokens);
+        m_total += tokens;
+        from += length;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+
+// Token budget for the typed context, the C++ side of prompt_builder.py.
+// NativeLlmClient cuts the context with the same rules as the Python worker,
+// so both backends send the same prompt for the same config. Positions are
+// code points, as in Python, so slices and estimates match for non-ASCII text.
+
+// Estimated token count: about four letters or three digits per token, one per
+// punctuation mark or other character, whitespace folded into the next token
+size_t EstimateTokens(std::u32string_view text);
+
+// Most recent tail of the context that fits a token budget (TokenBudgetTail in
+// prompt_builder.py). When the new context extends the previous one only the
+// appended text is counted; any other change is counted afresh from a slice
+// just large enough for the budget. Not thread-safe.
+class TokenBudgetTail {
+public:
+    explicit TokenBudgetTail(size_t budget = 0) : m_budget(budget) {}
+
+    // Change the budget (0 = no limit) and forget the previous context
+    void SetBudget(size_t budget);
+
+    // Tail of the UTF-8 context within the budget (all of it with a budget of 0)
+    std::string Update(const std::string& context);
+
+    // Estimated tokens of the tail returned by the last Update
+    size_t GetTokens() const { return m_total; }
+
+private:
+    // Whether text closes an unclosed '[' that lies before m_base
+    bool ClosesTrimmedKey(const std::u32string& text) const;
+
+    // Where recounting starts when text is appended: the last segment, or an unclosed key
+    size_t RewindPoint() const;
+
+    // Count text afresh from a slice that holds the budget
+    void Reset();
+
+    // Split m_text[from:] into segments and count them
+    void Append(size_t from);
+
+    size_t m_budget;
+    size_t m_total = 0;             // Tokens of the kept segments
+    std::u32string m_text;          // Previous context
+    size_t m_base = 0;              // Offset in m_text of the first kept segment
+    std::deque<size_t> m_segments;  // Segment lengths in code points
+    std::deque<size_t> m_tokens;
+};
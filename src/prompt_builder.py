@@ -0,0 +1,181 @@
+"""
+Prompt assembly for WinOpAuto
+
+Builds the chat messages of a completion request. The system prompt is
+prepared and counted once; the typed context is cut to its most recent tail
+within a token budget. The system message and the fixed text of the user
+template come first and never change between requests, so the providers'
+prompt caching (OpenAI and DeepSeek match on an exact prefix) keeps hitting.
+The native backend cuts the context the same way (prompt_budget.cpp); keep
+both in sync.
+"""
+
+import collections
+import re
+import threading
+from typing import Dict, List
+
+# Token counts are estimates of the providers' BPE tokenizers: about four
+# letters or three digits per token, one per punctuation mark or other
+# character (CJK, accented letters), whitespace folded into the next token.
+_PIECE = re.compile(r"[A-Za-z_]+|[0-9]+|[^\sA-Za-z0-9_]")
+
+# Units the context is trimmed by: a key like [Enter] or [MouseMove(..)] is
+# never split, and leading whitespace stays with the following word
+_SEGMENT = re.compile(r"\s*(?:\[[^\[\]]{1,64}\]|[A-Za-z0-9_]+|\S)|\s+")
+
+# Longest key markup (see _SEGMENT); an unclosed '[' within this many
+# characters of the end may still become one when more text is appended
+_MAX_MARKUP_CHARS = 66
+
+# Characters per token assumed when slicing a fresh context before counting
+_SLICE_CHARS_PER_TOKEN = 6
+
+
+def estimate_tokens(text: str) -> int:
+    """Estimated token count of text."""
+    count = 0
+    for piece in _PIECE.findall(text):
+        if piece[0].isdigit():
+            count += (len(piece) + 2) // 3
+        elif piece[0].isalpha() or piece[0] == '_':
+            count += (len(piece) + 3) // 4
+        else:
+            count += 1
+    return count
+
+
+class TokenBudgetTail:
+    """Most recent tail of the context that fits a token budget.
+
+    Typing mostly appends to the context, so when the new context extends the
+    previous one only the appended text is counted. Any other change is
+    counted afresh from a slice just large enough for the budget.
+    """
+
+    def __init__(self, budget: int):
+        self.budget = budget
+        self.total = 0                          # Tokens of the kept segments
+        self._text = ""                         # Previous context
+        self._base = 0                          # Offset in _text of the first kept segment
+        self._segments = collections.deque()
+        self._tokens = collections.deque()
+
+    def update(self, text: str) -> str:
+        """Tail of text within the budget (all of it with a budget of 0)."""
+        if self.budget <= 0:
+            return text
+
+        if self._text and text.startswith(self._text) and not self._closes_trimmed_key(text):
+            # The last segments may grow (a word, an unclosed key), so recount from them
+            end = len(self._text)
+            start = self._rewind_point()
+            while self._segments and end > start:
+                end -= len(self._segments[-1])
+                self.total -= self._tokens.pop()
+                self._segments.pop()
+            self._append(text[end:])
+        else:
+            self._reset(text)
+
+        self._text = text
+        while self.total > self.budget and len(self._segments) > 1:
+            self._base += len(self._segments[0])
+            self.total -= self._tokens.popleft()
+            self._segments.popleft()
+        return ''.join(self._segments)
+
+    def _closes_trimmed_key(self, text: str) -> bool:
+        # An unclosed '[' already trimmed away may become a key with the appended text;
+        # segments from it on are then wrong, so they are counted afresh
+        bracket = self._text.rfind('[', max(len(self._text) - _MAX_MARKUP_CHARS, 0), self._base)
+        return bracket >= 0 and ']' not in self._text[bracket:] and ']' in text[len(self._text):]
+
+    def _rewind_point(self) -> int:
+        start = len(self._text) - len(self._segments[-1]) if self._segments else self._base
+        bracket = self._text.rfind('[', max(len(self._text) - _MAX_MARKUP_CHARS, self._base))
+        if bracket >= 0 and ']' not in self._text[bracket:]:
+            start = min(start, bracket)
+        return start
+
+    def _reset(self, text: str):
+        # Widen the slice until it holds the budget or the whole context
+        chars = self.budget * _SLICE_CHARS_PER_TOKEN
+        while True:
+            self._segments.clear()
+            self._tokens.clear()
+            self.total = 0
+            self._base = max(len(text) - chars, 0)
+            # Start at an unclosed key before the cut so it isn't split
+            bracket = text.rfind('[', max(self._base - _MAX_MARKUP_CHARS, 0), self._base)
+            if bracket >= 0 and ']' not in text[bracket:self._base]:
+                self._base = bracket
+            self._append(text[self._base:])
+            # The first segment may be cut, so the rest alone must hold the budget
+            if self._base == 0 or (self.total > self.budget and len(self._segments) > 1):
+                break
+            chars *= 2
+        if self._base > 0 and len(self._segments) > 1:
+            # The first segment may have been cut by the slice
+            self._base += len(self._segments[0])
+            self.total -= self._tokens.popleft()
+            self._segments.popleft()
+
+    def _append(self, text: str):
+        for segment in _SEGMENT.findall(text):
+            tokens = estimate_tokens(segment)
+            self._segments.append(segment)
+            self._tokens.append(tokens)
+            self.total += tokens
+
+
+class PromptBuilder:
+    """Chat messages for a context: fixed system message, then the user template around the context tail."""
+
+    def __init__(self, system_prompt: str, user_template: str, context_budget: int):
+        self.system_tokens = estimate_tokens(system_prompt)
+        self._system_message = {"role": "system", "content": system_prompt}
+        head, found, tail = user_template.partition("{input}")
+        # Same escaping as str.format ("{{" -> "{"), applied once
+        self._user_head = head.format()
+        self._user_tail = tail.format() if found else ""
+        self._has_input = bool(found)
+        self._context = TokenBudgetTail(context_budget)
+        self._lock = threading.Lock()
+
+    def build(self, context: str) -> List[Dict[str, str]]:
+        with self._lock:
+            tail = self._context.update(context) if self._has_input else ""
+        return [self._system_message,
+                {"role": "user", "content": self._user_head + tail + self._user_tail}]
+
+    def context_tokens(self) -> int:
+        """Estimated tokens of the context tail in the last build."""
+        return self._context.total
+
+
+def test_token_budget_tail(trials: int = 2000):
+    """Check that a tail fed growing text always returns what a fresh tail returns."""
+    import random
+
+    units = ["a", "b", "1", "_", " ", "\n", "(", "[", "]", "é", "[Enter]", "x" * 70]
+    rng = random.Random(0)
+    for _ in range(trials):
+        budget = rng.choice([1, 2, 4, 8, 20])
+        tail = TokenBudgetTail(budget)
+        text = ""
+        for _ in range(rng.randint(1, 40)):
+            text += "".join(rng.choice(units) for _ in range(rng.randint(1, 4)))
+            fresh = TokenBudgetTail(budget)
+            expected = fresh.update(text)
+            actual = tail.update(text)
+            assert actual == expected and tail.total == fresh.total, \
+                f"budget {budget}, {text!r}: got {actual!r}, expected {expected!r}"
+    tail = TokenBudgetTail(4)
+    tail.update("[(b b(")
+    assert tail.update("[(b b(]") == "[(b b(]"
+    print(f"[OK] TokenBudgetTail matches a fresh tail on {trials} growing contexts")
+
+
+if __name__ == "__main__":
+    test_token_budget_tail()
@@ -0,0 +1,57 @@
+#include "raw_input_reader.h"
+#include "instrumentation.h"
+
+// Static member definitions
+alignas(16) BYTE RawInputReader::s_buffer[RawInputReader::BUFFER_SIZE];
+UINT RawInputReader::s_largestBatch = 0;
+
+bool RawInputReader::ProcessMessage(HRAWINPUT hRawInput, RawInputCallback callback) {
+    // Keyboard and mouse records are far smaller than the buffer, so no sizing call is needed
+    UINT size = BUFFER_SIZE;
+    UINT copied = GetRawInputData(hRawInput, RID_INPUT, s_buffer, &size, sizeof(RAWINPUTHEADER));
+
+    POINT cursorPos;
+    GetCursorPos(&cursorPos);
+
+    UINT batch = 0;
+    if (copied != static_cast<UINT>(-1) && copied > 0) {
+        batch = 1;
+        if (!DispatchBlocks(1, cursorPos, callback)) {
+            return false;
+        }
+    }
+
+    // Drain input queued behind this message; its WM_INPUT messages go away with it
+    while (true) {
+        size = BUFFER_SIZE;
+        UINT count = GetRawInputBuffer(reinterpret_cast<RAWINPUT*>(s_buffer), &size, sizeof(RAWINPUTHEADER));
+        if (count == 0 || count == static_cast<UINT>(-1)) {
+            break;
+        }
+        batch += count;
+        Instrumentation::Increment(Counter::RawInputBuffered, count);
+        if (!DispatchBlocks(count, cursorPos, callback)) {
+            return false;
+        }
+    }
+
+    if (batch > s_largestBatch) {
+        s_largestBatch = batch;
+    }
+    return true;
+}
+
+UINT RawInputReader::GetLargestBatch() {
+    return s_largestBatch;
+}
+
+bool RawInputReader::DispatchBlocks(UINT count, POINT cursorPos, RawInputCallback callback) {
+    RAWINPUT* raw = reinterpret_cast<RAWINPUT*>(s_buffer);
+    for (UINT i = 0; i < count; ++i) {
+        if (!callback(*raw, cursorPos)) {
+            return false;
+        }
+        raw = NEXTRAWINPUTBLOCK(raw);
+    }
+    return true;
+}
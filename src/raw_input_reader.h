@@ -0,0 +1,32 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+// Receives each raw input event; return false to stop reading (e.g. ESC)
+using RawInputCallback = bool (*)(const RAWINPUT& raw, POINT cursorPos);
+
+// Allocation-free WM_INPUT reader. The message's own event is copied with a
+// single GetRawInputData call into a preallocated buffer, then everything
+// else already queued is drained in bulk with GetRawInputBuffer, so a
+// 1000 Hz mouse costs a handful of messages per frame instead of one each.
+// The cursor is sampled once per batch. Must be called on the thread that
+// registered for raw input.
+class RawInputReader {
+public:
+    // Handle one WM_INPUT. Returns false if the callback asked to stop.
+    static bool ProcessMessage(HRAWINPUT hRawInput, RawInputCallback callback);
+
+    // Largest number of events handled for one WM_INPUT so far
+    static UINT GetLargestBatch();
+
+private:
+    // Run callback over count packed RAWINPUT blocks in s_buffer
+    static bool DispatchBlocks(UINT count, POINT cursorPos, RawInputCallback callback);
+
+    // Room for a few hundred mouse/keyboard records per GetRawInputBuffer call
+    static constexpr UINT BUFFER_SIZE = 16 * 1024;
+
+    alignas(16) static BYTE s_buffer[BUFFER_SIZE];
+    static UINT s_largestBatch;
+};
@@ -0,0 +1,163 @@
+#include "shared_journal.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+// Static member definitions
+HANDLE SharedJournal::s_mapping = nullptr;
+SharedJournalLayout* SharedJournal::s_layout = nullptr;
+std::wstring SharedJournal::s_name;
+
+// Bounded retries when a slot is caught mid-write
+constexpr int SEQLOCK_READ_ATTEMPTS = 16;
+
+bool SharedJournal::Initialize() {
+    if (s_layout) return true;
+
+    s_name = L"Local\\WinOpAuto-journal-" + std::to_wstring(GetCurrentProcessId());
+
+    // Pagefile-backed, so it never touches the disk unless paged out
+    s_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                   0, static_cast<DWORD>(GetSize()), s_name.c_str());
+    if (!s_mapping) {
+        std::cout << "[ERROR] Failed to create shared journal: " << GetLastError() << "\n";
+        return false;
+    }
+
+    s_layout = static_cast<SharedJournalLayout*>(MapViewOfFile(s_mapping, FILE_MAP_ALL_ACCESS, 0, 0, GetSize()));
+    if (!s_layout) {
+        std::cout << "[ERROR] Failed to map shared journal: " << GetLastError() << "\n";
+        CloseHandle(s_mapping);
+        s_mapping = nullptr;
+        return false;
+    }
+
+    // New mappings are zero-filled; only the header needs setting up
+    std::memcpy(s_layout->magic, SHARED_JOURNAL_MAGIC, sizeof(s_layout->magic));
+    s_layout->version = SHARED_JOURNAL_VERSION;
+    s_layout->recordSize = sizeof(BinaryLogRecord);
+    s_layout->eventCapacity = JOURNAL_EVENT_CAPACITY;
+    s_layout->contextCapacity = JOURNAL_CONTEXT_CAPACITY;
+    s_layout->responseCapacity = JOURNAL_RESPONSE_CAPACITY;
+
+    std::cout << "[OK] Shared journal created (" << GetSize() / 1024 << "KB, "
+              << JOURNAL_EVENT_CAPACITY << " events)\n";
+    return true;
+}
+
+void SharedJournal::Shutdown() {
+    if (s_layout) {
+        UnmapViewOfFile(s_layout);
+        s_layout = nullptr;
+    }
+    if (s_mapping) {
+        CloseHandle(s_mapping);
+        s_mapping = nullptr;
+    }
+}
+
+bool SharedJournal::IsOpen() {
+    return s_layout != nullptr;
+}
+
+const std::wstring& SharedJournal::GetName() {
+    return s_name;
+}
+
+void SharedJournal::AppendKeyboardEvent(std::uint64_t timestamp, USHORT vKey, bool isKeyUp, char charValue) {
+    if (!s_layout) return;
+
+    BinaryLogRecord record = {};
+    record.timestampOffset = timestamp;
+    record.kind = BINARY_RECORD_KEYBOARD;
+    record.flags = isKeyUp ? BINARY_RECORD_FLAG_UP : 0;
+    record.vKey = vKey;
+    record.charValue = static_cast<std::uint8_t>(charValue);
+    AppendRecord(record);
+}
+
+void SharedJournal::AppendMouseButtonEvent(std::uint64_t timestamp, const std::string& button, bool isButtonUp, POINT cursorPos) {
+    if (!s_layout) return;
+
+    BinaryLogRecord record = {};
+    record.timestampOffset = timestamp;
+    record.kind = BINARY_RECORD_MOUSE_BUTTON;
+    record.flags = isButtonUp ? BINARY_RECORD_FLAG_UP : 0;
+    record.button = button == "left" ? BINARY_BUTTON_LEFT
+                  : button == "right" ? BINARY_BUTTON_RIGHT
+                  : button == "middle" ? BINARY_BUTTON_MIDDLE : BINARY_BUTTON_NONE;
+    record.x = cursorPos.x;
+    record.y = cursorPos.y;
+    AppendRecord(record);
+}
+
+void SharedJournal::AppendMouseMotion(const MouseMotionSummary& summary) {
+    if (!s_layout) return;
+
+    // Stamped with the start of the run, as in the event log
+    AppendRecord(MakeMotionRecord(summary, summary.startTimestamp));
+}
+
+void SharedJournal::AppendRecord(const BinaryLogRecord& record) {
+    // Single writer: write the slot, then publish it by bumping the index
+    std::atomic_ref<std::uint64_t> writeIndex(s_layout->eventWriteIndex);
+    std::uint64_t index = writeIndex.load(std::memory_order_relaxed);
+    s_layout->events[index & (JOURNAL_EVENT_CAPACITY - 1)] = record;
+    writeIndex.store(index + 1, std::memory_order_release);
+}
+
+bool SharedJournal::WriteContext(std::uint32_t requestId, const std::string& context) {
+    if (!s_layout || context.size() > JOURNAL_CONTEXT_CAPACITY) {
+        return false;
+    }
+
+    std::atomic_ref<std::uint64_t> sequence(s_layout->contextSequence);
+    std::uint64_t start = sequence.load(std::memory_order_relaxed) | 1;
+    sequence.store(start, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    s_layout->contextRequestId = requestId;
+    s_layout->contextLength = static_cast<std::uint32_t>(context.size());
+    std::memcpy(s_layout->context, context.data(), context.size());
+
+    sequence.store(start + 1, std::memory_order_release);
+    return true;
+}
+
+bool SharedJournal::ReadResponse(std::uint32_t requestId, std::uint32_t& status, std::string& text) {
+    text.clear();
+    if (!s_layout) {
+        return false;
+    }
+
+    std::atomic_ref<std::uint64_t> sequence(s_layout->responseSequence);
+    for (int attempt = 0; attempt < SEQLOCK_READ_ATTEMPTS; ++attempt) {
+        std::uint64_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            YieldProcessor();
+            continue;
+        }
+
+        std::uint32_t slotRequestId = s_layout->responseRequestId;
+        std::uint32_t slotStatus = s_layout->responseStatus;
+        std::uint32_t length = s_layout->responseLength;
+        if (length > JOURNAL_RESPONSE_CAPACITY) {
+            return false;
+        }
+        text.assign(s_layout->response, length);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        if (slotRequestId != requestId) {
+            text.clear();
+            return false;
+        }
+        status = slotStatus;
+        return true;
+    }
+
+    text.clear();
+    return false;
+}
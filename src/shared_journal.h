@@ -0,0 +1,99 @@
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "event_logger.h"
+
+// Shared-memory journal between this process and completion_worker.py.
+// A named file mapping holds a ring of recent events, a context slot (written
+// here, read by the worker) and a response slot (written by the worker), so a
+// suggestion never round-trips through input_events.txt or python_output.txt.
+// The pipe is only used as a doorbell. Layout is mirrored in completion_worker.py.
+
+constexpr char SHARED_JOURNAL_MAGIC[4] = { 'W', 'O', 'A', 'J' };
+constexpr std::uint16_t SHARED_JOURNAL_VERSION = 2;
+constexpr std::uint32_t JOURNAL_EVENT_CAPACITY = 8192;          // Records, power of two
+constexpr std::uint32_t JOURNAL_CONTEXT_CAPACITY = 64 * 1024;   // Bytes of UTF-8
+constexpr std::uint32_t JOURNAL_RESPONSE_CAPACITY = 64 * 1024;  // Bytes of UTF-8
+
+// Consistency model:
+//  - eventWriteIndex counts records ever written; record i lives in events[i % capacity].
+//    Readers copy the window, re-read the index and discard records that may have been overwritten.
+//  - Each slot has a seqlock: the sequence is odd while the writer is updating it and even once stable.
+struct SharedJournalLayout {
+    // Header
+    char magic[4];
+    std::uint16_t version;
+    std::uint16_t recordSize;           // sizeof(BinaryLogRecord)
+    std::uint32_t eventCapacity;
+    std::uint32_t contextCapacity;
+    std::uint32_t responseCapacity;
+    std::uint8_t reserved[44];
+
+    // Event ring (single writer: the input thread). Timestamps are offsets from 0.
+    alignas(64) std::uint64_t eventWriteIndex;
+    std::uint8_t eventPadding[56];
+    BinaryLogRecord events[JOURNAL_EVENT_CAPACITY];
+
+    // Context slot (written by the client before ringing the doorbell)
+    alignas(64) std::uint64_t contextSequence;
+    std::uint32_t contextRequestId;
+    std::uint32_t contextLength;
+    char context[JOURNAL_CONTEXT_CAPACITY];
+
+    // Response slot (written by the worker before answering the doorbell)
+    alignas(64) std::uint64_t responseSequence;
+    std::uint32_t responseRequestId;
+    std::uint32_t responseStatus;       // CompletionStatus
+    std::uint32_t responseLength;
+    std::uint32_t responseReserved;
+    char response[JOURNAL_RESPONSE_CAPACITY];
+};
+
+static_assert(offsetof(SharedJournalLayout, eventWriteIndex) == 64, "Layout is shared with completion_worker.py");
+static_assert(offsetof(SharedJournalLayout, events) == 128, "Layout is shared with completion_worker.py");
+static_assert(offsetof(SharedJournalLayout, contextSequence) == 262272, "Layout is shared with completion_worker.py");
+static_assert(offsetof(SharedJournalLayout, context) == 262288, "Layout is shared with completion_worker.py");
+static_assert(offsetof(SharedJournalLayout, responseSequence) == 327872, "Layout is shared with completion_worker.py");
+static_assert(offsetof(SharedJournalLayout, response) == 327896, "Layout is shared with completion_worker.py");
+static_assert(sizeof(SharedJournalLayout) == 393472, "Layout is shared with completion_worker.py");
+
+class SharedJournal {
+public:
+    // Create the named mapping (Local\WinOpAuto-journal-<pid>)
+    static bool Initialize();
+
+    // Unmap and close the mapping
+    static void Shutdown();
+
+    // True if the mapping is available
+    static bool IsOpen();
+
+    // Mapping name passed to the worker (--journal)
+    static const std::wstring& GetName();
+
+    // Mapping size in bytes (the worker opens the mapping with the same size)
+    static constexpr size_t GetSize() { return sizeof(SharedJournalLayout); }
+
+    // Append events to the ring. Call from the input thread after EventLogger has
+    // logged the event, so the character reflects the current shift/caps state.
+    static void AppendKeyboardEvent(std::uint64_t timestamp, USHORT vKey, bool isKeyUp, char charValue);
+    static void AppendMouseButtonEvent(std::uint64_t timestamp, const std::string& button, bool isButtonUp, POINT cursorPos);
+    static void AppendMouseMotion(const MouseMotionSummary& summary);
+
+    // Publish the context for a request. Returns false if it does not fit the slot.
+    static bool WriteContext(std::uint32_t requestId, const std::string& context);
+
+    // Read the worker's response for requestId. Returns false if the slot holds
+    // another request or was being rewritten.
+    static bool ReadResponse(std::uint32_t requestId, std::uint32_t& status, std::string& text);
+
+private:
+    static HANDLE s_mapping;
+    static SharedJournalLayout* s_layout;
+    static std::wstring s_name;
+
+    static void AppendRecord(const BinaryLogRecord& record);
+};
@@ -1,26 +1,51 @@
 #include "special_keys.h"
 #include "input_injection.h"
 #include "suggestion_overlay.h"
+#include "event_logger.h"
+#include "suggestion_service.h"
+#include "typed_context.h"
+#include "diagnostics.h"
+#include "instrumentation.h"
+#include "key_table.h"
 #include <iostream>
-#include <fstream>
 
 // Static member definitions
 std::vector<USHORT> SpecialKeyHandler::s_specialKeys;
-std::vector<SpecialKeyState> SpecialKeyHandler::s_specialKeyStates;
+SpecialKeyHandler::KeySlot SpecialKeyHandler::s_keys[256];
+std::uint8_t SpecialKeyHandler::s_heldModifiers = 0;
+std::uint32_t SpecialKeyHandler::s_keyDowns = 0;
 std::string SpecialKeyHandler::s_pendingSuggestion = "";
 bool SpecialKeyHandler::s_hasPendingSuggestion = false;
 
+// Scan code of the right Shift key (both Shifts report VK_SHIFT in raw input)
+constexpr USHORT RIGHT_SHIFT_MAKE_CODE = 0x36;
+
+// Fold the side-specific held mask into KeyModifier bits
+static std::uint8_t FoldModifiers(std::uint8_t held) {
+    return static_cast<std::uint8_t>((held | (held >> 4)) & 0x0F);
+}
+
 void SpecialKeyHandler::Initialize() {
-    // Initialize the list of special keys we want to monitor
-    // Note: We use VK_CONTROL for both left/right Ctrl and distinguish by flags
-    s_specialKeys = {
-        VK_CONTROL,     // Ctrl (0x11) - we'll distinguish left/right by flags
-        VK_SHIFT,       // Shift (0x10)
-        VK_MENU         // Alt (0x12)
-    };
+    // Modifier bits: left keys in the low nibble, right keys in the high nibble
+    s_keys[VK_LCONTROL].modifierBit = KEYMOD_CTRL;
+    s_keys[VK_RCONTROL].modifierBit = KEYMOD_CTRL << 4;
+    s_keys[VK_LSHIFT].modifierBit = KEYMOD_SHIFT;
+    s_keys[VK_RSHIFT].modifierBit = KEYMOD_SHIFT << 4;
+    s_keys[VK_LMENU].modifierBit = KEYMOD_ALT;
+    s_keys[VK_RMENU].modifierBit = KEYMOD_ALT << 4;
+    s_keys[VK_LWIN].modifierBit = KEYMOD_WIN;
+    s_keys[VK_RWIN].modifierBit = KEYMOD_WIN << 4;
+    
+    // The monitored keys; Ctrl is split into left/right by the raw input flags
+    AddSpecialKey(VK_CONTROL);
+    AddSpecialKey(VK_SHIFT);
+    AddSpecialKey(VK_MENU);
     
-    // Initialize state tracking for each special key
-    s_specialKeyStates.resize(s_specialKeys.size());
+    // Left Ctrl generates a suggestion, Right Ctrl accepts it
+    RegisterTapHandler(VK_LCONTROL, OnLeftCtrlPressed);
+    RegisterTapHandler(VK_RCONTROL, OnRightCtrlPressed);
+    RegisterTapHandler(VK_SHIFT, OnShiftPressed);
+    RegisterTapHandler(VK_MENU, OnAltPressed);
     
     std::cout << "[OK] Special key handler initialized\n";
 }
@@ -30,12 +55,7 @@ bool SpecialKeyHandler::IsSpecialKey(USHORT vKey) {
 }
 
 int SpecialKeyHandler::GetSpecialKeyIndex(USHORT vKey) {
-    for (size_t i = 0; i < s_specialKeys.size(); ++i) {
-        if (s_specialKeys[i] == vKey) {
-            return static_cast<int>(i);
-        }
-    }
-    return -1; // Not a special key
+    return vKey < 256 ? s_keys[vKey].listIndex : -1;
 }
 
 const char* SpecialKeyHandler::GetKeyName(USHORT vKey) {
@@ -43,54 +63,103 @@ const char* SpecialKeyHandler::GetKeyName(USHORT vKey) {
         case VK_CONTROL: return "Ctrl";
         case VK_SHIFT: return "Shift";
         case VK_MENU: return "Alt";
-        default: return "Unknown";
+        case VK_LCONTROL: return "Left Ctrl";
+        case VK_RCONTROL: return "Right Ctrl";
+        case VK_LSHIFT: return "Left Shift";
+        case VK_RSHIFT: return "Right Shift";
+        case VK_LMENU: return "Left Alt";
+        case VK_RMENU: return "Right Alt";
+        case VK_LWIN: return "Left Win";
+        case VK_RWIN: return "Right Win";
+        default: return vKey < 256 ? KEY_TABLE[vKey].name : "Unknown";
     }
 }
 
-bool SpecialKeyHandler::ProcessSpecialKeyEvent(USHORT vKey, USHORT flags, bool isKeyUp, std::uint64_t timestamp, POINT cursorPos) {
-    int specialKeyIndex = GetSpecialKeyIndex(vKey);
-    if (specialKeyIndex < 0) {
-        return false; // Not a special key
+USHORT SpecialKeyHandler::ResolveSide(USHORT vKey, USHORT makeCode, USHORT flags) {
+    bool isE0 = (flags & RI_KEY_E0) != 0;
+    switch (vKey) {
+        case VK_CONTROL: return isE0 ? VK_RCONTROL : VK_LCONTROL;
+        case VK_MENU: return isE0 ? VK_RMENU : VK_LMENU;
+        case VK_SHIFT: return makeCode == RIGHT_SHIFT_MAKE_CODE ? VK_RSHIFT : VK_LSHIFT;
+        default: return vKey;
     }
-    
-    SpecialKeyState& keyState = s_specialKeyStates[specialKeyIndex];
+}
+
+template <typename Fn>
+void SpecialKeyHandler::ForEachSide(USHORT vKey, Fn fn) {
+    switch (vKey) {
+        case VK_CONTROL: fn(VK_LCONTROL); fn(VK_RCONTROL); break;
+        case VK_SHIFT: fn(VK_LSHIFT); fn(VK_RSHIFT); break;
+        case VK_MENU: fn(VK_LMENU); fn(VK_RMENU); break;
+        default: fn(vKey); break;
+    }
+}
+
+bool SpecialKeyHandler::ProcessSpecialKeyEvent(USHORT vKey, USHORT makeCode, USHORT flags, bool isKeyUp, std::uint64_t timestamp, POINT cursorPos) {
+    if (vKey >= 256) {
+        return false;
+    }
+    USHORT sidedKey = ResolveSide(vKey, makeCode, flags);
+    KeySlot& slot = s_keys[sidedKey];
+    SpecialKeyState& keyState = slot.state;
     
     if (!isKeyUp) {
-        // Key pressed down
+        // Auto-repeat keeps the original press (so holds can be timed) and is not a new combination
+        if (keyState.isPressed) {
+            return slot.listIndex >= 0;
+        }
+        
+        ++s_keyDowns;
         keyState.isPressed = true;
-        keyState.hadInterveningKeys = false;  // Reset the flag
+        keyState.keyDownsAtPress = s_keyDowns;
+        keyState.modifiersAtPress = s_heldModifiers;
         keyState.pressTimestamp = timestamp;
         keyState.pressPosition = cursorPos;
-    } else {
-        // Key released
-        if (keyState.isPressed && !keyState.hadInterveningKeys) {
-            // Complete press cycle detected WITHOUT intervening keys - trigger the handler
-            // For Ctrl keys, we need to distinguish left vs right using flags
-            if (vKey == VK_CONTROL) {
-                bool isRightCtrl = (flags & RI_KEY_E0) != 0;
-                if (isRightCtrl) {
-                    std::cout << "[SPECIAL] Right Ctrl pressed alone (no key combinations)\n";
-                    OnRightCtrlPressed(keyState.pressTimestamp, timestamp, keyState.pressPosition, cursorPos);
-                } else {
-                    std::cout << "[TRIGGER] Left Ctrl pressed - triggering input completion\n";
-                    OnLeftCtrlPressed(keyState.pressTimestamp, timestamp, keyState.pressPosition, cursorPos);
-                }
-            } else {
-                std::cout << "[SPECIAL] " << GetKeyName(vKey) << " pressed alone (no key combinations)\n";
-                OnSpecialKeyPressed(vKey, keyState.pressTimestamp, timestamp, 
-                                  keyState.pressPosition, cursorPos);
-            }
-        } else if (keyState.isPressed && keyState.hadInterveningKeys) {
-            // Special key was part of a combination - don't trigger handler
-            if (vKey == VK_CONTROL) {
-                bool isRightCtrl = (flags & RI_KEY_E0) != 0;
-                std::cout << "[SPECIAL] " << (isRightCtrl ? "Right Ctrl" : "Left Ctrl") << " was part of key combination - handler not triggered\n";
-            } else {
-                std::cout << "[SPECIAL] " << GetKeyName(vKey) << " was part of key combination - handler not triggered\n";
+        s_heldModifiers |= slot.modifierBit;
+        
+        // Chords: one lookup by key and folded modifier mask
+        if (slot.modifierBit == 0 && s_heldModifiers != 0) {
+            KeyHandler chord = slot.chords[FoldModifiers(s_heldModifiers)];
+            if (chord) {
+                std::cout << "[SPECIAL] Chord on " << GetKeyName(sidedKey) << " triggered\n";
+                chord(timestamp, timestamp, cursorPos, cursorPos);
+                return true;
             }
         }
-        keyState.isPressed = false;
-        keyState.hadInterveningKeys = false;
+        return slot.listIndex >= 0;
+    }
+    
+    // Key released
+    s_heldModifiers &= static_cast<std::uint8_t>(~slot.modifierBit);
+    bool wasPressed = keyState.isPressed;
+    keyState.isPressed = false;
+    if (slot.listIndex < 0) {
+        return false; // Not a special key
+    }
+    if (!wasPressed) {
+        return true;
+    }
+    
+    // Alone = no other key went down and no other modifier was already held
+    bool alone = keyState.keyDownsAtPress == s_keyDowns &&
+                 (keyState.modifiersAtPress & ~slot.modifierBit) == 0;
+    if (!alone) {
+        // Special key was part of a combination - don't trigger handler
+        std::cout << "[SPECIAL] " << GetKeyName(sidedKey) << " was part of key combination - handler not triggered\n";
+        return true;
+    }
+    
+    // Complete press cycle detected WITHOUT intervening keys - trigger the handler
+    std::uint64_t duration = timestamp - keyState.pressTimestamp;
+    if (slot.onHold && duration >= slot.holdMicros) {
+        std::cout << "[SPECIAL] " << GetKeyName(sidedKey) << " held for " << (duration / 1000) << "ms\n";
+        slot.onHold(keyState.pressTimestamp, timestamp, keyState.pressPosition, cursorPos);
+    } else if (slot.onTap) {
+        std::cout << "[SPECIAL] " << GetKeyName(sidedKey) << " pressed alone (no key combinations)\n";
+        slot.onTap(keyState.pressTimestamp, timestamp, keyState.pressPosition, cursorPos);
+    } else if (!slot.onHold) {
+        std::cout << "[SPECIAL] " << GetKeyName(sidedKey) << " pressed alone (no key combinations)\n";
+        OnSpecialKeyPressed(sidedKey, keyState.pressTimestamp, timestamp, keyState.pressPosition, cursorPos);
     }
     
     return true; // Event was handled
@@ -98,25 +167,57 @@ bool SpecialKeyHandler::ProcessSpecialKeyEvent(USHORT vKey, USHORT flags, bool i
 
 void SpecialKeyHandler::AddSpecialKey(USHORT vKey) {
     // Check if key is already being monitored
-    if (GetSpecialKeyIndex(vKey) >= 0) {
+    if (vKey >= 256 || GetSpecialKeyIndex(vKey) >= 0) {
         return; // Already exists
     }
     
+    // The generic key is what callers query; its sides are what events resolve to
+    std::int16_t index = static_cast<std::int16_t>(s_specialKeys.size());
     s_specialKeys.push_back(vKey);
-    s_specialKeyStates.push_back(SpecialKeyState());
+    s_keys[vKey].listIndex = index;
+    ForEachSide(vKey, [index](USHORT sidedKey) {
+        if (s_keys[sidedKey].listIndex < 0) {
+            s_keys[sidedKey].listIndex = index;
+        }
+    });
 }
 
 const std::vector<USHORT>& SpecialKeyHandler::GetSpecialKeys() {
     return s_specialKeys;
 }
 
+void SpecialKeyHandler::RegisterTapHandler(USHORT vKey, KeyHandler handler) {
+    if (vKey >= 256) return;
+    AddSpecialKey(vKey);
+    ForEachSide(vKey, [handler](USHORT sidedKey) { s_keys[sidedKey].onTap = handler; });
+}
+
+void SpecialKeyHandler::RegisterHoldHandler(USHORT vKey, DWORD minHoldMs, KeyHandler handler) {
+    if (vKey >= 256) return;
+    AddSpecialKey(vKey);
+    ForEachSide(vKey, [handler, minHoldMs](USHORT sidedKey) {
+        s_keys[sidedKey].onHold = handler;
+        s_keys[sidedKey].holdMicros = static_cast<std::uint64_t>(minHoldMs) * 1000;
+    });
+}
+
+void SpecialKeyHandler::RegisterChord(std::uint8_t modifiers, USHORT vKey, KeyHandler handler) {
+    if (vKey >= 256 || modifiers == KEYMOD_NONE || modifiers > 0x0F) return;
+    ForEachSide(vKey, [modifiers, handler](USHORT sidedKey) { s_keys[sidedKey].chords[modifiers] = handler; });
+}
+
+std::uint8_t SpecialKeyHandler::GetHeldModifiers() {
+    return FoldModifiers(s_heldModifiers);
+}
+
 void SpecialKeyHandler::NotifyRegularKeyPressed(USHORT vKey) {
-    // Check if any special keys are currently pressed
-    for (size_t i = 0; i < s_specialKeys.size(); ++i) {
-        if (s_specialKeyStates[i].isPressed) {
-            // Mark this special key as having intervening keys
-            s_specialKeyStates[i].hadInterveningKeys = true;
-            std::cout << "[COMBO] " << GetKeyName(s_specialKeys[i]) << " + " << std::hex << "0x" << vKey << std::dec << " detected\n";
+    // Combinations are detected from s_keyDowns on release; this only traces them
+    if (s_heldModifiers == 0 || !Diagnostics::IsEnabled(DiagCategory::Combo, DiagLevel::Trace)) {
+        return;
+    }
+    for (USHORT sidedKey : { VK_LCONTROL, VK_RCONTROL, VK_LSHIFT, VK_RSHIFT, VK_LMENU, VK_RMENU, VK_LWIN, VK_RWIN }) {
+        if ((s_heldModifiers & s_keys[sidedKey].modifierBit) && s_keys[sidedKey].listIndex >= 0) {
+            Diagnostics::Combo(GetKeyName(sidedKey), vKey);
         }
     }
 }
@@ -125,54 +226,75 @@ void SpecialKeyHandler::NotifyRegularKeyPressed(USHORT vKey) {
 void SpecialKeyHandler::OnLeftCtrlPressed(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos) {
     std::uint64_t duration = releaseTime - pressTime;
     
-    std::cout << "\n[AI] Generating input completion...\n";
+    std::cout << "[TRIGGER] Left Ctrl pressed - triggering input completion\n";
+    
+    // Generation runs on the suggestion worker; the result arrives as WM_SUGGESTION_READY
+    std::uint32_t requestId = SuggestionService::RequestSuggestion(TypedContext::GetContext());
+    s_hasPendingSuggestion = false;
     
-    // Call Python script to process input_events.txt (script is now in same directory as exe)
-    std::string pythonCmd = "python process_input.py";
-    int result = system(pythonCmd.c_str());
+    std::cout << "\n[AI] Generating input completion (request " << requestId << ")...\n";
+}
+
+void SpecialKeyHandler::OnSuggestionReady(std::uint32_t requestId) {
+    std::string completion;
+    bool success = false;
+    if (!SuggestionService::TakeResult(requestId, completion, success)) {
+        return;  // Superseded by newer input
+    }
+    
+    // Only the first line is used, matching the python_output.txt handoff
+    size_t lineEnd = completion.find_first_of("\r\n");
+    if (lineEnd != std::string::npos) {
+        completion.erase(lineEnd);
+    }
     
-    if (result == 0) {
+    if (success && !completion.empty()) {
+        // Store suggestion for potential acceptance with Right Ctrl
+        s_pendingSuggestion = completion;
+        s_hasPendingSuggestion = true;
         
-        // Read Python output (now in same directory as executable)
-        std::ifstream outputFile("python_output.txt");
-        if (outputFile.is_open()) {
-            std::string outputLine;
-            if (std::getline(outputFile, outputLine)) {
-                outputFile.close();
-                
-                if (!outputLine.empty()) {
-                    // Store suggestion for potential acceptance with Right Ctrl
-                    s_pendingSuggestion = outputLine;
-                    s_hasPendingSuggestion = true;
-                    
-                    // Show suggestion in overlay
-                    SuggestionOverlay::ShowSuggestion(outputLine);
-                    
-                    std::cout << "\n[READY] Completion: \"" << outputLine << "\"\n";
-                    std::cout << "[READY] Press RIGHT CTRL to accept, or ignore to cancel\n";
-                    
-                } else {
-                    std::cout << "[INFO] No completion available\n";
-                    s_hasPendingSuggestion = false;
-                }
-            } else {
-                std::cout << "[ERROR] Could not read Python output\n";
-                s_hasPendingSuggestion = false;
-            }
-        } else {
-            std::cout << "[ERROR] Could not open python_output.txt\n";
-            s_hasPendingSuggestion = false;
-        }
+        // Show suggestion in overlay (in place if it was streaming)
+        SuggestionOverlay::UpdateSuggestion(completion);
+        
+        // Build its keystrokes now so Right Ctrl only has to submit them
+        InputInjector::PrepareText(completion);
+        
+        std::cout << "\n[READY] Completion: \"" << completion << "\"\n";
+        std::cout << "[READY] Press RIGHT CTRL to accept, or ignore to cancel\n";
     } else {
-        std::cout << "[ERROR] Python script failed with exit code: " << result << "\n";
+        if (success) {
+            std::cout << "[INFO] No completion available\n";
+        }
         s_hasPendingSuggestion = false;
     }
     
     std::cout << "*** Suggestion generation completed ***\n\n";
 }
 
+void SpecialKeyHandler::OnSuggestionPartial(std::uint32_t requestId) {
+    std::string textSoFar;
+    if (!SuggestionService::TakePartial(requestId, textSoFar)) {
+        return;  // Superseded, or the final result is already in
+    }
+    
+    // Same first-line rule as the final result
+    size_t lineEnd = textSoFar.find_first_of("\r\n");
+    if (lineEnd != std::string::npos) {
+        textSoFar.erase(lineEnd);
+    }
+    if (textSoFar.empty()) {
+        return;
+    }
+    
+    // Right Ctrl accepts whatever has arrived; its key down cancels the rest of the stream
+    s_pendingSuggestion = textSoFar;
+    s_hasPendingSuggestion = true;
+    SuggestionOverlay::UpdateSuggestion(textSoFar);
+}
+
 // Specific handler for Right Ctrl key press - Accept suggestion
 void SpecialKeyHandler::OnRightCtrlPressed(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos) {
+    std::uint64_t acceptTicks = Instrumentation::NowTicks();
     std::uint64_t duration = releaseTime - pressTime;
     
     std::cout << "\n*** RIGHT CTRL PRESSED ***\n";
@@ -180,14 +302,8 @@ void SpecialKeyHandler::OnRightCtrlPressed(std::uint64_t pressTime, std::uint64_
     if (s_hasPendingSuggestion && !s_pendingSuggestion.empty()) {
         std::cout << " ACCEPTING LLM SUGGESTION: \"" << s_pendingSuggestion << "\"\n";
         
-        // Inject the LLM response as text using InputInjector
-        bool success = InputInjector::SendTextString(s_pendingSuggestion);
-        
-        if (success) {
-            std::cout << "[SUCCESS] Injected LLM text: " << s_pendingSuggestion.length() << " characters\n";
-        } else {
-            std::cout << "[ERROR] Failed to inject LLM text\n";
-        }
+        // Inject the LLM response on the injection thread; its keystrokes are filtered out of capture
+        InputInjector::QueueAccept(s_pendingSuggestion, acceptTicks);
         
         // Clear pending suggestion and hide overlay
         s_pendingSuggestion = "";
@@ -216,24 +332,12 @@ void SpecialKeyHandler::OnAltPressed(std::uint64_t pressTime, std::uint64_t rele
     std::cout << "\n*** ALT KEY PRESSED ***\n";
 }
 
-// Generic handler that routes to specific key handlers
+// Fallback for special keys added without a tap or hold handler
 void SpecialKeyHandler::OnSpecialKeyPressed(USHORT vKey, std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos) {
-    // Route to specific key handlers (Ctrl is handled separately in ProcessSpecialKeyEvent)
-    switch (vKey) {
-        case VK_SHIFT:
-            OnShiftPressed(pressTime, releaseTime, pressPos, releasePos);
-            break;
-        case VK_MENU:
-            OnAltPressed(pressTime, releaseTime, pressPos, releasePos);
-            break;
-        default:
-            // Fallback generic handler
-            std::cout << "\n*** SPECIAL KEY HOOK TRIGGERED ***\n";
-            std::cout << "Key: " << GetKeyName(vKey) << " (VK=0x" << std::hex << vKey << std::dec << ")\n";
-            std::cout << "Press duration: " << (releaseTime - pressTime) << " microseconds\n";
-            std::cout << "Press position: (" << pressPos.x << ", " << pressPos.y << ")\n";
-            std::cout << "Release position: (" << releasePos.x << ", " << releasePos.y << ")\n";
-            std::cout << "********************************\n\n";
-            break;
-    }
-}
\ No newline at end of file
+    std::cout << "\n*** SPECIAL KEY HOOK TRIGGERED ***\n";
+    std::cout << "Key: " << GetKeyName(vKey) << " (VK=0x" << std::hex << vKey << std::dec << ")\n";
+    std::cout << "Press duration: " << (releaseTime - pressTime) << " microseconds\n";
+    std::cout << "Press position: (" << pressPos.x << ", " << pressPos.y << ")\n";
+    std::cout << "Release position: (" << releasePos.x << ", " << releasePos.y << ")\n";
+    std::cout << "********************************\n\n";
+}
@@ -5,17 +5,32 @@
 #include <vector>
 #include <string>
 
-// Special key state tracking
+// Side-agnostic modifier bits for chords (e.g. KEYMOD_CTRL | KEYMOD_SHIFT).
+// The held-key mask keeps left keys in the low nibble and right keys in the high nibble.
+enum KeyModifier : std::uint8_t {
+    KEYMOD_NONE = 0,
+    KEYMOD_CTRL = 0x01,
+    KEYMOD_SHIFT = 0x02,
+    KEYMOD_ALT = 0x04,
+    KEYMOD_WIN = 0x08
+};
+
+// Called for a tap, hold or chord (times in microseconds; chords pass the key-down time twice)
+using KeyHandler = void (*)(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos);
+
+// Per-key state, kept for every virtual key so repeats and combinations are O(1) to detect
 struct SpecialKeyState {
     bool isPressed;
-    bool hadInterveningKeys;  // Flag to track if other keys were pressed while this special key was held
+    std::uint32_t keyDownsAtPress;   // Key-down counter when pressed; changed on release = other keys went down
+    std::uint8_t modifiersAtPress;   // Modifiers already held when pressed (side-specific mask)
     std::uint64_t pressTimestamp;
     POINT pressPosition;
     
-    SpecialKeyState() : isPressed(false), hadInterveningKeys(false), pressTimestamp(0), pressPosition({0, 0}) {}
+    SpecialKeyState() : isPressed(false), keyDownsAtPress(0), modifiersAtPress(0), pressTimestamp(0), pressPosition({0, 0}) {}
 };
 
-// Special key management
+// Special key management. Keys are looked up in a 256-entry table indexed by
+// virtual key; Ctrl, Shift and Alt are tracked per side (VK_LCONTROL, ...).
 class SpecialKeyHandler {
 public:
     // Initialize the special key handler
@@ -24,38 +39,79 @@ public:
     // Check if a key is a special key we monitor
     static bool IsSpecialKey(USHORT vKey);
     
-    // Get the index of a special key (-1 if not found)
+    // Get the index of a special key in GetSpecialKeys() (-1 if not found)
     static int GetSpecialKeyIndex(USHORT vKey);
     
     // Get the name of a special key
     static const char* GetKeyName(USHORT vKey);
     
-    // Process a special key event (returns true if it was handled)
-    static bool ProcessSpecialKeyEvent(USHORT vKey, USHORT flags, bool isKeyUp, std::uint64_t timestamp, POINT cursorPos);
+    // Process a key event: tracks held modifiers, fires chords and special key handlers.
+    // Called for every key; returns true if it was a special key or triggered a chord.
+    static bool ProcessSpecialKeyEvent(USHORT vKey, USHORT makeCode, USHORT flags, bool isKeyUp, std::uint64_t timestamp, POINT cursorPos);
     
-    // Notify that a regular key was pressed (to track key combinations)
+    // Notify that a regular key was pressed (combination tracing)
     static void NotifyRegularKeyPressed(USHORT vKey);
     
-    // Add a new special key to monitor
+    // Add a new special key to monitor (VK_CONTROL/VK_SHIFT/VK_MENU cover both sides)
     static void AddSpecialKey(USHORT vKey);
     
     // Get list of monitored special keys
     static const std::vector<USHORT>& GetSpecialKeys();
+    
+    // Run handler when vKey is pressed and released on its own, shorter than any hold handler's threshold.
+    // Makes vKey a special key; replaces an earlier tap handler.
+    static void RegisterTapHandler(USHORT vKey, KeyHandler handler);
+    
+    // Run handler when vKey is released on its own after being held for at least minHoldMs
+    static void RegisterHoldHandler(USHORT vKey, DWORD minHoldMs, KeyHandler handler);
+    
+    // Run handler when vKey goes down while exactly these modifiers are held (either side counts).
+    // nullptr removes the chord.
+    static void RegisterChord(std::uint8_t modifiers, USHORT vKey, KeyHandler handler);
+    
+    // Currently held modifiers (KeyModifier bits, sides folded together)
+    static std::uint8_t GetHeldModifiers();
+    
+    // Show the result of a finished suggestion request (called for WM_SUGGESTION_READY)
+    static void OnSuggestionReady(std::uint32_t requestId);
+    
+    // Show the text streamed so far (called for WM_SUGGESTION_PARTIAL); Right Ctrl can accept it
+    static void OnSuggestionPartial(std::uint32_t requestId);
 
 private:
+    // Direct-indexed entry for one virtual key
+    struct KeySlot {
+        SpecialKeyState state;
+        KeyHandler onTap = nullptr;
+        KeyHandler onHold = nullptr;
+        std::uint64_t holdMicros = 0;
+        std::uint8_t modifierBit = 0;    // Side-specific bit if this is a modifier key
+        std::int16_t listIndex = -1;     // Position in s_specialKeys (-1 = not special)
+        KeyHandler chords[16] = {};      // Indexed by the folded modifier mask
+    };
+    
     // Event handlers for specific keys
     static void OnLeftCtrlPressed(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos);
     static void OnRightCtrlPressed(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos);
     static void OnShiftPressed(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos);
     static void OnAltPressed(std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos);
     
-    // Generic handler for any special key
+    // Generic handler for a special key without a registered handler
     static void OnSpecialKeyPressed(USHORT vKey, std::uint64_t pressTime, std::uint64_t releaseTime, POINT pressPos, POINT releasePos);
     
+    // Map VK_CONTROL/VK_SHIFT/VK_MENU to their left/right virtual keys using the raw input flags
+    static USHORT ResolveSide(USHORT vKey, USHORT makeCode, USHORT flags);
+    
+    // Apply fn to vKey, or to both sides of a generic modifier
+    template <typename Fn>
+    static void ForEachSide(USHORT vKey, Fn fn);
+    
     static std::vector<USHORT> s_specialKeys;
-    static std::vector<SpecialKeyState> s_specialKeyStates;
+    static KeySlot s_keys[256];
+    static std::uint8_t s_heldModifiers;   // Side-specific bits of the modifiers currently down
+    static std::uint32_t s_keyDowns;       // Fresh (non-repeat) key downs seen so far
     
     // State for suggestion workflow
     static std::string s_pendingSuggestion;
     static bool s_hasPendingSuggestion;
-};
\ No newline at end of file
+};
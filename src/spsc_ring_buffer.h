@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded lock-free single-producer/single-consumer ring buffer.
+// Exactly one thread may call TryPush and exactly one other thread may call
+// TryPop/PopBatch. Storage is allocated once in the constructor; pushing and
+// popping never allocate.
+template <typename T>
+class SpscRingBuffer {
+public:
+    // Capacity is rounded up to the next power of two
+    explicit SpscRingBuffer(size_t capacity)
+        : m_capacity(RoundUpToPowerOfTwo(capacity)),
+          m_mask(m_capacity - 1),
+          m_slots(std::make_unique<T[]>(m_capacity)) {}
+
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    // Producer side: returns false if the buffer is full
+    bool TryPush(const T& item) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == m_capacity) {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == m_capacity) {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: returns false if the buffer is empty
+    bool TryPop(T& item) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail) {
+                return false;
+            }
+        }
+        item = m_slots[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: pop up to maxItems into out, returns the number popped
+    size_t PopBatch(T* out, size_t maxItems) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        size_t available = m_cachedTail - head;
+        size_t count = available < maxItems ? available : maxItems;
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = m_slots[(head + i) & m_mask];
+        }
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Approximate number of queued items (exact when called from either side while the other is idle)
+    size_t SizeApprox() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const {
+        return m_capacity;
+    }
+
+private:
+    static size_t RoundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_slots;
+
+    // Head and tail live on separate cache lines so producer and consumer don't false-share
+    alignas(64) std::atomic<size_t> m_head{0};  // Next slot to read (written by consumer)
+    size_t m_cachedTail = 0;                    // Consumer's last view of m_tail
+    alignas(64) std::atomic<size_t> m_tail{0};  // Next slot to write (written by producer)
+    size_t m_cachedHead = 0;                    // Producer's last view of m_head
+};
@@ -0,0 +1,104 @@
+#include "startup_timeline.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+// Static member definitions
+std::uint64_t StartupTimeline::s_mainTicks = 0;
+std::uint64_t StartupTimeline::s_preMainMicros = 0;
+std::vector<StartupTimeline::Step> StartupTimeline::s_steps;
+std::mutex StartupTimeline::s_mutex;
+std::atomic<bool> StartupTimeline::s_printed{false};
+
+namespace {
+
+std::uint64_t FileTimeToMicros(const FILETIME& fileTime) {
+    std::uint64_t ticks = (static_cast<std::uint64_t>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+    return ticks / 10;  // 100ns units
+}
+
+}  // namespace
+
+StartupStep::StartupStep(const char* name) : m_name(name), m_startTicks(Instrumentation::NowTicks()) {}
+
+void StartupTimeline::Initialize() {
+    s_mainTicks = Instrumentation::NowTicks();
+
+    // Loader, static initializers and DLL attach happen before main()
+    FILETIME creation, exitTime, kernel, user, now;
+    if (GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) {
+        GetSystemTimePreciseAsFileTime(&now);
+        std::uint64_t created = FileTimeToMicros(creation);
+        std::uint64_t current = FileTimeToMicros(now);
+        s_preMainMicros = current > created ? current - created : 0;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_steps.reserve(32);
+    s_steps.push_back({ "ProcessStart", 0, s_preMainMicros, GetCurrentThreadId() });
+}
+
+void StartupTimeline::Record(const char* step, std::uint64_t startTicks) {
+    std::uint64_t endTicks = Instrumentation::NowTicks();
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_steps.push_back({ step, SinceProcessStart(startTicks),
+                        Instrumentation::TicksToMicros(endTicks - startTicks), GetCurrentThreadId() });
+}
+
+void StartupTimeline::MarkCaptureLive() {
+    std::uint64_t liveMicros = SinceProcessStart(Instrumentation::NowTicks());
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_steps.push_back({ "CaptureLive", liveMicros, 0, GetCurrentThreadId() });
+    }
+    std::cout << "[STARTUP] Input capture live " << std::fixed << std::setprecision(1) << liveMicros / 1000.0
+              << "ms after process start\n" << std::defaultfloat;
+}
+
+void StartupTimeline::MarkFirstSuggestion(std::uint64_t latencyMicros) {
+    if (s_printed.exchange(true)) {
+        return;
+    }
+
+    std::uint64_t nowMicros = SinceProcessStart(Instrumentation::NowTicks());
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_steps.push_back({ "FirstSuggestion", nowMicros - (std::min)(latencyMicros, nowMicros), latencyMicros,
+                            GetCurrentThreadId() });
+    }
+    std::cout << "[STARTUP] First suggestion took " << std::fixed << std::setprecision(1) << latencyMicros / 1000.0
+              << "ms\n" << std::defaultfloat;
+    Print();
+}
+
+void StartupTimeline::PrintIfPending() {
+    if (!s_printed.exchange(true)) {
+        Print();
+    }
+}
+
+std::uint64_t StartupTimeline::SinceProcessStart(std::uint64_t ticks) {
+    return s_preMainMicros + (ticks > s_mainTicks ? Instrumentation::TicksToMicros(ticks - s_mainTicks) : 0);
+}
+
+void StartupTimeline::Print() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    // Steps are recorded when they end, possibly on other threads
+    std::vector<Step> steps = s_steps;
+    std::stable_sort(steps.begin(), steps.end(),
+                     [](const Step& a, const Step& b) { return a.startMicros < b.startMicros; });
+
+    std::cout << "\n=== STARTUP TIMELINE (ms since process start) ===\n";
+    std::cout << std::left << std::setw(20) << "Step" << std::right
+              << std::setw(10) << "Start" << std::setw(10) << "Took" << std::setw(10) << "Thread" << "\n";
+    std::cout << std::fixed << std::setprecision(1);
+    for (const Step& step : steps) {
+        std::cout << std::left << std::setw(20) << step.name << std::right
+                  << std::setw(10) << step.startMicros / 1000.0
+                  << std::setw(10) << step.durationMicros / 1000.0
+                  << std::setw(10) << step.threadId << "\n";
+    }
+    std::cout << std::defaultfloat << "=================================================\n\n";
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Startup steps on one time axis starting at process creation. Steps may run
+// on any thread (the completion backend starts on the suggestion worker).
+// The timeline is printed when the first suggestion is delivered, or at exit
+// if there was none.
+class StartupTimeline {
+public:
+    // Anchor the timeline to process creation; call first thing in main()
+    static void Initialize();
+
+    // Record a step that ran from startTicks (Instrumentation::NowTicks) until now
+    static void Record(const char* step, std::uint64_t startTicks);
+
+    // Input capture is running: report how long that took
+    static void MarkCaptureLive();
+
+    // Record the first suggestion delivered to the UI and print the timeline (later calls are ignored)
+    static void MarkFirstSuggestion(std::uint64_t latencyMicros);
+
+    // Print the timeline unless MarkFirstSuggestion already did
+    static void PrintIfPending();
+
+private:
+    struct Step {
+        const char* name;
+        std::uint64_t startMicros;      // Since process creation
+        std::uint64_t durationMicros;
+        DWORD threadId;
+    };
+
+    // Microseconds since process creation at Instrumentation tick value ticks
+    static std::uint64_t SinceProcessStart(std::uint64_t ticks);
+
+    static void Print();
+
+    static std::uint64_t s_mainTicks;           // Instrumentation ticks when Initialize ran
+    static std::uint64_t s_preMainMicros;       // Process creation until Initialize
+    static std::vector<Step> s_steps;
+    static std::mutex s_mutex;
+    static std::atomic<bool> s_printed;
+};
+
+// Records the lifetime of the scope as one startup step
+class StartupStep {
+public:
+    explicit StartupStep(const char* name);
+    ~StartupStep() { StartupTimeline::Record(m_name, m_startTicks); }
+
+    StartupStep(const StartupStep&) = delete;
+    StartupStep& operator=(const StartupStep&) = delete;
+
+private:
+    const char* m_name;
+    std::uint64_t m_startTicks;
+};
@@ -0,0 +1,146 @@
+#include "suggestion_cache.h"
+#include "instrumentation.h"
+#include "json_value.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Static member definitions
+std::list<SuggestionCache::Entry> SuggestionCache::s_entries;
+std::unordered_map<std::uint64_t, std::list<SuggestionCache::Entry>::iterator> SuggestionCache::s_index;
+std::mutex SuggestionCache::s_mutex;
+size_t SuggestionCache::s_capacity = 64;
+DWORD SuggestionCache::s_ttlMs = 600000;
+std::uint64_t SuggestionCache::s_configFingerprint = 0;
+
+constexpr std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr std::uint64_t FNV_PRIME = 1099511628211ull;
+
+void SuggestionCache::Initialize() {
+    // Same files the worker loads next to the executable
+    std::string configText;
+    std::ifstream configFile("LLM_config.json", std::ios::binary);
+    if (configFile.is_open()) {
+        std::ostringstream content;
+        content << configFile.rdbuf();
+        configText = content.str();
+    }
+    std::uint64_t fingerprint = FNV_OFFSET_BASIS;
+    for (unsigned char c : configText) {
+        fingerprint = (fingerprint ^ c) * FNV_PRIME;
+    }
+    fingerprint = HashFile("system_prompt.md", fingerprint);
+
+    // Size and lifetime come from the config; values set before Initialize are the fallback
+    JsonValue config;
+    bool hasConfig = JsonValue::Parse(configText, config) && config.IsObject();
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (hasConfig) {
+            double capacity = config.GetNumber("suggestion_cache_size", static_cast<double>(s_capacity));
+            double ttlSeconds = config.GetNumber("suggestion_cache_ttl_seconds", s_ttlMs / 1000.0);
+            s_capacity = static_cast<size_t>((std::max)(capacity, 0.0));
+            s_ttlMs = static_cast<DWORD>((std::max)(ttlSeconds, 0.0) * 1000);
+        }
+        s_configFingerprint = fingerprint;
+        s_entries.clear();
+        s_index.clear();
+    }
+
+    std::cout << "[OK] Suggestion cache initialized (" << s_capacity << " entries, "
+              << s_ttlMs / 1000 << "s TTL)\n";
+}
+
+bool SuggestionCache::Lookup(const std::string& context, std::string& completion) {
+    std::uint64_t key = MakeKey(context);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto found = s_index.find(key);
+    if (found == s_index.end() || found->second->context != context) {
+        Instrumentation::Increment(Counter::SuggestionCacheMiss);
+        return false;
+    }
+
+    auto entry = found->second;
+    if (GetTickCount64() - entry->insertedAt > s_ttlMs) {
+        s_index.erase(found);
+        s_entries.erase(entry);
+        Instrumentation::Increment(Counter::SuggestionCacheEviction);
+        Instrumentation::Increment(Counter::SuggestionCacheMiss);
+        return false;
+    }
+
+    // Move to the front without reallocating the entry
+    s_entries.splice(s_entries.begin(), s_entries, entry);
+    completion = entry->completion;
+    Instrumentation::Increment(Counter::SuggestionCacheHit);
+    return true;
+}
+
+void SuggestionCache::Insert(const std::string& context, const std::string& completion) {
+    std::uint64_t key = MakeKey(context);
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_capacity == 0) {
+        return;
+    }
+
+    auto found = s_index.find(key);
+    if (found != s_index.end()) {
+        s_entries.erase(found->second);
+        s_index.erase(found);
+    }
+
+    s_entries.push_front(Entry{ key, context, completion, GetTickCount64() });
+    s_index[key] = s_entries.begin();
+    EvictToCapacity();
+}
+
+void SuggestionCache::Clear() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_entries.clear();
+    s_index.clear();
+}
+
+void SuggestionCache::SetCapacity(size_t capacity) {
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_capacity = capacity;
+        EvictToCapacity();
+    }
+    std::cout << "[CONFIG] Suggestion cache capacity set to " << capacity << " entries\n";
+}
+
+void SuggestionCache::SetTimeToLive(DWORD ttlMs) {
+    s_ttlMs = ttlMs;
+    std::cout << "[CONFIG] Suggestion cache TTL set to " << ttlMs << "ms\n";
+}
+
+std::uint64_t SuggestionCache::MakeKey(const std::string& context) {
+    std::uint64_t hash = s_configFingerprint ^ FNV_OFFSET_BASIS;
+    for (unsigned char c : context) {
+        hash = (hash ^ c) * FNV_PRIME;
+    }
+    return hash;
+}
+
+std::uint64_t SuggestionCache::HashFile(const char* path, std::uint64_t hash) {
+    std::ifstream file(path, std::ios::binary);
+    char buffer[4096];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        for (std::streamsize i = 0; i < file.gcount(); ++i) {
+            hash = (hash ^ static_cast<unsigned char>(buffer[i])) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+void SuggestionCache::EvictToCapacity() {
+    while (s_entries.size() > s_capacity) {
+        s_index.erase(s_entries.back().key);
+        s_entries.pop_back();
+        Instrumentation::Increment(Counter::SuggestionCacheEviction);
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// LRU cache of finished suggestions keyed by the request context, so pressing
+// Left Ctrl again on unchanged input shows the previous completion without a
+// worker round trip. This is the only suggestion cache: it sits in front of
+// every backend (worker, native client, process_input.py). The context is
+// TypedContext, which is already cleaned like clean_input_for_llm output.
+// Keys also cover a fingerprint of the LLM config and system prompt as loaded
+// at startup (the worker reads them once too). Hits, misses and evictions are
+// reported through Instrumentation counters.
+class SuggestionCache {
+public:
+    // Compute the config fingerprint from LLM_config.json and system_prompt.md, apply
+    // suggestion_cache_size and suggestion_cache_ttl_seconds from LLM_config.json and drop all entries
+    static void Initialize();
+
+    // Copy the cached completion for context into completion. Expired entries count as misses.
+    static bool Lookup(const std::string& context, std::string& completion);
+
+    // Remember a completion, evicting the least recently used entry when full
+    static void Insert(const std::string& context, const std::string& completion);
+
+    // Drop all entries
+    static void Clear();
+
+    // Maximum number of entries (default: 64 unless LLM_config.json sets it, 0 disables the cache)
+    static void SetCapacity(size_t capacity);
+
+    // Entry lifetime (default: 600000ms = 10 minutes unless LLM_config.json sets it)
+    static void SetTimeToLive(DWORD ttlMs);
+
+private:
+    struct Entry {
+        std::uint64_t key;
+        std::string context;      // Compared on lookup so a hash collision can't return the wrong text
+        std::string completion;
+        ULONGLONG insertedAt;     // GetTickCount64
+    };
+
+    // FNV-1a 64 of the context, mixed with the config fingerprint
+    static std::uint64_t MakeKey(const std::string& context);
+
+    // FNV-1a 64 of a file's contents mixed into hash (unchanged if the file is missing)
+    static std::uint64_t HashFile(const char* path, std::uint64_t hash);
+
+    // Remove the least recently used entries until the size fits the capacity
+    static void EvictToCapacity();
+
+    static std::list<Entry> s_entries;   // Most recently used first
+    static std::unordered_map<std::uint64_t, std::list<Entry>::iterator> s_index;
+    static std::mutex s_mutex;           // Lookup runs on the UI thread, Insert on the suggestion worker
+    static size_t s_capacity;
+    static DWORD s_ttlMs;
+    static std::uint64_t s_configFingerprint;
+};
@@ -1,16 +1,47 @@
 #include "suggestion_overlay.h"
+#include "diagnostics.h"
+#include "instrumentation.h"
+#include <algorithm>
 #include <iostream>
 #include <wingdi.h>
+#include <shellscalingapi.h>
 
 // Static member definitions
 HWND SuggestionOverlay::s_overlayWindow = nullptr;
 bool SuggestionOverlay::s_initialized = false;
 std::string SuggestionOverlay::s_currentSuggestion = "";
+std::wstring SuggestionOverlay::s_displayText;
+RECT SuggestionOverlay::s_windowRect = { 0, 0, 0, 0 };
+OverlayAnchor SuggestionOverlay::s_anchor = {};
+std::vector<OverlayMonitor> SuggestionOverlay::s_monitors;
+bool SuggestionOverlay::s_monitorsValid = false;
+HFONT SuggestionOverlay::s_font = nullptr;
+UINT SuggestionOverlay::s_fontDpi = 0;
+HBRUSH SuggestionOverlay::s_backgroundBrush = nullptr;
+HPEN SuggestionOverlay::s_borderPen = nullptr;
+HDC SuggestionOverlay::s_bufferDC = nullptr;
+HBITMAP SuggestionOverlay::s_bufferBitmap = nullptr;
+HGDIOBJ SuggestionOverlay::s_bufferOldBitmap = nullptr;
+SIZE SuggestionOverlay::s_bufferSize = { 0, 0 };
+
+// Shown in front of every suggestion (light bulb emoji)
+constexpr const wchar_t* SUGGESTION_PREFIX = L"\U0001F4A1 ";
+
+// Layout in 96-DPI pixels, scaled to the monitor the overlay lands on
+constexpr int FONT_HEIGHT = 33;          // 1.5x the original 22px for readability
+constexpr int TEXT_PADDING_X = 10;
+constexpr int TEXT_PADDING_Y = 15;
+constexpr int MIN_WIDTH = 200;
+constexpr int MAX_WIDTH = 900;
+constexpr int CURSOR_OFFSET_X = 20;     // Below-right of the mouse, clear of the pointer
+constexpr int CURSOR_OFFSET_Y = 30;
+constexpr int CARET_GAP = 4;            // Below the caret line
+constexpr int SCREEN_MARGIN = 10;
 
 void SuggestionOverlay::Initialize() {
     if (s_initialized) return;
     
-    if (CreateOverlayWindow()) {
+    if (CreateOverlayWindow() && CreateGdiResources()) {
         s_initialized = true;
         std::cout << "[OVERLAY] Suggestion overlay initialized\n";
     } else {
@@ -21,28 +52,50 @@ void SuggestionOverlay::Initialize() {
 void SuggestionOverlay::ShowSuggestion(const std::string& suggestion) {
     if (!s_initialized || !s_overlayWindow) return;
     
-    s_currentSuggestion = suggestion;
+    bool textChanged = SetSuggestionText(suggestion);
+    bool wasVisible = IsWindowVisible(s_overlayWindow) != FALSE;
     
-    // Update position near cursor
-    UpdatePosition();
+    // Place near the caret or cursor (shows the window)
+    bool layoutChanged = UpdatePlacement(true);
     
-    // Show the window
-    ShowWindow(s_overlayWindow, SW_SHOWNOACTIVATE);
+    // Redraw only if something changed; a newly shown window gets WM_PAINT anyway
+    if ((textChanged || layoutChanged) && wasVisible) {
+        InvalidateRect(s_overlayWindow, nullptr, FALSE);
+        UpdateWindow(s_overlayWindow);
+    }
+    
+    if (Diagnostics::IsEnabled(DiagCategory::Overlay, DiagLevel::Trace)) {
+        Diagnostics::Message(DiagCategory::Overlay, DiagLevel::Trace, "[OVERLAY] Showing suggestion: \"" + suggestion + "\"");
+    }
+}
+
+void SuggestionOverlay::UpdateSuggestion(const std::string& suggestion) {
+    if (!s_initialized || !s_overlayWindow) return;
     
-    // Force redraw
-    InvalidateRect(s_overlayWindow, nullptr, TRUE);
-    UpdateWindow(s_overlayWindow);
+    // Streamed text keeps the overlay where it first appeared instead of chasing the cursor
+    if (!IsWindowVisible(s_overlayWindow)) {
+        ShowSuggestion(suggestion);
+        return;
+    }
     
-    std::cout << "[OVERLAY] Showing suggestion: \"" << suggestion << "\"\n";
+    if (SetSuggestionText(suggestion)) {
+        UpdatePlacement(false);  // Grow with the text, same anchor
+        InvalidateRect(s_overlayWindow, nullptr, FALSE);
+        UpdateWindow(s_overlayWindow);
+    }
 }
 
 void SuggestionOverlay::HideSuggestion() {
     if (!s_initialized || !s_overlayWindow) return;
     
+    // Called on every keydown, so do nothing unless something is showing
+    if (!IsWindowVisible(s_overlayWindow)) return;
+    
     ShowWindow(s_overlayWindow, SW_HIDE);
     s_currentSuggestion = "";
+    s_displayText.clear();
     
-    std::cout << "[OVERLAY] Suggestion hidden\n";
+    Diagnostics::Message(DiagCategory::Overlay, DiagLevel::Trace, "[OVERLAY] Suggestion hidden");
 }
 
 void SuggestionOverlay::Cleanup() {
@@ -50,6 +103,7 @@ void SuggestionOverlay::Cleanup() {
         DestroyWindow(s_overlayWindow);
         s_overlayWindow = nullptr;
     }
+    ReleaseGdiResources();
     s_initialized = false;
 }
 
@@ -62,7 +116,7 @@ bool SuggestionOverlay::CreateOverlayWindow() {
     wc.lpfnWndProc = OverlayWindowProc;
     wc.hInstance = GetModuleHandle(nullptr);
     wc.lpszClassName = className;
-    wc.hbrBackground = CreateSolidBrush(RGB(45, 45, 48)); // Dark background
+    wc.hbrBackground = nullptr; // WM_PAINT covers the whole client area
     wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
     
     if (!RegisterClassExW(&wc)) {
@@ -93,40 +147,55 @@ bool SuggestionOverlay::CreateOverlayWindow() {
     return true;
 }
 
-void SuggestionOverlay::UpdatePosition() {
-    if (!s_overlayWindow) return;
-    
-    // Get cursor position
-    POINT cursorPos;
-    GetCursorPos(&cursorPos);
-    
-    // Position overlay slightly below and to the right of cursor
-    int x = cursorPos.x + 20;
-    int y = cursorPos.y + 30;
+bool SuggestionOverlay::CreateGdiResources() {
+    // Subtle blue tint to indicate AI suggestion, with a blue accent border
+    s_backgroundBrush = CreateSolidBrush(RGB(40, 50, 70));
+    s_borderPen = CreatePen(PS_SOLID, 1, RGB(70, 130, 180));
+    s_bufferDC = CreateCompatibleDC(nullptr);
+    s_bufferOldBitmap = nullptr;
     
-    // Get screen dimensions to avoid going off-screen
-    int screenWidth = GetSystemMetrics(SM_CXSCREEN);
-    int screenHeight = GetSystemMetrics(SM_CYSCREEN);
-    
-    // Adjust if too close to screen edges (updated for 600x80 size)
-    if (x + 600 > screenWidth) x = screenWidth - 620;
-    if (y + 80 > screenHeight) y = cursorPos.y - 90;
-    if (x < 0) x = 10;
-    if (y < 0) y = 10;
+    if (!s_backgroundBrush || !s_borderPen || !s_bufferDC || !EnsureFont(96)) {
+        ReleaseGdiResources();
+        return false;
+    }
+    return true;
+}
+
+void SuggestionOverlay::ReleaseGdiResources() {
+    if (s_bufferDC) {
+        SelectObject(s_bufferDC, s_bufferOldBitmap);
+        DeleteDC(s_bufferDC);
+        s_bufferDC = nullptr;
+    }
+    if (s_bufferBitmap) {
+        DeleteObject(s_bufferBitmap);
+        s_bufferBitmap = nullptr;
+    }
+    s_bufferOldBitmap = nullptr;
+    s_bufferSize = { 0, 0 };
     
-    // Update window position
-    SetWindowPos(s_overlayWindow, HWND_TOPMOST, x, y, 600, 80, 
-                 SWP_NOACTIVATE | SWP_SHOWWINDOW);
+    if (s_font) {
+        DeleteObject(s_font);
+        s_font = nullptr;
+    }
+    s_fontDpi = 0;
+    if (s_backgroundBrush) {
+        DeleteObject(s_backgroundBrush);
+        s_backgroundBrush = nullptr;
+    }
+    if (s_borderPen) {
+        DeleteObject(s_borderPen);
+        s_borderPen = nullptr;
+    }
 }
 
-void SuggestionOverlay::DrawSuggestion(HDC hdc, RECT& rect) {
-    // Set up drawing
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, RGB(220, 220, 220)); // Light gray text
+bool SuggestionOverlay::EnsureFont(UINT dpi) {
+    if (s_font && s_fontDpi == dpi) {
+        return true;
+    }
     
-    // Create font (1.5x bigger for even better readability)
-    HFONT hFont = CreateFontW(
-        33,                        // Height (22 * 1.5 = 33)
+    HFONT font = CreateFontW(
+        -MulDiv(FONT_HEIGHT, dpi, 96), // Height (character height in pixels at this DPI)
         0,                         // Width (auto)
         0,                         // Escapement
         0,                         // Orientation
@@ -141,71 +210,272 @@ void SuggestionOverlay::DrawSuggestion(HDC hdc, RECT& rect) {
         DEFAULT_PITCH | FF_SWISS,  // PitchAndFamily
         L"Segoe UI"                // Font name
     );
+    if (!font) {
+        return s_font != nullptr;  // Keep the old size rather than nothing
+    }
+    
+    if (s_font) {
+        DeleteObject(s_font);
+    }
+    s_font = font;
+    s_fontDpi = dpi;
+    return true;
+}
+
+bool SuggestionOverlay::EnsureBackBuffer(HDC hdc, int width, int height) {
+    if (!s_bufferDC) return false;
+    if (s_bufferSize.cx == width && s_bufferSize.cy == height) {
+        return true;
+    }
+    
+    HBITMAP bitmap = CreateCompatibleBitmap(hdc, width, height);
+    if (!bitmap) return false;
+    
+    HGDIOBJ previous = SelectObject(s_bufferDC, bitmap);
+    if (s_bufferBitmap) {
+        DeleteObject(s_bufferBitmap);
+    } else {
+        s_bufferOldBitmap = previous;  // The DC's original 1x1 bitmap, restored on release
+    }
+    s_bufferBitmap = bitmap;
+    s_bufferSize = { width, height };
+    return true;
+}
+
+bool SuggestionOverlay::SetSuggestionText(const std::string& suggestion) {
+    if (suggestion == s_currentSuggestion && !s_displayText.empty()) {
+        return false;
+    }
+    s_currentSuggestion = suggestion;
+    
+    // Suggestions are UTF-8; decode them properly instead of widening byte by byte
+    s_displayText = SUGGESTION_PREFIX;
+    int wideLength = MultiByteToWideChar(CP_UTF8, 0, suggestion.data(), static_cast<int>(suggestion.size()), nullptr, 0);
+    if (wideLength > 0) {
+        size_t prefixLength = s_displayText.size();
+        s_displayText.resize(prefixLength + wideLength);
+        MultiByteToWideChar(CP_UTF8, 0, suggestion.data(), static_cast<int>(suggestion.size()),
+                            &s_displayText[prefixLength], wideLength);
+    }
+    return true;
+}
+
+void SuggestionOverlay::RefreshMonitors() {
+    s_monitors.clear();
+    EnumDisplayMonitors(nullptr, nullptr, EnumMonitorProc, 0);
+    s_monitorsValid = true;
+    
+    if (Diagnostics::IsEnabled(DiagCategory::Overlay, DiagLevel::Info)) {
+        Diagnostics::Message(DiagCategory::Overlay, DiagLevel::Info,
+                             "[OVERLAY] Display layout: " + std::to_string(s_monitors.size()) + " monitor(s)");
+    }
+}
+
+BOOL CALLBACK SuggestionOverlay::EnumMonitorProc(HMONITOR monitor, HDC hdc, RECT* bounds, LPARAM lParam) {
+    MONITORINFO info = {};
+    info.cbSize = sizeof(info);
+    if (!GetMonitorInfoW(monitor, &info)) {
+        return TRUE;
+    }
+    
+    UINT dpiX = 96, dpiY = 96;
+    if (!SUCCEEDED(GetDpiForMonitor(monitor, MDT_EFFECTIVE_DPI, &dpiX, &dpiY)) || dpiX == 0) {
+        dpiX = 96;
+    }
+    s_monitors.push_back({ info.rcMonitor, info.rcWork, dpiX });
+    return TRUE;
+}
+
+const OverlayMonitor* SuggestionOverlay::FindMonitor(POINT point) {
+    if (!s_monitorsValid) {
+        RefreshMonitors();
+    }
+    if (s_monitors.empty()) {
+        return nullptr;
+    }
     
-    HFONT oldFont = (HFONT)SelectObject(hdc, hFont);
+    // Points in the gaps between monitors go to the closest one
+    const OverlayMonitor* nearest = &s_monitors.front();
+    long long nearestDistance = -1;
+    for (const OverlayMonitor& monitor : s_monitors) {
+        if (PtInRect(&monitor.bounds, point)) {
+            return &monitor;
+        }
+        long long dx = point.x < monitor.bounds.left ? monitor.bounds.left - point.x :
+                       point.x >= monitor.bounds.right ? point.x - monitor.bounds.right + 1 : 0;
+        long long dy = point.y < monitor.bounds.top ? monitor.bounds.top - point.y :
+                       point.y >= monitor.bounds.bottom ? point.y - monitor.bounds.bottom + 1 : 0;
+        long long distance = dx * dx + dy * dy;
+        if (nearestDistance < 0 || distance < nearestDistance) {
+            nearest = &monitor;
+            nearestDistance = distance;
+        }
+    }
+    return nearest;
+}
+
+bool SuggestionOverlay::ComputeAnchor(OverlayAnchor& anchor) {
+    // The caret is where the completion will be typed, so prefer it over the mouse
+    RECT caret = {};
+    bool haveCaret = false;
+    GUITHREADINFO threadInfo = {};
+    threadInfo.cbSize = sizeof(threadInfo);
+    HWND foreground = GetForegroundWindow();
+    if (foreground && GetGUIThreadInfo(GetWindowThreadProcessId(foreground, nullptr), &threadInfo) && threadInfo.hwndCaret) {
+        POINT topLeft = { threadInfo.rcCaret.left, threadInfo.rcCaret.top };
+        POINT bottomRight = { threadInfo.rcCaret.right, threadInfo.rcCaret.bottom };
+        if (ClientToScreen(threadInfo.hwndCaret, &topLeft) && ClientToScreen(threadInfo.hwndCaret, &bottomRight)) {
+            caret = { topLeft.x, topLeft.y, bottomRight.x, bottomRight.y };
+            haveCaret = true;
+        }
+    }
     
-    // Add symbol prefix and draw text - try light bulb, fallback to simple symbol
-    std::wstring wDisplayText = L"\U0001F4A1 ";  // Unicode light bulb emoji (💡)
-    // If emoji doesn't work, you can replace above line with one of these:
-    // std::wstring wDisplayText = L"\u2022 ";     // Bullet point (•)
-    // std::wstring wDisplayText = L"\u25B6 ";     // Right triangle (▶)
-    // std::wstring wDisplayText = L"AI: ";        // Simple text fallback
+    POINT reference;
+    if (haveCaret) {
+        reference = { caret.left, caret.bottom };
+    } else if (!GetCursorPos(&reference)) {
+        return false;
+    }
     
-    // Convert suggestion to wide string and append
-    std::wstring wSuggestion(s_currentSuggestion.begin(), s_currentSuggestion.end());
-    wDisplayText += wSuggestion;
+    const OverlayMonitor* monitor = FindMonitor(reference);
+    if (!monitor) {
+        return false;
+    }
     
-    // Draw with padding (reduced for smaller height)
+    UINT dpi = monitor->dpi;
+    if (haveCaret) {
+        anchor.below = { caret.left, caret.bottom + MulDiv(CARET_GAP, dpi, 96) };
+        anchor.aboveY = caret.top - MulDiv(CARET_GAP, dpi, 96);
+    } else {
+        anchor.below = { reference.x + MulDiv(CURSOR_OFFSET_X, dpi, 96), reference.y + MulDiv(CURSOR_OFFSET_Y, dpi, 96) };
+        anchor.aboveY = reference.y - MulDiv(SCREEN_MARGIN, dpi, 96);
+    }
+    anchor.dpi = dpi;
+    anchor.work = monitor->work;
+    return true;
+}
+
+bool SuggestionOverlay::UpdatePlacement(bool reanchor) {
+    if (reanchor || s_anchor.dpi == 0) {
+        if (!ComputeAnchor(s_anchor)) {
+            return false;
+        }
+    }
+    
+    UINT dpi = s_anchor.dpi;
+    UINT oldFontDpi = s_fontDpi;
+    if (!EnsureFont(dpi)) {
+        return false;
+    }
+    
+    // Size the window to the text instead of a fixed 600x80 box
+    SIZE textSize = { 0, 0 };
+    HGDIOBJ oldFont = SelectObject(s_bufferDC, s_font);
+    GetTextExtentPoint32W(s_bufferDC, s_displayText.c_str(), static_cast<int>(s_displayText.size()), &textSize);
+    SelectObject(s_bufferDC, oldFont);
+    
+    const RECT& work = s_anchor.work;
+    int margin = MulDiv(SCREEN_MARGIN, dpi, 96);
+    int maxWidth = (std::min)(MulDiv(MAX_WIDTH, dpi, 96), static_cast<int>(work.right - work.left) - 2 * margin);
+    int width = textSize.cx + 2 * MulDiv(TEXT_PADDING_X, dpi, 96) + 2;  // +2 for the border
+    width = (std::max)((std::min)(width, maxWidth), (std::min)(MulDiv(MIN_WIDTH, dpi, 96), maxWidth));
+    int height = textSize.cy + 2 * MulDiv(TEXT_PADDING_Y, dpi, 96);
+    
+    // Below the anchor if it fits, otherwise above it; always inside the work area
+    int x = s_anchor.below.x;
+    int y = s_anchor.below.y;
+    if (y + height > work.bottom - margin) y = s_anchor.aboveY - height;
+    if (x + width > work.right - margin) x = work.right - margin - width;
+    if (x < work.left + margin) x = work.left + margin;
+    if (y < work.top + margin) y = work.top + margin;
+    
+    RECT placement = { x, y, x + width, y + height };
+    bool sizeChanged = width != s_windowRect.right - s_windowRect.left || height != s_windowRect.bottom - s_windowRect.top;
+    bool visible = IsWindowVisible(s_overlayWindow) != FALSE;
+    if (visible && EqualRect(&placement, &s_windowRect)) {
+        return oldFontDpi != s_fontDpi;
+    }
+    s_windowRect = placement;
+    
+    // Position, size and visibility in one call
+    SetWindowPos(s_overlayWindow, HWND_TOPMOST, x, y, width, height,
+                 SWP_NOACTIVATE | SWP_SHOWWINDOW);
+    return sizeChanged || oldFontDpi != s_fontDpi;
+}
+
+void SuggestionOverlay::DrawSuggestion(HDC hdc, RECT& rect) {
+    // Set up drawing
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, RGB(220, 220, 220)); // Light gray text
+    HFONT oldFont = (HFONT)SelectObject(hdc, s_font);
+    
+    // Draw with padding, scaled like the window
+    int paddingX = MulDiv(TEXT_PADDING_X, s_fontDpi, 96);
     RECT textRect = rect;
-    textRect.left += 10;
-    textRect.top += 5;
-    textRect.right -= 10;
-    textRect.bottom -= 5;
+    textRect.left += paddingX;
+    textRect.right -= paddingX;
     
-    DrawTextW(hdc, wDisplayText.c_str(), -1, &textRect, 
+    DrawTextW(hdc, s_displayText.c_str(), static_cast<int>(s_displayText.size()), &textRect, 
               DT_LEFT | DT_VCENTER | DT_SINGLELINE | DT_END_ELLIPSIS);
     
-    // Cleanup
     SelectObject(hdc, oldFont);
-    DeleteObject(hFont);
 }
 
 LRESULT CALLBACK SuggestionOverlay::OverlayWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
     switch (message) {
     case WM_PAINT: {
+        ScopedSpan span(Stage::OverlayPaint);
         PAINTSTRUCT ps;
         HDC hdc = BeginPaint(hWnd, &ps);
         
         RECT rect;
         GetClientRect(hWnd, &rect);
         
-        // Fill background with a subtle blue tint to indicate AI suggestion
-        HBRUSH bgBrush = CreateSolidBrush(RGB(40, 50, 70));  // Dark blue-gray
-        FillRect(hdc, &rect, bgBrush);
-        DeleteObject(bgBrush);
-        
-        // Draw border with a subtle blue accent
-        HPEN borderPen = CreatePen(PS_SOLID, 1, RGB(70, 130, 180));
-        HPEN oldPen = (HPEN)SelectObject(hdc, borderPen);
+        // Compose the frame off screen, then copy it in one go
+        HDC target = EnsureBackBuffer(hdc, rect.right, rect.bottom) ? s_bufferDC : hdc;
         
-        MoveToEx(hdc, 0, 0, nullptr);
-        LineTo(hdc, rect.right - 1, 0);
-        LineTo(hdc, rect.right - 1, rect.bottom - 1);
-        LineTo(hdc, 0, rect.bottom - 1);
-        LineTo(hdc, 0, 0);
+        FillRect(target, &rect, s_backgroundBrush);
         
-        SelectObject(hdc, oldPen);
-        DeleteObject(borderPen);
+        HPEN oldPen = (HPEN)SelectObject(target, s_borderPen);
+        MoveToEx(target, 0, 0, nullptr);
+        LineTo(target, rect.right - 1, 0);
+        LineTo(target, rect.right - 1, rect.bottom - 1);
+        LineTo(target, 0, rect.bottom - 1);
+        LineTo(target, 0, 0);
+        SelectObject(target, oldPen);
         
         // Draw suggestion text
         if (!s_currentSuggestion.empty()) {
-            DrawSuggestion(hdc, rect);
+            DrawSuggestion(target, rect);
+        }
+        
+        if (target != hdc) {
+            BitBlt(hdc, 0, 0, rect.right, rect.bottom, target, 0, 0, SRCCOPY);
         }
         
         EndPaint(hWnd, &ps);
         return 0;
     }
     
+    case WM_ERASEBKGND:
+        return 1;  // WM_PAINT draws every pixel
+    
+    case WM_DISPLAYCHANGE:
+    case WM_DPICHANGED:
+        // Monitors were added, moved or rescaled: re-read them on the next placement
+        s_monitorsValid = false;
+        if (IsWindowVisible(hWnd)) {
+            UpdatePlacement(true);
+            InvalidateRect(hWnd, nullptr, FALSE);
+        }
+        return 0;
+    
+    case WM_SETTINGCHANGE:
+        if (wParam == SPI_SETWORKAREA) {
+            s_monitorsValid = false;  // Taskbar moved or resized
+        }
+        return DefWindowProc(hWnd, message, wParam, lParam);
+    
     case WM_DESTROY:
         return 0;
         
@@ -2,6 +2,22 @@
 
 #include <windows.h>
 #include <string>
+#include <vector>
+
+// Cached display geometry; refreshed on WM_DISPLAYCHANGE, WM_DPICHANGED and work area changes
+struct OverlayMonitor {
+    RECT bounds;  // Monitor rectangle (virtual screen coordinates)
+    RECT work;    // Work area (excludes the taskbar)
+    UINT dpi;     // Effective DPI (96 = 100%)
+};
+
+// Where the overlay is attached: below the text caret when the foreground app exposes one, else below the mouse
+struct OverlayAnchor {
+    POINT below;   // Top-left corner when placed below the anchor
+    LONG aboveY;   // Bottom edge when there is no room below
+    UINT dpi;
+    RECT work;
+};
 
 class SuggestionOverlay {
 public:
@@ -11,6 +27,9 @@ public:
     // Show suggestion on screen
     static void ShowSuggestion(const std::string& suggestion);
     
+    // Replace the text of a visible suggestion in place (shows it if hidden)
+    static void UpdateSuggestion(const std::string& suggestion);
+    
     // Hide the suggestion
     static void HideSuggestion();
     
@@ -21,6 +40,25 @@ private:
     static HWND s_overlayWindow;
     static bool s_initialized;
     static std::string s_currentSuggestion;
+    static std::wstring s_displayText;   // Prefix + suggestion as UTF-16, rebuilt only when the text changes
+    static RECT s_windowRect;            // Last placement passed to SetWindowPos
+    static OverlayAnchor s_anchor;
+    
+    static std::vector<OverlayMonitor> s_monitors;
+    static bool s_monitorsValid;
+    
+    // GDI objects kept for the overlay's lifetime (the font is recreated when the DPI changes)
+    static HFONT s_font;
+    static UINT s_fontDpi;
+    static HBRUSH s_backgroundBrush;
+    static HPEN s_borderPen;
+    
+    // Back buffer the whole frame is drawn into before one BitBlt (no flicker, no erase);
+    // its DC also measures text for layout
+    static HDC s_bufferDC;
+    static HBITMAP s_bufferBitmap;
+    static HGDIOBJ s_bufferOldBitmap;
+    static SIZE s_bufferSize;
     
     // Window procedure for overlay
     static LRESULT CALLBACK OverlayWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
@@ -28,8 +66,32 @@ private:
     // Create the overlay window
     static bool CreateOverlayWindow();
     
-    // Update window position (near cursor)
-    static void UpdatePosition();
+    // Create the brush, pen and memory DC used by every paint
+    static bool CreateGdiResources();
+    static void ReleaseGdiResources();
+    
+    // Select a font scaled for dpi, recreating it only when the DPI changes
+    static bool EnsureFont(UINT dpi);
+    
+    // Make sure the back buffer matches the client size (compatible with hdc)
+    static bool EnsureBackBuffer(HDC hdc, int width, int height);
+    
+    // Store the suggestion and its UTF-16 display text. Returns false if it is unchanged.
+    static bool SetSuggestionText(const std::string& suggestion);
+    
+    // Enumerate monitors into s_monitors
+    static void RefreshMonitors();
+    static BOOL CALLBACK EnumMonitorProc(HMONITOR monitor, HDC hdc, RECT* bounds, LPARAM lParam);
+    
+    // Cached monitor containing point (nearest if none does)
+    static const OverlayMonitor* FindMonitor(POINT point);
+    
+    // Anchor to the caret of the foreground window, or the mouse cursor
+    static bool ComputeAnchor(OverlayAnchor& anchor);
+    
+    // Size the window to the text and place it at s_anchor with a single SetWindowPos (optionally re-anchoring).
+    // Returns true if the size or font changed, i.e. the contents need repainting.
+    static bool UpdatePlacement(bool reanchor);
     
     // Draw the suggestion text
     static void DrawSuggestion(HDC hdc, RECT& rect);
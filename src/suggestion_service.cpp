@@ -0,0 +1,366 @@
+#include "suggestion_service.h"
+#include "completion_client.h"
+#include "native_llm_client.h"
+#include "event_logger.h"
+#include "instrumentation.h"
+#include "startup_timeline.h"
+#include "suggestion_cache.h"
+#include <iostream>
+#include <fstream>
+
+// Window for the per-minute speculative request budget
+constexpr ULONGLONG PREFETCH_BUDGET_WINDOW_MS = 60000;
+
+// Static member definitions
+HWND SuggestionService::s_notifyWindow = nullptr;
+CompletionHandler SuggestionService::s_completionHandler = nullptr;
+BackendStartupHandler SuggestionService::s_backendStartup = nullptr;
+std::thread SuggestionService::s_workerThread;
+std::mutex SuggestionService::s_mutex;
+std::condition_variable SuggestionService::s_wake;
+bool SuggestionService::s_stopWorker = false;
+std::uint32_t SuggestionService::s_nextRequestId = 1;
+std::atomic<std::uint32_t> SuggestionService::s_activeRequestId{0};
+std::uint32_t SuggestionService::s_queuedRequestId = 0;
+std::string SuggestionService::s_queuedContext;
+std::uint64_t SuggestionService::s_queuedFlushTicket = 0;
+std::uint64_t SuggestionService::s_queuedStartTicks = 0;
+bool SuggestionService::s_queuedIsPrefetch = false;
+std::uint32_t SuggestionService::s_prefetchRequestId = 0;
+std::string SuggestionService::s_prefetchContext;
+std::string SuggestionService::s_lastPrefetchContext;
+std::uint64_t SuggestionService::s_prefetchAdoptedTicks = 0;
+std::uint32_t SuggestionService::s_prefetchBudget = 6;
+std::deque<ULONGLONG> SuggestionService::s_prefetchTimes;
+std::uint32_t SuggestionService::s_runningRequestId = 0;
+std::uint64_t SuggestionService::s_runningStartTicks = 0;
+std::uint32_t SuggestionService::s_partialRequestId = 0;
+std::string SuggestionService::s_partialCompletion;
+bool SuggestionService::s_partialPosted = false;
+std::uint32_t SuggestionService::s_resultRequestId = 0;
+std::string SuggestionService::s_resultCompletion;
+bool SuggestionService::s_resultSuccess = false;
+
+void SuggestionService::Initialize(HWND notifyWindow) {
+    if (s_workerThread.joinable()) return;
+
+    s_notifyWindow = notifyWindow;
+    SuggestionCache::Initialize();
+    s_stopWorker = false;
+    s_workerThread = std::thread(WorkerThreadMain);
+
+    std::cout << "[OK] Suggestion service initialized\n";
+}
+
+std::uint32_t SuggestionService::RequestSuggestion(const std::string& context) {
+    std::uint64_t startTicks = Instrumentation::NowTicks();
+    std::uint32_t requestId = NextRequestId();
+
+    // Unchanged context: answer from the cache without waking the worker
+    std::string cached;
+    if (SuggestionCache::Lookup(context, cached)) {
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (!s_queuedIsPrefetch) {
+                s_queuedRequestId = 0;  // Superseded; a queued prefetch still runs for the cache
+            }
+            s_activeRequestId = requestId;
+            s_resultRequestId = requestId;
+            s_resultCompletion = std::move(cached);
+            s_resultSuccess = true;
+        }
+        Instrumentation::RecordSince(Stage::SuggestionTotal, startTicks);
+        std::cout << "[AI] Suggestion served from cache\n";
+        PostMessage(s_notifyWindow, WM_SUGGESTION_READY, requestId, 0);
+        return requestId;
+    }
+
+    // Ask the logger to flush now in case the script fallback needs the file;
+    // the worker waits for the ticket, not this thread
+    std::uint64_t flushTicket = EventLogger::RequestFlush();
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        
+        // A speculative request for this exact context is already on its way: adopt it
+        if (s_prefetchRequestId != 0 && s_prefetchContext == context) {
+            s_activeRequestId = s_prefetchRequestId;
+            s_prefetchAdoptedTicks = startTicks;
+            Instrumentation::Increment(Counter::PrefetchAdopted);
+            std::cout << "[AI] Using speculative request " << s_prefetchRequestId << "\n";
+            return s_prefetchRequestId;
+        }
+        
+        // A prefetch the worker hasn't picked up yet is replaced by the real request
+        if (s_queuedRequestId != 0 && s_queuedIsPrefetch) {
+            s_prefetchRequestId = 0;
+            s_prefetchContext.clear();
+        }
+        
+        s_queuedRequestId = requestId;
+        s_queuedContext = context;
+        s_queuedFlushTicket = flushTicket;
+        s_queuedStartTicks = startTicks;
+        s_queuedIsPrefetch = false;
+        s_activeRequestId = requestId;
+    }
+    s_wake.notify_one();
+
+    return requestId;
+}
+
+bool SuggestionService::Prefetch(const std::string& context) {
+    if (context.empty() || !s_workerThread.joinable()) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        
+        // Never compete with a real request, and don't repeat the last speculation
+        if (s_queuedRequestId != 0 || s_activeRequestId != 0 || s_prefetchRequestId != 0 ||
+            context == s_lastPrefetchContext) {
+            return false;
+        }
+        
+        ULONGLONG now = GetTickCount64();
+        while (!s_prefetchTimes.empty() && now - s_prefetchTimes.front() >= PREFETCH_BUDGET_WINDOW_MS) {
+            s_prefetchTimes.pop_front();
+        }
+        if (s_prefetchTimes.size() >= s_prefetchBudget) {
+            Instrumentation::Increment(Counter::PrefetchBudgetExhausted);
+            return false;
+        }
+        s_prefetchTimes.push_back(now);
+        
+        std::uint32_t requestId = NextRequestId();
+        s_queuedRequestId = requestId;
+        s_queuedContext = context;
+        s_queuedFlushTicket = EventLogger::RequestFlush();
+        s_queuedStartTicks = Instrumentation::NowTicks();
+        s_queuedIsPrefetch = true;
+        s_prefetchRequestId = requestId;
+        s_prefetchContext = context;
+        s_lastPrefetchContext = context;
+    }
+    s_wake.notify_one();
+
+    Instrumentation::Increment(Counter::PrefetchIssued);
+    std::cout << "[AI] Speculative completion requested while idle\n";
+    return true;
+}
+
+void SuggestionService::SetPrefetchBudget(std::uint32_t requestsPerMinute) {
+    s_prefetchBudget = requestsPerMinute;
+    std::cout << "[CONFIG] Speculative completion budget set to " << requestsPerMinute << " per minute\n";
+}
+
+void SuggestionService::CancelPending() {
+    // An in-flight worker request can't be aborted without breaking the pipe
+    // framing, so it is left to finish and its result is discarded
+    if (s_activeRequestId.exchange(0) != 0) {
+        std::cout << "[AI] Suggestion request superseded by new input\n";
+    }
+}
+
+bool SuggestionService::TakeResult(std::uint32_t requestId, std::string& completion, bool& success) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (requestId == 0 || s_resultRequestId != requestId || s_activeRequestId != requestId) {
+        return false;  // Stale notification
+    }
+
+    completion = std::move(s_resultCompletion);
+    success = s_resultSuccess;
+    s_resultCompletion.clear();
+    s_resultRequestId = 0;
+    s_activeRequestId = 0;
+    return true;
+}
+
+bool SuggestionService::TakePartial(std::uint32_t requestId, std::string& textSoFar) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_partialPosted = false;
+    if (requestId == 0 || s_partialRequestId != requestId || s_activeRequestId != requestId) {
+        return false;  // Stale notification
+    }
+
+    textSoFar = s_partialCompletion;
+    return true;
+}
+
+bool SuggestionService::IsBusy() {
+    return s_activeRequestId != 0;
+}
+
+void SuggestionService::Shutdown() {
+    if (!s_workerThread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_stopWorker = true;
+        s_activeRequestId = 0;
+    }
+    s_wake.notify_one();
+
+    // Unblock a request that is waiting on the worker pipe or the network
+    CompletionClient::CancelPendingIo();
+    NativeLlmClient::CancelPendingIo();
+    s_workerThread.join();
+}
+
+void SuggestionService::SetCompletionHandler(CompletionHandler handler) {
+    s_completionHandler = handler;
+}
+
+void SuggestionService::SetBackendStartup(BackendStartupHandler handler) {
+    s_backendStartup = handler;
+}
+
+std::uint32_t SuggestionService::NextRequestId() {
+    std::uint32_t requestId = s_nextRequestId++;
+    if (requestId == 0) {
+        requestId = s_nextRequestId++;  // 0 means "no request"
+    }
+    return requestId;
+}
+
+void SuggestionService::OnPartialCompletion(const std::string& textSoFar) {
+    std::uint32_t requestId = s_runningRequestId;
+    bool firstPartial;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (s_activeRequestId != requestId) {
+            return;  // Nobody is waiting for this text (cancelled, or a prefetch not adopted yet)
+        }
+        firstPartial = s_partialRequestId != requestId;
+        s_partialRequestId = requestId;
+        s_partialCompletion = textSoFar;
+        if (s_partialPosted) {
+            return;  // The UI thread picks up the newest text with the pending message
+        }
+        s_partialPosted = true;
+    }
+
+    if (firstPartial) {
+        Instrumentation::RecordSince(Stage::FirstPartial, s_runningStartTicks);
+    }
+    PostMessage(s_notifyWindow, WM_SUGGESTION_PARTIAL, requestId, 0);
+}
+
+void SuggestionService::WorkerThreadMain() {
+    if (s_backendStartup) {
+        s_backendStartup();
+    }
+
+    while (true) {
+        std::uint32_t requestId;
+        std::string context;
+        std::uint64_t flushTicket;
+        std::uint64_t startTicks;
+        bool isPrefetch;
+        {
+            std::unique_lock<std::mutex> lock(s_mutex);
+            s_wake.wait(lock, [] { return s_stopWorker || s_queuedRequestId != 0; });
+            if (s_stopWorker) {
+                break;
+            }
+            requestId = s_queuedRequestId;
+            context = std::move(s_queuedContext);
+            flushTicket = s_queuedFlushTicket;
+            startTicks = s_queuedStartTicks;
+            isPrefetch = s_queuedIsPrefetch;
+            s_queuedRequestId = 0;
+        }
+
+        // Speculative requests always run: their result is cached even if nobody adopts them
+        std::string completion;
+        bool success = false;
+        if (isPrefetch || s_activeRequestId == requestId) {
+            s_runningRequestId = requestId;
+            s_runningStartTicks = startTicks;
+            success = GenerateCompletion(context, flushTicket, completion);
+            s_runningRequestId = 0;
+            if (success && !completion.empty()) {
+                SuggestionCache::Insert(context, completion);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (isPrefetch && s_prefetchRequestId == requestId) {
+                s_prefetchRequestId = 0;
+                s_prefetchContext.clear();
+                startTicks = s_prefetchAdoptedTicks;  // Only used if adopted below
+            }
+            if (s_partialRequestId == requestId) {
+                s_partialRequestId = 0;
+                s_partialCompletion.clear();
+            }
+            if (s_activeRequestId != requestId) {
+                continue;  // Superseded or cancelled while running
+            }
+            s_resultRequestId = requestId;
+            s_resultCompletion = std::move(completion);
+            s_resultSuccess = success;
+        }
+        Instrumentation::RecordSince(Stage::SuggestionTotal, startTicks);
+        PostMessage(s_notifyWindow, WM_SUGGESTION_READY, requestId, 0);
+        StartupTimeline::MarkFirstSuggestion(Instrumentation::TicksToMicros(Instrumentation::NowTicks() - startTicks));
+    }
+}
+
+bool SuggestionService::GenerateCompletion(const std::string& context, std::uint64_t flushTicket, std::string& completion) {
+    if (s_completionHandler) {
+        return s_completionHandler(context, completion);
+    }
+    
+    // The built-in client is used without Python, so it has no script fallback
+    if (NativeLlmClient::IsReady()) {
+        return NativeLlmClient::RequestCompletion(context, completion, OnPartialCompletion);
+    }
+    
+    // Prefer the persistent worker with the in-memory context; no log file rescan needed.
+    // A worker that was lost is relaunched here (with backoff) rather than on the input thread.
+    if (CompletionClient::EnsureConnected()) {
+        if (CompletionClient::RequestCompletion(context, COMPLETION_CONTEXT_IN_PAYLOAD, completion, OnPartialCompletion)) {
+            return true;
+        }
+        std::cout << "[WARNING] Completion worker failed, falling back to process_input.py\n";
+    }
+    
+    // The script reads input_events.txt, so the records it needs must be written first
+    EventLogger::WaitForFlush(flushTicket);
+    return RunCompletionScript(completion);
+}
+
+bool SuggestionService::RunCompletionScript(std::string& completion) {
+    completion.clear();
+
+    // Call Python script to process input_events.txt (script is now in same directory as exe)
+    std::string pythonCmd = "python process_input.py";
+    int result;
+    {
+        ScopedSpan span(Stage::ScriptRun);
+        result = system(pythonCmd.c_str());
+    }
+
+    if (result != 0) {
+        std::cout << "[ERROR] Python script failed with exit code: " << result << "\n";
+        return false;
+    }
+
+    // Read Python output (now in same directory as executable)
+    ScopedSpan span(Stage::OutputReadback);
+    std::ifstream outputFile("python_output.txt");
+    if (!outputFile.is_open()) {
+        std::cout << "[ERROR] Could not open python_output.txt\n";
+        return false;
+    }
+
+    if (!std::getline(outputFile, completion)) {
+        std::cout << "[ERROR] Could not read Python output\n";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Posted to the notify window when a suggestion request finishes (wParam = request id)
+constexpr UINT WM_SUGGESTION_READY = WM_USER + 2;
+
+// Posted to the notify window when more of a streamed suggestion has arrived (wParam = request id).
+// Updates are coalesced: at most one is pending until TakePartial collects it.
+constexpr UINT WM_SUGGESTION_PARTIAL = WM_USER + 3;
+
+// Replacement completion source (e.g. a fixed-latency fake for benchmarks).
+// Runs on the suggestion worker thread; returns false on failure.
+using CompletionHandler = bool (*)(const std::string& context, std::string& completion);
+
+// Starts the completion backend (worker process, native client, connection warm-up).
+// Runs on the suggestion worker thread before the first request is taken.
+using BackendStartupHandler = void (*)();
+
+// Runs suggestion generation on a background thread so the WM_INPUT loop
+// never waits on the LLM. Each request gets an id; a newer request or new
+// user input supersedes older ones and their results are discarded.
+class SuggestionService {
+public:
+    // Start the worker thread; results are posted to notifyWindow
+    static void Initialize(HWND notifyWindow);
+
+    // Queue a new request for the given input context, superseding any pending
+    // or in-flight one. A SuggestionCache hit is posted back immediately. Returns its id.
+    static std::uint32_t RequestSuggestion(const std::string& context);
+
+    // Start a speculative request for context while the user is idle. Its result goes to the
+    // SuggestionCache; a RequestSuggestion for the same context adopts it if still running.
+    // Returns false if a request is already pending, context was speculated last time, or the
+    // per-minute budget is used up.
+    static bool Prefetch(const std::string& context);
+
+    // Maximum speculative requests per minute (default: 6, 0 disables them)
+    static void SetPrefetchBudget(std::uint32_t requestsPerMinute);
+
+    // Drop the current request (e.g. the user kept typing)
+    static void CancelPending();
+
+    // Collect the result announced by WM_SUGGESTION_READY.
+    // Returns false if the request was superseded or cancelled in the meantime.
+    static bool TakeResult(std::uint32_t requestId, std::string& completion, bool& success);
+
+    // Collect the text streamed so far, announced by WM_SUGGESTION_PARTIAL.
+    // Returns false if the request was superseded, cancelled or already finished.
+    static bool TakePartial(std::uint32_t requestId, std::string& textSoFar);
+
+    // True while a request is queued or running
+    static bool IsBusy();
+
+    // Stop the worker thread, aborting any in-flight request
+    static void Shutdown();
+
+    // Use handler instead of the completion worker and script (nullptr restores them).
+    // Call before Initialize.
+    static void SetCompletionHandler(CompletionHandler handler);
+
+    // Run handler on the worker thread when it starts, so backend startup doesn't delay
+    // input capture; requests made meanwhile wait for it. Call before Initialize.
+    static void SetBackendStartup(BackendStartupHandler handler);
+
+private:
+    // Worker thread body
+    static void WorkerThreadMain();
+
+    // Produce a completion using the persistent worker, or the one-shot script as a fallback
+    static bool GenerateCompletion(const std::string& context, std::uint64_t flushTicket, std::string& completion);
+
+    // Legacy completion path: run process_input.py once and read python_output.txt
+    static bool RunCompletionScript(std::string& completion);
+
+    // Allocate a nonzero request id
+    static std::uint32_t NextRequestId();
+
+    // PartialCompletionHandler for the request the worker is running
+    static void OnPartialCompletion(const std::string& textSoFar);
+
+    static HWND s_notifyWindow;
+    static CompletionHandler s_completionHandler;
+    static BackendStartupHandler s_backendStartup;
+    static std::thread s_workerThread;
+    static std::mutex s_mutex;
+    static std::condition_variable s_wake;
+    static bool s_stopWorker;
+
+    static std::uint32_t s_nextRequestId;
+    static std::atomic<std::uint32_t> s_activeRequestId;  // 0 = nothing wanted
+    static std::uint32_t s_queuedRequestId;                // Not yet picked up by the worker
+    static std::string s_queuedContext;
+    static std::uint64_t s_queuedFlushTicket;              // Log flush the script fallback must wait for
+    static std::uint64_t s_queuedStartTicks;               // Instrumentation ticks when the request was made
+    static bool s_queuedIsPrefetch;
+
+    // Speculative requests, guarded by s_mutex
+    static std::uint32_t s_prefetchRequestId;              // Queued or running prefetch (0 = none)
+    static std::string s_prefetchContext;
+    static std::string s_lastPrefetchContext;              // Not speculated twice in a row
+    static std::uint64_t s_prefetchAdoptedTicks;           // When a RequestSuggestion adopted the prefetch
+    static std::uint32_t s_prefetchBudget;
+    static std::deque<ULONGLONG> s_prefetchTimes;          // Start times within the last minute
+
+    // Streamed text of the running request, guarded by s_mutex
+    static std::uint32_t s_runningRequestId;               // Written by the worker thread only
+    static std::uint64_t s_runningStartTicks;
+    static std::uint32_t s_partialRequestId;
+    static std::string s_partialCompletion;
+    static bool s_partialPosted;                           // WM_SUGGESTION_PARTIAL not yet collected
+
+    // Finished result, guarded by s_mutex
+    static std::uint32_t s_resultRequestId;
+    static std::string s_resultCompletion;
+    static bool s_resultSuccess;
+};
@@ -0,0 +1,238 @@
+#include "typed_context.h"
+#include "event_logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Static member definitions
+std::string TypedContext::s_buffer;
+size_t TypedContext::s_maxChars = 2000;
+size_t TypedContext::s_editableChars = 0;
+size_t TypedContext::s_spaceRun = 0;
+std::vector<size_t> TypedContext::s_spaceRuns;
+
+// Mouse positions are rounded to this grid for privacy, as in process_input.py
+constexpr LONG MOUSE_POSITION_GRID = 50;
+
+namespace {
+
+// Floor to the grid (matches Python's // for negative multi-monitor coordinates)
+LONG RoundDownToGrid(LONG value) {
+    LONG rounded = (value / MOUSE_POSITION_GRID) * MOUSE_POSITION_GRID;
+    if (value < 0 && rounded != value) {
+        rounded -= MOUSE_POSITION_GRID;
+    }
+    return rounded;
+}
+
+}  // namespace
+
+void TypedContext::Initialize() {
+    Clear();
+    s_buffer.reserve(s_maxChars * 2 + 64);
+    s_spaceRuns.reserve(s_maxChars);
+    std::cout << "[OK] Typed context initialized (last " << s_maxChars << " characters per request)\n";
+}
+
+void TypedContext::OnKeyboardEvent(USHORT vKey, bool isKeyUp) {
+    // Only process keydown events
+    if (isKeyUp) {
+        return;
+    }
+
+    // Table lookups into the reserved buffer, so typing does not allocate
+    char charValue = EventLogger::VKeyToCharCode(vKey);
+    if (charValue) {
+        AppendChar(charValue);
+        return;
+    }
+
+    if (vKey == VK_BACK) {
+        Backspace();
+        return;
+    }
+
+    const char* keyName = EventLogger::KeyName(vKey);
+    if (!keyName) {
+        AppendToken("[" + EventLogger::VKeyToKeyName(vKey) + "]");
+        return;
+    }
+
+    const char* mapped = MapKeyName(keyName);
+    if (!mapped) {
+        AppendToken("[" + std::string(keyName) + "]");
+    } else if (mapped[0] != '\0' && mapped[1] == '\0') {
+        AppendChar(mapped[0]);  // SPACE, ENTER, TAB
+    } else if (mapped[0] != '\0') {
+        AppendToken(mapped);
+    }
+}
+
+void TypedContext::OnMouseButtonEvent(const std::string& button, bool isButtonUp, POINT cursorPos) {
+    // Only show the click, not the release
+    if (isButtonUp) {
+        return;
+    }
+
+    const char* clickName = nullptr;
+    if (button == "left") clickName = "MouseLeftClick";
+    else if (button == "right") clickName = "MouseRightClick";
+    else if (button == "middle") clickName = "MouseMiddleClick";
+    else return;
+
+    AppendToken(std::string("[") + clickName + "(" + std::to_string(RoundDownToGrid(cursorPos.x)) + ","
+           + std::to_string(RoundDownToGrid(cursorPos.y)) + ")]");
+}
+
+void TypedContext::OnMouseMotion(const MouseMotionSummary& summary) {
+    if (summary.type == MouseEventData::WHEEL) {
+        if (summary.wheelDelta == 0) {
+            return;
+        }
+        std::int32_t notches = std::abs(summary.wheelDelta) / WHEEL_DELTA;
+        AppendToken(std::string(summary.wheelDelta > 0 ? "[ScrollUp(" : "[ScrollDown(")
+               + std::to_string(notches > 0 ? notches : 1) + ")]");
+        return;
+    }
+
+    // Jitter within one grid cell carries no context
+    LONG fromX = RoundDownToGrid(summary.startPos.x);
+    LONG fromY = RoundDownToGrid(summary.startPos.y);
+    LONG toX = RoundDownToGrid(summary.endPos.x);
+    LONG toY = RoundDownToGrid(summary.endPos.y);
+    if (fromX == toX && fromY == toY) {
+        return;
+    }
+    AppendToken("[MouseMove(" + std::to_string(fromX) + "," + std::to_string(fromY) + "->"
+           + std::to_string(toX) + "," + std::to_string(toY) + ")]");
+}
+
+std::string TypedContext::GetContext(size_t maxChars) {
+    if (maxChars == 0) {
+        maxChars = s_maxChars;
+    }
+    if (s_buffer.size() <= maxChars) {
+        return s_buffer;
+    }
+
+    size_t start = s_buffer.size() - maxChars;
+
+    // If the cut lands inside a [TOKEN], skip to the end of that token
+    size_t nextClose = s_buffer.find(']', start);
+    size_t nextOpen = s_buffer.find('[', start);
+    if (nextClose != std::string::npos && (nextOpen == std::string::npos || nextClose < nextOpen)) {
+        start = nextClose + 1;
+    }
+
+    return s_buffer.substr(start);
+}
+
+size_t TypedContext::GetLength() {
+    return s_buffer.size();
+}
+
+void TypedContext::Clear() {
+    s_buffer.clear();
+    s_editableChars = 0;
+    s_spaceRun = 0;
+    s_spaceRuns.clear();
+}
+
+void TypedContext::SetMaxChars(size_t maxChars) {
+    s_maxChars = maxChars > 0 ? maxChars : 1;
+    std::cout << "[CONFIG] Typed context limit set to " << s_maxChars << " characters\n";
+}
+
+const char* TypedContext::MapKeyName(std::string_view keyName) {
+    // Convert some common key names to more readable format for LLM understanding
+    static const struct {
+        const char* keyName;
+        const char* token;
+    } keyMapping[] = {
+        { "SPACE", " " },
+        { "ENTER", "\n" },
+        { "TAB", "\t" },
+        { "BACKSPACE", "[BACKSPACE]" },
+        { "DELETE", "[DELETE]" },
+        { "UP_ARROW", "[UP]" },
+        { "DOWN_ARROW", "[DOWN]" },
+        { "LEFT_ARROW", "[LEFT]" },
+        { "RIGHT_ARROW", "[RIGHT]" },
+        { "HOME", "[HOME]" },
+        { "END", "[END]" },
+        { "PAGE_UP", "[PAGEUP]" },
+        { "PAGE_DOWN", "[PAGEDOWN]" },
+        { "INSERT", "[INSERT]" },
+        // Only filter out modifier keys that don't add context
+        { "SHIFT", "" },      // Shift effect is already reflected in capitalization
+        { "CTRL", "" },       // Ctrl combinations are handled separately
+        { "ALT", "" },        // Alt combinations are handled separately
+        { "CAPS_LOCK", "[CAPS]" },
+    };
+
+    for (const auto& entry : keyMapping) {
+        if (keyName == entry.keyName) {
+            return entry.token;
+        }
+    }
+    return nullptr;  // Unmapped keys become [KEY_NAME]
+}
+
+void TypedContext::AppendChar(char c) {
+    if (c == ' ' && s_spaceRun > 0) {
+        ++s_spaceRun;
+        return;
+    }
+    if (s_spaceRun > 0) {
+        // Erasing back to this run must restore how many spaces it still holds
+        s_spaceRuns.push_back(s_spaceRun);
+    }
+    Append(std::string_view(&c, 1));
+    ++s_editableChars;
+    s_spaceRun = c == ' ' ? 1 : 0;
+}
+
+void TypedContext::AppendToken(std::string_view token) {
+    Append(token);
+    s_editableChars = 0;
+    s_spaceRun = 0;
+    s_spaceRuns.clear();
+}
+
+void TypedContext::Backspace() {
+    if (s_editableChars == 0) {
+        AppendToken("[BACKSPACE]");
+        return;
+    }
+    if (s_spaceRun > 1) {
+        --s_spaceRun;
+        return;
+    }
+    s_buffer.pop_back();
+    --s_editableChars;
+    if (s_editableChars > 0 && s_buffer.back() == ' ' && !s_spaceRuns.empty()) {
+        s_spaceRun = s_spaceRuns.back();
+        s_spaceRuns.pop_back();
+    } else {
+        s_spaceRun = s_editableChars > 0 && s_buffer.back() == ' ' ? 1 : 0;
+    }
+}
+
+void TypedContext::Append(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+
+    s_buffer += text;
+
+    // Trim in bulk so the cost is amortized O(1) per appended character
+    if (s_buffer.size() > s_maxChars * 2) {
+        s_buffer.erase(0, s_buffer.size() - s_maxChars);
+        s_editableChars = (std::min)(s_editableChars, s_buffer.size());
+        // Runs older than the erasable characters left can never be reached again
+        if (s_spaceRuns.size() > s_editableChars) {
+            s_spaceRuns.erase(s_spaceRuns.begin(), s_spaceRuns.end() - s_editableChars);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mouse_coalescer.h"
+
+// Incrementally maintained, bounded text view of recent input.
+// Produces the same sequence as process_input.py's extract_input_sequence
+// (characters, [KEY] tokens, [MouseLeftClick(x,y)] and motion markers) one event at a
+// time, so a suggestion request can send the tail without rescanning the log.
+// It is cleaned as it grows, like input_cleaner.py's InputNormalizer: runs of
+// spaces collapse to one and [BACKSPACE] right after typed characters erases
+// the last one (after a key or click it is kept, the cursor may have moved).
+class TypedContext {
+public:
+    // Reset the buffer
+    static void Initialize();
+
+    // Feed a keyboard event. Call after EventLogger::LogKeyboardEvent so the
+    // shift/caps state used for character mapping is up to date.
+    static void OnKeyboardEvent(USHORT vKey, bool isKeyUp);
+
+    // Feed a mouse button event ("left", "right", "middle")
+    static void OnMouseButtonEvent(const std::string& button, bool isButtonUp, POINT cursorPos);
+
+    // Feed a coalesced motion run: [MouseMove(x,y->x,y)] when it crosses a grid cell,
+    // [ScrollUp(n)]/[ScrollDown(n)] for wheel notches
+    static void OnMouseMotion(const MouseMotionSummary& summary);
+
+    // The most recent maxChars characters (0 = the configured limit).
+    // The cut never starts in the middle of a [TOKEN].
+    static std::string GetContext(size_t maxChars = 0);
+
+    // Number of characters currently retained
+    static size_t GetLength();
+
+    // Drop all retained context
+    static void Clear();
+
+    // Maximum number of characters sent with a request (default: 2000)
+    static void SetMaxChars(size_t maxChars);
+
+private:
+    // Map a key name without a character to its context token (mirrors key_mapping in process_input.py)
+    static const char* MapKeyName(std::string_view keyName);
+
+    // Append a typed character (spaces merge into a trailing space)
+    static void AppendChar(char c);
+
+    // Append a [TOKEN]; typed characters before it can no longer be erased
+    static void AppendToken(std::string_view token);
+
+    // Apply a backspace: erase the last typed character, or append [BACKSPACE]
+    static void Backspace();
+
+    // Append text and trim the buffer when it grows past twice the limit
+    static void Append(std::string_view text);
+
+    static std::string s_buffer;
+    static size_t s_maxChars;
+    static size_t s_editableChars;  // Trailing typed characters a backspace may erase
+    static size_t s_spaceRun;       // Raw spaces merged into the trailing space (0 = no trailing run)
+    static std::vector<size_t> s_spaceRuns;  // Raw lengths of the earlier spaces among the erasable characters
+};